@@ -7,7 +7,7 @@
  */
 #include "analog_filter.h"
 
-int analog_vals[ANALOG_CHANS];
+int analog_vals[ANALOG_CHANS];  // smoothed values - with ANALOG_FRAC_BITS fraction bits
 int analog_outs[ANALOG_CHANS];
 int analog_window[ANALOG_CHANS];
 int analog_smoothing[ANALOG_CHANS];
@@ -45,10 +45,11 @@ void analog_filter_set_val(unsigned char chan, int newval) {
 	if(chan >= ANALOG_CHANS) {
 		return;
 	}
-	// smoothing
+	// smoothing - the fraction bits stop the value sticking short of the input
 	smooth = analog_smoothing[chan];
-	temp = ((analog_vals[chan] * smooth) + (newval * (255 - smooth))) >> 8;
+	temp = ((analog_vals[chan] * smooth) + ((newval << ANALOG_FRAC_BITS) * (256 - smooth))) >> 8;
 	analog_vals[chan] = temp;
+	temp >>= ANALOG_FRAC_BITS;
 
 	// windowing
 	if(temp <= ANALOG_MINTH) {
@@ -13,6 +13,7 @@
 #define ANALOG_MINVAL 0x000
 #define ANALOG_MAXTH 0xfd0
 #define ANALOG_MINTH 0x020
+#define ANALOG_FRAC_BITS 4  // extra bits kept by the smoothing filter
 
 // defaults
 #define ANALOG_WINDOW_THRESH 32
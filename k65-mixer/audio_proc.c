@@ -45,6 +45,7 @@ extern int16_t audio_rec_buf[AUDIO_BUF_SIZE];
 extern int16_t audio_play_buf[AUDIO_BUF_SIZE];
 extern int audio_stream_p;
 int proc_buf;
+int32_t audio_proc_peak[2];  // highest output sample since the last read - L / R
 
 // local functions
 static inline int32_t scale(int32_t samp, int16_t scale);
@@ -52,6 +53,8 @@ static inline int32_t scale(int32_t samp, int16_t scale);
 // init the audio processor
 void audio_proc_init(void) {
 	proc_buf = 0;
+	audio_proc_peak[0] = 0;
+	audio_proc_peak[1] = 0;
 	delay_tempo_count = 0;
 	delay_buf_p = 0;
 }
@@ -233,6 +236,14 @@ void audio_proc_process(void) {
 
 	proc_buf = page;
 
+	// peak hold for monitoring
+	if(outL_meter > audio_proc_peak[0]) {
+		audio_proc_peak[0] = outL_meter;
+	}
+	if(outR_meter > audio_proc_peak[1]) {
+		audio_proc_peak[1] = outR_meter;
+	}
+
 	// level meters - do threshold
 	if(outL_meter > METER_THRESHOLD) {
 		outL_meter = METER_LED_BLINK_TIME;
@@ -254,6 +265,17 @@ static inline int32_t scale(int32_t samp, int16_t scale) {
 	return (samp * scale) >> 14;
 }
 
+// get the highest output sample since the last call - side: 0 = left, 1 = right
+int audio_proc_get_peak(int side) {
+	int peak;
+	if(side < 0 || side > 1) {
+		return 0;
+	}
+	peak = audio_proc_peak[side];
+	audio_proc_peak[side] = 0;
+	return peak;
+}
+
 // generate silent output
 void audio_proc_silence(void) {
 	int i;
@@ -17,4 +17,7 @@ void audio_proc_process(void);
 // generate silent output
 void audio_proc_silence(void);
 
+// get the highest output sample since the last call - side: 0 = left, 1 = right
+int audio_proc_get_peak(int side);
+
 #endif
@@ -22,6 +22,7 @@
 #include "audio_sys_ctrl.h"
 #include "WM8731_ctrl.h"
 #include "audio_proc.h"
+#include "isr_load.h"
 
 // hardware defines
 #define I2C1_SCL_TRIS TRISBbits.TRISB8
@@ -259,6 +260,7 @@ void __ISR(_SPI_1_VECTOR, ipl4) SPI_I2S_TRANSMIT(void) {
 #ifdef SINE_OUTPUT_TEST
 	int inL, inR;
 #endif
+	unsigned int load_start = isr_load_start();
     while(SPI1STATbits.TXBUFELM <= 4) {
 #ifdef SINE_OUTPUT_TEST
 		// get ADC samples
@@ -279,4 +281,5 @@ void __ISR(_SPI_1_VECTOR, ipl4) SPI_I2S_TRANSMIT(void) {
 #endif
 	}
     IFS1bits.SPI1TXIF = 0; // clear interrupt flag
+	isr_load_end(ISR_LOAD_SPI1, load_start);
 }
@@ -8,33 +8,98 @@
 #include "cv_gate_ctrl.h"
 #include "ioctl.h"
 #include "utils.h"
+#include "seq_store.h"
 
 #define NOTE_TABLE_LEN 128
 #define DAC_OFFSET 79
 #define CV_DAC_HI 3800
+#define CV_DAC_NONE -1  // nothing written yet
+#define GLIDE_OCTAVE ((12 * NOTE_STEP_SIZE) << 16)  // one octave in 16.16
+#define GLIDE_OUT(chan) ((glide_pos[chan] + 0x8000) >> 16)  // rounded glide output
+#define CV_CAL_NOTE(point) (((point) + 1) * 12)  // note for a calibration point
+#define CV_CAL_RANGE 127  // max correction in DAC steps
+#define CV_CAL_ZERO 0x8000  // saved points are offset so they are never blank
 unsigned int note_lookup[NOTE_TABLE_LEN];
+unsigned int note_bend_scale[NOTE_TABLE_LEN];  // semitone size vs. nominal - 8.8 fixed point
+int cal_point[CV_CAL_POINTS + 1];  // per octave correction in DAC steps - saved in pairs
+unsigned char cal_sel;  // selected calibration point
+unsigned char note1_cur;  // the current note on CV1
+unsigned char note2_cur;  // the current note on CV2
 int bend1;
+int bend1_cal;  // bend1 scaled for the current note
 int bend2;
+int bend2_cal;  // bend2 scaled for the current note
 int dac1_cur;  // the current DAC value not including the bend
 int dac2_cur;  // the current DAC value not including the bend
+// glide
+int glide_pos[2];  // the current output in DAC steps - 16.16 fixed point
+int glide_step[2];  // the glide step per ms - 16.16 fixed point
+int dac_last[2];  // the last value written to the DAC
+unsigned char gate_on[2];  // the current gate state
+unsigned char glide_mode;  // constant time or constant rate
+unsigned char glide_legato;  // 1 = only glide between overlapping notes
+int glide_time;  // the glide time in ms - 0 = off
+unsigned char gate2_en;  // 1 = the clock out is used as gate 2
+
+// local functions
+void cv_gate_ctrl_glide_start(unsigned char chan, int dac);
+void cv_gate_ctrl_gate2_out(unsigned char on);
+void cv_gate_ctrl_write(unsigned char chan, int val);
+void cv_gate_ctrl_cal_build(void);
 
 // init the CV/gate control code
 void cv_gate_ctrl_init(void) {
-	int i;
-	int step_pos;
 	// make the note lookup table
-	step_pos = DAC_OFFSET;
-	for(i = 0; i < NOTE_TABLE_LEN; i ++) {
-		note_lookup[i] = step_pos;
-		step_pos += NOTE_STEP_SIZE;
-	}
+	cv_gate_ctrl_cal_load();
 
 	bend1 = 0;
+	bend1_cal = 0;
 	bend2 = 0;
+	bend2_cal = 0;
+	gate2_en = 0;
+	dac_last[0] = CV_DAC_NONE;
+	dac_last[1] = CV_DAC_NONE;
+	cv_gate_ctrl_set_glide(0, CV_GLIDE_TIME, 0);
 	cv_gate_ctrl_note(0, 60, 0);
 	cv_gate_ctrl_note(1, 60, 0);
 }
 
+// run the glide - 1000us
+void cv_gate_ctrl_timer_task(void) {
+	int target;
+	// CV1
+	target = dac1_cur << 16;
+	if(glide_pos[0] != target) {
+		glide_pos[0] += glide_step[0];
+		if((glide_step[0] > 0 && glide_pos[0] > target) ||
+				(glide_step[0] < 0 && glide_pos[0] < target)) {
+			glide_pos[0] = target;
+		}
+		cv_gate_ctrl_write(0, GLIDE_OUT(0) + bend1_cal);
+	}
+	// CV2
+	target = dac2_cur << 16;
+	if(glide_pos[1] != target) {
+		glide_pos[1] += glide_step[1];
+		if((glide_step[1] > 0 && glide_pos[1] > target) ||
+				(glide_step[1] < 0 && glide_pos[1] < target)) {
+			glide_pos[1] = target;
+		}
+		cv_gate_ctrl_write(1, GLIDE_OUT(1) + bend2_cal);
+	}
+}
+
+// set up the glide
+// - time = glide time in ms - 0 = off
+// - mode = CV_GLIDE_TIME = time for any interval, CV_GLIDE_RATE = time per octave
+// - legato = 1 = only glide when the gate is already on
+void cv_gate_ctrl_set_glide(int time, unsigned char mode, unsigned char legato) {
+	if(time < 0) time = 0;
+	glide_time = time;
+	glide_mode = mode;
+	glide_legato = legato;
+}
+
 // set CV output
 void cv_gate_ctrl_note(unsigned char chan, unsigned char note, unsigned char on) {
 	if(chan > 1) return;
@@ -44,41 +109,49 @@ void cv_gate_ctrl_note(unsigned char chan, unsigned char note, unsigned char on)
 	if(on) {
 		// CV2 / GATE2
 		if(chan) {
-//			dac2_cur = note_lookup[note];
-//			ioctl_set_midi_cv_out(1, clamp(dac2_cur + bend2, 0, 4095));
-//			ioctl_set_midi_clock_out(1);  // clock used as gate 2
+			dac2_cur = note_lookup[note];
+			note2_cur = note;
+			bend2_cal = (bend2 * (int)note_bend_scale[note]) >> 8;
+			cv_gate_ctrl_glide_start(1, dac2_cur);
+			cv_gate_ctrl_write(1, GLIDE_OUT(1) + bend2_cal);
+			cv_gate_ctrl_gate2_out(1);
 		}
 		// CV1 / GATE1
 		else {
 			dac1_cur = note_lookup[note];
-			ioctl_set_midi_cv_out(0, clamp(dac1_cur + bend1, 0, 4095));
+			note1_cur = note;
+			bend1_cal = (bend1 * (int)note_bend_scale[note]) >> 8;
+			cv_gate_ctrl_glide_start(0, dac1_cur);
+			cv_gate_ctrl_write(0, GLIDE_OUT(0) + bend1_cal);
 			ioctl_set_midi_gate_out(1);
+			gate_on[0] = 1;
 		}
 	}
 	// note off
 	else {
 		// CV2 / GATE2
 		if(chan) {
-//			ioctl_set_midi_clock_out(0);  // clock used as gate 2
+			cv_gate_ctrl_gate2_out(0);
 		}
 		// CV1 / GATE1
 		else {
 			ioctl_set_midi_gate_out(0);
+			gate_on[0] = 0;
 		}
 	}
 }
 
 // set the CV output bend
 void cv_gate_ctrl_bend(unsigned char chan, int bend) {
-	int temp;
 	if(chan) {
 		bend2 = bend;
-		temp = dac2_cur + bend2;
-		ioctl_set_midi_cv_out(1, clamp(dac2_cur + bend2, 0, 4095));
+		bend2_cal = (bend2 * (int)note_bend_scale[note2_cur]) >> 8;
+		cv_gate_ctrl_write(1, GLIDE_OUT(1) + bend2_cal);
 	}
 	else {
 		bend1 = bend;
-		ioctl_set_midi_cv_out(0, clamp(dac1_cur + bend1, 0, 4095));
+		bend1_cal = (bend1 * (int)note_bend_scale[note1_cur]) >> 8;
+		cv_gate_ctrl_write(0, GLIDE_OUT(0) + bend1_cal);
 	}
 }
 
@@ -86,24 +159,163 @@ void cv_gate_ctrl_bend(unsigned char chan, int bend) {
 void cv_gate_ctrl_cv(unsigned char chan, unsigned int val) {
 	if(chan) {
 		dac2_cur = (val & 0xfff) + DAC_OFFSET;
-		if(dac2_cur > CV_DAC_HI) dac2_cur = CV_DAC_HI;		
-		ioctl_set_midi_cv_out(1, dac2_cur);
+		if(dac2_cur > CV_DAC_HI) dac2_cur = CV_DAC_HI;
+		glide_pos[1] = dac2_cur << 16;
+		glide_step[1] = 0;
+		cv_gate_ctrl_write(1, dac2_cur);
 	}
 	else {
 		dac1_cur = (val & 0xfff) + DAC_OFFSET;
 		if(dac1_cur > CV_DAC_HI) dac1_cur = CV_DAC_HI;
-		ioctl_set_midi_cv_out(0, dac1_cur);
+		glide_pos[0] = dac1_cur << 16;
+		glide_step[0] = 0;
+		cv_gate_ctrl_write(0, dac1_cur);
 	}
 }
 
 //set the gate output for CC / pitch bend
 void cv_gate_ctrl_gate(unsigned char chan, unsigned char on) {
-	unsigned char val = 0;
-	if(on) val = 255;
 	if(chan) {
-//		ioctl_set_midi_clock_out(on);  // clock used as gate 2
+		cv_gate_ctrl_gate2_out(on);
 	}
 	else {
 		ioctl_set_midi_gate_out(on);
+		gate_on[0] = on;
+	}
+}
+
+// force the outputs to the nominal value and the gates off - used when powered off
+void cv_gate_ctrl_off(void) {
+	ioctl_set_midi_cv_out(0, DAC_VAL_NOM);
+	ioctl_set_midi_cv_out(1, DAC_VAL_NOM);
+	ioctl_set_midi_gate_out(0);
+	cv_gate_ctrl_gate2_out(0);
+	dac_last[0] = DAC_VAL_NOM;
+	dac_last[1] = DAC_VAL_NOM;
+	gate_on[0] = 0;
+}
+
+// set whether the clock out is used as gate 2 - 0 = MIDI clock, 1 = gate 2
+void cv_gate_ctrl_set_gate2(unsigned char enable) {
+	cv_gate_ctrl_gate2_out(0);
+	gate2_en = enable & 0x01;
+}
+
+// get whether the clock out is used as gate 2
+unsigned char cv_gate_ctrl_get_gate2(void) {
+	return gate2_en;
+}
+
+// load the calibration from flash and build the note table
+void cv_gate_ctrl_cal_load(void) {
+	int i, temp;
+	for(i = 0; i < CV_CAL_POINTS; i += 2) {
+		temp = seq_store_get_setting(SEQ_STORE_SETTING_CV_CAL + (i >> 1),
+			CV_CAL_ZERO | (CV_CAL_ZERO << 16));
+		cal_point[i] = (temp & 0xffff) - CV_CAL_ZERO;
+		cal_point[i + 1] = (((unsigned int)temp >> 16) & 0xffff) - CV_CAL_ZERO;
+	}
+	cv_gate_ctrl_cal_build();
+}
+
+// save the calibration to flash
+// - the pair is packed unsigned so the upper point can't overflow an int
+void cv_gate_ctrl_cal_save(void) {
+	int i;
+	unsigned int temp;
+	for(i = 0; i < CV_CAL_POINTS; i += 2) {
+		temp = (unsigned int)(cal_point[i] + CV_CAL_ZERO) & 0xffff;
+		temp |= ((unsigned int)(cal_point[i + 1] + CV_CAL_ZERO) & 0xffff) << 16;
+		seq_store_set_setting(SEQ_STORE_SETTING_CV_CAL + (i >> 1), (int)temp);
+	}
+}
+
+// select a calibration point and play its note on CV1
+// - point 0-8 = the C in each octave from note 12
+void cv_gate_ctrl_cal_select(unsigned char point) {
+	if(point >= CV_CAL_POINTS) point = CV_CAL_POINTS - 1;
+	cal_sel = point;
+	cv_gate_ctrl_note(0, CV_CAL_NOTE(cal_sel), 1);
+}
+
+// set the correction for the selected calibration point in DAC steps
+void cv_gate_ctrl_cal_adjust(int offset) {
+	cal_point[cal_sel] = clamp(offset, -CV_CAL_RANGE, CV_CAL_RANGE);
+	cv_gate_ctrl_cal_build();
+	cv_gate_ctrl_note(0, CV_CAL_NOTE(cal_sel), 1);
+}
+
+//
+// local functions
+//
+// build the note table from the calibration points
+// - the correction is interpolated between the points in each octave
+// - notes outside the points use the nearest point
+void cv_gate_ctrl_cal_build(void) {
+	int i, point, corr, val;
+	int last = -1;
+	for(i = 0; i < NOTE_TABLE_LEN; i ++) {
+		point = (i / 12) - 1;
+		if(point < 0) {
+			corr = cal_point[0];
+		}
+		else if(point >= CV_CAL_POINTS - 1) {
+			corr = cal_point[CV_CAL_POINTS - 1];
+		}
+		else {
+			corr = cal_point[point] + (((cal_point[point + 1] -
+				cal_point[point]) * (i % 12)) / 12);
+		}
+		val = DAC_OFFSET + (i * NOTE_STEP_SIZE) + corr;
+		// keep the table rising so a bad calibration can't fold notes over
+		if(val <= last) val = last + 1;
+		val = clamp(val, 0, 4095);
+		note_lookup[i] = val;
+		last = val;
+	}
+	// bend scale - how big a semitone is above each note
+	for(i = 0; i < NOTE_TABLE_LEN - 1; i ++) {
+		note_bend_scale[i] = ((note_lookup[i + 1] - note_lookup[i]) << 8) /
+			NOTE_STEP_SIZE;
+	}
+	note_bend_scale[NOTE_TABLE_LEN - 1] = note_bend_scale[NOTE_TABLE_LEN - 2];
+}
+
+// start a glide to a new note
+void cv_gate_ctrl_glide_start(unsigned char chan, int dac) {
+	int delta = (dac << 16) - glide_pos[chan];
+	int dist = (delta < 0) ? -delta : delta;
+	// jump straight to the note
+	if(glide_time == 0 || delta == 0 || (glide_legato && !gate_on[chan])) {
+		glide_pos[chan] = dac << 16;
+		glide_step[chan] = 0;
+	}
+	// the steps are rounded up so a slow glide doesn't end late
+	// - the timer task stops at the note
+	// constant time - the whole glide takes the same time
+	else if(glide_mode == CV_GLIDE_TIME) {
+		glide_step[chan] = (dist + glide_time - 1) / glide_time;
+		if(delta < 0) glide_step[chan] = -glide_step[chan];
 	}
+	// constant rate - the glide time is per octave
+	else {
+		glide_step[chan] = (GLIDE_OCTAVE + glide_time - 1) / glide_time;
+		if(delta < 0) glide_step[chan] = -glide_step[chan];
+	}
+}
+
+// set the gate 2 output - only used if the clock out is gate 2
+void cv_gate_ctrl_gate2_out(unsigned char on) {
+	gate_on[1] = on;
+	if(!gate2_en) return;
+	if(on) ioctl_set_midi_clock_out(IOCTL_CLOCK_OUT_ON);
+	else ioctl_set_midi_clock_out(0);
+}
+
+// write a value to the DAC - only if it changed
+void cv_gate_ctrl_write(unsigned char chan, int val) {
+	val = clamp(val, 0, 4095);
+	if(val == dac_last[chan]) return;
+	dac_last[chan] = val;
+	ioctl_set_midi_cv_out(chan, val);
 }
@@ -12,9 +12,25 @@
 #define NOTE_HIGH 115
 #define NOTE_STEP_SIZE 31
 
+// glide modes
+#define CV_GLIDE_TIME 0  // the glide time is the same for any interval
+#define CV_GLIDE_RATE 1  // the glide time is per octave
+
+// calibration
+#define CV_CAL_POINTS 9  // correction points - one per octave from note 12
+
 // init the CV/gate control code
 void cv_gate_ctrl_init(void);
 
+// run the glide - 1000us
+void cv_gate_ctrl_timer_task(void);
+
+// set up the glide
+// - time = glide time in ms - 0 = off
+// - mode = CV_GLIDE_TIME = time for any interval, CV_GLIDE_RATE = time per octave
+// - legato = 1 = only glide when the gate is already on
+void cv_gate_ctrl_set_glide(int time, unsigned char mode, unsigned char legato);
+
 // set CV output for note
 void cv_gate_ctrl_note(unsigned char chan, unsigned char note, unsigned char on);
 
@@ -27,4 +43,26 @@ void cv_gate_ctrl_cv(unsigned char chan, unsigned int val);
 // set gate output for CC / pitch
 void cv_gate_ctrl_gate(unsigned char chan, unsigned char on);
 
+// force the outputs to the nominal value and the gates off - used when powered off
+void cv_gate_ctrl_off(void);
+
+// set whether the clock out is used as gate 2 - 0 = MIDI clock, 1 = gate 2
+void cv_gate_ctrl_set_gate2(unsigned char enable);
+
+// get whether the clock out is used as gate 2
+unsigned char cv_gate_ctrl_get_gate2(void);
+
+// load the calibration from flash and build the note table
+void cv_gate_ctrl_cal_load(void);
+
+// save the calibration to flash
+void cv_gate_ctrl_cal_save(void);
+
+// select a calibration point and play its note on CV1
+// - point 0-8 = the C in each octave from note 12
+void cv_gate_ctrl_cal_select(unsigned char point);
+
+// set the correction for the selected calibration point in DAC steps
+void cv_gate_ctrl_cal_adjust(int offset);
+
 #endif
\ No newline at end of file
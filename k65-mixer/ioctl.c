@@ -31,6 +31,7 @@
 #include <plib.h>
 #include "analog_filter.h"
 #include "switch_filter.h"
+#include "timer_wheel.h"
 
 // debug timing using master output LEDs
 //#define LED_DEBUG
@@ -39,6 +40,8 @@
 #define SEQ_LED_TIMEOUT 512
 
 // hardware ADC / filtering channels
+// - the ADC scans the enabled inputs in order into ADC1BUF0-7 so each
+//   channel number is also its result buffer slot
 #define AN_POT_MIXER_MASTER 0
 #define AN_POT_MIXER_DELAY_TIME 1
 #define AN_POT_MIXER_DELAY_MIX 2
@@ -69,22 +72,33 @@
 #define LED_DIVIDER_OUT4 0x40
 #define LED_DIVIDER_OUT6 0x80
 
+// blink timers - each output is turned on when set and turned off by a timer
+#define IOCTL_BLINK_OUTL 0  // mixer out L LED
+#define IOCTL_BLINK_OUTR 1  // mixer out R LED
+#define IOCTL_BLINK_DELAY 2  // delay time LED
+#define IOCTL_BLINK_MIDI_IN 3  // MIDI in LED
+#define IOCTL_BLINK_MIDI_CLOCK 4  // MIDI clock output (jack and LED)
+#define IOCTL_BLINK_MIDI_REC 5  // MIDI rec LED - blink once mode
+#define IOCTL_BLINK_MIDI_PLAY 6  // MIDI play LED - blink once mode
+#define IOCTL_NUM_BLINKS 7
+
 // state
 int ioctl_scan_phase;
-int ioctl_mixer_outL_led_timeout;  // blink time for mixer out L LED
-int ioctl_mixer_outR_led_timeout;  // blink time for mixer out R LED
-int ioctl_mixer_delay_led_timeout;  // blink timeout for delay time LED
-int ioctl_midi_clock_timeout;  // pulse time for MIDI clock output (jack and LED)
-int ioctl_midi_in_led_timeout;  // blink time for MIDI in LED
+int ioctl_blink_timer[IOCTL_NUM_BLINKS];  // timer wheel handles for each blink output
 int ioctl_led_reg;  // control register for the LED shift register (8 additional LEDs)
 // these LEDs can blink once or multiple times
 int ioctl_midi_rec_led_state;  // MIDI rec LED state (as per defines in .h file)
-int ioctl_midi_rec_led_timeout;  // MIDI rec LED timeout
 int ioctl_midi_play_led_state;  // MIDI play LED state (as per defines in .h file)
-int ioctl_midi_play_led_timeout;  // MIDI play LED timeout
+
+// local functions
+void ioctl_blink_start(int blink, int timeout);
+void ioctl_blink_output(int blink, int state);
+void ioctl_blink_expire(int blink);
 
 // init the ioctl
 void ioctl_init(void) {
+	int i;
+
 	// outputs
 	PORTSetPinsDigitalOut(IOPORT_A, BIT_7);
 	PORTSetPinsDigitalOut(IOPORT_B, BIT_5 | BIT_7);
@@ -119,6 +133,11 @@ void ioctl_init(void) {
 	analog_filter_set_smoothing(AN_DC_IN_VSENSE, CV_SMOOTHING);
 	analog_filter_set_smoothing(AN_POT_MIXER_PAN2, POT_SMOOTHING);
 
+	// blink timers
+	for(i = 0; i < IOCTL_NUM_BLINKS; i ++) {
+		ioctl_blink_timer[i] = timer_wheel_alloc(ioctl_blink_expire, i);
+	}
+
 	// reset stuff
 	ioctl_led_reg = 0;
 	ioctl_set_mixer_delay_led(0);
@@ -136,133 +155,42 @@ void ioctl_init(void) {
 
 // run the ioctl timer task
 void ioctl_timer_task(void) {
-	switch(ioctl_scan_phase & 0x07) {
-		case 0:
-			analog_filter_set_val(AN_POT_MIXER_MASTER, ReadADC10(AN_POT_MIXER_MASTER) << 2);
-			switch_filter_set_val(SW_REC, 1, ~IOCTL_MIDI_REC_SW);
-			break;
-		case 1:
-			analog_filter_set_val(AN_POT_MIXER_DELAY_TIME, ReadADC10(AN_POT_MIXER_DELAY_TIME) << 2);
-			switch_filter_set_val(SW_PLAY, 1, ~IOCTL_MIDI_PLAY_SW);
-			break;
-		case 2:
-			analog_filter_set_val(AN_POT_MIXER_DELAY_MIX, ReadADC10(AN_POT_MIXER_DELAY_MIX) << 2);
-			switch_filter_set_val(SW_REC, 1, ~IOCTL_MIDI_REC_SW);
-			break;
-		case 3:
-			analog_filter_set_val(AN_POT_MIXER_IN1_LEVEL, ReadADC10(AN_POT_MIXER_IN1_LEVEL) << 2);
-			switch_filter_set_val(SW_PLAY, 1, ~IOCTL_MIDI_PLAY_SW);
-			break;
-		case 4:
-			analog_filter_set_val(AN_POT_MIXER_IN2_LEVEL, ReadADC10(AN_POT_MIXER_IN2_LEVEL) << 2);
-			switch_filter_set_val(SW_REC, 1, ~IOCTL_MIDI_REC_SW);
-			break;
-		case 5:
-			analog_filter_set_val(AN_POT_MIXER_PAN1, ReadADC10(AN_POT_MIXER_PAN1) << 2);
-			switch_filter_set_val(SW_PLAY, 1, ~IOCTL_MIDI_PLAY_SW);
-			break;
-		case 6:
-			analog_filter_set_val(AN_POT_MIXER_PAN2, ReadADC10(AN_POT_MIXER_PAN2) << 2);
-			switch_filter_set_val(SW_REC, 1, ~IOCTL_MIDI_REC_SW);
-			break;
-		case 7:
-			analog_filter_set_val(AN_DC_IN_VSENSE, ReadADC10(AN_DC_IN_VSENSE) << 2);
-			switch_filter_set_val(SW_PLAY, 1, ~IOCTL_MIDI_PLAY_SW);
-			break;
-	}
+	int i;
 
-	//
-	// LED blinking
-	//
-#ifndef LED_DEBUG
-	// output L
-	if(ioctl_mixer_outL_led_timeout) {
-		IOCTL_MIXER_MASTER_L_LED = 1;
-		ioctl_mixer_outL_led_timeout --;
-	}
-	else {
-		IOCTL_MIXER_MASTER_L_LED = 0;
+	// analog inputs - the ADC scans all channels in the background
+	for(i = 0; i < ANALOG_CHANS; i ++) {
+		analog_filter_set_val(i, ReadADC10(i) << 2);
 	}
 
-	// output R
-	if(ioctl_mixer_outR_led_timeout) {
-		IOCTL_MIXER_MASTER_R_LED = 1;
-		ioctl_mixer_outR_led_timeout --;
+	// switches
+	if(ioctl_scan_phase & 0x01) {
+		switch_filter_set_val(SW_PLAY, 1, ~IOCTL_MIDI_PLAY_SW);
 	}
 	else {
-		IOCTL_MIXER_MASTER_R_LED = 0;
-	}
-#endif
-
-	// delay time LED blink
-	if(ioctl_mixer_delay_led_timeout) {
-		ioctl_led_reg |= LED_MIXER_DELAY_TIME_LED;
-		ioctl_mixer_delay_led_timeout --;
-	}
-	else {
-		ioctl_led_reg &= ~LED_MIXER_DELAY_TIME_LED;
-	}
-
-	// MIDI IN LED blink
-	if(ioctl_midi_in_led_timeout) {
-		ioctl_led_reg |= LED_MIDI_IN_LED;
-		ioctl_midi_in_led_timeout --;
-	}
-	else {
-		ioctl_led_reg &= ~LED_MIDI_IN_LED;
-	}
-
-	// MIDI clock out blink
-	if(ioctl_midi_clock_timeout) {
-		IOCTL_MIDI_CLOCK_OUT = 1;
-		ioctl_midi_clock_timeout --;
-	}
-	else {
-		IOCTL_MIDI_CLOCK_OUT = 0;	
+		switch_filter_set_val(SW_REC, 1, ~IOCTL_MIDI_REC_SW);
 	}
 
+	//
+	// LED blinking - one-shot blinks are handled by the timer wheel
+	//
 	// MIDI rec LED
-	switch(ioctl_midi_rec_led_state) {
-		case SEQ_LED_BLINK_ONCE:
-			if(ioctl_midi_rec_led_timeout) {
-				ioctl_led_reg |= LED_MIDI_REC_LED;
-				ioctl_midi_rec_led_timeout --;
-			}
-			else {
-				ioctl_led_reg &= ~LED_MIDI_REC_LED;
-				ioctl_midi_rec_led_state = SEQ_LED_OFF;
-			}
-			break;
-		case SEQ_LED_BLINK:
-			if(ioctl_scan_phase & 0x200) {
-				ioctl_led_reg |= LED_MIDI_REC_LED;
-			}
-			else {
-				ioctl_led_reg &= ~LED_MIDI_REC_LED;
-			}
-			break;
+	if(ioctl_midi_rec_led_state == SEQ_LED_BLINK) {
+		if(ioctl_scan_phase & 0x200) {
+			ioctl_led_reg |= LED_MIDI_REC_LED;
+		}
+		else {
+			ioctl_led_reg &= ~LED_MIDI_REC_LED;
+		}
 	}
 
 	// MIDI play LED
-	switch(ioctl_midi_play_led_state) {
-		case SEQ_LED_BLINK_ONCE:
-			if(ioctl_midi_play_led_timeout) {
-				ioctl_led_reg |= LED_MIDI_PLAY_LED;
-				ioctl_midi_play_led_timeout --;
-			}
-			else {
-				ioctl_led_reg &= ~LED_MIDI_PLAY_LED;
-				ioctl_midi_play_led_state = SEQ_LED_OFF;
-			}
-			break;
-		case SEQ_LED_BLINK:
-			if(ioctl_scan_phase & 0x200) {
-				ioctl_led_reg |= LED_MIDI_PLAY_LED;
-			}
-			else {
-				ioctl_led_reg &= ~LED_MIDI_PLAY_LED;
-			}
-			break;
+	if(ioctl_midi_play_led_state == SEQ_LED_BLINK) {
+		if(ioctl_scan_phase & 0x200) {
+			ioctl_led_reg |= LED_MIDI_PLAY_LED;
+		}
+		else {
+			ioctl_led_reg &= ~LED_MIDI_PLAY_LED;
+		}
 	}
 
 	// do DAC or LED update
@@ -314,28 +242,30 @@ int ioctl_get_power_sw(void) {
 
 // set the state of the mixer delay LED - 0-255 = 0-63ms
 void ioctl_set_mixer_delay_led(int timeout) {
-	ioctl_mixer_delay_led_timeout = timeout & 0xff;
+	ioctl_blink_start(IOCTL_BLINK_DELAY, timeout & 0xff);
 }
 
 // set the state of the mixer output LEDs - 0-255 = 0-63ms
 void ioctl_set_mixer_output_leds(int left, int right) {
-	ioctl_mixer_outL_led_timeout = left & 0xff;
-	ioctl_mixer_outR_led_timeout = right & 0xff;
+	ioctl_blink_start(IOCTL_BLINK_OUTL, left & 0xff);
+	ioctl_blink_start(IOCTL_BLINK_OUTR, right & 0xff);
 }
 
 // set the state of the MIDI in LED - 0 = off, 1 = blink once, 2 = blink, 3 = on
 void ioctl_set_midi_in_led(int timeout) {
-	ioctl_midi_in_led_timeout = timeout & 0xff;
+	ioctl_blink_start(IOCTL_BLINK_MIDI_IN, timeout & 0xff);
 }
 
 // set the state of the MIDI rec LED
 void ioctl_set_midi_rec_led(int state) {
+	// cancel any blink in progress
+	timer_wheel_stop(ioctl_blink_timer[IOCTL_BLINK_MIDI_REC]);
 	switch(state) {
 		case SEQ_LED_OFF:
 			ioctl_led_reg &= ~LED_MIDI_REC_LED;
 			break;
 		case SEQ_LED_BLINK_ONCE:
-			ioctl_midi_rec_led_timeout = SEQ_LED_TIMEOUT;
+			ioctl_blink_start(IOCTL_BLINK_MIDI_REC, SEQ_LED_TIMEOUT);
 			break;
 		case SEQ_LED_BLINK:
 			// XXX handled by the task timer
@@ -349,12 +279,14 @@ void ioctl_set_midi_rec_led(int state) {
 
 // set the state of the MIDI play LED
 void ioctl_set_midi_play_led(int state) {
+	// cancel any blink in progress
+	timer_wheel_stop(ioctl_blink_timer[IOCTL_BLINK_MIDI_PLAY]);
 	switch(state) {
 		case SEQ_LED_OFF:
 			ioctl_led_reg &= ~LED_MIDI_PLAY_LED;
 			break;
 		case SEQ_LED_BLINK_ONCE:
-			ioctl_midi_play_led_timeout = SEQ_LED_TIMEOUT;
+			ioctl_blink_start(IOCTL_BLINK_MIDI_PLAY, SEQ_LED_TIMEOUT);
 			break;
 		case SEQ_LED_BLINK:
 			// XXX handled by the task timer
@@ -407,10 +339,78 @@ void ioctl_set_midi_gate_out(int state) {
 
 // set the state of the MIDI clock out - 0-254 = 0-63ms, 255 = on
 void ioctl_set_midi_clock_out(int timeout) {
-	ioctl_midi_clock_timeout = timeout & 0xff;
+	// stay on until turned off
+	if(timeout == IOCTL_CLOCK_OUT_ON) {
+		timer_wheel_stop(ioctl_blink_timer[IOCTL_BLINK_MIDI_CLOCK]);
+		ioctl_blink_output(IOCTL_BLINK_MIDI_CLOCK, 1);
+		return;
+	}
+	ioctl_blink_start(IOCTL_BLINK_MIDI_CLOCK, timeout & 0xff);
 }
 
 // set the status of the power control output
 void ioctl_set_analog_power_ctrl(int state) {
 	IOCTL_ANALOG_PWR_CTRL = state & 0x01;
+}
+
+//
+// local functions
+//
+// turn on a blink output and start its timer - timeout = 0 turns it off
+void ioctl_blink_start(int blink, int timeout) {
+	if(timeout) {
+		ioctl_blink_output(blink, 1);
+		timer_wheel_start(ioctl_blink_timer[blink], timeout, 0);
+	}
+	else {
+		timer_wheel_stop(ioctl_blink_timer[blink]);
+		ioctl_blink_output(blink, 0);
+	}
+}
+
+// set the state of a blink output
+void ioctl_blink_output(int blink, int state) {
+	switch(blink) {
+		case IOCTL_BLINK_OUTL:
+#ifndef LED_DEBUG
+			IOCTL_MIXER_MASTER_L_LED = state & 0x01;
+#endif
+			break;
+		case IOCTL_BLINK_OUTR:
+#ifndef LED_DEBUG
+			IOCTL_MIXER_MASTER_R_LED = state & 0x01;
+#endif
+			break;
+		case IOCTL_BLINK_DELAY:
+			if(state) ioctl_led_reg |= LED_MIXER_DELAY_TIME_LED;
+			else ioctl_led_reg &= ~LED_MIXER_DELAY_TIME_LED;
+			break;
+		case IOCTL_BLINK_MIDI_IN:
+			if(state) ioctl_led_reg |= LED_MIDI_IN_LED;
+			else ioctl_led_reg &= ~LED_MIDI_IN_LED;
+			break;
+		case IOCTL_BLINK_MIDI_CLOCK:
+			IOCTL_MIDI_CLOCK_OUT = state & 0x01;
+			break;
+		case IOCTL_BLINK_MIDI_REC:
+			if(state) ioctl_led_reg |= LED_MIDI_REC_LED;
+			else ioctl_led_reg &= ~LED_MIDI_REC_LED;
+			break;
+		case IOCTL_BLINK_MIDI_PLAY:
+			if(state) ioctl_led_reg |= LED_MIDI_PLAY_LED;
+			else ioctl_led_reg &= ~LED_MIDI_PLAY_LED;
+			break;
+	}
+}
+
+// a blink timer expired - called from the timer wheel
+void ioctl_blink_expire(int blink) {
+	ioctl_blink_output(blink, 0);
+	// blink once is done
+	if(blink == IOCTL_BLINK_MIDI_REC) {
+		ioctl_midi_rec_led_state = SEQ_LED_OFF;
+	}
+	else if(blink == IOCTL_BLINK_MIDI_PLAY) {
+		ioctl_midi_play_led_state = SEQ_LED_OFF;
+	}
 }
\ No newline at end of file
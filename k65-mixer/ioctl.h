@@ -22,7 +22,7 @@
 #define POT_MIXER_IN2_LEVEL 4
 #define POT_MIXER_PAN1 5
 #define POT_MIXER_PAN2 6
-#define POT_SMOOTHING 200
+#define POT_SMOOTHING 248  // per 250us sample - about 8ms to 63%
 
 // switch channels
 #define SW_REC 0
@@ -30,7 +30,7 @@
 
 // DC in channels
 #define DC_IN_VSENSE 0
-#define CV_SMOOTHING 100
+#define CV_SMOOTHING 228  // per 250us sample - about 2ms to 63%
 
 #define DAC_VAL_NOM 0x7ff
 
@@ -79,7 +79,8 @@ void ioctl_set_midi_cv_out(int chan, int val);
 // set the state of the MIDI gate out
 void ioctl_set_midi_gate_out(int state);
 
-// set the state of the MIDI clock out
+// set the state of the MIDI clock out - 0-254 = 0-63ms, 255 = on
+#define IOCTL_CLOCK_OUT_ON 255
 void ioctl_set_midi_clock_out(int state);
 
 // set the status of the power control output
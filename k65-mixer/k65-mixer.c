@@ -47,6 +47,7 @@
 #include <stdio.h>
 #include "HardwareProfile.h"
 #include "TimeDelay.h"
+#include "timer_wheel.h"
 #include "ioctl.h"
 #include "phenol_midi.h"
 #include "power_ctrl.h"
@@ -57,9 +58,12 @@
 #include "cv_gate_ctrl.h"
 #include "voice.h"
 #include "seq.h"
+#include "seq_store.h"
 #include "midi_clock.h"
 #include "usb_ctrl.h"
 #include "midi.h"
+#include "isr_load.h"
+#include "telem.h"
 
 // fuse settings
 #pragma config UPLLEN   = ON        // USB PLL Enabled
@@ -117,6 +121,9 @@ int main(void) {
 	ConfigIntTimer1(T1_INT_ON | T1_INT_PRIOR_1);
 
 	// set up modules
+	isr_load_init();
+	timer_wheel_init();  // must be run before ioctl_init()
+	seq_store_init();  // must be run before phenol_midi_init() and seq_init()
 	ioctl_init();  // must be run before other init routines
 	usb_ctrl_init();  // set up the USB stuff
 	cv_gate_ctrl_init();  // must be run before voice_init()
@@ -129,6 +136,7 @@ int main(void) {
     midi_clock_init();
 	pulse_div_init();
 	seq_init();
+	telem_init();
 
 	// MIDI port - UART2
 	PPSUnLock;
@@ -164,6 +172,10 @@ int main(void) {
 		// - receive USB MIDI messages and stick them into the MIDI RX routines
 		// - get TX data to send and possibly send off a message
 		usb_ctrl_poll();
+
+		// sequencer saves and flash writes for the sequencer store
+		seq_poll();
+		seq_store_poll();
     	Delay10us(10);
 	}
 }
@@ -175,13 +187,17 @@ int main(void) {
 void __ISR(_TIMER_1_VECTOR, ipl2) Timer1Handler(void) {
 	static int power_state = POWER_STATE_BOOT;  // starting default
     static int startup_delay = STARTUP_DELAY_TIMEOUT;
+	unsigned int load_start = isr_load_start();
 	INTClearFlag(INT_T1);
 
 	// run always
+	timer_wheel_task();
 	ioctl_timer_task();
+	isr_load_timer_task();
 
 	// we are on - run normally
 	if(power_state == POWER_STATE_ON) {
+		seq_store_set_idle(0);  // a flash erase would stop the audio
         // startup delay - lamp check
         if(startup_delay) {
             startup_delay --;
@@ -218,6 +234,8 @@ void __ISR(_TIMER_1_VECTOR, ipl2) Timer1Handler(void) {
     		if((timer_div & 0x03) == 0) {
                 midi_clock_timer_task();
 		    	seq_timer_task();
+		    	cv_gate_ctrl_timer_task();
+		    	telem_timer_task();
     		}
 #ifdef DEBUG_MIDI
 	    	if((timer_div & 0xfff) == 0) {
@@ -240,13 +258,12 @@ void __ISR(_TIMER_1_VECTOR, ipl2) Timer1Handler(void) {
 		ioctl_set_midi_rec_led(SEQ_LED_OFF);
 		ioctl_set_midi_play_led(SEQ_LED_OFF);
 		ioctl_set_divider_outputs(0, 0, 0, 0);
-		ioctl_set_midi_cv_out(0, DAC_VAL_NOM);
-		ioctl_set_midi_cv_out(1, DAC_VAL_NOM);
-		ioctl_set_midi_gate_out(0);
+		cv_gate_ctrl_off();
 		ioctl_set_midi_clock_out(0);
         ioctl_set_midi_in_led(0);
         ioctl_set_mixer_output_leds(0, 0);
 		audio_proc_silence();
+		seq_store_set_idle(1);  // flash erases are okay while off / in standby
         startup_delay = STARTUP_DELAY_TIMEOUT;
 	}
 
@@ -257,15 +274,19 @@ void __ISR(_TIMER_1_VECTOR, ipl2) Timer1Handler(void) {
 	}
 
 	timer_div ++;
+	isr_load_end(ISR_LOAD_TIMER1, load_start);
 }
 
 // MIDI RX interrupt
 void __ISR(_UART2_VECTOR, ipl1) IntUart2Handler(void) {
+	unsigned int load_start = isr_load_start();
 	// is this an RX interrupt?
 	if(INTGetFlag(INT_U2RX)) {
 		INTClearFlag(INT_U2RX);
-	 	if(!UARTReceivedDataIsAvailable(UART2)) return;  // required to prevent junk reception of 0x00
-		midi_rx_byte(MIDI_PORT_DIN, UARTGetDataByte(UART2));
-		U2STAbits.OERR = 0;
+	 	if(UARTReceivedDataIsAvailable(UART2)) {  // required to prevent junk reception of 0x00
+			midi_rx_byte(MIDI_PORT_DIN, UARTGetDataByte(UART2));
+			U2STAbits.OERR = 0;
+		}
 	}
+	isr_load_end(ISR_LOAD_UART2, load_start);
 }
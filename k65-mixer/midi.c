@@ -108,6 +108,24 @@ unsigned char midi_tx_get_byte(unsigned char port) {
 	return ret;
 }
 
+// returns the number of bytes that can be added to the TX buffer for a port
+int midi_tx_room(unsigned char port) {
+	if(port > (MIDI_NUMPORTS - 1)) return 0;
+	return (MIDI_TX_BUFSIZE - 1) - midi_tx_depth(port);
+}
+
+// returns the number of bytes waiting in the TX buffer for a port
+int midi_tx_depth(unsigned char port) {
+	if(port > (MIDI_NUMPORTS - 1)) return 0;
+	return (midi_tx_in_pos[port] - midi_tx_out_pos[port]) & MIDI_TX_BUF_MASK;
+}
+
+// returns the number of bytes waiting in the RX buffer for a port
+int midi_rx_depth(unsigned char port) {
+	if(port > (MIDI_NUMPORTS - 1)) return 0;
+	return (midi_rx_in_pos[port] - midi_rx_out_pos[port]) & MIDI_RX_BUF_MASK;
+}
+
 // handle a new byte received from the stream
 void midi_rx_byte(unsigned char port, unsigned char rx_byte) {
 	if(port > (MIDI_NUMPORTS - 1)) return;
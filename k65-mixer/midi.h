@@ -49,6 +49,15 @@ unsigned char midi_tx_avail(unsigned char port);
 // returns the next available TX byte for a port
 unsigned char midi_tx_get_byte(unsigned char port);
 
+// returns the number of bytes that can be added to the TX buffer for a port
+int midi_tx_room(unsigned char port);
+
+// returns the number of bytes waiting in the TX buffer for a port
+int midi_tx_depth(unsigned char port);
+
+// returns the number of bytes waiting in the RX buffer for a port
+int midi_rx_depth(unsigned char port);
+
 // handle a new byte received from the stream
 void midi_rx_byte(unsigned char port, unsigned char rx_byte);
 
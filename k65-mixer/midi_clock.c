@@ -10,6 +10,7 @@
 #include "phenol_midi.h"
 #include "seq.h"
 #include "ioctl.h"
+#include "cv_gate_ctrl.h"
 #include "pulse_div.h"
 #include <inttypes.h>
 
@@ -27,6 +28,11 @@ int midi_clock_div_count;  // external clock divider counter
 int midi_clock_time_count;  // a count of real time
 int midi_clock_next_tick_time;  // time for the next tick
 int midi_clock_us_per_tick;  // the number of us per tick
+// external clock tempo
+int midi_clock_ms_count;  // free running count of ms
+int midi_clock_beat_start;  // ms count at the start of the external beat
+int midi_clock_beat_ticks;  // external ticks so far this beat
+int midi_clock_ext_us_per_tick;  // external clock us per tick - measured over a beat
 
 // init the MIDI clock
 void midi_clock_init(void) {
@@ -39,10 +45,16 @@ void midi_clock_init(void) {
     midi_clock_set_tempo(96.0);
     midi_clock_set_clock_div(0);  // div = 1/1
     midi_clock_div_count = 0;
+    midi_clock_ms_count = 0;
+    midi_clock_beat_start = 0;
+    midi_clock_beat_ticks = 0;
+    midi_clock_ext_us_per_tick = 0;
 }
 
 // run the MIDI clock timer task - 1000us
 void midi_clock_timer_task(void) {
+    midi_clock_ms_count ++;
+
     // handle clock switching - external MIDI vs. internal clock gen
     if(midi_clock_timeout) {
         midi_clock_internal = 0;  // internal clock disabled
@@ -76,8 +88,21 @@ int midi_clock_get_internal(void) {
     return midi_clock_internal;
 }
 
+// get the current tempo - BPM x 10 - 0 if the external clock has not been measured
+int midi_clock_get_tempo(void) {
+    int us_per_tick = midi_clock_ext_us_per_tick;
+    if(midi_clock_internal) {
+        us_per_tick = midi_clock_us_per_tick;
+    }
+    if(us_per_tick <= 0) {
+        return 0;
+    }
+    return 25000000 / us_per_tick;  // 60000000 * 10 / (us_per_tick * 24)
+}
+
 // pulse the clock output - used by sequencer for internal clock
 void midi_clock_pulse_clock_out(void) {
+    if(cv_gate_ctrl_get_gate2()) return;  // clock out is used as gate 2
     ioctl_set_midi_clock_out(MIDI_CLOCK_PULSE_TIME);
 }
 
@@ -105,12 +130,24 @@ void midi_clock_ungate(void) {
 void midi_clock_rx_song_position(unsigned int pos) {
 	midi_clock_tick_count = (pos * 6) % 24;
     midi_clock_div_count = 0;
+    // pos is in 16th notes - 6 clocks each
+    if(!midi_clock_internal) {
+        seq_clock_handle_song_position((pos * 6) / (midi_clock_div_setting + 1));
+    }
 }
 
 // handle MIDI timing tick
 void midi_clock_rx_timing_tick(void) {
     midi_clock_timeout = MIDI_CLOCK_TIMEOUT_TIME;  // reset clock timeout
 
+    // measure the tempo over each beat - 24 ticks
+    midi_clock_beat_ticks ++;
+    if(midi_clock_beat_ticks == 24) {
+        midi_clock_ext_us_per_tick = ((midi_clock_ms_count - midi_clock_beat_start) * 1000) / 24;
+        midi_clock_beat_start = midi_clock_ms_count;
+        midi_clock_beat_ticks = 0;
+    }
+
 	if(!midi_clock_run) {
 		return;
 	}
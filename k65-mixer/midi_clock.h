@@ -17,6 +17,9 @@ void midi_clock_timer_task(void);
 // check if the clock is running on internal - 1 = internal, 0 = external
 int midi_clock_get_internal(void);
 
+// get the current tempo - BPM x 10 - 0 if the external clock has not been measured
+int midi_clock_get_tempo(void);
+
 // pulse the clock output
 void midi_clock_pulse_clock_out(void);
 
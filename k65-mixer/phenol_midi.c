@@ -18,6 +18,8 @@
 #include "pulse_div.h"
 #include "seq.h"
 #include "midi_clock.h"
+#include "seq_store.h"
+#include "telem.h"
 
 // device restart
 #define BOOTLOADER_ADDR 0x9FC00000  // check this
@@ -26,15 +28,141 @@
 // LED blink times
 #define MIDI_LED_BLINK_TIME 20
 
-// trigger threshold for pitch bend gate trigger#define PITCH_BEND_TRIG_UP 0x27ff#define PITCH_BEND_TRIG_DOWN 0x17ff
-// event mappings#define EVENT_MAP_UNASSIGNED 0#define EVENT_MAP_NOTE 1#define EVENT_MAP_CC 2#define EVENT_MAP_PITCH_BEND 3
-// CV/gateunsigned char cv1_map;  // CV1 event mappingunsigned char cv2_map;  // CV2 event mappingunsigned char cv1_chan;  // CV1 receive channelunsigned char cv2_chan;  // CV2 receive channelunsigned char cv1_val;  // CV1 CC assignment / bend dirunsigned char cv2_val;  // CV2 CC assignment / bend dir
-// direct control modeunsigned int cv_direct1;  // CV1 direct control mode valueunsigned int cv_direct2;  // CV2 direct control mode value
+// trigger threshold for pitch bend gate trigger
+#define PITCH_BEND_TRIG_UP 0x27ff
+#define PITCH_BEND_TRIG_DOWN 0x17ff
+
+// event mappings
+#define EVENT_MAP_UNASSIGNED 0
+#define EVENT_MAP_NOTE 1
+#define EVENT_MAP_CC 2
+#define EVENT_MAP_PITCH_BEND 3
+#define EVENT_MAP_VELOCITY 4
+#define EVENT_MAP_PRESSURE 5
+#define EVENT_MAP_MAX 5
+
+// channel actions - built from the event mappings
+#define CHAN_ACT_SEQ 0x01  // CV1 note - notes and bend go to the sequencer
+#define CHAN_ACT_VOICE2 0x02  // CV2 note - notes and bend go to the sequencer for voice 2
+#define CHAN_ACT_VELO1 0x04  // CV1 velocity
+#define CHAN_ACT_VELO2 0x08  // CV2 velocity
+#define CHAN_ACT_BEND1 0x10  // CV1 pitch bend
+#define CHAN_ACT_BEND2 0x20  // CV2 pitch bend
+#define CHAN_ACT_PRESS1 0x40  // CV1 channel pressure
+#define CHAN_ACT_PRESS2 0x80  // CV2 channel pressure
+
+// CC outputs - built from the event mappings
+#define CC_OUT_CV1 0x01
+#define CC_OUT_CV2 0x02
+
+// CC functions on the CV1 channel
+#define CC_FUNC_NONE 0
+#define CC_FUNC_GLIDE_TIME 1
+#define CC_FUNC_CLOCK_SPEED 2
+#define CC_FUNC_ARP_ORDER 3
+#define CC_FUNC_ARP_OCTAVES 4
+#define CC_FUNC_ARP_RATE 5
+#define CC_FUNC_ARP_GATE 6
+#define CC_FUNC_GLIDE_RATE 7
+#define CC_FUNC_SUSTAIN 8
+#define CC_FUNC_GLIDE_ON 9
+#define CC_FUNC_GLIDE_LEGATO 10
+#define CC_FUNC_SEQ_QUANTIZE 11
+#define CC_FUNC_SEQ_SWING 12
+
+// CC functions on channel 16
+#define CC_DIRECT_NONE 0
+#define CC_DIRECT_CV1_MSB 1
+#define CC_DIRECT_CV1_LSB 2
+#define CC_DIRECT_CV2_MSB 3
+#define CC_DIRECT_CV2_LSB 4
+#define CC_DIRECT_GATE1 5
+#define CC_DIRECT_GATE2 6
+#define CC_DIRECT_CAL_SELECT 7
+#define CC_DIRECT_CAL_ADJUST 8
+#define CC_DIRECT_CAL_SAVE 9
+#define CC_DIRECT_CV1_MAP 10
+#define CC_DIRECT_CV2_MAP 11
+#define CC_DIRECT_CV1_CHAN 12
+#define CC_DIRECT_CV2_CHAN 13
+#define CC_DIRECT_CV1_VAL 14
+#define CC_DIRECT_CV2_VAL 15
+#define CC_DIRECT_GATE2_CLOCK 16
+
+// CV/gate
+unsigned char cv1_map;  // CV1 event mapping
+unsigned char cv2_map;  // CV2 event mapping
+unsigned char cv1_chan;  // CV1 receive channel
+unsigned char cv2_chan;  // CV2 receive channel
+unsigned char cv1_val;  // CV1 CC assignment / bend dir
+unsigned char cv2_val;  // CV2 CC assignment / bend dir
+unsigned char gate2_clock;  // 0 = clock out is the MIDI clock, 1 = clock out is gate 2
+
+// dispatch tables - rebuilt when the mappings change
+unsigned char phenol_midi_chan_act[16];  // actions for each channel
+unsigned char phenol_midi_cc_out[128];  // CV outputs mapped to each CC
+
+// CC functions on the CV1 channel
+const unsigned char phenol_midi_cc_func[128] = {
+	[5] = CC_FUNC_GLIDE_TIME,
+	[16] = CC_FUNC_CLOCK_SPEED,
+	[20] = CC_FUNC_ARP_ORDER,
+	[21] = CC_FUNC_ARP_OCTAVES,
+	[22] = CC_FUNC_ARP_RATE,
+	[23] = CC_FUNC_ARP_GATE,
+	[24] = CC_FUNC_GLIDE_RATE,
+	[25] = CC_FUNC_SEQ_QUANTIZE,
+	[26] = CC_FUNC_SEQ_SWING,
+	[64] = CC_FUNC_SUSTAIN,
+	[65] = CC_FUNC_GLIDE_ON,
+	[68] = CC_FUNC_GLIDE_LEGATO
+};
+
+// CC functions on channel 16
+const unsigned char phenol_midi_cc_direct[128] = {
+	[16] = CC_DIRECT_CV1_MSB,
+	[17] = CC_DIRECT_CV2_MSB,
+	[18] = CC_DIRECT_GATE1,
+	[19] = CC_DIRECT_GATE2,
+	[20] = CC_DIRECT_CAL_SELECT,
+	[21] = CC_DIRECT_CAL_ADJUST,
+	[22] = CC_DIRECT_CAL_SAVE,
+	[24] = CC_DIRECT_CV1_MAP,
+	[25] = CC_DIRECT_CV2_MAP,
+	[26] = CC_DIRECT_CV1_CHAN,
+	[27] = CC_DIRECT_CV2_CHAN,
+	[28] = CC_DIRECT_CV1_VAL,
+	[29] = CC_DIRECT_CV2_VAL,
+	[30] = CC_DIRECT_GATE2_CLOCK,
+	[48] = CC_DIRECT_CV1_LSB,
+	[49] = CC_DIRECT_CV2_LSB
+};
+
+// direct control mode
+unsigned int cv_direct1;  // CV1 direct control mode value
+unsigned int cv_direct2;  // CV2 direct control mode value
 
 // stop ignore
 unsigned char stop_ignore;  // 0 = disabled, 1 = enabled
 
-// local functionsvoid phenol_midi_set_cv(unsigned char num, unsigned char map, unsigned char chan, unsigned char val);
+// glide - static so they stay apart from the glide state in cv_gate_ctrl.c
+static unsigned char glide_cc_time;  // glide time CC value
+static unsigned char glide_cc_on;  // portamento on / off
+static unsigned char glide_cc_rate;  // 0 = constant time, 1 = constant rate
+static unsigned char glide_cc_legato;  // 0 = always glide, 1 = legato only
+
+// arp rates in clock ticks - 1/4, 1/4T, 1/8, 1/8T, 1/16, 1/16T, 1/32, 1/32T
+const unsigned char phenol_midi_arp_rates[8] = {24, 16, 12, 8, 6, 4, 3, 2};
+// sequencer record quantize grids - off, 1/4, 1/8, 1/8T, 1/16, 1/16T, 1/32, 1/32T
+const unsigned char phenol_midi_quantize_grids[8] = {0, 24, 12, 8, 6, 4, 3, 2};
+
+// local functions
+void phenol_midi_set_cv(unsigned char num, unsigned char map, unsigned char chan, unsigned char val);
+void phenol_midi_set_gate2_clock(unsigned char state);
+void phenol_midi_save_cv(unsigned char num);
+void phenol_midi_build_maps(void);
+void phenol_midi_out_value(unsigned char num, unsigned int cv, unsigned char gate);
+void phenol_midi_update_glide(void);
 
 // initialize the MIDI handler
 void phenol_midi_init(void) {
@@ -44,10 +172,19 @@ void phenol_midi_init(void) {
 
 // reset any modes that were set (for soft power on)
 void phenol_midi_reset(void) {
-	// fixed settings
-	phenol_midi_set_cv(0, EVENT_MAP_NOTE, 0, 0);
-	phenol_midi_set_cv(1, EVENT_MAP_CC, 0, 1);
-    phenol_midi_set_stop_ignore(0);  // disabled
+	int temp;
+	// saved mappings - CV1 = note, CV2 = mod wheel by default
+	temp = seq_store_get_setting(SEQ_STORE_SETTING_CV1_MAP, EVENT_MAP_NOTE);
+	phenol_midi_set_cv(0, temp & 0xff, (temp >> 8) & 0xff, (temp >> 16) & 0xff);
+	temp = seq_store_get_setting(SEQ_STORE_SETTING_CV2_MAP, EVENT_MAP_CC | (1 << 16));
+	phenol_midi_set_cv(1, temp & 0xff, (temp >> 8) & 0xff, (temp >> 16) & 0xff);
+	phenol_midi_set_gate2_clock((temp >> 24) & 0x01);
+	glide_cc_time = 0;
+	glide_cc_on = 1;
+	glide_cc_rate = 0;
+	glide_cc_legato = 0;
+	phenol_midi_update_glide();
+    phenol_midi_set_stop_ignore(seq_store_get_setting(SEQ_STORE_SETTING_STOP_IGNORE, 0));
 }
 
 // run the timer task to do mode switching
@@ -119,22 +256,25 @@ void _midi_receive_act(unsigned char port) {
 void _midi_rx_note_off(unsigned char port,
 		unsigned char channel, 
 		unsigned char note) {
+	unsigned char act;
 	if(channel == 15) return;  // channel 16 is not used for notes
 
+	act = phenol_midi_chan_act[channel];
 	// sequencer note off
-	if(cv1_map == EVENT_MAP_NOTE && cv1_chan == channel) {
-		seq_midi_note_off(note);
+	if(act & CHAN_ACT_SEQ) {
+		seq_midi_note_off(0, note);
 	}
-
-/*
-	// CV/gate - note off
-	if(cv1_map == EVENT_MAP_NOTE && cv1_chan == channel) {
-		voice_note_off(0, note);
+	// CV2 note off - recorded on its own track
+	if(act & CHAN_ACT_VOICE2) {
+		seq_midi_note_off(1, note);
 	}
-	if(cv2_map == EVENT_MAP_NOTE && cv2_chan == channel) {
-		voice_note_off(1, note);
+	// velocity gates
+	if(act & CHAN_ACT_VELO1) {
+		cv_gate_ctrl_gate(0, 0);
+	}
+	if(act & CHAN_ACT_VELO2) {
+		cv_gate_ctrl_gate(1, 0);
 	}
-*/
 }
 
 // note on - note on with velocity > 0 calls this
@@ -142,21 +282,25 @@ void _midi_rx_note_on(unsigned char port,
 		unsigned char channel, 
 		unsigned char note, 
 		unsigned char velocity) {
+	unsigned char act;
 	if(channel == 15) return;  // channel 16 is not used for notes
 
+	act = phenol_midi_chan_act[channel];
 	// sequencer note on
-	if(cv1_map == EVENT_MAP_NOTE && cv1_chan == channel) {
-		seq_midi_note_on(note);
+	if(act & CHAN_ACT_SEQ) {
+		seq_midi_note_on(0, note);
 	}
-/*
-	// note CV/gate
-	if(cv1_map == EVENT_MAP_NOTE && cv1_chan == channel) {
-		voice_note_on(0, note, velocity);
+	// CV2 note on - recorded on its own track
+	if(act & CHAN_ACT_VOICE2) {
+		seq_midi_note_on(1, note);
 	}
-	if(cv2_map == EVENT_MAP_NOTE && cv2_chan == channel) {
-		voice_note_on(1, note, velocity);
+	// velocity CV and gates
+	if(act & CHAN_ACT_VELO1) {
+		phenol_midi_out_value(0, velocity << 5, 1);
+	}
+	if(act & CHAN_ACT_VELO2) {
+		phenol_midi_out_value(1, velocity << 5, 1);
 	}
-*/
 }
 
 // key pressure
@@ -172,97 +316,156 @@ void _midi_rx_control_change(unsigned char port,
 		unsigned char channel,
 		unsigned char controller,
 		unsigned char value) {
+	unsigned char out = phenol_midi_cc_out[controller];
+
+	// CC mapped CV outputs - gate is on for values 64-127
+	if((out & CC_OUT_CV1) && cv1_chan == channel) {
+		phenol_midi_out_value(0, value << 5, value >> 6);
+	}
+	if((out & CC_OUT_CV2) && cv2_chan == channel) {
+		phenol_midi_out_value(1, value << 5, value >> 6);
+	}
 
     // only care about our channel
     if(cv1_chan == channel) {
-    	// sequencer mod wheel
-	    if(controller == 1) {
-			cv_gate_ctrl_cv(1, value << 5);
-	    }
-        // sequencer sustain pedal
-        else if(controller == 64) {
-            seq_midi_sustain_pedal(value);
-        }
-        // MIDI clock speed control
-        else if(controller == 16) {
-            // internal clock - adjust tempo
-            if(midi_clock_get_internal()) {
-                midi_clock_set_tempo((value << 1) + 40);
-            }
-            // external clock - adjust clock div
-            else {
-                midi_clock_set_clock_div(value >> 5);  // 0-3
-            }
+        switch(phenol_midi_cc_func[controller]) {
+            // glide time
+            case CC_FUNC_GLIDE_TIME:
+                glide_cc_time = value;
+                phenol_midi_update_glide();
+                break;
+            // MIDI clock speed control
+            case CC_FUNC_CLOCK_SPEED:
+                // internal clock - adjust tempo
+                if(midi_clock_get_internal()) {
+                    midi_clock_set_tempo((value << 1) + 40);
+                }
+                // external clock - adjust clock div
+                else {
+                    midi_clock_set_clock_div(value >> 5);  // 0-3
+                }
+                break;
+            // arp order - up / down / random / as played
+            case CC_FUNC_ARP_ORDER:
+                voice_set_arp_order(value >> 5);
+                break;
+            // arp octave range - 1-4
+            case CC_FUNC_ARP_OCTAVES:
+                voice_set_arp_octaves((value >> 5) + 1);
+                break;
+            // arp rate
+            case CC_FUNC_ARP_RATE:
+                voice_set_arp_rate(phenol_midi_arp_rates[value >> 4]);
+                break;
+            // arp gate length
+            case CC_FUNC_ARP_GATE:
+                voice_set_arp_gate(value);
+                break;
+            // glide constant time / constant rate
+            case CC_FUNC_GLIDE_RATE:
+                glide_cc_rate = value >> 6;
+                phenol_midi_update_glide();
+                break;
+            // sequencer sustain pedal
+            case CC_FUNC_SUSTAIN:
+                seq_midi_sustain_pedal(value);
+                break;
+            // sequencer record quantize
+            case CC_FUNC_SEQ_QUANTIZE:
+                seq_set_quantize(phenol_midi_quantize_grids[value >> 4]);
+                break;
+            // sequencer record swing
+            case CC_FUNC_SEQ_SWING:
+                seq_set_swing(value);
+                break;
+            // glide on / off
+            case CC_FUNC_GLIDE_ON:
+                glide_cc_on = value >> 6;
+                phenol_midi_update_glide();
+                break;
+            // glide legato only
+            case CC_FUNC_GLIDE_LEGATO:
+                glide_cc_legato = value >> 6;
+                phenol_midi_update_glide();
+                break;
         }
     }
-    
-
-/*
-	// CC damper pedal mode
-	if(cv1_map == EVENT_MAP_NOTE && cv1_chan == channel && controller == 64) {
-		voice_damper(0, value);
-	}
-	if(cv2_map == EVENT_MAP_NOTE && cv2_chan == channel && controller == 64) {
-		voice_damper(1, value);
-	}
-	// direct control of CV2 - mod wheel
-	if(cv1_chan == channel && controller == 1) {
-		cv_gate_ctrl_cv(1, value << 5);
-	}
-	// CC CV/gate
-	if(cv1_map == EVENT_MAP_CC && cv1_chan == channel && cv1_val == controller) {
-		cv_gate_ctrl_cv(0, value << 5);
-		// value 64-127
-		if(value & 0x40) {
-			cv_gate_ctrl_gate(0, 1);
-		}
-		// value 0-63
-		else {
-			cv_gate_ctrl_gate(0, 0);
-		}
-	}
-	if(cv2_map == EVENT_MAP_CC && cv2_chan == channel && cv2_val == controller) {
-		cv_gate_ctrl_cv(1, value << 5);
-		// value 64-127
-		if(value & 0x40) {
-			cv_gate_ctrl_gate(1, 1);
-		}
-		// value 0-63
-		else {
-			cv_gate_ctrl_gate(1, 0);
-		}
-	}
-*/
 	// CC channel 16 direct control mode
-//	if(channel == 15) {
 	else if(channel == 15) {
-		// CV1 value - MSB
-		if(controller == 16) {
-			cv_direct1 = (cv_direct1 & 0x1f) | (value << 5);
-			cv_gate_ctrl_cv(0, cv_direct1);
-		}
-		// CV1 value - LSB
-		else if(controller == 48) {
-			cv_direct1 = (cv_direct1 & 0xfe0) | (value >> 2);
-			cv_gate_ctrl_cv(0, cv_direct1);
-		}
-		// CV2 value - MSB
-		else if(controller == 17) {
-			cv_direct2 = (cv_direct2 & 0x1f) | (value << 5);
-			cv_gate_ctrl_cv(1, cv_direct2);
-		}
-		// CV2 value - LSB
-		else if(controller == 49) {
-			cv_direct2 = (cv_direct2 & 0xfe0) | (value >> 2);
-			cv_gate_ctrl_cv(1, cv_direct2);
-		}
-		// gate 1
-		else if(controller == 18) {
-			cv_gate_ctrl_gate(0, value >> 6);
-		}
-		// gate 2
-		else if(controller == 19) {
-			cv_gate_ctrl_gate(1, value >> 6);
+		switch(phenol_midi_cc_direct[controller]) {
+			// CV1 value - MSB
+			case CC_DIRECT_CV1_MSB:
+				cv_direct1 = (cv_direct1 & 0x1f) | (value << 5);
+				cv_gate_ctrl_cv(0, cv_direct1);
+				break;
+			// CV1 value - LSB
+			case CC_DIRECT_CV1_LSB:
+				cv_direct1 = (cv_direct1 & 0xfe0) | (value >> 2);
+				cv_gate_ctrl_cv(0, cv_direct1);
+				break;
+			// CV2 value - MSB
+			case CC_DIRECT_CV2_MSB:
+				cv_direct2 = (cv_direct2 & 0x1f) | (value << 5);
+				cv_gate_ctrl_cv(1, cv_direct2);
+				break;
+			// CV2 value - LSB
+			case CC_DIRECT_CV2_LSB:
+				cv_direct2 = (cv_direct2 & 0xfe0) | (value >> 2);
+				cv_gate_ctrl_cv(1, cv_direct2);
+				break;
+			// gate 1
+			case CC_DIRECT_GATE1:
+				cv_gate_ctrl_gate(0, value >> 6);
+				break;
+			// gate 2
+			case CC_DIRECT_GATE2:
+				cv_gate_ctrl_gate(1, value >> 6);
+				break;
+			// CV calibration - select the octave to tune
+			case CC_DIRECT_CAL_SELECT:
+				cv_gate_ctrl_cal_select(value);
+				break;
+			// CV calibration - correction for the selected octave - 64 = none
+			case CC_DIRECT_CAL_ADJUST:
+				cv_gate_ctrl_cal_adjust(value - 64);
+				break;
+			// CV calibration - 64-127 = save, 0-63 = go back to the saved values
+			case CC_DIRECT_CAL_SAVE:
+				if(value & 0x40) cv_gate_ctrl_cal_save();
+				else cv_gate_ctrl_cal_load();
+				break;
+			// CV mapping - 0-5 = off / note / CC / bend / velocity / pressure
+			case CC_DIRECT_CV1_MAP:
+				phenol_midi_set_cv(0, value >> 4, cv1_chan, cv1_val);
+				phenol_midi_save_cv(0);
+				break;
+			case CC_DIRECT_CV2_MAP:
+				phenol_midi_set_cv(1, value >> 4, cv2_chan, cv2_val);
+				phenol_midi_save_cv(1);
+				break;
+			// CV receive channel - 0-15
+			case CC_DIRECT_CV1_CHAN:
+				phenol_midi_set_cv(0, cv1_map, value & 0x0f, cv1_val);
+				phenol_midi_save_cv(0);
+				break;
+			case CC_DIRECT_CV2_CHAN:
+				phenol_midi_set_cv(1, cv2_map, value & 0x0f, cv2_val);
+				phenol_midi_save_cv(1);
+				break;
+			// CV CC number / bend direction - 0 = up, 1 = down
+			case CC_DIRECT_CV1_VAL:
+				phenol_midi_set_cv(0, cv1_map, cv1_chan, value);
+				phenol_midi_save_cv(0);
+				break;
+			case CC_DIRECT_CV2_VAL:
+				phenol_midi_set_cv(1, cv2_map, cv2_chan, value);
+				phenol_midi_save_cv(1);
+				break;
+			// clock out - 0-63 = MIDI clock, 64-127 = gate 2
+			case CC_DIRECT_GATE2_CLOCK:
+				phenol_midi_set_gate2_clock(value >> 6);
+				phenol_midi_save_cv(1);
+				break;
 		}
 	}
 }
@@ -322,6 +525,30 @@ void _midi_rx_program_change(unsigned char port,
 		else if(program > 11 && program < 24) {
 			voice_set_pitch_bend_range(1, program - 11);
 		}
+		// program 24-31 = select sequencer pattern 1-8
+		else if(program > 23 && program < 32) {
+			seq_pattern_queue(program - 24);
+		}
+		// program 32-39 = add sequencer pattern 1-8 to the chain
+		else if(program > 31 && program < 40) {
+			seq_pattern_chain_add(program - 32);
+		}
+		// program 40 = clear the sequencer pattern chain
+		else if(program == 40) {
+			seq_pattern_chain_clear();
+		}
+		// program 41-43 = note priority last / high / low
+		else if(program > 40 && program < 44) {
+			voice_set_priority(program - 41);
+		}
+		// program 44-48 = voice mode single / split / poly / arp / velo
+		else if(program > 43 && program < 49) {
+			voice_set_mode(program - 44, 60);
+		}
+		// program 49-56 = 1-8 chained units for poly mode
+		else if(program > 48 && program < 57) {
+			voice_set_units(program - 48);
+		}
 	}
 }
 
@@ -329,27 +556,39 @@ void _midi_rx_program_change(unsigned char port,
 void _midi_rx_channel_pressure(unsigned char port,
 		unsigned char channel,
 		unsigned char pressure) {
+	unsigned char act = phenol_midi_chan_act[channel];
+	// pressure CV - gate is on for values 64-127
+	if(act & CHAN_ACT_PRESS1) {
+		phenol_midi_out_value(0, pressure << 5, pressure >> 6);
+	}
+	if(act & CHAN_ACT_PRESS2) {
+		phenol_midi_out_value(1, pressure << 5, pressure >> 6);
+	}
 }
 
 // pitch bend
 void _midi_rx_pitch_bend(unsigned char port,
 		unsigned char channel,
 		int bend) {
+	unsigned char act = phenol_midi_chan_act[channel];
 
 	// sequencer pitch bend
-	if(cv1_map == EVENT_MAP_NOTE && cv1_chan == channel) {
-		seq_midi_pitch_bend(bend);
+	if(act & CHAN_ACT_SEQ) {
+		seq_midi_pitch_bend(0, bend);
 	}
-
-/*
-	// pitch bend - note bend mode
-	if(cv1_map == EVENT_MAP_NOTE && cv1_chan == channel) {
-		voice_pitch_bend(0, bend);
+	// CV2 note bend
+	if(act & CHAN_ACT_VOICE2) {
+		seq_midi_pitch_bend(1, bend);
 	}
-	if(cv2_map == EVENT_MAP_NOTE && cv2_chan == channel) {
-		voice_pitch_bend(1, bend);
+	// bend CV - gate is on past the trigger point in the set direction
+	if(act & CHAN_ACT_BEND1) {
+		phenol_midi_out_value(0, bend >> 2, cv1_val ?
+			(bend < PITCH_BEND_TRIG_DOWN) : (bend > PITCH_BEND_TRIG_UP));
+	}
+	if(act & CHAN_ACT_BEND2) {
+		phenol_midi_out_value(1, bend >> 2, cv2_val ?
+			(bend < PITCH_BEND_TRIG_DOWN) : (bend > PITCH_BEND_TRIG_UP));
 	}
-*/
 }
 
 //
@@ -374,6 +613,15 @@ void _midi_rx_song_select(unsigned char port,
 void _midi_rx_sysex_msg(unsigned char port,
 		unsigned char data[], 
 		unsigned char len) {
+	// Kilpatrick Audio message for this device
+	if(len < 5 || data[0] != 0x00 || data[1] != 0x01 ||
+			data[2] != 0x72 || data[3] != DEV_ID) {
+		return;
+	}
+	// telemetry rate - period in ms - 0 = off
+	if(data[4] == TELEM_CMD_SET_RATE && len == 7) {
+		telem_set_rate(data[5] | (data[6] << 7));
+	}
 	// XXX setup message
 }
 
@@ -428,14 +676,95 @@ void _midi_restart_device(void) {
 void phenol_midi_set_cv(unsigned char num, unsigned char map, 
 		unsigned char chan, unsigned char val) {
 	if(num > 1) return;
+	if(map > EVENT_MAP_MAX) map = EVENT_MAP_UNASSIGNED;
 	if(num == 1) {
-		cv2_map = map & 0x03;
-		cv2_chan = chan & 0xff;
+		cv2_map = map;
+		cv2_chan = chan & 0x0f;
 		cv2_val = val & 0x7f;
 	}
 	else {
-		cv1_map = map & 0x03;
-		cv1_chan = chan & 0xff;
+		cv1_map = map;
+		cv1_chan = chan & 0x0f;
 		cv1_val = val & 0x7f;
 	}
+	phenol_midi_build_maps();
+}
+
+// set whether the clock out is used as gate 2
+void phenol_midi_set_gate2_clock(unsigned char state) {
+	gate2_clock = state & 0x01;
+	cv_gate_ctrl_set_gate2(gate2_clock);
+}
+
+// save a CV config
+void phenol_midi_save_cv(unsigned char num) {
+	if(num == 1) {
+		seq_store_set_setting(SEQ_STORE_SETTING_CV2_MAP, cv2_map |
+			(cv2_chan << 8) | (cv2_val << 16) | (gate2_clock << 24));
+	}
+	else {
+		seq_store_set_setting(SEQ_STORE_SETTING_CV1_MAP, cv1_map |
+			(cv1_chan << 8) | (cv1_val << 16));
+	}
+}
+
+// build the dispatch tables from the CV configs
+// - the MIDI handlers only need one lookup to find what to do
+void phenol_midi_build_maps(void) {
+	int i;
+	for(i = 0; i < 16; i ++) {
+		phenol_midi_chan_act[i] = 0;
+	}
+	for(i = 0; i < 128; i ++) {
+		phenol_midi_cc_out[i] = 0;
+	}
+	switch(cv1_map) {
+		case EVENT_MAP_NOTE:
+			phenol_midi_chan_act[cv1_chan] |= CHAN_ACT_SEQ;
+			break;
+		case EVENT_MAP_CC:
+			phenol_midi_cc_out[cv1_val] |= CC_OUT_CV1;
+			break;
+		case EVENT_MAP_PITCH_BEND:
+			phenol_midi_chan_act[cv1_chan] |= CHAN_ACT_BEND1;
+			break;
+		case EVENT_MAP_VELOCITY:
+			phenol_midi_chan_act[cv1_chan] |= CHAN_ACT_VELO1;
+			break;
+		case EVENT_MAP_PRESSURE:
+			phenol_midi_chan_act[cv1_chan] |= CHAN_ACT_PRESS1;
+			break;
+	}
+	switch(cv2_map) {
+		case EVENT_MAP_NOTE:
+			phenol_midi_chan_act[cv2_chan] |= CHAN_ACT_VOICE2;
+			break;
+		case EVENT_MAP_CC:
+			phenol_midi_cc_out[cv2_val] |= CC_OUT_CV2;
+			break;
+		case EVENT_MAP_PITCH_BEND:
+			phenol_midi_chan_act[cv2_chan] |= CHAN_ACT_BEND2;
+			break;
+		case EVENT_MAP_VELOCITY:
+			phenol_midi_chan_act[cv2_chan] |= CHAN_ACT_VELO2;
+			break;
+		case EVENT_MAP_PRESSURE:
+			phenol_midi_chan_act[cv2_chan] |= CHAN_ACT_PRESS2;
+			break;
+	}
+}
+
+// set a mapped CV output value and gate
+void phenol_midi_out_value(unsigned char num, unsigned int cv, unsigned char gate) {
+	cv_gate_ctrl_cv(num, cv);
+	cv_gate_ctrl_gate(num, gate);
+}
+
+// update the glide from the CC settings
+// - the time curve is squared so the low end has more resolution
+void phenol_midi_update_glide(void) {
+	int time = 0;
+	if(glide_cc_on) time = (glide_cc_time * glide_cc_time) >> 2;  // 0-4032ms
+	cv_gate_ctrl_set_glide(time, glide_cc_rate ? CV_GLIDE_RATE : CV_GLIDE_TIME,
+		glide_cc_legato);
 }
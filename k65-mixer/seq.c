@@ -22,6 +22,10 @@
  *	- to play
  *		- tap to play once - play LED on solid
  *		- press and hold to loop - play LED blinks
+ *	- overdub
+ *		- tap record while looping - record lit solid
+ *		- notes played are added to the pattern at the end of each loop
+ *		- tap record again to stop overdubbing - or play to stop
  *	- controls
  *		- speed CC
  *			- speed CC for playback with no clock
@@ -31,12 +35,16 @@
  *		- external
  * 
  */
+#include <plib.h>
 #include "seq.h"
 #include "voice.h"
 #include "ioctl.h"
 #include "midi_clock.h"
 #include "phenol_midi.h"
+#include "seq_pack.h"
+#include "seq_store.h"
 #include <inttypes.h>
+#include <string.h>
 
 //#define SEQ_HOST_DEBUG
 //#define SEQ_MIDI_DEBUG
@@ -62,6 +70,7 @@
 #define SEQ_STATE_PLAY_ONCE_END 8
 #define SEQ_STATE_PLAY_LOOP_END 9
 #define SEQ_STATE_REC_END 10
+#define SEQ_STATE_OVERDUB 11
 int seq_state;
 // button handling
 #define SEQ_BUTTON_HOLD_TIMEOUT 500
@@ -72,32 +81,176 @@ int seq_play_button_state;  // play button state - 1 = pressed, 0 = not pressed
 int seq_button_lockout;  // do not process more event
 // state
 int seq_run_timer;  // a timer for record or playback (in ms)
-int seq_play_event_pos;  // the event position for playback
+int seq_play_event_pos;  // the event number for playback
+struct seq_pack_state seq_play_pack;  // playback stream decoder
+struct seq_event seq_play_event;  // the next event to play
 int seq_last_event_time;  // run timer value at last event
+int seq_loop_base;  // run timer value at the start of the loop
 int seq_play_transpose;  // transpose the playback up or down
 #define SEQ_PLAY_TRANSPOSE_BASE 60  // the base note for transposing up or down
 // events
-#define SEQ_EVENT_NOTE_OFF 0x80
-#define SEQ_EVENT_NOTE_ON 0x90
-#define SEQ_EVENT_PITCH_BEND 0xe0
-#define SEQ_EVENT_REST 0xfe
-#define SEQ_EVENT_END 0xff
 #define SEQ_NOTE_VEL 64
 #define SEQ_STEP_REC_STEP_TIME 6  // 6 clock ticks
-#define SEQ_MAX_EVENTS 1024
-struct seq_event {
-    uint16_t time;  // delta time since last event (in ms)
-    uint8_t type;  // event type
-    uint8_t value;  // event value
+// tracks - all tracks are merged into one stream per pattern
+#define SEQ_NUM_VOICES 2
+#define SEQ_TRACK_VOICE(track) ((track) & 0x01)  // even tracks play on voice 0, odd on voice 1
+#define SEQ_BUF_SIZE 4096  // packed event buffer size in bytes
+uint8_t seq_event_buf[SEQ_BUF_SIZE];  // all patterns packed end to end
+struct seq_pack_state seq_rec_pack;  // record stream encoder
+int seq_rec_base;  // buffer offset of the pattern being recorded
+int seq_rec_time;  // time of the last event recorded (in clock ticks)
+#define SEQ_REC_BEND_NONE -1
+int seq_rec_bend[SEQ_NUM_VOICES];  // pitch bend waiting to be recorded - only the last one in each tick is kept
+// step record chords - notes played while keys are held go on the same step
+#define SEQ_STEP_CHORD_MAX SEQ_PACK_HELD_MAX
+uint8_t seq_step_chord[SEQ_STEP_CHORD_MAX];  // notes in the last step
+uint8_t seq_step_chord_track[SEQ_STEP_CHORD_MAX];  // track of each note
+int seq_step_chord_len;
+int seq_step_keys;  // keys held down in step record
+int seq_num_events;  // events in the selected pattern
+// patterns
+#define SEQ_NUM_PATTERNS 8
+#define SEQ_PATTERN_NONE 0xff
+#define SEQ_PATTERN_TABLE_SIZE (SEQ_NUM_PATTERNS * 6)  // saved after the patterns
+#define SEQ_CHAIN_MAX 16
+struct seq_pattern {
+    uint16_t start;  // start of the pattern in the event buffer
+    uint16_t len;  // length in bytes
+    uint16_t num_events;  // number of events - 0 = empty
+    uint8_t index_start;  // first song position checkpoint in the index pool
+    uint8_t index_len;  // number of checkpoints - 0 = none
+    int length;  // length in clock ticks
 };
-struct seq_event seq_event_buf[SEQ_MAX_EVENTS];
-int seq_num_events;
+struct seq_pattern seq_patterns[SEQ_NUM_PATTERNS];
+int seq_buf_used;  // bytes used by all patterns
+int seq_pattern;  // selected pattern
+int seq_pattern_next;  // pattern queued for the end of the loop
+uint8_t *seq_play_buf;  // selected pattern data
+int seq_play_size;  // selected pattern length in bytes
+uint8_t seq_chain[SEQ_CHAIN_MAX];  // patterns to play in order when looping
+int seq_chain_len;
+int seq_chain_pos;
 int seq_startup;
+int seq_restored;  // 1 = saved sequence was loaded
+// song position index - a checkpoint every few bytes of each pattern so
+// playback can jump anywhere without decoding the whole stream
+// - checkpoints are added as a pattern is recorded or merged, and when
+//   the patterns are loaded, so selecting a pattern just points at them
+// - the checkpoints of all patterns share one pool - each pattern has a
+//   run of entries which is moved up and down as patterns change size
+#define SEQ_INDEX_STEP 128  // bytes between checkpoints
+#define SEQ_INDEX_SIZE ((SEQ_BUF_SIZE / SEQ_INDEX_STEP) + SEQ_NUM_PATTERNS)  // enough for a full buffer
+struct seq_index_entry {
+    int time;  // time of the events before the checkpoint (in clock ticks)
+    uint16_t event;  // event number at the checkpoint
+    struct seq_pack_mark mark;  // stream position and last pitch bend at the checkpoint
+};
+struct seq_index_entry seq_index_pool[SEQ_INDEX_SIZE];
+int seq_index_used;  // entries used by all patterns
+struct seq_index_entry *seq_index;  // checkpoints of the selected pattern
+int seq_index_len;  // number of checkpoints
+int seq_length;  // total sequence length (in clock ticks)
+// MIDI continue - a DAW locate is stop, song position, continue, so the
+// place and the way playback was going are kept from the stop
+int seq_resume_state;  // state to continue in - idle = don't
+int seq_resume_time;  // time to continue from (in clock ticks)
+// overdub - events played over a loop go into a side buffer and are merged
+// into the pattern at the end of the pass - the merge rewrites the pattern
+// in place a few events at a time just ahead of playback
+#define SEQ_DUB_SIZE 32  // side buffer size in events - must be a power of 2
+#define SEQ_DUB_TRACK(voice) ((voice) + 2)  // overdubs go on tracks 2 and 3
+// most the packed pattern can grow for each event merged into it:
+// the event itself, a track change and bend change on the next event,
+// and held note offs that can no longer use the short form or find their
+// track from the held notes - 1 byte can become a track change and a note
+#define SEQ_DUB_ROOM ((SEQ_PACK_MAX_EVENT_LEN * 2) + (SEQ_PACK_HELD_MAX * 3))
+// the room for the next merge is opened, and the room a merge did not need
+// is closed up, by moving the end of the buffer a chunk at a time on the
+// clock ticks during the loop
+#define SEQ_DUB_MOVE_CHUNK 256  // most bytes moved on a clock tick
+#define SEQ_DUB_MERGE_STEP 16  // events merged on a clock tick on top of keeping ahead of playback
+#define SEQ_QUANT_GRID_MAX 96  // longest quantize grid - 1 bar
+struct seq_dub_event {
+    int time;  // time from the start of the loop - or of the recording (in clock ticks)
+    uint8_t track;
+    uint8_t type;
+    uint16_t value;
+};
+struct seq_dub_event seq_dub_buf[SEQ_DUB_SIZE];
+int seq_dub_head;  // next event to record
+int seq_dub_tail;  // next event to merge
+int seq_dub_count;  // events in the side buffer
+int seq_dub_merge_left;  // events in the side buffer that belong to the running merge
+uint8_t seq_dub_held[SEQ_PACK_HELD_MAX];  // recorded notes that need a note off
+uint8_t seq_dub_held_track[SEQ_PACK_HELD_MAX];
+int seq_dub_held_time[SEQ_PACK_HELD_MAX];  // time the note on was recorded at
+int seq_dub_held_shift[SEQ_PACK_HELD_MAX];  // how far the note on was moved by quantizing
+int seq_dub_num_held;
+int seq_dub_merging;  // 1 = a merge is running
+int seq_dub_dirty;  // 1 = the pattern needs to be saved
+int seq_dub_room;  // bytes of room opened in front of the pattern for the next merge
+int seq_dub_move_lo;  // start of the block being moved
+int seq_dub_move_hi;  // end of the block being moved
+int seq_dub_move_pos;  // bytes from here up (moving up) or below here (moving down) are moved
+int seq_dub_move_by;  // bytes the block is moved by - up > 0 - down < 0 - 0 = not moving
+int seq_dub_play_moved;  // 1 = playback has moved up with the pattern
+int seq_dub_gap;  // bytes the old pattern was moved up to make room
+int seq_dub_old_len;  // length of the old pattern in bytes
+int seq_dub_in_left;  // old events left to merge
+int seq_dub_in_time;  // time of the next old event
+int seq_dub_out_time;  // time of the last merged event
+int seq_dub_out_events;  // number of merged events
+int seq_dub_index_len;  // song position checkpoints written by the merge
+struct seq_pack_state seq_dub_in;  // old pattern reader
+struct seq_pack_state seq_dub_out;  // merged pattern writer
+struct seq_event seq_dub_in_event;  // next old event
+// record quantize - note ons are moved to the nearest grid line as they
+// are recorded and their note offs move with them, so playback is unchanged
+// - every other grid line is pushed late by the swing
+// - realtime record holds events back in the side buffer until nothing
+//   recorded after them can be moved in front of them
+int seq_quant_grid;  // grid in clock ticks - 0 = off
+int seq_quant_swing;  // swing - 0-127 = up to half a grid late
 
 // local functions
 void seq_change_state(int newstate);
-void seq_record_event(int event_type, int value, int step_rec);
+void seq_record_event(int track, int event_type, int value, int step_rec);
+void seq_record_write(int time, int track, int event_type, int value);
+void seq_record_bend_flush(void);
+void seq_record_step_flush(void);
+void seq_record_at(int time, int track, int event_type, int value);
+void seq_record_quant(int track, int event_type, int value);
+void seq_record_quant_flush(int all);
+int seq_quantize_time(int time);
+void seq_notes_off(void);
+void seq_set_transpose(int transpose);
+void seq_play_rewind(void);
+void seq_play_seek(int time);
+void seq_index_build(int pattern);
+void seq_index_resize(int pattern, int len);
+int seq_index_add(int pattern, int num, struct seq_pack_state *pack, int time, int event);
 void seq_play_events(void);
+void seq_pattern_select(int pattern);
+void seq_pattern_advance(void);
+void seq_pattern_remove(int pattern);
+void seq_pattern_save(void);
+void seq_pattern_load(void);
+int seq_dub_time(void);
+void seq_dub_record(int voice, int event_type, int value);
+void seq_dub_release(void);
+void seq_dub_insert(int time, int track, int event_type, int value);
+int seq_dub_hold(int track, int note, int time, int shift);
+int seq_dub_unhold(int track, int note, int time);
+void seq_dub_task(int time);
+void seq_dub_merge_start(void);
+void seq_dub_merge_event(void);
+void seq_dub_merge_run(int time);
+void seq_dub_flush(void);
+void seq_dub_room_open(void);
+void seq_dub_move_start(int lo, int by);
+void seq_dub_move_chunk(void);
+void seq_dub_move_end(void);
+void seq_dub_play_follow(void);
 
 // init the sequencer
 void seq_init(void) {
@@ -109,9 +262,36 @@ void seq_init(void) {
     seq_button_lockout = 0;
     seq_run_timer = 0;
     seq_play_event_pos = 0;
-    seq_num_events = 0;
-    seq_play_transpose = 0;
+    seq_play_transpose = 0;
     seq_startup = 5000;
+    seq_rec_bend[0] = SEQ_REC_BEND_NONE;
+    seq_rec_bend[1] = SEQ_REC_BEND_NONE;
+    seq_step_chord_len = 0;
+    seq_step_keys = 0;
+    seq_pattern_next = SEQ_PATTERN_NONE;
+    seq_chain_len = 0;
+    seq_chain_pos = 0;
+    seq_dub_head = 0;
+    seq_dub_tail = 0;
+    seq_dub_count = 0;
+    seq_dub_merge_left = 0;
+    seq_dub_num_held = 0;
+    seq_dub_merging = 0;
+    seq_dub_dirty = 0;
+    seq_dub_room = 0;
+    seq_dub_move_by = 0;
+    seq_dub_play_moved = 0;
+    seq_resume_state = SEQ_STATE_IDLE;
+    seq_resume_time = 0;
+    seq_quant_grid = seq_store_get_setting(SEQ_STORE_SETTING_QUANTIZE, 0);
+    seq_quant_swing = seq_quant_grid >> 8;
+    seq_quant_grid &= 0xff;
+    // load the saved patterns once - RAM is kept across soft power cycles
+    if(!seq_restored) {
+        seq_pattern_load();
+        seq_pattern_select(0);
+        seq_restored = 1;
+    }
 }
 
 // run the timer task - 1000us
@@ -148,9 +328,11 @@ void seq_timer_task(void) {
                     }
                     else {
                         phenol_midi_set_stop_ignore(1);  // enable
-                        ioctl_set_midi_rec_led(SEQ_LED_BLINK_ONCE);
-                        ioctl_set_midi_play_led(SEQ_LED_BLINK_ONCE);
+                        ioctl_set_midi_rec_led(SEQ_LED_BLINK_ONCE);
+                        ioctl_set_midi_play_led(SEQ_LED_BLINK_ONCE);
                     }
+                    seq_store_set_setting(SEQ_STORE_SETTING_STOP_IGNORE,
+                        phenol_midi_get_stop_ignore());
                 }
                 // normal
                 else {
@@ -171,8 +353,16 @@ void seq_timer_task(void) {
                 }
                 // play is not pressed
                 else {
+                    // overdub over a playing loop
+                    if(seq_state == SEQ_STATE_PLAY_LOOP) {
+                        seq_change_state(SEQ_STATE_OVERDUB);
+                    }
+                    // stop overdubbing and keep looping
+                    else if(seq_state == SEQ_STATE_OVERDUB) {
+                        seq_change_state(SEQ_STATE_PLAY_LOOP);
+                    }
                     // cancel recording
-                    if(seq_state == SEQ_STATE_STEP_REC_STBY || 
+                    else if(seq_state == SEQ_STATE_STEP_REC_STBY || 
                             seq_state == SEQ_STATE_RT_REC_STBY ||
                             seq_state == SEQ_STATE_STEP_REC_RUN ||
                             seq_state == SEQ_STATE_RT_REC_RUN) {
@@ -190,9 +380,24 @@ void seq_timer_task(void) {
         // play pressed
         if(seq_play_button_state) {
             seq_play_button_timer ++;
-            if(seq_play_button_timer == SEQ_BUTTON_HOLD_TIMEOUT) {
-                // loop mode
-                seq_change_state(SEQ_STATE_PLAY_LOOP);
+            if(seq_play_button_timer == SEQ_BUTTON_HOLD_TIMEOUT) {
+                // startup unit change - step to the next poly unit
+                if(seq_startup) {
+                    if(voice_get_unit() + 1 < voice_get_units()) {
+                        voice_set_unit(voice_get_unit() + 1);
+                    }
+                    // back to the first unit
+                    else {
+                        voice_set_unit(0);
+                        ioctl_set_midi_rec_led(SEQ_LED_BLINK_ONCE);
+                    }
+                    ioctl_set_midi_play_led(SEQ_LED_BLINK_ONCE);
+                }
+                // normal
+                else {
+                    // loop mode
+                    seq_change_state(SEQ_STATE_PLAY_LOOP);
+                }
                 seq_button_lockout = 1;
             }
         }
@@ -210,7 +415,8 @@ void seq_timer_task(void) {
                     seq_change_state(SEQ_STATE_PLAY_ONCE_END);
                 }
                 // stop a playing loop
-                else if(seq_state == SEQ_STATE_PLAY_LOOP) {
+                else if(seq_state == SEQ_STATE_PLAY_LOOP ||
+                        seq_state == SEQ_STATE_OVERDUB) {
                     seq_change_state(SEQ_STATE_PLAY_LOOP_END);
                 }
                 // start playing
@@ -252,32 +458,163 @@ void seq_clock_handle_midi_start(void) {
 
 // handle a MIDI stop event
 void seq_clock_handle_midi_stop(void) {
+    int state = seq_state;
+    int time = seq_run_timer - seq_loop_base;
     seq_change_state(SEQ_STATE_IDLE);
+    // remember where playback was for a continue
+    if(state == SEQ_STATE_PLAY_ONCE) {
+        seq_resume_state = SEQ_STATE_PLAY_ONCE;
+        seq_resume_time = time;
+    }
+    else if(state == SEQ_STATE_PLAY_LOOP || state == SEQ_STATE_OVERDUB) {
+        seq_resume_state = SEQ_STATE_PLAY_LOOP;
+        seq_resume_time = time;
+    }
 }
 
 // handle a MIDI continue event
 void seq_clock_handle_midi_continue(void) {
-    // no action     
+    int state = seq_resume_state;
+    if(seq_state != SEQ_STATE_IDLE || state == SEQ_STATE_IDLE) {
+        return;
+    }
+    seq_resume_state = SEQ_STATE_IDLE;  // starting play sends a continue too
+    // past the end of a one-shot
+    if(state == SEQ_STATE_PLAY_ONCE && seq_resume_time >= seq_length) {
+        return;
+    }
+    seq_change_state(state);
+    if(seq_state == state) {
+        seq_play_seek(seq_resume_time);
+    }
 }
 
+// handle a MIDI song position - tick = song position in clock ticks
+void seq_clock_handle_song_position(int tick) {
+    switch(seq_state) {
+        case SEQ_STATE_PLAY_ONCE:
+            // past the end of a one-shot
+            if(tick >= seq_length) {
+                seq_change_state(SEQ_STATE_PLAY_ONCE_END);
+                break;
+            }
+            seq_play_seek(tick);
+            break;
+        case SEQ_STATE_PLAY_LOOP:
+        case SEQ_STATE_OVERDUB:
+            seq_play_seek(tick);
+            break;
+        case SEQ_STATE_IDLE:
+            // stopped by MIDI stop - continue from here
+            seq_resume_time = tick;
+            break;
+    }
+}
+
 // handle a MIDI clock fail event
 void seq_clock_handle_clock_fail(void) {
     seq_change_state(SEQ_STATE_IDLE);  // stop and reset sequencer
 }
 
+// run the main loop task - call from the main loop
+// - a merged overdub is saved here once the buffer is at rest rather than
+//   on the clock tick that ends the loop
+void seq_poll(void) {
+    if(!seq_dub_dirty) {
+        return;
+    }
+    // the task timer moves data around in the buffer
+    INTEnable(INT_SOURCE_TIMER(TMR1), INT_DISABLED);
+    if(seq_dub_dirty && !seq_dub_count && !seq_dub_merging && !seq_dub_move_by &&
+            (seq_state == SEQ_STATE_IDLE || seq_state == SEQ_STATE_PLAY_ONCE ||
+            seq_state == SEQ_STATE_PLAY_LOOP)) {
+        seq_store_rec_start(seq_event_buf);
+        seq_pattern_save();
+    }
+    INTEnable(INT_SOURCE_TIMER(TMR1), INT_ENABLED);
+}
+
 // handle a clock tick
 void seq_clock_tick(void) {
+    voice_clock_tick();  // arp clock
     switch(seq_state) {
         case SEQ_STATE_RT_REC_RUN:
+            seq_record_bend_flush();
+            seq_record_quant_flush(0);
             seq_run_timer ++;
             break;
         case SEQ_STATE_PLAY_ONCE:
         case SEQ_STATE_PLAY_LOOP:
+        case SEQ_STATE_OVERDUB:
+            // keep the overdub merge ahead of playback and get the room
+            // ready for the next one
+            seq_dub_task(seq_run_timer - seq_loop_base);
             seq_play_events();        
             seq_run_timer ++;
             break;
-    }
-}
+    }
+}
+
+// select a pattern - switches at the end of the loop if playing
+void seq_pattern_queue(int pattern) {
+    if(pattern < 0 || pattern >= SEQ_NUM_PATTERNS) {
+        return;
+    }
+    switch(seq_state) {
+        case SEQ_STATE_PLAY_ONCE:
+        case SEQ_STATE_PLAY_LOOP:
+        case SEQ_STATE_OVERDUB:
+            seq_pattern_next = pattern;
+            break;
+        case SEQ_STATE_RT_REC_RUN:
+        case SEQ_STATE_STEP_REC_RUN:
+            break;  // finish recording first
+        default:
+            seq_pattern_select(pattern);
+            break;
+    }
+}
+
+// add a pattern to the end of the chain
+void seq_pattern_chain_add(int pattern) {
+    if(pattern < 0 || pattern >= SEQ_NUM_PATTERNS) {
+        return;
+    }
+    if(seq_chain_len == SEQ_CHAIN_MAX) {
+        return;
+    }
+    seq_chain[seq_chain_len] = pattern;
+    seq_chain_len ++;
+}
+
+// clear the chain
+void seq_pattern_chain_clear(void) {
+    seq_chain_len = 0;
+    seq_chain_pos = 0;
+}
+
+// set the record quantize grid - grid = clock ticks - 0 = off
+void seq_set_quantize(int grid) {
+    if(grid < 0 || grid > SEQ_QUANT_GRID_MAX) {
+        return;
+    }
+    seq_quant_grid = grid;
+    seq_store_set_setting(SEQ_STORE_SETTING_QUANTIZE, seq_quant_grid | (seq_quant_swing << 8));
+}
+
+// set the record swing - swing = 0-127 - every other grid line is up to half a grid late
+void seq_set_swing(int swing) {
+    if(swing < 0 || swing > 127) {
+        return;
+    }
+    seq_quant_swing = swing;
+    seq_store_set_setting(SEQ_STORE_SETTING_QUANTIZE, seq_quant_grid | (seq_quant_swing << 8));
+}
+
+// get the sequencer state - for monitoring
+int seq_get_state(void) {
+    return seq_state;
+}
 
 //
 // local functions
@@ -290,6 +627,15 @@ void seq_change_state(int newstate) {
     if(newstate == seq_state) {
         return;
     }
+    // playback only continues from a MIDI stop if nothing else was done
+    if(newstate != SEQ_STATE_IDLE) {
+        seq_resume_state = SEQ_STATE_IDLE;
+    }
+
+    // overdub notes still held are ended when overdubbing stops
+    if(seq_state == SEQ_STATE_OVERDUB) {
+        seq_dub_release();
+    }
 
     // see if we need to stop recording before entering another state
     if(seq_state == SEQ_STATE_RT_REC_RUN ||
@@ -302,11 +648,25 @@ void seq_change_state(int newstate) {
 #endif
         // insert end event in event list
         if(seq_state == SEQ_STATE_STEP_REC_RUN) {
-            seq_record_event(SEQ_EVENT_END, 0, 1);
+            seq_record_event(0, SEQ_EVENT_END, 0, 1);
         }
         else {
-            seq_record_event(SEQ_EVENT_END, 0, 0);
+            seq_record_event(0, SEQ_EVENT_END, 0, 0);
         }
+        // add the new pattern after the others - its checkpoints were
+        // added as it was recorded
+        if(seq_num_events) {
+            seq_patterns[seq_pattern].start = seq_rec_base;
+            seq_patterns[seq_pattern].len = seq_rec_pack.pos;
+            seq_patterns[seq_pattern].num_events = seq_num_events;
+            seq_patterns[seq_pattern].length = seq_rec_time;
+            seq_buf_used += seq_rec_pack.pos;
+        }
+        else {
+            seq_index_resize(seq_pattern, 0);
+        }
+        seq_pattern_select(seq_pattern);
+        seq_pattern_save();
         seq_state = SEQ_STATE_IDLE;  // in case the new state is invalid
     }
 
@@ -319,10 +679,11 @@ void seq_change_state(int newstate) {
 #ifdef SEQ_MIDI_DEBUG
             _midi_tx_debug(MIDI_PORT_USB, "seq state: idle");
 #endif
-            voice_all_notes_off(0);
+            seq_notes_off();
+            seq_dub_flush();  // finish any overdub before the pattern can change
             ioctl_set_midi_rec_led(SEQ_LED_OFF);
-            ioctl_set_midi_play_led(SEQ_LED_OFF);
-            voice_set_transpose(0, 0);  // reset transpose but remember current setting
+            ioctl_set_midi_play_led(SEQ_LED_OFF);
+            seq_set_transpose(0);  // reset transpose but remember current setting
             seq_state = SEQ_STATE_IDLE;
             break;
         case SEQ_STATE_ERASE:
@@ -333,7 +694,10 @@ void seq_change_state(int newstate) {
             _midi_tx_debug(MIDI_PORT_USB, "seq state: erase");
 #endif
             seq_change_state(SEQ_STATE_IDLE);
-            seq_num_events = 0;
+            // erase the selected pattern
+            seq_pattern_remove(seq_pattern);
+            seq_store_rec_start(seq_event_buf);
+            seq_pattern_save();
             ioctl_set_midi_rec_led(SEQ_LED_BLINK_ONCE);
             ioctl_set_midi_play_led(SEQ_LED_OFF);
             seq_change_state(SEQ_STATE_IDLE);
@@ -350,7 +714,7 @@ void seq_change_state(int newstate) {
             ioctl_set_midi_play_led(SEQ_LED_BLINK);
             // reset transpose
             seq_play_transpose = 0;
-            voice_set_transpose(0, seq_play_transpose);
+            seq_set_transpose(seq_play_transpose);
             seq_state = SEQ_STATE_RT_REC_STBY;
             break;
         case SEQ_STATE_RT_REC_RUN:
@@ -362,9 +726,19 @@ void seq_change_state(int newstate) {
 #endif
             seq_run_timer = 0;
             seq_last_event_time = 0;
-            seq_num_events = 0;
+            seq_rec_bend[0] = SEQ_REC_BEND_NONE;
+            seq_rec_bend[1] = SEQ_REC_BEND_NONE;
+            seq_dub_num_held = 0;
+            // record over the selected pattern - it goes after the others
+            seq_pattern_remove(seq_pattern);
+            seq_rec_base = seq_buf_used;
+            seq_rec_time = 0;
+            seq_pack_init(&seq_rec_pack, seq_event_buf + seq_rec_base,
+                SEQ_BUF_SIZE - SEQ_PATTERN_TABLE_SIZE - seq_rec_base);
+            seq_store_rec_start(seq_event_buf);
+            seq_store_rec_update(seq_rec_base);
             ioctl_set_midi_rec_led(SEQ_LED_ON);
-            ioctl_set_midi_play_led(SEQ_LED_ON);
+            ioctl_set_midi_play_led(SEQ_LED_ON);
             seq_state = SEQ_STATE_RT_REC_RUN;
             break;
         case SEQ_STATE_STEP_REC_STBY:
@@ -379,7 +753,7 @@ void seq_change_state(int newstate) {
             ioctl_set_midi_play_led(SEQ_LED_OFF);
             // reset transpose
             seq_play_transpose = 0;
-            voice_set_transpose(0, seq_play_transpose);
+            seq_set_transpose(seq_play_transpose);
             seq_state = SEQ_STATE_STEP_REC_STBY;
             break;
         case SEQ_STATE_STEP_REC_RUN:
@@ -391,9 +765,17 @@ void seq_change_state(int newstate) {
 #endif
             seq_run_timer = 0;
             seq_last_event_time = 0;
-            seq_num_events = 0;
+            seq_step_chord_len = 0;
+            // record over the selected pattern - it goes after the others
+            seq_pattern_remove(seq_pattern);
+            seq_rec_base = seq_buf_used;
+            seq_rec_time = 0;
+            seq_pack_init(&seq_rec_pack, seq_event_buf + seq_rec_base,
+                SEQ_BUF_SIZE - SEQ_PATTERN_TABLE_SIZE - seq_rec_base);
+            seq_store_rec_start(seq_event_buf);
+            seq_store_rec_update(seq_rec_base);
             ioctl_set_midi_rec_led(SEQ_LED_ON);
-            ioctl_set_midi_play_led(SEQ_LED_OFF);
+            ioctl_set_midi_play_led(SEQ_LED_OFF);
             seq_state = SEQ_STATE_STEP_REC_RUN;
             break;
         case SEQ_STATE_PLAY_ONCE:
@@ -408,10 +790,10 @@ void seq_change_state(int newstate) {
             if(seq_num_events > 0) {
                 // reset transpose
                 seq_play_transpose = 0;
-                voice_set_transpose(0, seq_play_transpose);
-                // start playback
+                seq_set_transpose(seq_play_transpose);
+                // start playback
                 seq_run_timer = 0;
-                seq_play_event_pos = 0;
+                seq_play_rewind();
                 seq_last_event_time = 0;
                 ioctl_set_midi_rec_led(SEQ_LED_OFF);
                 ioctl_set_midi_play_led(SEQ_LED_ON);
@@ -427,7 +809,8 @@ void seq_change_state(int newstate) {
             _midi_tx_debug(MIDI_PORT_USB, "seq state: play loop");
 #endif
             // if we're already playing a one-shot, just enable loop mode without restarting
-            if(seq_state == SEQ_STATE_PLAY_ONCE) {
+            if(seq_state == SEQ_STATE_PLAY_ONCE ||
+                    seq_state == SEQ_STATE_OVERDUB) {
                 seq_state = SEQ_STATE_PLAY_LOOP;
                 ioctl_set_midi_rec_led(SEQ_LED_OFF);
                 ioctl_set_midi_play_led(SEQ_LED_BLINK);
@@ -438,10 +821,10 @@ void seq_change_state(int newstate) {
                 if(seq_num_events > 0) {
                     // reset transpose
                     seq_play_transpose = 0;
-                    voice_set_transpose(0, seq_play_transpose);
-                    // start playback
+                    seq_set_transpose(seq_play_transpose);
+                    // start playback
                     seq_run_timer = 0;
-                    seq_play_event_pos = 0;
+                    seq_play_rewind();
                     seq_last_event_time = 0;
                     seq_state = SEQ_STATE_PLAY_LOOP;
                     ioctl_set_midi_rec_led(SEQ_LED_OFF);
@@ -458,6 +841,21 @@ void seq_change_state(int newstate) {
         case SEQ_STATE_PLAY_LOOP_END:
             seq_state = SEQ_STATE_PLAY_ONCE;  // cause playback to stop at end
             break;
+        case SEQ_STATE_OVERDUB:
+#ifdef SEQ_HOST_DEBUG
+            log_debug("seq state: overdub");
+#endif
+#ifdef SEQ_MIDI_DEBUG
+            _midi_tx_debug(MIDI_PORT_USB, "seq state: overdub");
+#endif
+            // only over a pattern that is already playing
+            if(seq_state == SEQ_STATE_PLAY_ONCE ||
+                    seq_state == SEQ_STATE_PLAY_LOOP) {
+                ioctl_set_midi_rec_led(SEQ_LED_ON);
+                ioctl_set_midi_play_led(SEQ_LED_BLINK);
+                seq_state = SEQ_STATE_OVERDUB;
+            }
+            break;
         default:
 #ifdef SEQ_HOST_DEBUG
             log_debug("unknown state: %d", newstate);
@@ -471,174 +869,540 @@ void seq_change_state(int newstate) {
 }
 
 // record an event at the current time
-void seq_record_event(int event_type, int value, int step_rec) {
-#ifdef SEQ_MIDI_DEBUG
-    char strtmp[64];
-#endif
-    // we have space to record more events
-    if(seq_num_events < (SEQ_MAX_EVENTS - 2)) {
-        seq_event_buf[seq_num_events].type = event_type;
-        seq_event_buf[seq_num_events].value = value;
-        // step record
-        if(step_rec) {
-            // force first event at 0 time delta
-            if(seq_num_events == 0) {
-                seq_event_buf[seq_num_events].time = 0;
-            }
-            // other events go forward 
-            else {
-                seq_event_buf[seq_num_events].time = SEQ_STEP_REC_STEP_TIME >> 1;
-            }
-            // note on events are automatically stopped 1/2 a step later
-            if(event_type == SEQ_EVENT_NOTE_ON) {
-                // insert note off
-                seq_num_events ++;
-                seq_event_buf[seq_num_events].type = SEQ_EVENT_NOTE_OFF;
-                seq_event_buf[seq_num_events].value = value;
-                seq_event_buf[seq_num_events].time = SEQ_STEP_REC_STEP_TIME >> 1;
-            }
-            // rest event
-            else if(event_type == SEQ_EVENT_REST) {
-                // make the delta the full step length instead of half a step
-                seq_event_buf[seq_num_events].time = SEQ_STEP_REC_STEP_TIME;
+void seq_record_event(int track, int event_type, int value, int step_rec) {
+    // keep the pitch bend in order with the other events
+    if(event_type != SEQ_EVENT_PITCH_BEND) {
+        seq_record_bend_flush();
+    }
+    // make sure there is room for the event, the note offs and the end marker
+    if(event_type != SEQ_EVENT_END &&
+            seq_pack_room(&seq_rec_pack) <
+            (SEQ_PACK_MAX_EVENT_LEN * (3 + seq_step_chord_len + seq_dub_count))) {
+#ifdef SEQ_HOST_DEBUG
+        log_debug("event list full - stopping record");
+#endif
+#ifdef SEQ_MIDI_DEBUG
+        _midi_tx_debug(MIDI_PORT_USB, "event list full - stopping record");
+#endif
+        seq_change_state(SEQ_STATE_IDLE);  // inserts the end marker
+        return;
+    }
+    // step record
+    if(step_rec) {
+        // note on events are automatically stopped 1/2 a step later
+        if(event_type == SEQ_EVENT_NOTE_ON) {
+            // other keys are still held down - add the note to the chord
+            if(seq_step_keys && seq_step_chord_len &&
+                    seq_step_chord_len < SEQ_STEP_CHORD_MAX) {
+                seq_record_write(0, track, event_type, value);
             }
-            // end the sequence
-            else if(event_type == SEQ_EVENT_END) {
-                // we can't have a sequence with no notes
-                if(seq_num_events == 0) {
-                    return;
-                }
-                seq_event_buf[seq_num_events].type = SEQ_EVENT_END;
-                // back up 1 tick so next loop starts on the note start time
-                seq_event_buf[seq_num_events].time = (SEQ_STEP_REC_STEP_TIME >> 1) - 1;
+            // force first event at 0 time delta - other events go forward
+            else if(seq_num_events == 0) {
+                seq_record_write(0, track, event_type, value);
             }
-            // other events are ignored
             else {
+                seq_record_step_flush();
+                seq_record_write(SEQ_STEP_REC_STEP_TIME >> 1, track, event_type, value);
+            }
+            // the note off is inserted when the step is done
+            seq_step_chord[seq_step_chord_len] = value;
+            seq_step_chord_track[seq_step_chord_len] = track;
+            seq_step_chord_len ++;
+        }
+        // rest event
+        else if(event_type == SEQ_EVENT_REST) {
+            seq_record_step_flush();
+            // the delta is the full step length instead of half a step
+            seq_record_write(SEQ_STEP_REC_STEP_TIME, track, event_type, 0);
+        }
+        // end the sequence
+        else if(event_type == SEQ_EVENT_END) {
+            seq_record_step_flush();
+            // we can't have a sequence with no notes
+            if(seq_num_events == 0) {
                 return;
             }
+            // back up 1 tick so next loop starts on the note start time
+            seq_record_write((SEQ_STEP_REC_STEP_TIME >> 1) - 1, track, event_type, 0);
         }
-        // realtime record
+        // other events are ignored
         else {
-            seq_event_buf[seq_num_events].time = seq_run_timer - seq_last_event_time;            
+            return;
         }
-#ifdef SEQ_HOST_DEBUG
-        log_debug("recording event - num: %d - type: 0x%02x - value: 0x%02x - time: %d",
-            seq_num_events,
-            seq_event_buf[seq_num_events].type,
-            seq_event_buf[seq_num_events].value,
-            seq_event_buf[seq_num_events].time);            
-#endif
-#ifdef SEQ_MIDI_DEBUG
-        sprintf(strtmp, "recording event - num: %d - type: 0x%02x - value: 0x%02x - time: %d",
-            seq_num_events,
-            seq_event_buf[seq_num_events].type,
-            seq_event_buf[seq_num_events].value,
-            seq_event_buf[seq_num_events].time);            
-        _midi_tx_debug(MIDI_PORT_USB, strtmp);
+    }
+    // realtime record - quantized
+    else if(seq_quant_grid && event_type != SEQ_EVENT_END) {
+        seq_record_quant(track, event_type, value);
+        return;
+    }
+    // realtime record - anything held back goes first
+    else {
+        seq_record_quant_flush(1);
+        seq_record_at(seq_run_timer, track, event_type, value);
+        return;
+    }
+    seq_last_event_time = seq_run_timer;
+}
+
+// record an event at a time in the recording
+// - the time can't go backwards so late events go with the last one
+void seq_record_at(int time, int track, int event_type, int value) {
+    if(time < seq_last_event_time) {
+        time = seq_last_event_time;
+    }
+    seq_record_write(time - seq_last_event_time, track, event_type, value);
+    seq_last_event_time = time;
+}
+
+// hold a realtime event back in the side buffer at its quantized time
+void seq_record_quant(int track, int event_type, int value) {
+    struct seq_dub_event *ev;
+    int time = seq_run_timer;
+    int temp;
+
+    // side buffer is full - the oldest event has to go now
+    if(seq_dub_count == SEQ_DUB_SIZE) {
+        ev = &seq_dub_buf[seq_dub_tail];
+        seq_dub_tail = (seq_dub_tail + 1) & (SEQ_DUB_SIZE - 1);
+        seq_dub_count --;
+        seq_record_at(ev->time, ev->track, ev->type, ev->value);
+    }
+    if(event_type == SEQ_EVENT_NOTE_ON) {
+        temp = seq_quantize_time(time);
+        // the note is left where it is if its note off can't be moved with it
+        if(seq_dub_hold(track, value, temp, temp - time)) {
+            time = temp;
+        }
+    }
+    else if(event_type == SEQ_EVENT_NOTE_OFF) {
+        temp = seq_dub_unhold(track, value, time);
+        if(temp >= 0) {
+            time = temp;
+        }
+    }
+    seq_dub_insert(time, track, event_type, value);
+}
+
+// record the held back realtime events
+// - all = 1 - record all of them
+// - all = 0 - record the ones that nothing recorded from now on can go in front of
+void seq_record_quant_flush(int all) {
+    struct seq_dub_event *ev;
+    while(seq_dub_count) {
+        ev = &seq_dub_buf[seq_dub_tail];
+        if(!all && (ev->time + seq_quant_grid) >= seq_run_timer) {
+            return;
+        }
+        seq_dub_tail = (seq_dub_tail + 1) & (SEQ_DUB_SIZE - 1);
+        seq_dub_count --;
+        seq_record_at(ev->time, ev->track, ev->type, ev->value);
+    }
+}
+
+// move a time to the nearest quantize grid line
+// - grid lines come in pairs and the second one is late by the swing
+int seq_quantize_time(int time) {
+    int pair, late, base;
+    if(seq_quant_grid == 0) {
+        return time;
+    }
+    pair = seq_quant_grid << 1;
+    late = seq_quant_grid + ((seq_quant_grid * seq_quant_swing) >> 8);
+    base = time - (time % pair);
+    time = (time - base) << 1;  // compare at half tick steps
+    if(time < late) {
+        return base;
+    }
+    if(time < (late + pair)) {
+        return base + late;
+    }
+    return base + pair;
+}
+
+// insert the note offs for the last step record chord - half a step after the notes
+void seq_record_step_flush(void) {
+    int i;
+    for(i = 0; i < seq_step_chord_len; i ++) {
+        seq_record_write(i ? 0 : (SEQ_STEP_REC_STEP_TIME >> 1),
+            seq_step_chord_track[i], SEQ_EVENT_NOTE_OFF, seq_step_chord[i]);
+    }
+    seq_step_chord_len = 0;
+}
+
+// record the pitch bends that are waiting
+// - bends in the same tick are played at the same time so only the last one is needed
+void seq_record_bend_flush(void) {
+    int voice, bend;
+    for(voice = 0; voice < SEQ_NUM_VOICES; voice ++) {
+        bend = seq_rec_bend[voice];
+        if(bend == SEQ_REC_BEND_NONE) continue;
+        seq_rec_bend[voice] = SEQ_REC_BEND_NONE;
+        seq_record_event(voice, SEQ_EVENT_PITCH_BEND, bend, 0);
+    }
+}
+
+// pack an event onto the end of the recording
+void seq_record_write(int time, int track, int event_type, int value) {
+#ifdef SEQ_MIDI_DEBUG
+    char strtmp[64];
 #endif
-        seq_last_event_time = seq_run_timer;
-        seq_num_events ++;
-        if(seq_num_events == (SEQ_MAX_EVENTS - 1)) {
-            // insert end marker
-            seq_event_buf[seq_num_events].type = SEQ_EVENT_END;
-            seq_event_buf[seq_num_events].value = 0;
-            if(step_rec) {
-                seq_event_buf[seq_num_events].time = SEQ_STEP_REC_STEP_TIME;
-            }
-            else {
-                seq_event_buf[seq_num_events].time = 0;
-            }
+    seq_index_add(seq_pattern, seq_patterns[seq_pattern].index_len,
+        &seq_rec_pack, seq_rec_time, seq_num_events);
+    if(!seq_pack_write(&seq_rec_pack, time, track, event_type, value)) {
+        return;
+    }
+    seq_rec_time += time;
 #ifdef SEQ_HOST_DEBUG
-            log_debug("event list full - stopping record");
-#endif
-#ifdef SEQ_MIDI_DEBUG
-            _midi_tx_debug(MIDI_PORT_USB, "event list full - stopping record");
+    log_debug("recording event - num: %d - track: %d - type: 0x%02x - value: 0x%02x - time: %d - bytes: %d",
+        seq_num_events, track, event_type, value, time, seq_rec_pack.pos);
 #endif
-            seq_change_state(SEQ_STATE_IDLE);
+#ifdef SEQ_MIDI_DEBUG
+    sprintf(strtmp, "recording event - num: %d - track: %d - type: 0x%02x - value: 0x%02x - time: %d",
+        seq_num_events, track, event_type, value, time);
+    _midi_tx_debug(MIDI_PORT_USB, strtmp);
+#endif
+    seq_num_events ++;
+    seq_store_rec_update(seq_rec_base + seq_rec_pack.pos);
+}
+
+// rewind playback to the start of the recording
+void seq_play_rewind(void) {
+    seq_play_event_pos = 0;
+    seq_loop_base = seq_run_timer;
+    seq_pack_init(&seq_play_pack, seq_play_buf, seq_play_size);
+    if(seq_pack_read(&seq_play_pack, &seq_play_event) != SEQ_PACK_READ_OK) {
+        seq_play_event_pos = seq_num_events;
+    }
+}
+
+// seek playback to a time in the sequence and chase the notes that should be on
+// - uses the index of the selected pattern, which is always ready, and reads
+//   at most the events between two checkpoints
+void seq_play_seek(int time) {
+    struct seq_index_entry *entry;
+    struct seq_pack_mark mark;
+    int lo, hi, mid, event_time, i;
+
+    // the overdub has to be merged to jump around in the pattern
+    if(seq_state == SEQ_STATE_OVERDUB) {
+        seq_dub_release();
+    }
+    seq_dub_flush();
+    if(seq_index_len == 0 || seq_length == 0) {
+        return;
+    }
+    time %= seq_length;
+
+    // find the last checkpoint before the time
+    lo = 0;
+    hi = seq_index_len - 1;
+    while(lo < hi) {
+        mid = (lo + hi + 1) >> 1;
+        if(seq_index[mid].time < time) {
+            lo = mid;
+        }
+        else {
+            hi = mid - 1;
         }
     }
-    else {
-        seq_change_state(SEQ_STATE_IDLE);
+    entry = &seq_index[lo];
+
+    // skip over the events before the time - the next checkpoint is at or
+    // past the time so the event is found before it
+    seq_pack_init(&seq_play_pack, seq_play_buf, seq_play_size);
+    seq_pack_set_mark(&seq_play_pack, &entry->mark);
+    seq_play_event_pos = entry->event;
+    event_time = entry->time;
+    while(1) {
+        seq_pack_get_mark(&seq_play_pack, &mark);  // held notes before this event
+        if(seq_play_event_pos >= seq_num_events ||
+                seq_pack_read(&seq_play_pack, &seq_play_event) != SEQ_PACK_READ_OK) {
+            seq_play_event_pos = seq_num_events;
+            break;
+        }
+        if((event_time + seq_play_event.time) >= time) {
+            break;
+        }
+        event_time += seq_play_event.time;
+        seq_play_event_pos ++;
+    }
+    seq_run_timer = time;
+    seq_last_event_time = event_time;
+    seq_loop_base = 0;
+
+    // chase - the held notes are the ones that should be sounding
+    seq_notes_off();
+    seq_set_transpose(seq_play_transpose);
+    for(i = 0; i < SEQ_PACK_NUM_TRACKS; i ++) {
+        if(mark.bend_seen & (1 << i)) {
+            voice_pitch_bend(SEQ_TRACK_VOICE(i), mark.run_bend[i]);
+        }
+    }
+    for(i = 0; i < mark.num_held; i ++) {
+        voice_note_on(SEQ_TRACK_VOICE(mark.held_track[i]), mark.held[i], SEQ_NOTE_VEL);
+    }
+}
+
+// build the song position index and length of a pattern by reading it
+// - only used when the patterns are loaded - recording and merging add
+//   the checkpoints as they go
+void seq_index_build(int pattern) {
+    struct seq_pattern *pat = &seq_patterns[pattern];
+    struct seq_pack_state pack;
+    struct seq_event ev;
+    int i, time;
+
+    seq_index_resize(pattern, 0);
+    seq_pack_init(&pack, seq_event_buf + pat->start, pat->len);
+    time = 0;
+    for(i = 0; i < pat->num_events; i ++) {
+        seq_index_add(pattern, pat->index_len, &pack, time, i);
+        if(seq_pack_read(&pack, &ev) != SEQ_PACK_READ_OK) {
+            break;
+        }
+        time += ev.time;
+    }
+    pat->length = time;
+}
+
+// change the number of checkpoints a pattern has in the index pool
+// - the checkpoints of the patterns after it are moved to make room
+// - a pattern with no checkpoints gets its new ones at the end
+void seq_index_resize(int pattern, int len) {
+    struct seq_pattern *pat = &seq_patterns[pattern];
+    int i, end, change;
+
+    if(pat->index_len == 0) {
+        pat->index_start = seq_index_used;
+    }
+    end = pat->index_start + pat->index_len;
+    change = len - pat->index_len;
+    if((seq_index_used + change) > SEQ_INDEX_SIZE) {
+        change = SEQ_INDEX_SIZE - seq_index_used;
+    }
+    if(change == 0) {
+        return;
+    }
+    memmove(&seq_index_pool[end + change], &seq_index_pool[end],
+        (seq_index_used - end) * sizeof(struct seq_index_entry));
+    for(i = 0; i < SEQ_NUM_PATTERNS; i ++) {
+        if(seq_patterns[i].index_len && seq_patterns[i].index_start >= end) {
+            seq_patterns[i].index_start += change;
+        }
+    }
+    seq_index_used += change;
+    pat->index_len += change;
+}
+
+// add a checkpoint for the next event written to a pattern if the stream
+// has gone far enough since the last one
+// - num is the number of checkpoints written so far - the pattern gets
+//   more entries if it needs them
+// - returns the new number of checkpoints
+int seq_index_add(int pattern, int num, struct seq_pack_state *pack, int time, int event) {
+    struct seq_pattern *pat = &seq_patterns[pattern];
+    struct seq_index_entry *entry;
+
+    if(pack->pos < (num * SEQ_INDEX_STEP)) {
+        return num;
+    }
+    if(num >= pat->index_len) {
+        if(seq_index_used >= SEQ_INDEX_SIZE) {
+            return num;
+        }
+        seq_index_resize(pattern, num + 1);
     }
+    entry = &seq_index_pool[pat->index_start + num];
+    entry->time = time;
+    entry->event = event;
+    seq_pack_get_mark(pack, &entry->mark);
+    return num + 1;
+}
+
+// select a pattern for playback - O(1) so it can be done on the clock tick
+void seq_pattern_select(int pattern) {
+    seq_pattern = pattern;
+    seq_play_buf = seq_event_buf + seq_patterns[pattern].start;
+    seq_play_size = seq_patterns[pattern].len;
+    seq_num_events = seq_patterns[pattern].num_events;
+    seq_index = &seq_index_pool[seq_patterns[pattern].index_start];
+    seq_index_len = seq_patterns[pattern].index_len;
+    seq_length = seq_patterns[pattern].length;
+}
+
+// go to the queued pattern or the next one in the chain at the end of a loop
+void seq_pattern_advance(void) {
+    int next = seq_pattern_next;
+    seq_pattern_next = SEQ_PATTERN_NONE;
+    if(next == SEQ_PATTERN_NONE && seq_chain_len) {
+        next = seq_chain[seq_chain_pos];
+        seq_chain_pos ++;
+        if(seq_chain_pos >= seq_chain_len) {
+            seq_chain_pos = 0;
+        }
+    }
+    if(next != SEQ_PATTERN_NONE && next != seq_pattern) {
+        seq_dub_flush();  // finish any overdub before the pattern changes
+        seq_pattern_select(next);
+    }
+}
+
+// remove a pattern and close up the space it used
+void seq_pattern_remove(int pattern) {
+    struct seq_pattern *pat = &seq_patterns[pattern];
+    int i;
+    if(pat->len) {
+        seq_store_rec_edit();
+        memmove(seq_event_buf + pat->start, seq_event_buf + pat->start + pat->len,
+            seq_buf_used - (pat->start + pat->len));
+        for(i = 0; i < SEQ_NUM_PATTERNS; i ++) {
+            if(seq_patterns[i].start > pat->start) {
+                seq_patterns[i].start -= pat->len;
+            }
+        }
+        seq_buf_used -= pat->len;
+    }
+    seq_index_resize(pattern, 0);
+    pat->start = 0;
+    pat->len = 0;
+    pat->num_events = 0;
+    pat->length = 0;
+    seq_pattern_select(seq_pattern);
+}
+
+// save all the patterns to the flash store
+// - the pattern table is put after the patterns
+void seq_pattern_save(void) {
+    uint8_t *table = seq_event_buf + seq_buf_used;
+    int i;
+    seq_dub_dirty = 0;  // a merged overdub goes with it
+    for(i = 0; i < SEQ_NUM_PATTERNS; i ++) {
+        *table++ = seq_patterns[i].start & 0xff;
+        *table++ = seq_patterns[i].start >> 8;
+        *table++ = seq_patterns[i].len & 0xff;
+        *table++ = seq_patterns[i].len >> 8;
+        *table++ = seq_patterns[i].num_events & 0xff;
+        *table++ = seq_patterns[i].num_events >> 8;
+    }
+    seq_store_rec_commit(seq_buf_used + SEQ_PATTERN_TABLE_SIZE, SEQ_NUM_PATTERNS);
+}
+
+// load all the patterns from the flash store
+void seq_pattern_load(void) {
+    uint8_t *table;
+    int i, len, num;
+
+    seq_buf_used = 0;
+    seq_index_used = 0;
+    for(i = 0; i < SEQ_NUM_PATTERNS; i ++) {
+        seq_patterns[i].start = 0;
+        seq_patterns[i].len = 0;
+        seq_patterns[i].num_events = 0;
+        seq_patterns[i].index_start = 0;
+        seq_patterns[i].index_len = 0;
+        seq_patterns[i].length = 0;
+    }
+    len = seq_store_load(seq_event_buf, SEQ_BUF_SIZE, &num);
+    if(num != SEQ_NUM_PATTERNS || len < SEQ_PATTERN_TABLE_SIZE) {
+        return;
+    }
+    len -= SEQ_PATTERN_TABLE_SIZE;
+    table = seq_event_buf + len;
+    for(i = 0; i < SEQ_NUM_PATTERNS; i ++) {
+        seq_patterns[i].start = table[0] | (table[1] << 8);
+        seq_patterns[i].len = table[2] | (table[3] << 8);
+        seq_patterns[i].num_events = table[4] | (table[5] << 8);
+        table += 6;
+        // bad entry
+        if((seq_patterns[i].start + seq_patterns[i].len) > len) {
+            seq_patterns[i].start = 0;
+            seq_patterns[i].len = 0;
+            seq_patterns[i].num_events = 0;
+        }
+        seq_index_build(i);
+    }
+    seq_buf_used = len;
 }
 
 // play events if possible
 void seq_play_events(void) {
-#ifdef SEQ_MIDI_DEBUG
-    char strtmp[64];
-#endif
-    int temp;
+#ifdef SEQ_MIDI_DEBUG
+    char strtmp[64];
+#endif
+    int temp, voice;
     while(1) {
         // there are more events to play
-        if(seq_play_event_pos < seq_num_events) {
-            // if we are on internal and it's event 0, pulse the clock output
-            if(seq_play_event_pos == 0 && midi_clock_get_internal()) {
-                midi_clock_pulse_clock_out();
-            }
+        if(seq_play_event_pos < seq_num_events) {
+            // if we are on internal and it's event 0, pulse the clock output
+            if(seq_play_event_pos == 0 && midi_clock_get_internal()) {
+                midi_clock_pulse_clock_out();
+            }
 
-            // execute the event
-            if(seq_event_buf[seq_play_event_pos].time <= (seq_run_timer - seq_last_event_time)) {
-                switch(seq_event_buf[seq_play_event_pos].type) {
+            // execute the event - all tracks are in one stream so
+            // everything due on this tick is played in one pass
+            if(seq_play_event.time <= (seq_run_timer - seq_last_event_time)) {
+                voice = SEQ_TRACK_VOICE(seq_play_event.track);
+                switch(seq_play_event.type) {
                     case SEQ_EVENT_NOTE_OFF:
 #ifdef SEQ_HOST_DEBUG
                         log_debug("play note off - event: %d - time: %d - value: 0x%02x", 
                             seq_play_event_pos,
                             seq_run_timer,
-                            seq_event_buf[seq_play_event_pos].value);
-#endif
-#ifdef SEQ_MIDI_DEBUG
+                            seq_play_event.value);
+#endif
+#ifdef SEQ_MIDI_DEBUG
                         sprintf(strtmp, "play note off - event: %d - time: %d - value: 0x%02x", 
                             seq_play_event_pos,
                             seq_run_timer,
-                            seq_event_buf[seq_play_event_pos].value);
-                        _midi_tx_debug(MIDI_PORT_USB, strtmp);
+                            seq_play_event.value);
+                        _midi_tx_debug(MIDI_PORT_USB, strtmp);
 #endif         
-                        voice_note_off(0, seq_event_buf[seq_play_event_pos].value);
+                        voice_note_off(voice, seq_play_event.value);
                         break;
                     case SEQ_EVENT_NOTE_ON:
 #ifdef SEQ_HOST_DEBUG
                         log_debug("play note on - event: %d - time: %d - value: 0x%02x", 
                             seq_play_event_pos,
                             seq_run_timer,
-                            seq_event_buf[seq_play_event_pos].value);
-#endif
+                            seq_play_event.value);
+#endif
 #ifdef SEQ_MIDI_DEBUG
                         sprintf(strtmp, "play note on - event: %d - time: %d - value: 0x%02x", 
                             seq_play_event_pos,
                             seq_run_timer,
-                            seq_event_buf[seq_play_event_pos].value);
-                        _midi_tx_debug(MIDI_PORT_USB, strtmp);
+                            seq_play_event.value);
+                        _midi_tx_debug(MIDI_PORT_USB, strtmp);
 #endif
                         // update transpose offset in voice module
-                        voice_set_transpose(0, seq_play_transpose);
+                        voice_set_transpose(voice, seq_play_transpose);
                         // turn on note
-                        voice_note_on(0, seq_event_buf[seq_play_event_pos].value, SEQ_NOTE_VEL);
+                        voice_note_on(voice, seq_play_event.value, SEQ_NOTE_VEL);
                         break;
                     case SEQ_EVENT_PITCH_BEND:
-                        temp = seq_event_buf[seq_play_event_pos].value << 8;
+                        temp = seq_play_event.value;
 #ifdef SEQ_HOST_DEBUG
                         log_debug("play pitch bend - event: %d - time: %d - value: %d", 
                             seq_play_event_pos,
                             seq_run_timer,
                             temp);
-#endif
-#ifdef SEQ_MIDI_DEBUG
+#endif
+#ifdef SEQ_MIDI_DEBUG
                         sprintf(strtmp, "play pitch bend - event: %d - time: %d - value: %d", 
                             seq_play_event_pos,
                             seq_run_timer,
-                            temp);                  
-                        _midi_tx_debug(MIDI_PORT_USB, strtmp);
+                            temp);                  
+                        _midi_tx_debug(MIDI_PORT_USB, strtmp);
 #endif
-                        voice_pitch_bend(0, temp);
-                        break;
-                    case SEQ_EVENT_REST:
-                        // do nothing
+                        voice_pitch_bend(voice, temp);
+                        break;
+                    case SEQ_EVENT_REST:
+                        // do nothing
 #ifdef SEQ_HOST_DEBUG
                         log_debug("play rest");
-#endif
-#ifdef SEQ_MIDI_DEBUG
-                        _midi_tx_debug(MIDI_PORT_USB, "play rest");
-#endif
+#endif
+#ifdef SEQ_MIDI_DEBUG
+                        _midi_tx_debug(MIDI_PORT_USB, "play rest");
+#endif
                         break;
                     case SEQ_EVENT_END:
                         // let it go because the routine below will catch us
@@ -646,6 +1410,15 @@ void seq_play_events(void) {
                 }
                 seq_play_event_pos ++;
                 seq_last_event_time = seq_run_timer;
+                // the pattern may be moving up to open room for a merge
+                if(seq_dub_move_by > 0) {
+                    seq_dub_play_follow();
+                }
+                // unpack the next event
+                if(seq_play_event_pos < seq_num_events &&
+                        seq_pack_read(&seq_play_pack, &seq_play_event) != SEQ_PACK_READ_OK) {
+                    seq_play_event_pos = seq_num_events;
+                }
             }
             // event is in the future
             else {
@@ -656,31 +1429,471 @@ void seq_play_events(void) {
         else {
 #ifdef SEQ_HOST_DEBUG
             log_debug("playback end - time: %d", seq_run_timer);
-#endif
-#ifdef SEQ_MIDI_DEBUG
-            sprintf(strtmp, "playback end - time: %d", seq_run_timer);
-            _midi_tx_debug(MIDI_PORT_USB, strtmp);
 #endif
-            voice_all_notes_off(0);
-            // loop
-            if(seq_state == SEQ_STATE_PLAY_LOOP) {
-                seq_play_event_pos = 0;
+#ifdef SEQ_MIDI_DEBUG
+            sprintf(strtmp, "playback end - time: %d", seq_run_timer);
+            _midi_tx_debug(MIDI_PORT_USB, strtmp);
+#endif
+            // overdub notes held over the end of the loop are ended here
+            if(seq_state == SEQ_STATE_OVERDUB) {
+                seq_dub_release();
             }
-            // stop
-            else {
-                seq_change_state(SEQ_STATE_IDLE);
+            seq_notes_off();
+            // loop - merge the overdub or carry on with the queued or chained pattern
+            if(seq_state == SEQ_STATE_PLAY_LOOP || seq_state == SEQ_STATE_OVERDUB) {
+                if(seq_dub_count) {
+                    seq_dub_merge_start();
+                    seq_dub_merge_run(0);  // the start of the loop is ready to play
+                }
+                else {
+                    seq_pattern_advance();
+                }
+                if(seq_num_events) {
+                    seq_play_rewind();
+                    // the first event waits for the next tick
+                    if(seq_play_event.time == 0) {
+                        seq_loop_base ++;
+                    }
+                    return;
+                }
+            }
+            // a queued pattern plays once before stopping
+            else if(seq_pattern_next != SEQ_PATTERN_NONE) {
+                seq_dub_flush();
+                seq_pattern_select(seq_pattern_next);
+                seq_pattern_next = SEQ_PATTERN_NONE;
+                if(seq_num_events) {
+                    seq_play_rewind();
+                    return;
+                }
             }
+            // stop
+            seq_change_state(SEQ_STATE_IDLE);
             return;
         }
     }
 }            
 
+//
+// overdub
+//
+// get the time from the start of the loop for an overdub event
+int seq_dub_time(void) {
+    int time = seq_run_timer - seq_loop_base;
+    if(time < 0) {
+        return 0;
+    }
+    return time;
+}
+
+// add an event to the overdub side buffer
+void seq_dub_record(int voice, int event_type, int value) {
+    struct seq_dub_event *ev;
+    int track = SEQ_DUB_TRACK(voice);
+    int time = seq_dub_time();
+    int room, temp;
+
+    // note offs are only recorded for notes that were recorded
+    if(event_type == SEQ_EVENT_NOTE_OFF) {
+        time = seq_dub_unhold(track, value, time);
+        if(time < 0) {
+            return;
+        }
+    }
+    else {
+        // bends in the same tick are played at the same time so only the last one is needed
+        if(event_type == SEQ_EVENT_PITCH_BEND && seq_dub_count > seq_dub_merge_left) {
+            ev = &seq_dub_buf[(seq_dub_head - 1) & (SEQ_DUB_SIZE - 1)];
+            if(ev->type == SEQ_EVENT_PITCH_BEND && ev->track == track && ev->time == time) {
+                ev->value = value;
+                return;
+            }
+        }
+        // see how many more events fit in the side buffer and the pattern
+        // - the note offs for the held notes always have room kept for them
+        room = SEQ_DUB_SIZE - seq_dub_count;
+        temp = (SEQ_BUF_SIZE - SEQ_PATTERN_TABLE_SIZE - seq_buf_used) / SEQ_DUB_ROOM;
+        // the room for the next merge is already set aside
+        if(seq_dub_room) {
+            temp = seq_dub_room / SEQ_DUB_ROOM;
+        }
+        temp -= seq_dub_count - seq_dub_merge_left;
+        if(temp < room) {
+            room = temp;
+        }
+        room -= seq_dub_num_held;
+        if(event_type == SEQ_EVENT_NOTE_ON) {
+            if(room < 2) {
+                return;
+            }
+            temp = seq_quantize_time(time);
+            // notes moved past the end of the loop go at the start
+            if(seq_length && temp >= seq_length) {
+                temp -= seq_length;
+            }
+            if(!seq_dub_hold(track, value, temp, temp - time)) {
+                return;
+            }
+            time = temp;
+        }
+        else if(room < 1) {
+            return;
+        }
+    }
+    seq_dub_insert(time, track, event_type, value);
+}
+
+// put an event in the side buffer in time order
+// - events in the running merge are not touched
+void seq_dub_insert(int time, int track, int event_type, int value) {
+    struct seq_dub_event *ev;
+    int pos = seq_dub_head;
+    int prev, i;
+
+    // move later events up to make room
+    for(i = seq_dub_count - seq_dub_merge_left; i > 0; i --) {
+        prev = (pos - 1) & (SEQ_DUB_SIZE - 1);
+        if(seq_dub_buf[prev].time <= time) {
+            break;
+        }
+        seq_dub_buf[pos] = seq_dub_buf[prev];
+        pos = prev;
+    }
+    ev = &seq_dub_buf[pos];
+    ev->time = time;
+    ev->track = track;
+    ev->type = event_type;
+    ev->value = value;
+    seq_dub_head = (seq_dub_head + 1) & (SEQ_DUB_SIZE - 1);
+    seq_dub_count ++;
+}
+
+// add a recorded note to the held list - returns 0 if the list is full
+// - time = time the note on was recorded at
+// - shift = how far the note on was moved by quantizing
+int seq_dub_hold(int track, int note, int time, int shift) {
+    if(seq_dub_num_held == SEQ_PACK_HELD_MAX) {
+        return 0;
+    }
+    seq_dub_held[seq_dub_num_held] = note;
+    seq_dub_held_track[seq_dub_num_held] = track;
+    seq_dub_held_time[seq_dub_num_held] = time;
+    seq_dub_held_shift[seq_dub_num_held] = shift;
+    seq_dub_num_held ++;
+    return 1;
+}
+
+// remove a recorded note from the held list
+// - returns the time to record the note off at - or -1 if the note was not held
+// - the note off moves with the note on so the note length is kept
+int seq_dub_unhold(int track, int note, int time) {
+    int i;
+    for(i = 0; i < seq_dub_num_held; i ++) {
+        if(seq_dub_held[i] == note && seq_dub_held_track[i] == track) {
+            break;
+        }
+    }
+    if(i == seq_dub_num_held) {
+        return -1;
+    }
+    time += seq_dub_held_shift[i];
+    if(time <= seq_dub_held_time[i]) {
+        time = seq_dub_held_time[i] + 1;
+    }
+    seq_dub_num_held --;
+    for(; i < seq_dub_num_held; i ++) {
+        seq_dub_held[i] = seq_dub_held[i + 1];
+        seq_dub_held_track[i] = seq_dub_held_track[i + 1];
+        seq_dub_held_time[i] = seq_dub_held_time[i + 1];
+        seq_dub_held_shift[i] = seq_dub_held_shift[i + 1];
+    }
+    return time;
+}
+
+// end the overdub notes that are still held
+void seq_dub_release(void) {
+    while(seq_dub_num_held) {
+        seq_dub_record(seq_dub_held_track[0] - SEQ_DUB_TRACK(0),
+            SEQ_EVENT_NOTE_OFF, seq_dub_held[0]);
+    }
+}
+
+// keep the overdub merge ahead of playback and get the room ready for the
+// next one - call on each clock tick while playing
+// - a few more events than playback needs are merged on each tick so the
+//   merge is done well before the end of the loop, and then the room the
+//   next merge needs is opened a chunk at a time
+void seq_dub_task(int time) {
+    int i;
+    seq_dub_merge_run(time);
+    for(i = 0; i < SEQ_DUB_MERGE_STEP && seq_dub_merging; i ++) {
+        seq_dub_merge_event();
+    }
+    if(seq_dub_merging) {
+        return;
+    }
+    if(!seq_dub_move_by && !seq_dub_room && seq_dub_count &&
+            seq_patterns[seq_pattern].num_events) {
+        seq_dub_room_open();
+    }
+    seq_dub_move_chunk();
+}
+
+// start merging the side buffer into the selected pattern
+// - the old pattern has been moved up by seq_dub_task() to leave room in
+//   front of it so the merged pattern can be written over it without a
+//   second buffer - if the loop was too short to get it all done it is
+//   finished here
+void seq_dub_merge_start(void) {
+    struct seq_pattern *pat = &seq_patterns[seq_pattern];
+
+    // finish the last merge first
+    while(seq_dub_merging) {
+        seq_dub_merge_event();
+    }
+    while(seq_dub_move_by) {
+        seq_dub_move_chunk();
+    }
+    if(seq_dub_count == 0) {
+        return;
+    }
+    // nothing to merge into
+    if(pat->num_events == 0) {
+        seq_dub_head = 0;
+        seq_dub_tail = 0;
+        seq_dub_count = 0;
+        return;
+    }
+    if(!seq_dub_room) {
+        seq_dub_room_open();
+        while(seq_dub_move_by) {
+            seq_dub_move_chunk();
+        }
+    }
+    seq_dub_merge_left = seq_dub_count;
+    seq_dub_gap = seq_dub_room;
+    seq_dub_room = 0;
+    seq_dub_old_len = pat->len;
+
+    // set up the reader and writer
+    seq_pack_init(&seq_dub_in, seq_event_buf + pat->start + seq_dub_gap, seq_dub_old_len);
+    seq_pack_init(&seq_dub_out, seq_event_buf + pat->start, seq_dub_old_len + seq_dub_gap);
+    seq_dub_in_left = pat->num_events;
+    seq_dub_in_time = 0;
+    if(seq_pack_read(&seq_dub_in, &seq_dub_in_event) == SEQ_PACK_READ_OK) {
+        seq_dub_in_time = seq_dub_in_event.time;
+    }
+    else {
+        seq_dub_in_left = 0;
+    }
+    seq_dub_out_time = 0;
+    seq_dub_out_events = 0;
+
+    // playback follows the merged pattern as it is written
+    pat->len = seq_dub_old_len + seq_dub_gap;
+    pat->num_events += seq_dub_count;
+    // the song position index is rebuilt by the merge - the merged pattern
+    // can't be longer than the room it has so this is enough checkpoints
+    seq_index_resize(seq_pattern, ((pat->len - 1) / SEQ_INDEX_STEP) + 1);
+    seq_pattern_select(seq_pattern);
+    seq_dub_index_len = 0;
+    seq_dub_merging = 1;
+}
+
+// merge the next event - old events go first if the times are the same
+void seq_dub_merge_event(void) {
+    struct seq_pattern *pat = &seq_patterns[seq_pattern];
+    struct seq_dub_event *dub = 0;
+    int time, track, type, value, slack;
+
+    if(!seq_dub_merging) {
+        return;
+    }
+    if(seq_dub_merge_left) {
+        dub = &seq_dub_buf[seq_dub_tail];
+        // side buffer events always go before the end marker
+        if(seq_dub_in_left && dub->time >= seq_dub_in_time &&
+                seq_dub_in_event.type != SEQ_EVENT_END) {
+            dub = 0;
+        }
+    }
+    // next side buffer event
+    if(dub) {
+        time = dub->time;
+        if(seq_dub_in_left && time > seq_dub_in_time) {
+            time = seq_dub_in_time;
+        }
+        if(time < seq_dub_out_time) {
+            time = seq_dub_out_time;
+        }
+        track = dub->track;
+        type = dub->type;
+        value = dub->value;
+        seq_dub_tail = (seq_dub_tail + 1) & (SEQ_DUB_SIZE - 1);
+        seq_dub_count --;
+        seq_dub_merge_left --;
+    }
+    // next old event - the one after it is read first to free up its space
+    else if(seq_dub_in_left) {
+        time = seq_dub_in_time;
+        track = seq_dub_in_event.track;
+        type = seq_dub_in_event.type;
+        value = seq_dub_in_event.value;
+        seq_dub_in_left --;
+        if(seq_dub_in_left &&
+                seq_pack_read(&seq_dub_in, &seq_dub_in_event) == SEQ_PACK_READ_OK) {
+            seq_dub_in_time += seq_dub_in_event.time;
+        }
+        else {
+            seq_dub_in_left = 0;
+        }
+    }
+    // all done - the room that was not needed is closed up by seq_dub_task()
+    else {
+        slack = seq_dub_old_len + seq_dub_gap - seq_dub_out.pos;
+        pat->len = seq_dub_out.pos;
+        pat->num_events = seq_dub_out_events;
+        pat->length = seq_dub_out_time;
+        seq_index_resize(seq_pattern, seq_dub_index_len);
+        seq_pattern_select(seq_pattern);
+        seq_dub_merging = 0;
+        seq_dub_dirty = 1;
+        seq_dub_move_start(pat->start + seq_dub_old_len + seq_dub_gap, -slack);
+        return;
+    }
+
+    // add a song position checkpoint
+    seq_dub_index_len = seq_index_add(seq_pattern, seq_dub_index_len,
+        &seq_dub_out, seq_dub_out_time, seq_dub_out_events);
+    seq_pack_write(&seq_dub_out, time - seq_dub_out_time, track, type, value);
+    seq_dub_out_time = time;
+    seq_dub_out_events ++;
+}
+
+// merge until the merged pattern is past a time from the start of the loop
+// - playback reads one event ahead so the merge has to stay past it
+void seq_dub_merge_run(int time) {
+    while(seq_dub_merging && seq_dub_out_time <= time) {
+        seq_dub_merge_event();
+    }
+}
+
+// merge everything that was overdubbed now - the pattern is saved by seq_poll()
+void seq_dub_flush(void) {
+    seq_dub_merge_start();
+    while(seq_dub_merging) {
+        seq_dub_merge_event();
+    }
+    while(seq_dub_move_by) {
+        seq_dub_move_chunk();
+    }
+}
+
+// start opening room in front of the selected pattern for the next merge
+// - there is room for as many events as the side buffer holds, or as many
+//   as fit, since more can be recorded until the end of the loop
+void seq_dub_room_open(void) {
+    int room = (SEQ_BUF_SIZE - SEQ_PATTERN_TABLE_SIZE - seq_buf_used) / SEQ_DUB_ROOM;
+    if(room > SEQ_DUB_SIZE) {
+        room = SEQ_DUB_SIZE;
+    }
+    seq_dub_room = room * SEQ_DUB_ROOM;
+    seq_dub_move_start(seq_patterns[seq_pattern].start, seq_dub_room);
+}
+
+// start moving the end of the buffer from lo up or down - by > 0 = up
+// - the patterns after the selected one are fixed up once it is all moved
+void seq_dub_move_start(int lo, int by) {
+    seq_store_rec_edit();  // saved again by seq_poll() once the merge is done
+    seq_dub_move_lo = lo;
+    seq_dub_move_hi = seq_buf_used;
+    seq_dub_move_pos = lo;
+    if(by > 0) {
+        seq_dub_move_pos = seq_buf_used;
+    }
+    seq_dub_move_by = by;
+    seq_dub_play_moved = 0;
+}
+
+// move the next chunk - from the top when moving up and from the bottom
+// when moving down so nothing is written over before it is moved
+void seq_dub_move_chunk(void) {
+    int num;
+    if(seq_dub_move_by > 0) {
+        num = seq_dub_move_pos - seq_dub_move_lo;
+        if(num > SEQ_DUB_MOVE_CHUNK) {
+            num = SEQ_DUB_MOVE_CHUNK;
+        }
+        seq_dub_move_pos -= num;
+        memmove(seq_event_buf + seq_dub_move_pos + seq_dub_move_by,
+            seq_event_buf + seq_dub_move_pos, num);
+        seq_dub_play_follow();
+        if(seq_dub_move_pos == seq_dub_move_lo) {
+            seq_dub_move_end();
+        }
+    }
+    else if(seq_dub_move_by < 0) {
+        num = seq_dub_move_hi - seq_dub_move_pos;
+        if(num > SEQ_DUB_MOVE_CHUNK) {
+            num = SEQ_DUB_MOVE_CHUNK;
+        }
+        memmove(seq_event_buf + seq_dub_move_pos + seq_dub_move_by,
+            seq_event_buf + seq_dub_move_pos, num);
+        seq_dub_move_pos += num;
+        if(seq_dub_move_pos == seq_dub_move_hi) {
+            seq_dub_move_end();
+        }
+    }
+}
+
+// the move is done - the selected pattern keeps its start since the room
+// or the merged pattern is there
+void seq_dub_move_end(void) {
+    int i;
+    for(i = 0; i < SEQ_NUM_PATTERNS; i ++) {
+        if(seq_patterns[i].start > seq_patterns[seq_pattern].start) {
+            seq_patterns[i].start += seq_dub_move_by;
+        }
+    }
+    seq_buf_used += seq_dub_move_by;
+    seq_dub_move_by = 0;
+}
+
+// playback jumps up with the selected pattern once the move gets to where
+// it is reading - until then the old place still holds what it reads next
+// since the room is bigger than an event
+void seq_dub_play_follow(void) {
+    if(seq_dub_play_moved ||
+            (seq_play_buf - seq_event_buf) + seq_play_pack.pos < seq_dub_move_pos) {
+        return;
+    }
+    seq_play_buf += seq_dub_move_by;
+    seq_play_pack.buf += seq_dub_move_by;
+    seq_dub_play_moved = 1;
+}
+
+// turn off the notes on all the voices
+void seq_notes_off(void) {
+    int voice;
+    for(voice = 0; voice < SEQ_NUM_VOICES; voice ++) {
+        voice_all_notes_off(voice);
+    }
+}
+
+// set the transpose on all the voices
+void seq_set_transpose(int transpose) {
+    int voice;
+    for(voice = 0; voice < SEQ_NUM_VOICES; voice ++) {
+        voice_set_transpose(voice, transpose);
+    }
+}
+
 //
 // MIDI handlers - sequencer-specific messages
 // pass through this module always
 //
 // note off
-void seq_midi_note_off(int note) {
+void seq_midi_note_off(int voice, int note) {
 #ifdef SEQ_MIDI_DEBUG
     char strtmp[64];
 #endif
@@ -697,13 +1910,19 @@ void seq_midi_note_off(int note) {
     //
     // realtime record
     if(seq_state == SEQ_STATE_RT_REC_RUN) {
-        seq_record_event(SEQ_EVENT_NOTE_OFF, note, 0);
-        voice_note_off(0, note);
-    }
+        seq_record_event(voice, SEQ_EVENT_NOTE_OFF, note, 0);
+        voice_note_off(voice, note);
+    }
     // step record
     else if(seq_state == SEQ_STATE_STEP_REC_RUN) {
-         // note off inserted automatically during playback
-        voice_note_off(0, note);
+        // note off inserted automatically during playback
+        if(seq_step_keys) seq_step_keys --;
+        voice_note_off(voice, note);
+    }
+    // overdub
+    else if(seq_state == SEQ_STATE_OVERDUB) {
+        seq_dub_record(voice, SEQ_EVENT_NOTE_OFF, note);
+        voice_note_off(voice, note);
     }
     // playback - don't echo anything
     else if(seq_state == SEQ_STATE_PLAY_ONCE || 
@@ -712,12 +1931,12 @@ void seq_midi_note_off(int note) {
     }
     // live playing
     else {
-        voice_note_off(0, note);
+        voice_note_off(voice, note);
     }
 }
 
 // note on
-void seq_midi_note_on(int note) {
+void seq_midi_note_on(int voice, int note) {
 #ifdef SEQ_MIDI_DEBUG
     char strtmp[64];
 #endif
@@ -735,6 +1954,7 @@ void seq_midi_note_on(int note) {
     }
     else if(seq_state == SEQ_STATE_STEP_REC_STBY) {
         seq_change_state(SEQ_STATE_STEP_REC_RUN);
+        seq_step_keys = 0;
     }
     
     //
@@ -742,14 +1962,20 @@ void seq_midi_note_on(int note) {
     //
     // realtime record
     if(seq_state == SEQ_STATE_RT_REC_RUN) {
-        seq_record_event(SEQ_EVENT_NOTE_ON, note, 0);
-        voice_note_on(0, note, SEQ_NOTE_VEL);
-    }
-    // step record
+        seq_record_event(voice, SEQ_EVENT_NOTE_ON, note, 0);
+        voice_note_on(voice, note, SEQ_NOTE_VEL);
+    }
+    // step record - notes played while other keys are held make a chord
     else if(seq_state == SEQ_STATE_STEP_REC_RUN) {
-        seq_record_event(SEQ_EVENT_NOTE_ON, note, 1);
-        voice_note_on(0, note, SEQ_NOTE_VEL);
+        seq_record_event(voice, SEQ_EVENT_NOTE_ON, note, 1);
+        seq_step_keys ++;
+        voice_note_on(voice, note, SEQ_NOTE_VEL);
     }
+    // overdub - played along with the loop
+    else if(seq_state == SEQ_STATE_OVERDUB) {
+        seq_dub_record(voice, SEQ_EVENT_NOTE_ON, note);
+        voice_note_on(voice, note, SEQ_NOTE_VEL);
+    }
     // playback
     else if(seq_state == SEQ_STATE_PLAY_ONCE || 
             seq_state == SEQ_STATE_PLAY_LOOP) {
@@ -758,23 +1984,26 @@ void seq_midi_note_on(int note) {
     }
     // live playing
     else {
-        voice_note_on(0, note, SEQ_NOTE_VEL);
+        voice_note_on(voice, note, SEQ_NOTE_VEL);
     }
 }
 
-// pitch bend - bend = 14 bit signed value
-void seq_midi_pitch_bend(int bend) {
-    int temp = bend >> 8;  // reduce to 8 bit
+// pitch bend - bend = 14 bit value - 0x2000 = center
+void seq_midi_pitch_bend(int voice, int bend) {
     // handle MIDI
     if(seq_state == SEQ_STATE_RT_REC_RUN) {
-        seq_record_event(SEQ_EVENT_PITCH_BEND, temp, 0);
-        voice_pitch_bend(0, temp << 8);
+        seq_rec_bend[voice] = bend;  // recorded on the next tick
+        voice_pitch_bend(voice, bend);
     }
     else if(seq_state == SEQ_STATE_STEP_REC_RUN) {
         // not supported in step record mode
     }
+    else if(seq_state == SEQ_STATE_OVERDUB) {
+        seq_dub_record(voice, SEQ_EVENT_PITCH_BEND, bend);
+        voice_pitch_bend(voice, bend);
+    }
     else {
-        voice_pitch_bend(0, temp << 8);
+        voice_pitch_bend(voice, bend);
     }
 }
 
@@ -788,7 +2017,7 @@ void seq_midi_sustain_pedal(int value) {
     else if(seq_state == SEQ_STATE_STEP_REC_RUN) {
         if(value == 127) {
             // insert a rest in the recording
-            seq_record_event(SEQ_EVENT_REST, 0, 1);
+            seq_record_event(0, SEQ_EVENT_REST, 0, 1);
         }
     }
     // playback loop enable
@@ -798,7 +2027,8 @@ void seq_midi_sustain_pedal(int value) {
         }
     }
     // playback loop end
-    else if(seq_state == SEQ_STATE_PLAY_LOOP) {
+    else if(seq_state == SEQ_STATE_PLAY_LOOP ||
+            seq_state == SEQ_STATE_OVERDUB) {
         if(value == 127) {
             seq_change_state(SEQ_STATE_PLAY_LOOP_END);
         }
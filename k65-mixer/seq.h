@@ -14,6 +14,9 @@ void seq_init(void);
 // run the timer task - 1000us
 void seq_timer_task(void);
 
+// run the main loop task - call from the main loop
+void seq_poll(void);
+
 // handle the record button
 void seq_rec_button(int pressed);
 
@@ -29,24 +32,46 @@ void seq_clock_handle_midi_stop(void);
 // handle a MIDI continue event
 void seq_clock_handle_midi_continue(void);
 
+// handle a MIDI song position - tick = song position in clock ticks
+void seq_clock_handle_song_position(int tick);
+
 // handle a MIDI clock fail event
 void seq_clock_handle_clock_fail(void);
 
 // handle a clock tick
 void seq_clock_tick(void);
-
+
+// select a pattern - switches at the end of the loop if playing
+void seq_pattern_queue(int pattern);
+
+// add a pattern to the end of the chain
+void seq_pattern_chain_add(int pattern);
+
+// clear the chain
+void seq_pattern_chain_clear(void);
+
+// set the record quantize grid - grid = clock ticks - 0 = off
+void seq_set_quantize(int grid);
+
+// set the record swing - swing = 0-127 - every other grid line is up to half a grid late
+void seq_set_swing(int swing);
+
+// get the sequencer state - for monitoring
+int seq_get_state(void);
+
 //
 // MIDI handlers - sequencer-specific messages
 // pass through this module always
 //
+// - voice = the voice the input is for - each voice records to its own track
 // note off
-void seq_midi_note_off(int note);
+void seq_midi_note_off(int voice, int note);
 
 // note on
-void seq_midi_note_on(int note);
+void seq_midi_note_on(int voice, int note);
 
-// pitch bend - bend = 14 bit signed value
-void seq_midi_pitch_bend(int bend);
+// pitch bend - bend = 14 bit value - 0x2000 = center
+void seq_midi_pitch_bend(int voice, int bend);
 
 // sustain pedal
 void seq_midi_sustain_pedal(int value);
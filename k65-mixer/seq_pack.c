@@ -0,0 +1,491 @@
+/*
+ * PHENOL Mini Sequencer - Packed Event Stream
+ *
+ * Copyright 2015: Andrew Kilpatrick
+ * Written by: Andrew Kilpatrick
+ *
+ * Events are stored as a byte stream instead of fixed 4 byte records:
+ *	- each event starts with a token byte: cc dddddd
+ *		- cc = class
+ *			- 0 = note on - followed by the note
+ *			- 1 = note off for the most recently held note - on
+ *			      any track - no data
+ *			- 2 = note off - followed by the note
+ *			- 3 = other event - followed by the type (if it changed)
+ *			      and the value (if the type has one)
+ *		- dddddd = delta time 0-62 - 63 means that the delta time
+ *		  minus 63 follows as a variable length number (7 bits per
+ *		  byte, MSB first, bit 7 set on all but the last byte)
+ *	- type bytes always have bit 7 set and values never do, so
+ *	  repeated pitch bends only need the token and the value
+ *	- the writer and the reader both keep the same held note list
+ *	  so most note offs can be stored as a single byte
+ *	- pitch bends are 14 bits and are stored as the change from the
+ *	  last bend on the same track - value bytes are: m c dddddd
+ *		- m = more bytes follow - each one adds 6 more bits
+ *		- c = coarse - the change is in MSB steps (first byte only,
+ *		  which then only has 5 data bits)
+ *		- the change is zigzag coded (0, -1, 1, -2, ...) MSB first
+ *	  so most bends from a wheel only need one value byte
+ *	- older streams stored bend >> 8 as an absolute value - these
+ *	  are still read back using their own type byte
+ *	- all tracks are merged into one stream in time order - a track
+ *	  event (other class, type 0xf0-0xf3) switches the track for the
+ *	  events after it and holds the delta time of the next event
+ *	  - streams with no track events are all on track 0
+ *	- a note on that switches tracks uses type 0xf4-0xf7 instead and is
+ *	  followed by the note - 3 bytes instead of 4
+ *	- note offs do not need a track event - a note off with no track
+ *	  event in front of it goes to the running track if the note is
+ *	  held there, or else the last track the note is held on
+ *	- streams from before note offs found their own track read back
+ *	  the same, except for a note off of a note that was not held on
+ *	  its track but was on another one - only when more than 8 notes
+ *	  were held at once, or for a note off with no note on
+ *
+ * A typical note on / note off pair takes 3 bytes instead of 8.
+ *
+ */
+#include "seq_pack.h"
+
+// token classes
+#define SEQ_PACK_CLASS_NOTE_ON 0x00
+#define SEQ_PACK_CLASS_NOTE_OFF_HELD 0x40
+#define SEQ_PACK_CLASS_NOTE_OFF 0x80
+#define SEQ_PACK_CLASS_OTHER 0xc0
+#define SEQ_PACK_CLASS_MASK 0xc0
+#define SEQ_PACK_DELTA_MASK 0x3f
+#define SEQ_PACK_DELTA_EXT 0x3f  // extended delta time follows
+#define SEQ_PACK_TIME_MAX 0xffff
+#define SEQ_PACK_TYPE_BEND_OLD SEQ_EVENT_PITCH_BEND  // old absolute bend
+#define SEQ_PACK_TYPE_BEND 0xe1  // 14 bit bend - stored as a change
+#define SEQ_PACK_TYPE_TRACK 0xf0  // track change - low bits are the track
+#define SEQ_PACK_TYPE_TRACK_MASK 0xfc
+#define SEQ_PACK_TYPE_TRACK_NOTE_ON 0xf4  // track change and note on - low bits are the track
+#define SEQ_PACK_BEND_CENTER 0x2000
+#define SEQ_PACK_BEND_MORE 0x40  // another bend byte follows
+#define SEQ_PACK_BEND_COARSE 0x20  // the change is in MSB steps
+
+// local functions
+int seq_pack_put_time(uint8_t *out, int len, uint8_t token, int time);
+void seq_pack_held_on(struct seq_pack_state *s, uint8_t note, uint8_t track);
+int seq_pack_held_off(struct seq_pack_state *s, uint8_t note, uint8_t track);
+int seq_pack_held_track(struct seq_pack_state *s, uint8_t note);
+int seq_pack_put_bend(uint8_t *out, int len, int change);
+int seq_pack_get_byte(struct seq_pack_state *s, uint8_t *byte);
+int seq_pack_get_bend(struct seq_pack_state *s, uint8_t first);
+
+// reset the stream state to the start of a buffer
+void seq_pack_init(struct seq_pack_state *s, uint8_t *buf, int size) {
+    int i;
+    s->buf = buf;
+    s->size = size;
+    s->pos = 0;
+    s->run_type = SEQ_PACK_RUN_NONE;
+    s->run_track = 0;
+    s->num_held = 0;
+    s->bend_seen = 0;
+    for(i = 0; i < SEQ_PACK_NUM_TRACKS; i ++) {
+        s->run_bend[i] = SEQ_PACK_BEND_CENTER;
+    }
+}
+
+// get the number of free bytes left in the buffer
+int seq_pack_room(struct seq_pack_state *s) {
+    return s->size - s->pos;
+}
+
+// pack an event onto the end of the stream
+// returns 1 on success, 0 if there was no room
+int seq_pack_write(struct seq_pack_state *s, int time, int track, int type, int value) {
+    uint8_t out[SEQ_PACK_MAX_EVENT_LEN];
+    int len, i, change;
+    uint8_t token;
+
+    if(time < 0) time = 0;
+    if(time > SEQ_PACK_TIME_MAX) time = SEQ_PACK_TIME_MAX;
+    track &= (SEQ_PACK_NUM_TRACKS - 1);
+    if(type == SEQ_EVENT_PITCH_BEND) {
+        value &= 0x3fff;
+    }
+    else {
+        value &= 0x7f;
+    }
+
+    // work out the class and if the track has to be switched
+    change = (track != s->run_track);
+    switch(type) {
+        case SEQ_EVENT_NOTE_ON:
+            token = SEQ_PACK_CLASS_NOTE_ON;
+            break;
+        case SEQ_EVENT_NOTE_OFF:
+            // the note off can be paired with the last held note - on any track
+            if(s->num_held && s->held[s->num_held - 1] == value &&
+                    s->held_track[s->num_held - 1] == track) {
+                token = SEQ_PACK_CLASS_NOTE_OFF_HELD;
+                change = 0;
+            }
+            // or find its track from the held notes
+            else {
+                token = SEQ_PACK_CLASS_NOTE_OFF;
+                change = (seq_pack_held_track(s, value) != track);
+            }
+            break;
+        default:
+            token = SEQ_PACK_CLASS_OTHER;
+            break;
+    }
+
+    // switching tracks - the track event takes the delta time
+    len = 0;
+    if(change && token == SEQ_PACK_CLASS_NOTE_ON) {
+        len = seq_pack_put_time(out, len, SEQ_PACK_CLASS_OTHER, time);
+        out[len ++] = SEQ_PACK_TYPE_TRACK_NOTE_ON | track;
+    }
+    else {
+        if(change) {
+            len = seq_pack_put_time(out, len, SEQ_PACK_CLASS_OTHER, time);
+            out[len ++] = SEQ_PACK_TYPE_TRACK | track;
+            time = 0;
+        }
+        len = seq_pack_put_time(out, len, token, time);
+    }
+
+    // event data
+    switch(token) {
+        case SEQ_PACK_CLASS_NOTE_ON:
+        case SEQ_PACK_CLASS_NOTE_OFF:
+            out[len ++] = value;
+            break;
+        case SEQ_PACK_CLASS_OTHER:
+            // events with a value can use running type
+            if(type == SEQ_EVENT_PITCH_BEND) {
+                if(s->run_type != SEQ_PACK_TYPE_BEND) {
+                    out[len ++] = SEQ_PACK_TYPE_BEND;
+                }
+                len = seq_pack_put_bend(out, len, value - s->run_bend[track]);
+            }
+            else {
+                out[len ++] = type;
+            }
+            break;
+    }
+
+    if(len > seq_pack_room(s)) {
+        return 0;
+    }
+
+    // commit the event
+    for(i = 0; i < len; i ++) {
+        s->buf[s->pos ++] = out[i];
+    }
+    s->run_track = track;
+    if(type == SEQ_EVENT_NOTE_ON) {
+        seq_pack_held_on(s, value, track);
+    }
+    else if(type == SEQ_EVENT_NOTE_OFF) {
+        seq_pack_held_off(s, value, track);
+    }
+    else if(type == SEQ_EVENT_PITCH_BEND) {
+        s->run_type = SEQ_PACK_TYPE_BEND;
+        s->run_bend[track] = value;
+        s->bend_seen |= (1 << track);
+    }
+    return 1;
+}
+
+// unpack the next event from the stream
+// returns SEQ_PACK_READ_OK on success, SEQ_PACK_READ_END if the end of the
+// buffer was reached or SEQ_PACK_READ_ERROR if the event was cut short
+int seq_pack_read(struct seq_pack_state *s, struct seq_event *ev) {
+    uint8_t token, temp;
+    unsigned int time, delta;
+    int change;
+
+    time = 0;
+    change = 0;
+    while(1) {
+        if(s->pos >= s->size) {
+            return SEQ_PACK_READ_END;
+        }
+        token = s->buf[s->pos ++];
+
+        // delta time
+        delta = token & SEQ_PACK_DELTA_MASK;
+        if(delta == SEQ_PACK_DELTA_EXT) {
+            delta = 0;
+            do {
+                if(!seq_pack_get_byte(s, &temp)) {
+                    return SEQ_PACK_READ_ERROR;
+                }
+                delta = (delta << 7) | (temp & 0x7f);
+            } while(temp & 0x80);
+            delta += SEQ_PACK_DELTA_EXT;
+        }
+        time += delta;
+
+        // track change - the event after it is on the new track
+        if((token & SEQ_PACK_CLASS_MASK) == SEQ_PACK_CLASS_OTHER) {
+            if(s->pos >= s->size) {
+                return SEQ_PACK_READ_ERROR;
+            }
+            if((s->buf[s->pos] & SEQ_PACK_TYPE_TRACK_MASK) == SEQ_PACK_TYPE_TRACK) {
+                s->run_track = s->buf[s->pos ++] & (SEQ_PACK_NUM_TRACKS - 1);
+                change = 1;
+                continue;
+            }
+            // note on with its own track
+            if((s->buf[s->pos] & SEQ_PACK_TYPE_TRACK_MASK) == SEQ_PACK_TYPE_TRACK_NOTE_ON) {
+                s->run_track = s->buf[s->pos ++] & (SEQ_PACK_NUM_TRACKS - 1);
+                token = SEQ_PACK_CLASS_NOTE_ON;
+            }
+        }
+        break;
+    }
+    ev->time = time;
+    ev->track = s->run_track;
+
+    // event data
+    switch(token & SEQ_PACK_CLASS_MASK) {
+        case SEQ_PACK_CLASS_NOTE_ON:
+            if(!seq_pack_get_byte(s, &temp)) {
+                return SEQ_PACK_READ_ERROR;
+            }
+            ev->type = SEQ_EVENT_NOTE_ON;
+            ev->value = temp;
+            seq_pack_held_on(s, ev->value, ev->track);
+            break;
+        case SEQ_PACK_CLASS_NOTE_OFF_HELD:
+            ev->type = SEQ_EVENT_NOTE_OFF;
+            ev->value = 0;
+            if(s->num_held) {
+                ev->value = s->held[s->num_held - 1];
+                ev->track = s->held_track[s->num_held - 1];
+                s->num_held --;
+            }
+            s->run_track = ev->track;
+            break;
+        case SEQ_PACK_CLASS_NOTE_OFF:
+            if(!seq_pack_get_byte(s, &temp)) {
+                return SEQ_PACK_READ_ERROR;
+            }
+            ev->type = SEQ_EVENT_NOTE_OFF;
+            ev->value = temp;
+            if(!change) {
+                ev->track = seq_pack_held_track(s, ev->value);
+            }
+            s->run_track = ev->track;
+            seq_pack_held_off(s, ev->value, ev->track);
+            break;
+        case SEQ_PACK_CLASS_OTHER:
+            temp = s->buf[s->pos ++];  // checked above
+            // new type
+            if(temp & 0x80) {
+                if(temp != SEQ_PACK_TYPE_BEND && temp != SEQ_PACK_TYPE_BEND_OLD) {
+                    ev->type = temp;
+                    ev->value = 0;
+                    break;
+                }
+                s->run_type = temp;
+                if(!seq_pack_get_byte(s, &temp)) {
+                    return SEQ_PACK_READ_ERROR;
+                }
+            }
+            // pitch bend value
+            if(s->run_type == SEQ_PACK_TYPE_BEND) {
+                if(!seq_pack_get_bend(s, temp)) {
+                    return SEQ_PACK_READ_ERROR;
+                }
+            }
+            else {
+                s->run_bend[s->run_track] = temp << 8;  // old bends were stored as bend >> 8
+            }
+            s->bend_seen |= (1 << s->run_track);
+            ev->type = SEQ_EVENT_PITCH_BEND;
+            ev->value = s->run_bend[s->run_track];
+            break;
+    }
+    return SEQ_PACK_READ_OK;
+}
+
+// save the current stream position
+void seq_pack_get_mark(struct seq_pack_state *s, struct seq_pack_mark *m) {
+    int i;
+    m->pos = s->pos;
+    m->run_type = s->run_type;
+    m->run_track = s->run_track;
+    m->bend_seen = s->bend_seen;
+    for(i = 0; i < SEQ_PACK_NUM_TRACKS; i ++) {
+        m->run_bend[i] = s->run_bend[i];
+    }
+    m->num_held = s->num_held;
+    for(i = 0; i < s->num_held; i ++) {
+        m->held[i] = s->held[i];
+        m->held_track[i] = s->held_track[i];
+    }
+}
+
+// go back to a saved stream position
+void seq_pack_set_mark(struct seq_pack_state *s, struct seq_pack_mark *m) {
+    int i;
+    s->pos = m->pos;
+    s->run_type = m->run_type;
+    s->run_track = m->run_track;
+    s->bend_seen = m->bend_seen;
+    for(i = 0; i < SEQ_PACK_NUM_TRACKS; i ++) {
+        s->run_bend[i] = m->run_bend[i];
+    }
+    s->num_held = m->num_held;
+    for(i = 0; i < m->num_held; i ++) {
+        s->held[i] = m->held[i];
+        s->held_track[i] = m->held_track[i];
+    }
+}
+
+//
+// local functions
+//
+// add a token and its delta time to an event - returns the new event length
+int seq_pack_put_time(uint8_t *out, int len, uint8_t token, int time) {
+    int ext, shift, start = len;
+    len ++;
+    if(time < SEQ_PACK_DELTA_EXT) {
+        token |= time;
+    }
+    else {
+        token |= SEQ_PACK_DELTA_EXT;
+        ext = time - SEQ_PACK_DELTA_EXT;
+        shift = 14;
+        while(shift && (ext >> shift) == 0) {
+            shift -= 7;
+        }
+        while(shift) {
+            out[len ++] = 0x80 | ((ext >> shift) & 0x7f);
+            shift -= 7;
+        }
+        out[len ++] = ext & 0x7f;
+    }
+    out[start] = token;
+    return len;
+}
+
+// add a note to the held list - moves it to the end if it is already held
+void seq_pack_held_on(struct seq_pack_state *s, uint8_t note, uint8_t track) {
+    int i;
+    seq_pack_held_off(s, note, track);
+    // list is full - drop the oldest note
+    if(s->num_held == SEQ_PACK_HELD_MAX) {
+        for(i = 1; i < SEQ_PACK_HELD_MAX; i ++) {
+            s->held[i - 1] = s->held[i];
+            s->held_track[i - 1] = s->held_track[i];
+        }
+        s->num_held --;
+    }
+    s->held[s->num_held] = note;
+    s->held_track[s->num_held] = track;
+    s->num_held ++;
+}
+
+// remove a note from the held list - returns 1 if it was held
+int seq_pack_held_off(struct seq_pack_state *s, uint8_t note, uint8_t track) {
+    int i, found = 0;
+    for(i = 0; i < s->num_held; i ++) {
+        if(found) {
+            s->held[i - 1] = s->held[i];
+            s->held_track[i - 1] = s->held_track[i];
+        }
+        else if(s->held[i] == note && s->held_track[i] == track) {
+            found = 1;
+        }
+    }
+    if(found) {
+        s->num_held --;
+    }
+    return found;
+}
+
+// get the track of a note off with no track event in front of it - the running
+// track if the note is held there, or else the last track the note is held on
+int seq_pack_held_track(struct seq_pack_state *s, uint8_t note) {
+    int i, track = s->run_track;
+    for(i = 0; i < s->num_held; i ++) {
+        if(s->held[i] != note) {
+            continue;
+        }
+        if(s->held_track[i] == s->run_track) {
+            return s->run_track;
+        }
+        track = s->held_track[i];
+    }
+    return track;
+}
+
+// add a pitch bend change to an event - returns the new event length
+int seq_pack_put_bend(uint8_t *out, int len, int change) {
+    int flags = 0;
+    int shift = 0;
+    unsigned int zig;
+
+    // whole MSB steps - most wheels only send the MSB
+    if(change && (change & 0x7f) == 0) {
+        flags = SEQ_PACK_BEND_COARSE;
+        change /= 128;
+    }
+    // zigzag code so small changes in either direction are small
+    if(change < 0) {
+        zig = ((-change) << 1) - 1;
+    }
+    else {
+        zig = change << 1;
+    }
+    // first byte holds 5 bits - the rest hold 6 bits
+    while((zig >> shift) > 0x1f) {
+        shift += 6;
+    }
+    if(shift) flags |= SEQ_PACK_BEND_MORE;
+    out[len ++] = flags | (zig >> shift);
+    while(shift) {
+        shift -= 6;
+        flags = 0;
+        if(shift) flags = SEQ_PACK_BEND_MORE;
+        out[len ++] = flags | ((zig >> shift) & 0x3f);
+    }
+    return len;
+}
+
+// get the next byte of an event - returns 0 if the stream ran out
+// - the stream is left at the end so later reads stop too
+int seq_pack_get_byte(struct seq_pack_state *s, uint8_t *byte) {
+    if(s->pos >= s->size) {
+        s->pos = s->size;
+        return 0;
+    }
+    *byte = s->buf[s->pos ++];
+    return 1;
+}
+
+// read a pitch bend change and apply it to the running bend for the track
+// returns 1 on success, 0 if the stream ran out
+int seq_pack_get_bend(struct seq_pack_state *s, uint8_t first) {
+    unsigned int zig = first & 0x1f;
+    uint8_t temp = first;
+    int change;
+
+    while(temp & SEQ_PACK_BEND_MORE) {
+        if(!seq_pack_get_byte(s, &temp)) {
+            return 0;
+        }
+        zig = (zig << 6) | (temp & 0x3f);
+    }
+    if(zig & 0x01) {
+        change = -(int)((zig + 1) >> 1);
+    }
+    else {
+        change = zig >> 1;
+    }
+    if(first & SEQ_PACK_BEND_COARSE) {
+        change *= 128;
+    }
+    s->run_bend[s->run_track] = (s->run_bend[s->run_track] + change) & 0x3fff;
+    return 1;
+}
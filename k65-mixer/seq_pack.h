@@ -0,0 +1,88 @@
+/*
+ * PHENOL Mini Sequencer - Packed Event Stream
+ *
+ * Copyright 2015: Andrew Kilpatrick
+ * Written by: Andrew Kilpatrick
+ *
+ */
+#ifndef SEQ_PACK_H
+#define SEQ_PACK_H
+
+#include <inttypes.h>
+
+// events
+#define SEQ_EVENT_NOTE_OFF 0x80
+#define SEQ_EVENT_NOTE_ON 0x90
+#define SEQ_EVENT_PITCH_BEND 0xe0
+#define SEQ_EVENT_REST 0xfe
+#define SEQ_EVENT_END 0xff
+
+// an unpacked event
+struct seq_event {
+    uint16_t time;  // delta time since last event (in clock ticks)
+    uint8_t type;  // event type
+    uint8_t track;  // track the event is on
+    uint16_t value;  // event value (0-127 - 0-16383 for pitch bend)
+};
+
+#define SEQ_PACK_MAX_EVENT_LEN 10  // the most bytes a single event can take - with a track change
+#define SEQ_PACK_HELD_MAX 8  // held notes tracked for note off pairing
+#define SEQ_PACK_RUN_NONE 0x00  // no running type yet
+#define SEQ_PACK_NUM_TRACKS 4  // tracks merged into one stream
+
+// read results
+#define SEQ_PACK_READ_OK 1  // an event was read
+#define SEQ_PACK_READ_END 0  // the end of the buffer was reached
+#define SEQ_PACK_READ_ERROR -1  // the last event was cut short by the end of the buffer
+
+// reader / writer state for a packed stream
+struct seq_pack_state {
+    uint8_t *buf;  // stream buffer
+    int size;  // size of the buffer in bytes
+    int pos;  // current read / write position in bytes
+    uint8_t run_type;  // running type for non-note events
+    uint8_t run_track;  // track of the last event
+    uint8_t num_held;  // number of held notes
+    uint8_t held[SEQ_PACK_HELD_MAX];  // held notes - most recent last
+    uint8_t held_track[SEQ_PACK_HELD_MAX];  // track of each held note
+    uint8_t bend_seen;  // tracks that had a pitch bend - 1 bit each
+    uint16_t run_bend[SEQ_PACK_NUM_TRACKS];  // last pitch bend - bends are stored as changes
+};
+
+// a saved stream position - enough to carry on reading from there
+struct seq_pack_mark {
+    uint16_t pos;  // position in bytes
+    uint8_t run_type;  // running type
+    uint8_t run_track;  // track of the last event
+    uint8_t num_held;  // number of held notes
+    uint8_t held[SEQ_PACK_HELD_MAX];  // held notes - most recent last
+    uint8_t held_track[SEQ_PACK_HELD_MAX];  // track of each held note
+    uint8_t bend_seen;  // tracks that had a pitch bend - 1 bit each
+    uint16_t run_bend[SEQ_PACK_NUM_TRACKS];  // last pitch bend on each track
+};
+
+// reset the stream state to the start of a buffer
+void seq_pack_init(struct seq_pack_state *s, uint8_t *buf, int size);
+
+// get the number of free bytes left in the buffer
+int seq_pack_room(struct seq_pack_state *s);
+
+// pack an event onto the end of the stream
+// - events must be written in time order - tracks can be mixed freely
+// returns 1 on success, 0 if there was no room
+int seq_pack_write(struct seq_pack_state *s, int time, int track, int type, int value);
+
+// unpack the next event from the stream
+// - every byte is checked against the buffer size - a cut short event
+//   leaves the stream at the end so later reads return SEQ_PACK_READ_END
+// returns SEQ_PACK_READ_OK on success, SEQ_PACK_READ_END if the end of the
+// buffer was reached or SEQ_PACK_READ_ERROR if the event was cut short
+int seq_pack_read(struct seq_pack_state *s, struct seq_event *ev);
+
+// save the current stream position
+void seq_pack_get_mark(struct seq_pack_state *s, struct seq_pack_mark *m);
+
+// go back to a saved stream position
+void seq_pack_set_mark(struct seq_pack_state *s, struct seq_pack_mark *m);
+
+#endif
@@ -0,0 +1,771 @@
+/*
+ * PHENOL Mini Sequencer - Flash Store
+ *
+ * Copyright 2015: Andrew Kilpatrick
+ * Written by: Andrew Kilpatrick
+ *
+ * Sequences and settings are saved in a log of records in spare
+ * program flash:
+ *	- each page starts with a magic word and a serial number which
+ *	  goes up every time a page is opened - the serials give the order
+ *	  of the log, so pages can be used in any order
+ *	- records are appended and never changed - a header word holds
+ *	  the type, a tag and the payload length in words
+ *	- while recording, the packed event stream is written out in
+ *	  small data records as it grows
+ *	- when recording ends, a commit record points back to the first
+ *	  data record and holds the length and CRC of the sequence - the
+ *	  last word of the commit is a seal which is written last so a
+ *	  commit that was cut off by a power loss is ignored
+ *	- each new page starts with a copy of the saved settings so the
+ *	  newest page always holds all of them - a setting record has a
+ *	  check word written last like the commit seal, and any setting
+ *	  missing from the newest page after a cut off copy is written again
+ *	- the oldest pages are erased to keep some blank pages ready, but
+ *	  only while powered off / in standby since an erase stalls the
+ *	  CPU - pages holding the saved sequence are never erased and the
+ *	  log just goes around them
+ *	- while powered on, saves only use the blank pages kept ready - if
+ *	  they run out the save fails and is counted, and it is tried again
+ *	  once in the next standby after the old pages are erased, as long
+ *	  as no newer save or change to the buffer came after it
+ *
+ * Mounting only walks the record headers, and loading only reads the
+ * data records of the newest valid commit.
+ *
+ * The sequencer calls in from the task timer, but all flash access is
+ * done from seq_store_poll() in the main loop. The task timer side only
+ * writes requests which the poll routine picks up. The poll routine
+ * copies each chunk out of the sequencer buffer with the task timer
+ * held off, and drops a recording if the buffer was moved around while
+ * it was being written, so a torn copy is never committed.
+ *
+ */
+#include <plib.h>
+#include "seq_store.h"
+
+// flash layout - must match the space left out of the linker script
+#define SEQ_STORE_BASE 0x9d01cc00  // kseg0 address of the first page
+#define SEQ_STORE_NUM_PAGES 12
+#define SEQ_STORE_PAGE_SIZE 1024
+#define SEQ_STORE_PAGE_WORDS (SEQ_STORE_PAGE_SIZE >> 2)
+#define SEQ_STORE_RESERVE_PAGES 6  // erased pages to keep ahead for recording - a full buffer takes 6
+#define SEQ_STORE_CHUNK_WORDS 16  // max data record payload
+#define SEQ_STORE_CHUNK_BYTES (SEQ_STORE_CHUNK_WORDS << 2)
+#define SEQ_STORE_ADDR(page, word) (SEQ_STORE_BASE + \
+    ((page) * SEQ_STORE_PAGE_SIZE) + ((word) << 2))
+// read through kseg1 so the cache never returns stale data after a write
+#define SEQ_STORE_READ(page, word) \
+    (*(volatile uint32_t *)(SEQ_STORE_ADDR(page, word) | 0x20000000))
+
+// page header
+#define SEQ_STORE_MAGIC 0x50485351  // "PHSQ"
+#define SEQ_STORE_HDR_MAGIC 0
+#define SEQ_STORE_HDR_SERIAL 1
+#define SEQ_STORE_HDR_LEN 2
+#define SEQ_STORE_BLANK 0xffffffff
+
+// page states
+#define SEQ_STORE_PAGE_BLANK 0  // erased and unused
+#define SEQ_STORE_PAGE_USED 1  // has a valid header
+#define SEQ_STORE_PAGE_DIRTY 2  // needs to be erased
+
+// records
+#define SEQ_STORE_REC(type, tag, len) (((type) << 24) | ((tag) << 8) | (len))
+#define SEQ_STORE_REC_TYPE(hdr) ((hdr) >> 24)
+#define SEQ_STORE_REC_TAG(hdr) (((hdr) >> 8) & 0xffff)
+#define SEQ_STORE_REC_LEN(hdr) ((int)((hdr) & 0xff))  // int so it compares with word counts
+#define SEQ_STORE_REC_DATA 0x01  // tag = session - payload = stream bytes
+#define SEQ_STORE_REC_COMMIT 0x02  // tag = session - payload = see below
+#define SEQ_STORE_REC_SETTING 0x03  // tag = setting - payload = value, check
+#define SEQ_STORE_COMMIT_LEN 4
+#define SEQ_STORE_COMMIT_SIZE 0  // len | (num_events << 16)
+#define SEQ_STORE_COMMIT_START 1  // (page << 16) | word of first data record
+#define SEQ_STORE_COMMIT_CRC 2
+#define SEQ_STORE_COMMIT_SEAL 3  // check of the other words - written last
+#define SEQ_STORE_SEAL_KEY 0x5ea15ea1
+#define SEQ_STORE_SETTING_LEN 2
+#define SEQ_STORE_SETTING_CHECK(hdr, val) ((hdr) ^ (val) ^ SEQ_STORE_SEAL_KEY)
+#define SEQ_STORE_NONE 0xffff
+
+// recording states
+#define SEQ_STORE_REC_IDLE 0
+#define SEQ_STORE_REC_RUN 1
+#define SEQ_STORE_REC_FAIL 2
+
+// log state
+uint8_t seq_store_page_state[SEQ_STORE_NUM_PAGES];
+uint32_t seq_store_page_serial[SEQ_STORE_NUM_PAGES];
+int seq_store_page;  // page being written
+int seq_store_word;  // next free word in the page being written
+uint32_t seq_store_serial;  // serial of the page being written
+uint16_t seq_store_session;  // last session number used
+int seq_store_loc_page;  // location of the last record written
+int seq_store_loc_word;
+volatile int seq_store_idle;  // 1 = erasing is okay
+
+// saved sequence
+int seq_store_live;  // 1 = there is a saved sequence
+uint16_t seq_store_live_session;
+int seq_store_live_len;  // length in bytes
+int seq_store_live_events;  // number of events
+int seq_store_live_start;  // page of the first data record
+int seq_store_live_word;  // word of the first data record
+int seq_store_live_end;  // page of the commit record
+uint16_t seq_store_live_crc;
+
+// recording - requests from the task timer
+volatile int seq_store_req_start;  // start count
+volatile int seq_store_req_len;  // bytes recorded so far
+volatile int seq_store_req_commit;  // start count of the committed recording
+volatile int seq_store_req_commit_len;
+volatile int seq_store_req_commit_events;
+volatile int seq_store_req_edit;  // edit count - bumped when the buffer is changed in place
+uint8_t * volatile seq_store_req_buf;
+// recording - handled by the poll routine
+int seq_store_rec_state;
+int seq_store_rec_num;  // start count being handled
+int seq_store_rec_flushed;  // bytes written to flash
+int seq_store_rec_page;  // location of the first data record
+int seq_store_rec_word;
+int seq_store_rec_edit_num;  // edit count when the recording started
+int seq_store_rec_retried;  // 1 = a failed recording was already tried again
+int seq_store_fails;  // recordings that failed since boot
+uint16_t seq_store_rec_crc;
+
+// settings
+int seq_store_setting_val[SEQ_STORE_NUM_SETTINGS];
+volatile uint8_t seq_store_setting_saved[SEQ_STORE_NUM_SETTINGS];
+volatile uint8_t seq_store_setting_dirty[SEQ_STORE_NUM_SETTINGS];
+
+// local functions
+void seq_store_mount_page(int page);
+int seq_store_commit_valid(int page, int word, uint32_t hdr);
+void seq_store_setting_data(int setting, uint32_t *data);
+void seq_store_rec_task(void);
+void seq_store_rec_reset(void);
+void seq_store_rec_retry(void);
+int seq_store_erase_task(void);
+int seq_store_write_rec(uint32_t hdr, uint32_t *data, int len);
+int seq_store_open_page(void);
+int seq_store_write_word(int word, uint32_t val);
+int seq_store_is_live(int page);
+int seq_store_next_page(int page);
+uint16_t seq_store_crc(uint16_t crc, uint8_t data);
+
+// init the store and mount the log - call once at boot
+void seq_store_init(void) {
+    int i, page, newest, word;
+    uint32_t serial;
+
+    seq_store_live = 0;
+    seq_store_session = 0;
+    seq_store_idle = 0;
+    seq_store_req_start = 0;
+    seq_store_req_len = 0;
+    seq_store_req_commit = 0;
+    seq_store_req_edit = 0;
+    seq_store_rec_state = SEQ_STORE_REC_IDLE;
+    seq_store_rec_num = 0;
+    seq_store_fails = 0;
+    for(i = 0; i < SEQ_STORE_NUM_SETTINGS; i ++) {
+        seq_store_setting_saved[i] = 0;
+        seq_store_setting_dirty[i] = 0;
+    }
+
+    // find the newest page by serial
+    newest = -1;
+    serial = 0;
+    for(page = 0; page < SEQ_STORE_NUM_PAGES; page ++) {
+        if(SEQ_STORE_READ(page, SEQ_STORE_HDR_MAGIC) == SEQ_STORE_MAGIC) {
+            seq_store_page_state[page] = SEQ_STORE_PAGE_USED;
+            seq_store_page_serial[page] = SEQ_STORE_READ(page, SEQ_STORE_HDR_SERIAL);
+            if(newest == -1 || (int32_t)(SEQ_STORE_READ(page, SEQ_STORE_HDR_SERIAL) - serial) > 0) {
+                newest = page;
+                serial = SEQ_STORE_READ(page, SEQ_STORE_HDR_SERIAL);
+            }
+        }
+        // a blank header could still be a cut off erase or page open
+        else {
+            seq_store_page_state[page] = SEQ_STORE_PAGE_BLANK;
+            for(word = 0; word < SEQ_STORE_PAGE_WORDS; word ++) {
+                if(SEQ_STORE_READ(page, word) != SEQ_STORE_BLANK) {
+                    seq_store_page_state[page] = SEQ_STORE_PAGE_DIRTY;
+                    break;
+                }
+            }
+        }
+    }
+
+    // empty store - the first write opens page 0
+    if(newest == -1) {
+        seq_store_page = SEQ_STORE_NUM_PAGES - 1;
+        seq_store_word = SEQ_STORE_PAGE_WORDS;
+        seq_store_serial = 0;
+        return;
+    }
+
+    // walk the pages from oldest to newest - the newest page is last
+    seq_store_serial = serial;
+    page = seq_store_next_page(-1);
+    while(page != -1) {
+        seq_store_mount_page(page);
+        page = seq_store_next_page(page);
+    }
+}
+
+// run the store task - call from the main loop
+void seq_store_poll(void) {
+    int i;
+    uint32_t data[SEQ_STORE_SETTING_LEN];
+
+    // recording
+    seq_store_rec_task();
+    if(seq_store_rec_state == SEQ_STORE_REC_RUN) {
+        return;
+    }
+
+    // changed settings - one per poll
+    for(i = 0; i < SEQ_STORE_NUM_SETTINGS; i ++) {
+        if(seq_store_setting_dirty[i]) {
+            seq_store_setting_dirty[i] = 0;
+            seq_store_setting_data(i, data);
+            seq_store_write_rec(SEQ_STORE_REC(SEQ_STORE_REC_SETTING, i,
+                SEQ_STORE_SETTING_LEN), data, SEQ_STORE_SETTING_LEN);
+            return;
+        }
+    }
+
+    // keep erased pages ready for the next recording - once they are
+    // ready a recording that failed for want of them can go again
+    if(seq_store_idle && !seq_store_erase_task()) {
+        seq_store_rec_retry();
+    }
+}
+
+// allow or disallow page erases - 1 = erasing is okay right now
+void seq_store_set_idle(int idle) {
+    seq_store_idle = idle;
+}
+
+// load the last saved sequence into a buffer
+int seq_store_load(uint8_t *buf, int size, int *num_events) {
+    int page, word, len, i;
+    uint32_t hdr, data;
+    uint16_t crc;
+
+    *num_events = 0;
+    if(!seq_store_live || seq_store_live_len > size) {
+        return 0;
+    }
+
+    // gather the data records of the saved session
+    page = seq_store_live_start;
+    word = seq_store_live_word;
+    len = 0;
+    crc = 0xffff;
+    while(len < seq_store_live_len) {
+        hdr = SEQ_STORE_BLANK;
+        if(word < SEQ_STORE_PAGE_WORDS) {
+            hdr = SEQ_STORE_READ(page, word);
+        }
+        // end of page - go to the next one
+        if(hdr == SEQ_STORE_BLANK ||
+                (word + 1 + SEQ_STORE_REC_LEN(hdr)) > SEQ_STORE_PAGE_WORDS) {
+            page = seq_store_next_page(page);
+            if(page == -1) {
+                return 0;
+            }
+            word = SEQ_STORE_HDR_LEN;
+            continue;
+        }
+        if(SEQ_STORE_REC_TYPE(hdr) == SEQ_STORE_REC_DATA &&
+                SEQ_STORE_REC_TAG(hdr) == seq_store_live_session) {
+            for(i = 0; i < SEQ_STORE_REC_LEN(hdr) && len < seq_store_live_len; i ++) {
+                data = SEQ_STORE_READ(page, word + 1 + i);
+                buf[len ++] = data & 0xff;
+                if(len < seq_store_live_len) buf[len ++] = (data >> 8) & 0xff;
+                if(len < seq_store_live_len) buf[len ++] = (data >> 16) & 0xff;
+                if(len < seq_store_live_len) buf[len ++] = (data >> 24) & 0xff;
+            }
+        }
+        word += 1 + SEQ_STORE_REC_LEN(hdr);
+    }
+
+    for(i = 0; i < len; i ++) {
+        crc = seq_store_crc(crc, buf[i]);
+    }
+    if(crc != seq_store_live_crc) {
+        return 0;
+    }
+    *num_events = seq_store_live_events;
+    return len;
+}
+
+// start saving a new sequence from a buffer
+void seq_store_rec_start(uint8_t *buf) {
+    seq_store_req_buf = buf;
+    seq_store_req_len = 0;
+    seq_store_req_start ++;
+}
+
+// update the number of bytes recorded so far
+void seq_store_rec_update(int len) {
+    seq_store_req_len = len;
+}
+
+// finish saving the sequence
+void seq_store_rec_commit(int len, int num_events) {
+    seq_store_req_len = len;
+    seq_store_req_commit_len = len;
+    seq_store_req_commit_events = num_events;
+    seq_store_req_commit = seq_store_req_start;
+}
+
+// the buffer is about to be changed in place - call before moving data
+// - a sequence that is still being saved is dropped
+void seq_store_rec_edit(void) {
+    seq_store_req_edit ++;
+}
+
+// get the number of saves that failed since boot
+int seq_store_get_fails(void) {
+    return seq_store_fails;
+}
+
+// get a setting - returns the default if it was never saved
+int seq_store_get_setting(int setting, int def) {
+    if(setting < 0 || setting >= SEQ_STORE_NUM_SETTINGS) {
+        return def;
+    }
+    if(!seq_store_setting_saved[setting]) {
+        return def;
+    }
+    return seq_store_setting_val[setting];
+}
+
+// set a setting - only changed values are saved
+void seq_store_set_setting(int setting, int value) {
+    if(setting < 0 || setting >= SEQ_STORE_NUM_SETTINGS) {
+        return;
+    }
+    if(seq_store_setting_saved[setting] &&
+            seq_store_setting_val[setting] == value) {
+        return;
+    }
+    seq_store_setting_val[setting] = value;
+    seq_store_setting_saved[setting] = 1;
+    seq_store_setting_dirty[setting] = 1;
+}
+
+//
+// local functions
+//
+// walk the records in a page during mount
+void seq_store_mount_page(int page) {
+    int word, len, i;
+    uint32_t hdr, data;
+
+    // settings not found in this page - only matters for the newest page
+    for(i = 0; i < SEQ_STORE_NUM_SETTINGS; i ++) {
+        seq_store_setting_dirty[i] = seq_store_setting_saved[i];
+    }
+
+    word = SEQ_STORE_HDR_LEN;
+    while(word < SEQ_STORE_PAGE_WORDS) {
+        hdr = SEQ_STORE_READ(page, word);
+        if(hdr == SEQ_STORE_BLANK) {
+            break;
+        }
+        len = SEQ_STORE_REC_LEN(hdr);
+        // junk - don't write any more into this page
+        if((word + 1 + len) > SEQ_STORE_PAGE_WORDS) {
+            word = SEQ_STORE_PAGE_WORDS;
+            break;
+        }
+        switch(SEQ_STORE_REC_TYPE(hdr)) {
+            case SEQ_STORE_REC_DATA:
+                seq_store_session = SEQ_STORE_REC_TAG(hdr);
+                break;
+            case SEQ_STORE_REC_COMMIT:
+                seq_store_session = SEQ_STORE_REC_TAG(hdr);
+                if(seq_store_commit_valid(page, word, hdr)) {
+                    data = SEQ_STORE_READ(page, word + 1 + SEQ_STORE_COMMIT_SIZE);
+                    seq_store_live_session = SEQ_STORE_REC_TAG(hdr);
+                    seq_store_live_len = data & 0xffff;
+                    seq_store_live_events = data >> 16;
+                    data = SEQ_STORE_READ(page, word + 1 + SEQ_STORE_COMMIT_START);
+                    seq_store_live_start = data >> 16;
+                    seq_store_live_word = data & 0xffff;
+                    seq_store_live_end = page;
+                    seq_store_live_crc = SEQ_STORE_READ(page, word + 1 + SEQ_STORE_COMMIT_CRC);
+                    seq_store_live = 1;
+                    // an empty sequence has nothing to protect
+                    if(seq_store_live_len == 0) {
+                        seq_store_live_start = page;
+                    }
+                    else if(seq_store_live_start >= SEQ_STORE_NUM_PAGES) {
+                        seq_store_live = 0;
+                    }
+                }
+                break;
+            case SEQ_STORE_REC_SETTING:
+                // a setting cut off by a power loss is ignored
+                data = SEQ_STORE_READ(page, word + 1);
+                if(SEQ_STORE_REC_TAG(hdr) < SEQ_STORE_NUM_SETTINGS &&
+                        len == SEQ_STORE_SETTING_LEN &&
+                        SEQ_STORE_READ(page, word + 2) == SEQ_STORE_SETTING_CHECK(hdr, data)) {
+                    seq_store_setting_val[SEQ_STORE_REC_TAG(hdr)] = data;
+                    seq_store_setting_saved[SEQ_STORE_REC_TAG(hdr)] = 1;
+                    seq_store_setting_dirty[SEQ_STORE_REC_TAG(hdr)] = 0;
+                }
+                break;
+            // junk - don't write any more into this page
+            default:
+                word = SEQ_STORE_PAGE_WORDS;
+                continue;
+        }
+        word += 1 + len;
+    }
+    // the last page walked is the newest
+    seq_store_page = page;
+    seq_store_word = word;
+}
+
+// check that a commit record was completely written
+int seq_store_commit_valid(int page, int word, uint32_t hdr) {
+    uint32_t seal;
+    if(SEQ_STORE_REC_LEN(hdr) != SEQ_STORE_COMMIT_LEN) {
+        return 0;
+    }
+    seal = hdr ^ SEQ_STORE_SEAL_KEY;
+    seal ^= SEQ_STORE_READ(page, word + 1 + SEQ_STORE_COMMIT_SIZE);
+    seal ^= SEQ_STORE_READ(page, word + 1 + SEQ_STORE_COMMIT_START);
+    seal ^= SEQ_STORE_READ(page, word + 1 + SEQ_STORE_COMMIT_CRC);
+    if(SEQ_STORE_READ(page, word + 1 + SEQ_STORE_COMMIT_SEAL) != seal) {
+        return 0;
+    }
+    return 1;
+}
+
+// handle recording requests
+void seq_store_rec_task(void) {
+    int start, len, i, num, commit, events;
+    uint32_t data[SEQ_STORE_COMMIT_LEN + 1];
+    uint32_t chunk[SEQ_STORE_CHUNK_WORDS];
+    uint8_t *buf;
+
+    // the task timer moves data around in the buffer, so the requests
+    // and the next chunk are copied with it held off
+    INTEnable(INT_SOURCE_TIMER(TMR1), INT_DISABLED);
+
+    // a new recording was started - drop anything left from the last one
+    start = seq_store_req_start;
+    if(start != seq_store_rec_num) {
+        seq_store_rec_num = start;
+        seq_store_rec_edit_num = seq_store_req_edit;
+        seq_store_rec_retried = 0;
+        seq_store_rec_reset();
+    }
+    if(seq_store_rec_state != SEQ_STORE_REC_RUN) {
+        INTEnable(INT_SOURCE_TIMER(TMR1), INT_ENABLED);
+        return;
+    }
+
+    // see how much there is to write
+    commit = (seq_store_req_commit == start);
+    events = seq_store_req_commit_events;
+    if(commit) {
+        len = seq_store_req_commit_len;
+    }
+    else {
+        len = seq_store_req_len;
+    }
+    num = len - seq_store_rec_flushed;
+    if(num > SEQ_STORE_CHUNK_BYTES) {
+        num = SEQ_STORE_CHUNK_BYTES;
+    }
+
+    // the buffer was changed under the recording - the part already
+    // written no longer matches the rest, so drop it and wait for the
+    // next one - once everything is copied the commit can still go ahead
+    if(num > 0 && seq_store_req_edit != seq_store_rec_edit_num) {
+        seq_store_rec_state = SEQ_STORE_REC_IDLE;
+        INTEnable(INT_SOURCE_TIMER(TMR1), INT_ENABLED);
+        return;
+    }
+
+    // copy a full chunk, or whatever is left once the recording is done
+    if(num == SEQ_STORE_CHUNK_BYTES || (num > 0 && commit)) {
+        buf = seq_store_req_buf + seq_store_rec_flushed;
+        for(i = 0; i < SEQ_STORE_CHUNK_WORDS; i ++) {
+            chunk[i] = SEQ_STORE_BLANK;
+        }
+        for(i = 0; i < num; i ++) {
+            chunk[i >> 2] &= ~(0xffu << ((i & 3) << 3));
+            chunk[i >> 2] |= (uint32_t)buf[i] << ((i & 3) << 3);
+        }
+    }
+    INTEnable(INT_SOURCE_TIMER(TMR1), INT_ENABLED);
+
+    // write the chunk - the CRC is worked out from the copy
+    if(num == SEQ_STORE_CHUNK_BYTES || (num > 0 && commit)) {
+        for(i = 0; i < num; i ++) {
+            seq_store_rec_crc = seq_store_crc(seq_store_rec_crc,
+                (chunk[i >> 2] >> ((i & 3) << 3)) & 0xff);
+        }
+        if(!seq_store_write_rec(SEQ_STORE_REC(SEQ_STORE_REC_DATA, seq_store_session,
+                (num + 3) >> 2), chunk, (num + 3) >> 2)) {
+            seq_store_rec_state = SEQ_STORE_REC_FAIL;
+            seq_store_fails ++;
+            return;
+        }
+        if(seq_store_rec_flushed == 0) {
+            seq_store_rec_page = seq_store_loc_page;
+            seq_store_rec_word = seq_store_loc_word;
+        }
+        seq_store_rec_flushed += num;
+        return;
+    }
+
+    // everything is written - commit the sequence
+    if(commit && num == 0) {
+        data[0] = SEQ_STORE_REC(SEQ_STORE_REC_COMMIT, seq_store_session, SEQ_STORE_COMMIT_LEN);
+        data[1 + SEQ_STORE_COMMIT_SIZE] = (len & 0xffff) |
+            ((uint32_t)events << 16);
+        data[1 + SEQ_STORE_COMMIT_START] = ((uint32_t)seq_store_rec_page << 16) |
+            seq_store_rec_word;
+        data[1 + SEQ_STORE_COMMIT_CRC] = seq_store_rec_crc;
+        data[1 + SEQ_STORE_COMMIT_SEAL] = data[0] ^ data[1] ^ data[2] ^ data[3] ^
+            SEQ_STORE_SEAL_KEY;
+        if(!seq_store_write_rec(data[0], &data[1], SEQ_STORE_COMMIT_LEN)) {
+            seq_store_rec_state = SEQ_STORE_REC_FAIL;
+            seq_store_fails ++;
+            return;
+        }
+        seq_store_live = 1;
+        seq_store_live_session = seq_store_session;
+        seq_store_live_len = len;
+        seq_store_live_events = events;
+        seq_store_live_start = seq_store_rec_page;
+        seq_store_live_word = seq_store_rec_word;
+        seq_store_live_end = seq_store_loc_page;
+        seq_store_live_crc = seq_store_rec_crc;
+        if(len == 0) {
+            seq_store_live_start = seq_store_loc_page;
+        }
+        seq_store_rec_state = SEQ_STORE_REC_IDLE;
+    }
+}
+
+// start writing the recording from the beginning in a new session
+void seq_store_rec_reset(void) {
+    seq_store_rec_state = SEQ_STORE_REC_RUN;
+    seq_store_rec_flushed = 0;
+    seq_store_rec_page = SEQ_STORE_NONE;
+    seq_store_rec_word = SEQ_STORE_NONE;
+    seq_store_rec_crc = 0xffff;
+    seq_store_session ++;
+    if(seq_store_live && seq_store_session == seq_store_live_session) {
+        seq_store_session ++;
+    }
+}
+
+// try a failed recording once more - only if it was committed and
+// nothing was started or changed in the buffer since, so it still
+// holds the same sequence
+void seq_store_rec_retry(void) {
+    INTEnable(INT_SOURCE_TIMER(TMR1), INT_DISABLED);
+    if(seq_store_rec_state == SEQ_STORE_REC_FAIL && !seq_store_rec_retried &&
+            seq_store_req_start == seq_store_rec_num &&
+            seq_store_req_commit == seq_store_rec_num &&
+            seq_store_req_edit == seq_store_rec_edit_num) {
+        seq_store_rec_retried = 1;
+        seq_store_rec_reset();
+    }
+    INTEnable(INT_SOURCE_TIMER(TMR1), INT_ENABLED);
+}
+
+// erase the oldest page if there are not enough erased pages ready
+// - returns 1 if a page was erased
+int seq_store_erase_task(void) {
+    int page, blank, oldest, word;
+
+    // cut off pages go first, then the oldest page that is not in use
+    blank = 0;
+    oldest = -1;
+    for(page = 0; page < SEQ_STORE_NUM_PAGES; page ++) {
+        if(seq_store_page_state[page] == SEQ_STORE_PAGE_BLANK) {
+            blank ++;
+        }
+        else if(seq_store_page_state[page] == SEQ_STORE_PAGE_DIRTY) {
+            oldest = page;
+        }
+        else if(page != seq_store_page && !seq_store_is_live(page) &&
+                (oldest == -1 || (seq_store_page_state[oldest] == SEQ_STORE_PAGE_USED &&
+                (int32_t)(seq_store_page_serial[page] - seq_store_page_serial[oldest]) < 0))) {
+            oldest = page;
+        }
+    }
+    if(blank >= SEQ_STORE_RESERVE_PAGES || oldest == -1) {
+        return 0;
+    }
+
+    NVMErasePage((void *)SEQ_STORE_ADDR(oldest, 0));
+    seq_store_page_state[oldest] = SEQ_STORE_PAGE_BLANK;
+    for(word = 0; word < SEQ_STORE_PAGE_WORDS; word ++) {
+        if(SEQ_STORE_READ(oldest, word) != SEQ_STORE_BLANK) {
+            seq_store_page_state[oldest] = SEQ_STORE_PAGE_DIRTY;
+            break;
+        }
+    }
+    return 1;
+}
+
+// write a record at the end of the log - returns 1 on success
+int seq_store_write_rec(uint32_t hdr, uint32_t *data, int len) {
+    int i;
+    if((seq_store_word + 1 + len) > SEQ_STORE_PAGE_WORDS) {
+        if(!seq_store_open_page()) {
+            return 0;
+        }
+    }
+    seq_store_loc_page = seq_store_page;
+    seq_store_loc_word = seq_store_word;
+    // header first so a cut off record is still skipped at mount
+    if(!seq_store_write_word(seq_store_word, hdr)) {
+        seq_store_word = SEQ_STORE_PAGE_WORDS;
+        return 0;
+    }
+    seq_store_word ++;
+    for(i = 0; i < len; i ++) {
+        if(!seq_store_write_word(seq_store_word, data[i])) {
+            seq_store_word = SEQ_STORE_PAGE_WORDS;
+            return 0;
+        }
+        seq_store_word ++;
+    }
+    return 1;
+}
+
+// start writing the next page - returns 1 on success
+int seq_store_open_page(void) {
+    int page, i;
+    uint32_t data[SEQ_STORE_SETTING_LEN];
+
+    // use the next blank page after the current one to spread the wear
+    page = seq_store_page;
+    for(i = 0; i < SEQ_STORE_NUM_PAGES; i ++) {
+        page ++;
+        if(page == SEQ_STORE_NUM_PAGES) {
+            page = 0;
+        }
+        if(seq_store_page_state[page] == SEQ_STORE_PAGE_BLANK) {
+            break;
+        }
+    }
+    if(i == SEQ_STORE_NUM_PAGES) {
+        return 0;
+    }
+    seq_store_page = page;
+    seq_store_word = SEQ_STORE_PAGE_WORDS;  // in case of a write error
+    seq_store_page_state[page] = SEQ_STORE_PAGE_DIRTY;
+    // serial first so a cut off header never looks like the newest page
+    seq_store_serial ++;
+    seq_store_page_serial[page] = seq_store_serial;
+    if(!seq_store_write_word(SEQ_STORE_HDR_SERIAL, seq_store_serial)) {
+        return 0;
+    }
+    if(!seq_store_write_word(SEQ_STORE_HDR_MAGIC, SEQ_STORE_MAGIC)) {
+        return 0;
+    }
+    seq_store_page_state[page] = SEQ_STORE_PAGE_USED;
+    seq_store_word = SEQ_STORE_HDR_LEN;
+
+    // copy the settings so older pages can be erased
+    for(i = 0; i < SEQ_STORE_NUM_SETTINGS; i ++) {
+        if(seq_store_setting_saved[i]) {
+            seq_store_setting_dirty[i] = 0;
+            seq_store_setting_data(i, data);
+            if(!seq_store_write_word(seq_store_word,
+                    SEQ_STORE_REC(SEQ_STORE_REC_SETTING, i, SEQ_STORE_SETTING_LEN)) ||
+                    !seq_store_write_word(seq_store_word + 1, data[0]) ||
+                    !seq_store_write_word(seq_store_word + 2, data[1])) {
+                seq_store_word = SEQ_STORE_PAGE_WORDS;
+                return 0;
+            }
+            seq_store_word += 1 + SEQ_STORE_SETTING_LEN;
+        }
+    }
+    return 1;
+}
+
+// get the payload of a setting record - the check word goes last
+void seq_store_setting_data(int setting, uint32_t *data) {
+    data[0] = seq_store_setting_val[setting];
+    data[1] = SEQ_STORE_SETTING_CHECK(SEQ_STORE_REC(SEQ_STORE_REC_SETTING,
+        setting, SEQ_STORE_SETTING_LEN), data[0]);
+}
+
+// write a word to the current page - returns 1 on success
+int seq_store_write_word(int word, uint32_t val) {
+    if(NVMWriteWord((void *)SEQ_STORE_ADDR(seq_store_page, word), val)) {
+        return 0;
+    }
+    if(SEQ_STORE_READ(seq_store_page, word) != val) {
+        return 0;
+    }
+    return 1;
+}
+
+// check if a page holds part of the saved sequence
+int seq_store_is_live(int page) {
+    if(!seq_store_live || seq_store_page_state[page] != SEQ_STORE_PAGE_USED) {
+        return 0;
+    }
+    if((int32_t)(seq_store_page_serial[page] -
+            seq_store_page_serial[seq_store_live_start]) < 0) {
+        return 0;
+    }
+    if((int32_t)(seq_store_page_serial[page] -
+            seq_store_page_serial[seq_store_live_end]) > 0) {
+        return 0;
+    }
+    return 1;
+}
+
+// get the next page in log order - page = -1 gets the oldest page
+// - returns -1 if there are no more pages
+int seq_store_next_page(int page) {
+    int i, next;
+    next = -1;
+    for(i = 0; i < SEQ_STORE_NUM_PAGES; i ++) {
+        if(seq_store_page_state[i] != SEQ_STORE_PAGE_USED) {
+            continue;
+        }
+        if(page != -1 && (int32_t)(seq_store_page_serial[i] -
+                seq_store_page_serial[page]) <= 0) {
+            continue;
+        }
+        if(next == -1 || (int32_t)(seq_store_page_serial[i] -
+                seq_store_page_serial[next]) < 0) {
+            next = i;
+        }
+    }
+    return next;
+}
+
+// update a CRC-16 (CCITT) with a byte
+uint16_t seq_store_crc(uint16_t crc, uint8_t data) {
+    int i;
+    crc ^= data << 8;
+    for(i = 0; i < 8; i ++) {
+        if(crc & 0x8000) {
+            crc = (crc << 1) ^ 0x1021;
+        }
+        else {
+            crc <<= 1;
+        }
+    }
+    return crc;
+}
@@ -0,0 +1,65 @@
+/*
+ * PHENOL Mini Sequencer - Flash Store
+ *
+ * Copyright 2015: Andrew Kilpatrick
+ * Written by: Andrew Kilpatrick
+ *
+ */
+#ifndef SEQ_STORE_H
+#define SEQ_STORE_H
+
+#include <inttypes.h>
+
+// settings
+#define SEQ_STORE_SETTING_STOP_IGNORE 0
+#define SEQ_STORE_SETTING_VOICE_MODE 1
+#define SEQ_STORE_SETTING_VOICE_UNIT 2
+#define SEQ_STORE_SETTING_VOICE_UNITS 3
+#define SEQ_STORE_SETTING_CV_CAL 4  // 5 settings - 2 CV calibration points each
+#define SEQ_STORE_SETTING_CV1_MAP 9
+#define SEQ_STORE_SETTING_CV2_MAP 10
+#define SEQ_STORE_SETTING_QUANTIZE 11  // grid | swing << 8
+#define SEQ_STORE_NUM_SETTINGS 16
+
+// init the store and mount the log - call once at boot
+void seq_store_init(void);
+
+// run the store task - call from the main loop
+// - does the actual flash writes and erases
+void seq_store_poll(void);
+
+// allow or disallow page erases - 1 = erasing is okay right now
+// - an erase stalls the CPU for up to 20ms which would stop the audio
+//   and drop MIDI input, so only allow it while powered off / in standby
+void seq_store_set_idle(int idle);
+
+// load the last saved sequence into a buffer
+// - returns the length in bytes and sets the number of events
+int seq_store_load(uint8_t *buf, int size, int *num_events);
+
+// start saving a new sequence from a buffer
+void seq_store_rec_start(uint8_t *buf);
+
+// update the number of bytes recorded so far
+void seq_store_rec_update(int len);
+
+// finish saving the sequence
+void seq_store_rec_commit(int len, int num_events);
+
+// the buffer is about to be changed in place - call before moving data
+// - a sequence that is still being saved is dropped, so the change must
+//   be followed by a new save
+void seq_store_rec_edit(void);
+
+// get the number of saves that failed since boot
+// - a save fails if the blank pages run out while powered on - the last
+//   one is tried again in standby
+int seq_store_get_fails(void);
+
+// get a setting - returns the default if it was never saved
+int seq_store_get_setting(int setting, int def);
+
+// set a setting - only changed values are saved
+void seq_store_set_setting(int setting, int value);
+
+#endif
@@ -0,0 +1,157 @@
+/*
+ * K65 Phenol Mixer - Telemetry
+ *
+ * Copyright 2015: Andrew Kilpatrick
+ * Written by: Andrew Kilpatrick
+ *
+ * Sends the state of the mixer as sysex frames on the USB MIDI port. Each
+ * frame only has the fields that changed since the last frame sent and
+ * every TELEM_KEY_INTERVAL frames has all of them. A frame is skipped if
+ * the TX buffer doesn't have room for the largest frame so the time taken
+ * is always the same - see tools/telem_dump.c for the decoder.
+ *
+ */
+#include "telem.h"
+#include "midi.h"
+#include "phenol_midi.h"
+#include "analog_filter.h"
+#include "audio_proc.h"
+#include "seq.h"
+#include "seq_store.h"
+#include "midi_clock.h"
+#include "isr_load.h"
+
+#define TELEM_PORT MIDI_PORT_USB
+#define TELEM_MIN_PERIOD 10  // ms - keeps the USB MIDI port usable
+#define TELEM_MAX_PERIOD 16383  // ms - 14 bits from the set rate message
+#define TELEM_KEY_INTERVAL 16  // frames between key frames
+
+// state
+int telem_period;  // frame period - ms - 0 = off
+int telem_count;  // ms since the last frame
+int telem_seq;  // frame count
+int telem_key_count;  // frames until the next key frame
+int telem_drops;  // frames not sent
+int telem_last[TELEM_NUM_FIELDS];  // field values in the last frame sent
+unsigned char telem_buf[TELEM_MAX_FRAME];  // frame being made
+
+// local functions
+void telem_read_fields(int *vals);
+
+// init the telemetry
+void telem_init(void) {
+	int i;
+	telem_period = 0;
+	telem_count = 0;
+	telem_seq = 0;
+	telem_key_count = 0;
+	telem_drops = 0;
+	for(i = 0; i < TELEM_NUM_FIELDS; i ++) {
+		telem_last[i] = 0;
+	}
+}
+
+// run the telemetry timer task - call every 1ms
+void telem_timer_task(void) {
+	int vals[TELEM_NUM_FIELDS];
+	int i, len, delta, key;
+	unsigned int zz;
+	if(telem_period == 0) {
+		return;
+	}
+	telem_count ++;
+	if(telem_count < telem_period) {
+		return;
+	}
+	telem_count = 0;
+	if(midi_tx_room(TELEM_PORT) < TELEM_MAX_FRAME + 2) {
+		telem_drops ++;
+		return;
+	}
+	telem_read_fields(vals);
+
+	// header
+	key = (telem_key_count == 0);
+	telem_buf[0] = 0x00;
+	telem_buf[1] = 0x01;
+	telem_buf[2] = 0x72;
+	telem_buf[3] = midi_get_device_type();
+	telem_buf[4] = TELEM_CMD_FRAME;
+	telem_buf[5] = telem_seq;
+	telem_buf[6] = key ? TELEM_FLAG_KEY : 0;
+	for(i = 0; i < TELEM_BITMAP_BYTES; i ++) {
+		telem_buf[TELEM_HEADER_LEN + i] = 0;
+	}
+	len = TELEM_HEADER_LEN + TELEM_BITMAP_BYTES;
+
+	// changed fields
+	for(i = 0; i < TELEM_NUM_FIELDS; i ++) {
+		delta = vals[i];
+		if(!key) {
+			delta -= telem_last[i];
+		}
+		telem_last[i] = vals[i];
+		if(delta == 0) {
+			continue;
+		}
+		telem_buf[TELEM_HEADER_LEN + (i / 7)] |= 1 << (i % 7);
+		zz = ((unsigned int)delta << 1) ^ (delta >> 31);
+		while(zz > 0x3f) {
+			telem_buf[len ++] = (zz & 0x3f) | 0x40;
+			zz >>= 6;
+		}
+		telem_buf[len ++] = zz;
+	}
+
+	_midi_tx_sysex_msg(TELEM_PORT, telem_buf, len);
+	telem_seq = (telem_seq + 1) & 0x7f;
+	telem_key_count ++;
+	if(telem_key_count == TELEM_KEY_INTERVAL) {
+		telem_key_count = 0;
+	}
+}
+
+// set the frame period - ms - 0 = off
+void telem_set_rate(int period) {
+	if(period < 0) {
+		return;
+	}
+	if(period > 0 && period < TELEM_MIN_PERIOD) {
+		period = TELEM_MIN_PERIOD;
+	}
+	if(period > TELEM_MAX_PERIOD) {
+		period = TELEM_MAX_PERIOD;
+	}
+	telem_period = period;
+	telem_count = 0;
+	telem_key_count = 0;  // start with a key frame so the decoder can sync
+}
+
+//
+// local functions
+//
+// read the fields for a frame - values must fit in 16 bits
+void telem_read_fields(int *vals) {
+	int i;
+	for(i = 0; i < ANALOG_CHANS; i ++) {
+		vals[TELEM_FIELD_POT + i] = analog_filter_get_val(i);
+	}
+	vals[TELEM_FIELD_PEAK_L] = audio_proc_get_peak(0);
+	vals[TELEM_FIELD_PEAK_R] = audio_proc_get_peak(1);
+	vals[TELEM_FIELD_SEQ_STATE] = seq_get_state();
+	vals[TELEM_FIELD_TEMPO] = midi_clock_get_tempo();
+	if(vals[TELEM_FIELD_TEMPO] > 0xffff) {
+		vals[TELEM_FIELD_TEMPO] = 0xffff;  // external clock much too fast
+	}
+	vals[TELEM_FIELD_CLOCK_INT] = midi_clock_get_internal();
+	vals[TELEM_FIELD_RX_DIN] = midi_rx_depth(MIDI_PORT_DIN);
+	vals[TELEM_FIELD_RX_USB] = midi_rx_depth(MIDI_PORT_USB);
+	vals[TELEM_FIELD_TX_DIN] = midi_tx_depth(MIDI_PORT_DIN);
+	vals[TELEM_FIELD_TX_USB] = midi_tx_depth(MIDI_PORT_USB);
+	for(i = 0; i < ISR_LOAD_NUM; i ++) {
+		vals[TELEM_FIELD_LOAD + i] = isr_load_get_load(i);
+		vals[TELEM_FIELD_MAX + i] = isr_load_get_max(i);
+	}
+	vals[TELEM_FIELD_DROPS] = telem_drops & 0xffff;
+	vals[TELEM_FIELD_STORE_FAILS] = seq_store_get_fails() & 0xffff;
+}
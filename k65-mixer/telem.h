@@ -0,0 +1,63 @@
+/*
+ * K65 Phenol Mixer - Telemetry
+ *
+ * Copyright 2015: Andrew Kilpatrick
+ * Written by: Andrew Kilpatrick
+ *
+ * Frame format - sysex data after F0:
+ *	00 01 72 dev_id TELEM_CMD_FRAME seq flags bitmap[TELEM_BITMAP_BYTES] deltas...
+ *	- seq - frame count - 0-127 - a gap means frames were lost
+ *	- flags - TELEM_FLAG_KEY if the deltas are from 0 instead of the last frame
+ *	- bitmap - 7 fields per byte - field 0 is bit 0 of the first byte
+ *	- deltas - one for each field set in the bitmap - zigzag coded
+ *	  (0, -1, 1, -2...) - 6 bits per byte from the low end - bit 6 set if
+ *	  more bytes follow
+ *
+ * The frame rate is set with:
+ *	00 01 72 dev_id TELEM_CMD_SET_RATE period_lsb period_msb - ms - 0 = off
+ *
+ */
+#ifndef TELEM_H
+#define TELEM_H
+
+// sysex commands
+#define TELEM_CMD_FRAME 0x20  // telemetry frame - device to host
+#define TELEM_CMD_SET_RATE 0x21  // set the frame period - host to device
+
+// frame fields
+#define TELEM_FIELD_POT 0  // 8 analog filter values - 7 pots and the DC in sense - 12 bit
+#define TELEM_FIELD_PEAK_L 8  // highest left output sample since the last frame
+#define TELEM_FIELD_PEAK_R 9  // highest right output sample since the last frame
+#define TELEM_FIELD_SEQ_STATE 10  // sequencer state
+#define TELEM_FIELD_TEMPO 11  // tempo - BPM x 10
+#define TELEM_FIELD_CLOCK_INT 12  // 1 = internal clock, 0 = external
+#define TELEM_FIELD_RX_DIN 13  // MIDI RX buffer depth - DIN
+#define TELEM_FIELD_RX_USB 14  // MIDI RX buffer depth - USB
+#define TELEM_FIELD_TX_DIN 15  // MIDI TX buffer depth - DIN
+#define TELEM_FIELD_TX_USB 16  // MIDI TX buffer depth - USB
+#define TELEM_FIELD_LOAD 17  // 3 ISR loads - 0-1000 - timer 1, UART 2, SPI 1
+#define TELEM_FIELD_MAX 20  // 3 ISR longest runs - us - timer 1, UART 2, SPI 1
+#define TELEM_FIELD_DROPS 23  // frames not sent because the TX buffer was full
+#define TELEM_FIELD_STORE_FAILS 24  // sequencer saves that failed since boot
+#define TELEM_NUM_FIELDS 25
+#define TELEM_BITMAP_BYTES ((TELEM_NUM_FIELDS + 6) / 7)
+
+// flags
+#define TELEM_FLAG_KEY 0x01  // key frame
+
+// sizes
+#define TELEM_HEADER_LEN 7  // ID, device, command, seq, flags
+#define TELEM_MAX_DELTA_LEN 3  // zigzag of a 16 bit value in 6 bit groups
+#define TELEM_MAX_FRAME (TELEM_HEADER_LEN + TELEM_BITMAP_BYTES + \
+	(TELEM_NUM_FIELDS * TELEM_MAX_DELTA_LEN))
+
+// init the telemetry
+void telem_init(void);
+
+// run the telemetry timer task - call every 1ms
+void telem_timer_task(void);
+
+// set the frame period - ms - 0 = off
+void telem_set_rate(int period);
+
+#endif
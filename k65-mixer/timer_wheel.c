@@ -0,0 +1,198 @@
+/*
+ * K65 Phenol Mixer - Timer Wheel
+ *
+ * Copyright 2015: Andrew Kilpatrick
+ * Written by: Andrew Kilpatrick
+ *
+ * A two level timer wheel for one-shot and periodic callbacks:
+ *	- level 0 has one slot per tick and covers the next 64 ticks
+ *	- level 1 has one slot per 64 ticks and is cascaded into level 0
+ *	  each time level 0 wraps around
+ *	- each tick only touches the timers that are due (plus one
+ *	  cascade every 64 ticks) no matter how many timers are running
+ *	- timers that expire on the same tick are called in the order
+ *	  they were linked into the slot - the order they were started,
+ *	  except that timers cascaded down from level 1 come after the
+ *	  ones that were started straight into level 0
+ *
+ * All calls must be made from the task timer context (or before
+ * interrupts are enabled) since there is no locking.
+ *
+ */
+#include "timer_wheel.h"
+
+// wheel geometry
+#define TW_L0_BITS 6
+#define TW_L0_SIZE (1 << TW_L0_BITS)
+#define TW_L0_MASK (TW_L0_SIZE - 1)
+#define TW_L1_SIZE 64
+#define TW_L1_MASK (TW_L1_SIZE - 1)
+#define TW_NUM_SLOTS (TW_L0_SIZE + TW_L1_SIZE)
+
+struct timer_wheel_timer {
+	void (*func)(int arg);  // callback
+	int arg;  // callback argument
+	unsigned int expire;  // tick count when the timer expires
+	int period;  // reload period in ticks - 0 = one-shot
+	unsigned char next;  // next timer in the slot list
+	unsigned char prev;  // previous timer in the slot list
+	unsigned char slot;  // slot we are linked into - TIMER_WHEEL_NONE = stopped
+};
+struct timer_wheel_timer timer_wheel_timers[TIMER_WHEEL_MAX_TIMERS];
+unsigned char timer_wheel_slots[TW_NUM_SLOTS];  // first timer in each slot list
+unsigned int timer_wheel_tick;  // current tick count
+int timer_wheel_num_timers;  // number of timers allocated
+
+// local functions
+void timer_wheel_link(int timer);
+void timer_wheel_unlink(int timer);
+
+// init the timer wheel
+void timer_wheel_init(void) {
+	int i;
+	for(i = 0; i < TW_NUM_SLOTS; i ++) {
+		timer_wheel_slots[i] = TIMER_WHEEL_NONE;
+	}
+	for(i = 0; i < TIMER_WHEEL_MAX_TIMERS; i ++) {
+		timer_wheel_timers[i].func = 0;
+		timer_wheel_timers[i].slot = TIMER_WHEEL_NONE;
+	}
+	timer_wheel_tick = 0;
+	timer_wheel_num_timers = 0;
+}
+
+// run the timer wheel task - call once per tick (250us)
+void timer_wheel_task(void) {
+	int timer, slot;
+	struct timer_wheel_timer *t;
+
+	timer_wheel_tick ++;
+
+	// level 0 wrapped - move the next level 1 slot down into level 0
+	if((timer_wheel_tick & TW_L0_MASK) == 0) {
+		slot = TW_L0_SIZE + ((timer_wheel_tick >> TW_L0_BITS) & TW_L1_MASK);
+		while(timer_wheel_slots[slot] != TIMER_WHEEL_NONE) {
+			timer = timer_wheel_slots[slot];
+			timer_wheel_unlink(timer);
+			timer_wheel_link(timer);
+		}
+	}
+
+	// run the timers that are due
+	slot = timer_wheel_tick & TW_L0_MASK;
+	while(timer_wheel_slots[slot] != TIMER_WHEEL_NONE) {
+		timer = timer_wheel_slots[slot];
+		t = &timer_wheel_timers[timer];
+		timer_wheel_unlink(timer);
+		// reload periodic timers before the callback so it can stop them
+		if(t->period) {
+			t->expire += t->period;
+			timer_wheel_link(timer);
+		}
+		t->func(t->arg);
+	}
+}
+
+// allocate a timer - returns a handle or TIMER_WHEEL_NONE if none are free
+int timer_wheel_alloc(void (*func)(int arg), int arg) {
+	int timer;
+	if(timer_wheel_num_timers >= TIMER_WHEEL_MAX_TIMERS) {
+		return TIMER_WHEEL_NONE;
+	}
+	timer = timer_wheel_num_timers;
+	timer_wheel_timers[timer].func = func;
+	timer_wheel_timers[timer].arg = arg;
+	timer_wheel_timers[timer].period = 0;
+	timer_wheel_timers[timer].slot = TIMER_WHEEL_NONE;
+	timer_wheel_num_timers ++;
+	return timer;
+}
+
+// start or restart a timer - delay and period are in ticks
+void timer_wheel_start(int timer, int delay, int period) {
+	if(timer < 0 || timer >= timer_wheel_num_timers) {
+		return;
+	}
+	if(delay < 1) delay = 1;
+	if(delay > TIMER_WHEEL_MAX_DELAY) delay = TIMER_WHEEL_MAX_DELAY;
+	if(period < 0) period = 0;
+	if(period > TIMER_WHEEL_MAX_DELAY) period = TIMER_WHEEL_MAX_DELAY;
+	timer_wheel_unlink(timer);
+	timer_wheel_timers[timer].expire = timer_wheel_tick + delay;
+	timer_wheel_timers[timer].period = period;
+	timer_wheel_link(timer);
+}
+
+// stop a timer
+void timer_wheel_stop(int timer) {
+	if(timer < 0 || timer >= timer_wheel_num_timers) {
+		return;
+	}
+	timer_wheel_unlink(timer);
+}
+
+// check if a timer is running - 1 = running, 0 = stopped
+int timer_wheel_is_running(int timer) {
+	if(timer < 0 || timer >= timer_wheel_num_timers) {
+		return 0;
+	}
+	if(timer_wheel_timers[timer].slot == TIMER_WHEEL_NONE) {
+		return 0;
+	}
+	return 1;
+}
+
+//
+// local functions
+//
+// link a timer into the slot for its expire time - added to the end of the list
+void timer_wheel_link(int timer) {
+	struct timer_wheel_timer *t = &timer_wheel_timers[timer];
+	unsigned int delta = t->expire - timer_wheel_tick;
+	int slot, first, last;
+
+	// due within the current level 0 window
+	if(delta < TW_L0_SIZE) {
+		slot = t->expire & TW_L0_MASK;
+	}
+	// due later - wait in level 1
+	else {
+		slot = TW_L0_SIZE + ((t->expire >> TW_L0_BITS) & TW_L1_MASK);
+	}
+
+	// slot lists are circular so the first timer points back to the last
+	first = timer_wheel_slots[slot];
+	if(first == TIMER_WHEEL_NONE) {
+		t->next = timer;
+		t->prev = timer;
+		timer_wheel_slots[slot] = timer;
+	}
+	else {
+		last = timer_wheel_timers[first].prev;
+		t->next = first;
+		t->prev = last;
+		timer_wheel_timers[last].next = timer;
+		timer_wheel_timers[first].prev = timer;
+	}
+	t->slot = slot;
+}
+
+// unlink a timer from its slot list
+void timer_wheel_unlink(int timer) {
+	struct timer_wheel_timer *t = &timer_wheel_timers[timer];
+	if(t->slot == TIMER_WHEEL_NONE) {
+		return;
+	}
+	// only timer in the list
+	if(t->next == timer) {
+		timer_wheel_slots[t->slot] = TIMER_WHEEL_NONE;
+	}
+	else {
+		timer_wheel_timers[t->prev].next = t->next;
+		timer_wheel_timers[t->next].prev = t->prev;
+		if(timer_wheel_slots[t->slot] == timer) {
+			timer_wheel_slots[t->slot] = t->next;
+		}
+	}
+	t->slot = TIMER_WHEEL_NONE;
+}
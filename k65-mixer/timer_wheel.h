@@ -0,0 +1,36 @@
+/*
+ * K65 Phenol Mixer - Timer Wheel
+ *
+ * Copyright 2015: Andrew Kilpatrick
+ * Written by: Andrew Kilpatrick
+ *
+ */
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+// settings
+#define TIMER_WHEEL_MAX_TIMERS 16  // number of timers that can be allocated
+#define TIMER_WHEEL_MAX_DELAY 4000  // longest delay in ticks (1 tick = 250us)
+#define TIMER_WHEEL_NONE 0xff  // invalid timer handle
+
+// init the timer wheel
+void timer_wheel_init(void);
+
+// run the timer wheel task - call once per tick (250us)
+void timer_wheel_task(void);
+
+// allocate a timer - returns a handle or TIMER_WHEEL_NONE if none are free
+// - func is called with arg from the timer task when the timer expires
+int timer_wheel_alloc(void (*func)(int arg), int arg);
+
+// start or restart a timer - delay and period are in ticks
+// - period = 0 for one-shot timers
+void timer_wheel_start(int timer, int delay, int period);
+
+// stop a timer
+void timer_wheel_stop(int timer);
+
+// check if a timer is running - 1 = running, 0 = stopped
+int timer_wheel_is_running(int timer);
+
+#endif
@@ -0,0 +1,238 @@
+/*
+ * K65 Phenol Mixer - Telemetry Decoder
+ *
+ * Copyright 2015: Andrew Kilpatrick
+ * Written by: Andrew Kilpatrick
+ *
+ * Host tool - decodes the telemetry frames from telem.c and prints them.
+ *
+ * Build from the k65-mixer directory:
+ *	gcc -o telem_dump tools/telem_dump.c
+ *
+ * Run with the raw MIDI device for the USB port - eg. /dev/snd/midiC1D0
+ * on Linux - or a file with a capture of the MIDI bytes:
+ *	./telem_dump -rate 50 /dev/snd/midiC1D0  - turn on 50ms frames and print
+ *	./telem_dump -csv capture.syx  - print a capture as CSV
+ *
+ * Options:
+ *	-rate ms  - send the set rate message first - 0 = off
+ *	-csv  - print CSV instead of text
+ *	-all  - print every frame - otherwise only frames that changed
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include "../telem.h"
+
+#define TELEM_DUMP_DEV_ID 0x48  // K65 device code
+#define TELEM_DUMP_BUF_SIZE 256
+
+// field names - in telem.h order
+const char *telem_dump_names[TELEM_NUM_FIELDS] = {
+	"master", "delay_time", "delay_mix", "in1", "in2", "pan1", "dc_in", "pan2",
+	"peak_l", "peak_r", "seq_state", "tempo_x10", "clock_int",
+	"rx_din", "rx_usb", "tx_din", "tx_usb",
+	"load_t1", "load_uart2", "load_spi1",
+	"max_us_t1", "max_us_uart2", "max_us_spi1", "drops", "store_fails"
+};
+
+// settings
+int telem_dump_csv = 0;
+int telem_dump_all = 0;
+
+// state
+unsigned char telem_dump_msg[TELEM_DUMP_BUF_SIZE];  // sysex being received
+int telem_dump_len;  // sysex length - -1 if not in a sysex
+int telem_dump_vals[TELEM_NUM_FIELDS];  // decoded field values
+int telem_dump_synced;  // 1 = the values are good
+int telem_dump_next_seq;  // expected seq of the next frame
+long telem_dump_frames;  // frames decoded
+long telem_dump_lost;  // frames lost
+struct timespec telem_dump_start;  // time the tool was started
+
+// local functions
+void telem_dump_byte(unsigned char b);
+void telem_dump_frame(unsigned char *msg, int len);
+void telem_dump_print(int changed);
+int telem_dump_send_rate(int fd, int period);
+void telem_dump_usage(void);
+
+// main
+int main(int argc, char **argv) {
+	unsigned char buf[TELEM_DUMP_BUF_SIZE];
+	const char *path = NULL;
+	int i, fd, n, period = -1;
+	for(i = 1; i < argc; i ++) {
+		if(strcmp(argv[i], "-csv") == 0) {
+			telem_dump_csv = 1;
+		}
+		else if(strcmp(argv[i], "-all") == 0) {
+			telem_dump_all = 1;
+		}
+		else if(strcmp(argv[i], "-rate") == 0 && i + 1 < argc) {
+			period = atoi(argv[++ i]);
+		}
+		else if(argv[i][0] != '-' && path == NULL) {
+			path = argv[i];
+		}
+		else {
+			telem_dump_usage();
+			return 1;
+		}
+	}
+	if(path == NULL || period > 16383) {
+		telem_dump_usage();
+		return 1;
+	}
+	fd = open(path, period >= 0 ? O_RDWR : O_RDONLY);
+	if(fd < 0) {
+		perror(path);
+		return 1;
+	}
+	if(period >= 0 && !telem_dump_send_rate(fd, period)) {
+		perror(path);
+		return 1;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &telem_dump_start);
+	telem_dump_len = -1;
+	if(telem_dump_csv) {
+		printf("time_ms,seq");
+		for(i = 0; i < TELEM_NUM_FIELDS; i ++) {
+			printf(",%s", telem_dump_names[i]);
+		}
+		printf("\n");
+	}
+	while((n = read(fd, buf, sizeof(buf))) > 0) {
+		for(i = 0; i < n; i ++) {
+			telem_dump_byte(buf[i]);
+		}
+		fflush(stdout);
+	}
+	fprintf(stderr, "telem_dump: %ld frames - %ld lost\n", telem_dump_frames, telem_dump_lost);
+	close(fd);
+	return 0;
+}
+
+// handle a received MIDI byte
+void telem_dump_byte(unsigned char b) {
+	// realtime messages can be mixed in with sysex
+	if(b >= 0xf8) {
+		return;
+	}
+	if(b == 0xf0) {
+		telem_dump_len = 0;
+	}
+	else if(b == 0xf7) {
+		if(telem_dump_len > 0) {
+			telem_dump_frame(telem_dump_msg, telem_dump_len);
+		}
+		telem_dump_len = -1;
+	}
+	// any other status byte ends the sysex
+	else if(b & 0x80) {
+		telem_dump_len = -1;
+	}
+	else if(telem_dump_len >= 0 && telem_dump_len < TELEM_DUMP_BUF_SIZE) {
+		telem_dump_msg[telem_dump_len ++] = b;
+	}
+}
+
+// decode a sysex message - data after F0
+void telem_dump_frame(unsigned char *msg, int len) {
+	int i, pos, seq, key, shift, changed;
+	unsigned int zz;
+	if(len < TELEM_HEADER_LEN + TELEM_BITMAP_BYTES || msg[0] != 0x00 ||
+			msg[1] != 0x01 || msg[2] != 0x72 || msg[3] != TELEM_DUMP_DEV_ID ||
+			msg[4] != TELEM_CMD_FRAME) {
+		return;
+	}
+	seq = msg[5];
+	key = msg[6] & TELEM_FLAG_KEY;
+
+	// check for lost frames - deltas can't be used until the next key frame
+	if(telem_dump_frames > 0 && seq != telem_dump_next_seq) {
+		telem_dump_lost += (seq - telem_dump_next_seq) & 0x7f;
+		telem_dump_synced = 0;
+	}
+	telem_dump_next_seq = (seq + 1) & 0x7f;
+	telem_dump_frames ++;
+	if(key) {
+		telem_dump_synced = 1;
+		for(i = 0; i < TELEM_NUM_FIELDS; i ++) {
+			telem_dump_vals[i] = 0;
+		}
+	}
+
+	// apply the deltas
+	pos = TELEM_HEADER_LEN + TELEM_BITMAP_BYTES;
+	changed = 0;
+	for(i = 0; i < TELEM_NUM_FIELDS; i ++) {
+		if(!(msg[TELEM_HEADER_LEN + (i / 7)] & (1 << (i % 7)))) {
+			continue;
+		}
+		zz = 0;
+		shift = 0;
+		do {
+			if(pos >= len || shift > 12) {
+				fprintf(stderr, "telem_dump: bad frame %d\n", seq);
+				telem_dump_synced = 0;
+				return;
+			}
+			zz |= (msg[pos] & 0x3f) << shift;
+			shift += 6;
+		} while(msg[pos ++] & 0x40);
+		telem_dump_vals[i] += (int)(zz >> 1) ^ -(int)(zz & 1);
+		changed = 1;
+	}
+	if(telem_dump_synced && (changed || telem_dump_all)) {
+		telem_dump_print(seq);
+	}
+}
+
+// print the current values
+void telem_dump_print(int seq) {
+	struct timespec now;
+	long ms;
+	int i;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	ms = ((now.tv_sec - telem_dump_start.tv_sec) * 1000) +
+		((now.tv_nsec - telem_dump_start.tv_nsec) / 1000000);
+	if(telem_dump_csv) {
+		printf("%ld,%d", ms, seq);
+		for(i = 0; i < TELEM_NUM_FIELDS; i ++) {
+			printf(",%d", telem_dump_vals[i]);
+		}
+		printf("\n");
+		return;
+	}
+	printf("%8ld.%03ld #%-3d", ms / 1000, ms % 1000, seq);
+	for(i = 0; i < TELEM_NUM_FIELDS; i ++) {
+		printf(" %s=%d", telem_dump_names[i], telem_dump_vals[i]);
+	}
+	printf("\n");
+}
+
+// send the set rate message - returns 0 on error
+int telem_dump_send_rate(int fd, int period) {
+	unsigned char msg[9];
+	msg[0] = 0xf0;
+	msg[1] = 0x00;
+	msg[2] = 0x01;
+	msg[3] = 0x72;
+	msg[4] = TELEM_DUMP_DEV_ID;
+	msg[5] = TELEM_CMD_SET_RATE;
+	msg[6] = period & 0x7f;
+	msg[7] = (period >> 7) & 0x7f;
+	msg[8] = 0xf7;
+	return write(fd, msg, sizeof(msg)) == sizeof(msg);
+}
+
+// show the usage
+void telem_dump_usage(void) {
+	fprintf(stderr, "usage: telem_dump [-rate ms] [-csv] [-all] device|file\n");
+}
@@ -9,16 +9,19 @@
 #include "voice.h"
 //#include "config_store.h"
 #include "cv_gate_ctrl.h"
+#include "seq_store.h"
 
 // settings
 unsigned char voice_mode;  // the voice mode
 unsigned char voice_split;  // split point
 unsigned char voice_unit;  // voice unit number
-int voice_bend1_interval;  // the total CV1 bend steps
-int voice_bend2_interval;  // the total CV2 bend steps
+unsigned char voice_units;  // number of chained units in poly mode
+int voice_bend1_range;  // the total CV1 bend in DAC steps
+int voice_bend2_range;  // the total CV2 bend in DAC steps
+#define VOICE_BEND_OUT(bend, range) (((bend) * (range) + 0x1000) >> 13)  // rounded DAC steps
 
-#define NOTE_MONO_MAX 8
 #define NOTE_POLY_MAX 16
+#define VOICE_NOTE_NONE 0xff
 
 #define VOICE_RETRIG_START 2
 #define VOICE_RETRIG_STOP 1
@@ -36,10 +39,12 @@ unsigned char voice2_retrig_note;  // the note to retrig
 int voice1_transpose;  // transpose up or down
 int voice2_transpose;  // transpose up or down
 // single and split mode
-unsigned char voice1_mono_prio[NOTE_MONO_MAX];
-unsigned char voice2_mono_prio[NOTE_MONO_MAX];
-unsigned char voice1_mono_pos;
-unsigned char voice2_mono_pos;
+unsigned char voice_prio;  // note priority
+unsigned int voice_held[2][4];  // held notes - 1 bit per note
+unsigned char voice_held_prev[2][128];  // next older held note - held notes only
+unsigned char voice_held_next[2][128];  // next newer held note - held notes only
+unsigned char voice_held_last[2];  // most recently held note
+unsigned char voice_held_first[2];  // least recently held note
 unsigned char voice1_mono_keypressed;
 unsigned char voice2_mono_keypressed;
 unsigned char voice1_playing;
@@ -47,26 +52,64 @@ unsigned char voice2_playing;
 // poly mode
 unsigned char note_poly_slots[NOTE_POLY_MAX];
 unsigned char note_poly_hold[NOTE_POLY_MAX];
+unsigned int note_poly_time[NOTE_POLY_MAX];  // when each slot was assigned
+unsigned int voice_poly_count;  // note on counter for slot ages
+unsigned char voice_poly_next;  // next slot to try
+// arp mode
+unsigned char voice_arp_order;  // note order
+unsigned char voice_arp_octaves;  // octave range - 1-4
+unsigned char voice_arp_rate;  // clock ticks per step
+unsigned char voice_arp_gate;  // gate length - 0-127 = 0-100% of the step
+unsigned char voice_arp_gate_ticks;  // gate length in clock ticks
+unsigned char voice_arp_count;  // clock ticks since the last step
+unsigned char voice_arp_note;  // the current held note
+unsigned char voice_arp_oct;  // the current octave
+unsigned int voice_arp_sustain[4];  // notes released while the damper is down
+unsigned int voice_arp_rand;  // random order state
 
 // function prototypes
 void voice_arp_note_on(unsigned char note);
 void voice_arp_note_off(unsigned char note);
+void voice_arp_release_sustain(void);
+void voice_arp_reset(void);
+unsigned char voice_arp_next(void);
 void voice_poly_note_on(unsigned char note);
 void voice_poly_note_off(unsigned char note);
+unsigned char voice_poly_oldest(unsigned char num_slots);
 void voice_mono_note_on(unsigned char voice, unsigned char note);
 void voice_mono_note_off(unsigned char voice, unsigned char note);
+void voice_held_on(unsigned char voice, unsigned char note);
+void voice_held_off(unsigned char voice, unsigned char note);
+void voice_held_clear(unsigned char voice);
+unsigned char voice_held_above(unsigned char voice, unsigned char note);
+unsigned char voice_held_below(unsigned char voice, unsigned char note);
+unsigned char voice_held_pick(unsigned char voice);
 void voice_output_ctrl(unsigned char voice, unsigned char note, unsigned char on);
+void voice_apply_mode(unsigned char mode, unsigned char split);
+void voice_apply_unit(unsigned char unit);
+void voice_apply_units(unsigned char units);
 
 // init the voice manager code
 void voice_init(void) {
 	// load the config from flash memory
 //	voice_set_mode(config_store_get_val(CONFIG_VOICE_MODE),//			config_store_get_val(CONFIG_VOICE_SPLIT));//	voice_set_unit(config_store_get_val(CONFIG_VOICE_UNIT));//	voice_set_pitch_bend_range(0, config_store_get_val(CONFIG_VOICE_BEND1));//	voice_set_pitch_bend_range(1, config_store_get_val(CONFIG_VOICE_BEND2));
 
+	// saved settings - not saved back so flash is only written when
+	// the user changes a setting
+	voice_apply_units(seq_store_get_setting(SEQ_STORE_SETTING_VOICE_UNITS, 1));
+	voice_apply_unit(seq_store_get_setting(SEQ_STORE_SETTING_VOICE_UNIT, 0));
+	voice_apply_mode(seq_store_get_setting(SEQ_STORE_SETTING_VOICE_MODE,
+		VOICE_MODE_SINGLE), 60);
+
 	// fixed settings
-	voice_set_mode(VOICE_MODE_SINGLE, 60);
-	voice_set_unit(0);
 	voice_set_pitch_bend_range(0, 2);
 	voice_set_pitch_bend_range(1, 2);
+	voice_set_priority(VOICE_PRIO_LAST);
+	voice_set_arp_order(VOICE_ARP_UP);
+	voice_set_arp_octaves(1);
+	voice_set_arp_rate(6);
+	voice_set_arp_gate(64);
+	voice_arp_rand = 1;
 
 	// reset everything
 	voice1_cur = 60;  // make sure we reset to this note
@@ -101,39 +144,35 @@ void voice_timer_task(void) {
 
 // sets up a voice mode
 void voice_set_mode(unsigned char mode, unsigned char split) {
-	if(mode == VOICE_MODE_SPLIT) {
-		voice_mode = mode;
-		voice_split = split & 0x7f;
-	}
-	else if(mode == VOICE_MODE_POLY) {
-		voice_mode = mode;
-		voice_split = 0;
-	}
-	else if(mode == VOICE_MODE_ARP) {
-		voice_mode = mode;
-		voice_split = 0;
-	}
-	else if(mode == VOICE_MODE_VELO) {
-		voice_mode = mode;
-		voice_split = 0;
-	}
-	else {
-		voice_mode = VOICE_MODE_SINGLE;
-		voice_split = 0;
-	}
+	voice_apply_mode(mode, split);
 //	// store settings to flash memory
 //	config_store_set_val(CONFIG_VOICE_MODE, voice_mode);
 //	config_store_set_val(CONFIG_VOICE_SPLIT, voice_split);
-	voice_state_reset();
+	seq_store_set_setting(SEQ_STORE_SETTING_VOICE_MODE, voice_mode);
 }
 
 // set up the voice unit
 void voice_set_unit(unsigned char unit) {
-	voice_unit = unit;
-	if(voice_unit > 7) voice_unit = 7;
+	voice_apply_unit(unit);
 //	// store settings to flash memory
 //	config_store_set_val(CONFIG_VOICE_UNIT, voice_unit);
-	voice_state_reset();
+	seq_store_set_setting(SEQ_STORE_SETTING_VOICE_UNIT, voice_unit);
+}
+
+// get the voice unit
+unsigned char voice_get_unit(void) {
+	return voice_unit;
+}
+
+// set the number of chained units for poly mode
+void voice_set_units(unsigned char units) {
+	voice_apply_units(units);
+	seq_store_set_setting(SEQ_STORE_SETTING_VOICE_UNITS, voice_units);
+}
+
+// get the number of chained units for poly mode
+unsigned char voice_get_units(void) {
+	return voice_units;
 }
 
 // set the pitch bend up amount
@@ -144,15 +183,83 @@ void voice_set_pitch_bend_range(unsigned char voice, unsigned char bend) {
 	if(voice) {
 //		// store settings to flash memory
 //		config_store_set_val(CONFIG_VOICE_BEND2, bend_semi);
-		voice_bend2_interval = 8192 / (bend_semi * NOTE_STEP_SIZE);
+		voice_bend2_range = bend_semi * NOTE_STEP_SIZE;
 	}
 	else {
 //		// store settings to flash memory
 //		config_store_set_val(CONFIG_VOICE_BEND1, bend_semi);
-		voice_bend1_interval = 8192 / (bend_semi * NOTE_STEP_SIZE);
+		voice_bend1_range = bend_semi * NOTE_STEP_SIZE;
 	}
 }
 
+// set the note priority for single and split mode
+void voice_set_priority(unsigned char prio) {
+	if(prio > VOICE_PRIO_LOW) prio = VOICE_PRIO_LAST;
+	voice_prio = prio;
+}
+
+// set the arp note order
+void voice_set_arp_order(unsigned char order) {
+	if(order > VOICE_ARP_PLAYED) order = VOICE_ARP_UP;
+	voice_arp_order = order;
+}
+
+// set the arp octave range - 1-4
+void voice_set_arp_octaves(unsigned char octaves) {
+	if(octaves < 1) octaves = 1;
+	if(octaves > 4) octaves = 4;
+	voice_arp_octaves = octaves;
+	if(voice_arp_oct >= voice_arp_octaves) voice_arp_oct = 0;
+}
+
+// set the arp rate in clock ticks per step - 1-96
+void voice_set_arp_rate(unsigned char ticks) {
+	if(ticks < 1) ticks = 1;
+	if(ticks > 96) ticks = 96;
+	voice_arp_rate = ticks;
+	voice_set_arp_gate(voice_arp_gate);
+	// not running yet - first step on the next tick
+	if(voice_arp_note == VOICE_NOTE_NONE) voice_arp_count = voice_arp_rate - 1;
+}
+
+// set the arp gate length - 0-127 = 0-100% of the step
+void voice_set_arp_gate(unsigned char gate) {
+	voice_arp_gate = gate & 0x7f;
+	voice_arp_gate_ticks = (voice_arp_rate * (voice_arp_gate + 1)) >> 7;
+	if(voice_arp_gate_ticks < 1) voice_arp_gate_ticks = 1;
+	// full length - tie the steps together
+	if(voice_arp_gate_ticks >= voice_arp_rate) voice_arp_gate_ticks = 0;
+}
+
+// run the arp - call on every sequencer clock tick
+void voice_clock_tick(void) {
+	unsigned char note;
+	if(voice_mode != VOICE_MODE_ARP) return;
+
+	// end of the gate
+	voice_arp_count ++;
+	if(voice_arp_count == voice_arp_gate_ticks && voice1_playing) {
+		voice_output_ctrl(0, voice1_cur, 0);
+	}
+	if(voice_arp_count < voice_arp_rate) return;
+
+	// next step
+	voice_arp_count = 0;
+	note = voice_arp_next();
+	voice_arp_note = note;
+	// no notes held - start over on the next note on
+	if(note == VOICE_NOTE_NONE) {
+		if(voice1_playing) voice_output_ctrl(0, voice1_cur, 0);
+		voice_arp_count = voice_arp_rate - 1;
+		return;
+	}
+	note += voice_arp_oct * 12;
+	while(note > NOTE_HIGH) note -= 12;
+	// tied steps on the same note need a retrigger
+	if(voice1_playing && voice1_cur == note) voice1_retrig = VOICE_RETRIG_START;
+	voice_output_ctrl(0, note, 1);
+}
+
 // set the note offset (transpose) for generating pitches
 void voice_set_transpose(unsigned char voice, int transpose) {
 	if(voice) {
@@ -239,10 +346,7 @@ void voice_all_notes_off(unsigned char voice) {
 	    voice2_retrig = VOICE_RETRIG_IDLE;
     
 	    // clear note stuff
-	    for(i = 0; i < NOTE_MONO_MAX; i ++) {
-		    voice2_mono_prio[i] = 0;
-    	}
-	    voice2_mono_pos = 0;
+	    voice_held_clear(1);
 	    voice2_mono_keypressed = 0;
 	    voice2_playing = 0;
 
@@ -256,10 +360,8 @@ void voice_all_notes_off(unsigned char voice) {
 	    voice1_retrig = VOICE_RETRIG_IDLE;
     
 	    // clear note stuff
-	    for(i = 0; i < NOTE_MONO_MAX; i ++) {
-		    voice1_mono_prio[i] = 0;
-    	}
-	    voice1_mono_pos = 0;
+	    voice_held_clear(0);
+	    voice_arp_reset();
 	    voice1_mono_keypressed = 0;
 	    voice1_playing = 0;
 
@@ -272,7 +374,10 @@ void voice_all_notes_off(unsigned char voice) {
 	    for(i = 0; i < NOTE_POLY_MAX; i ++) {
 		    note_poly_slots[i] = 0;
 		    note_poly_hold[i] = 0;
+		    note_poly_time[i] = 0;
 	    }
+	    voice_poly_count = 0;
+	    voice_poly_next = 0;
     }
 }
 
@@ -356,22 +461,7 @@ void voice_damper(unsigned char voice, unsigned char state) {
 		else {
 			damper1 = 0;
 			damper2 = 0;
-			// notes are still playing
-			if(voice1_cur || voice2_cur) {
-				// no keys are held
-				if(!voice1_mono_keypressed && !voice2_mono_keypressed) {
-					voice_output_ctrl(0, voice1_cur, 0);
-					voice_output_ctrl(1, voice2_cur, 0);
-				}
-				// only voice1 is held
-				else if(voice1_mono_keypressed && !voice2_mono_keypressed) {
-					voice_mono_note_on(1, voice1_cur);
-				}
-				// only voice2 is held
-				else if(voice2_mono_keypressed && !voice1_mono_keypressed) {
-					voice_mono_note_on(0, voice2_cur);
-				}
-			}
+			voice_arp_release_sustain();
 		}
 	}
 }
@@ -385,17 +475,17 @@ void voice_pitch_bend(unsigned char voice, unsigned int bend) {
 	if(voice_mode == VOICE_MODE_POLY || 
 			voice_mode == VOICE_MODE_SPLIT ||
 			voice_mode == VOICE_MODE_ARP) {
-		temp = bend_amount / voice_bend1_interval;
+		temp = VOICE_BEND_OUT(bend_amount, voice_bend1_range);
 		cv_gate_ctrl_bend(0, temp);
 		cv_gate_ctrl_bend(1, temp);
 	}
 	// single mode
 	else if(voice_mode == VOICE_MODE_SINGLE || voice_mode == VOICE_MODE_VELO) {
 		if(voice) {
-			cv_gate_ctrl_bend(1, bend_amount / voice_bend2_interval);
+			cv_gate_ctrl_bend(1, VOICE_BEND_OUT(bend_amount, voice_bend2_range));
 		}
 		else {
-			cv_gate_ctrl_bend(0, bend_amount / voice_bend1_interval);
+			cv_gate_ctrl_bend(0, VOICE_BEND_OUT(bend_amount, voice_bend1_range));
 		}
 	}
 }
@@ -405,75 +495,167 @@ void voice_pitch_bend(unsigned char voice, unsigned int bend) {
 //
 // handle arp mode note on
 void voice_arp_note_on(unsigned char note) {
-	// no voices are playing
-	if(!voice1_playing) {
-		// turn on both voices
-		voice_mono_note_on(0, note);
-		voice_mono_note_on(1, note);
-	}
-	// voice 1 is already playing
-	else {
-		// send new note only to voice 2
-		voice_mono_note_on(1, note);
-	}
+	voice_arp_sustain[note >> 5] &= ~(1 << (note & 0x1f));
+	voice_held_on(0, note);
 }
 
 // handle arp mode note off
 void voice_arp_note_off(unsigned char note) {
-	// if the damper is on
-	// and voice1 and voice2 are playing
-	// and voice1 and voice2 are playing different notes
-	// remove the voice1 note from voice2 list
-	if(damper1 && voice1_playing && voice2_playing && (voice1_cur != voice2_cur)) {
-		voice_mono_note_off(1, voice1_cur);
+	// keep playing the note until the damper is released
+	if(damper1) {
+		voice_arp_sustain[note >> 5] |= (1 << (note & 0x1f));
+		return;
+	}
+	voice_held_off(0, note);
+}
+
+// release all notes that were held by the damper
+void voice_arp_release_sustain(void) {
+	unsigned char i, bit;
+	for(i = 0; i < 4; i ++) {
+		while(voice_arp_sustain[i]) {
+			bit = 31 - __builtin_clz(voice_arp_sustain[i]);
+			voice_arp_sustain[i] &= ~(1 << bit);
+			voice_held_off(0, (i << 5) + bit);
+		}
+	}
+}
+
+// reset the arp to the start of the pattern
+void voice_arp_reset(void) {
+	unsigned char i;
+	for(i = 0; i < 4; i ++) {
+		voice_arp_sustain[i] = 0;
 	}
+	voice_arp_note = VOICE_NOTE_NONE;
+	voice_arp_count = voice_arp_rate - 1;  // first step on the next tick
+}
 
-	// try turning off this note from both voices
-	voice_mono_note_off(0, note);
-	voice_mono_note_off(1, note);
-	// if only voice 2 is now playing, make voice 1 play the same note
-	if(!voice1_playing && voice2_playing) {
-		voice_mono_note_on(0, voice2_cur);
+// work out the next arp note - VOICE_NOTE_NONE if no notes are held
+unsigned char voice_arp_next(void) {
+	unsigned char note = voice_arp_note;
+	switch(voice_arp_order) {
+		case VOICE_ARP_DOWN:
+			if(note != VOICE_NOTE_NONE) {
+				note = voice_held_below(0, note);
+				if(note != VOICE_NOTE_NONE) return note;
+				if(voice_arp_oct) voice_arp_oct --;
+				else voice_arp_oct = voice_arp_octaves - 1;
+			}
+			else {
+				voice_arp_oct = voice_arp_octaves - 1;
+			}
+			return voice_held_below(0, VOICE_NOTE_NONE);
+		case VOICE_ARP_RANDOM:
+			voice_arp_rand ^= voice_arp_rand << 13;
+			voice_arp_rand ^= voice_arp_rand >> 17;
+			voice_arp_rand ^= voice_arp_rand << 5;
+			voice_arp_oct = ((voice_arp_rand >> 8) & 0xff) % voice_arp_octaves;
+			// first held note from a random start point
+			note = voice_held_above(0, (voice_arp_rand & 0x7f) - 1);
+			if(note != VOICE_NOTE_NONE) return note;
+			return voice_held_above(0, VOICE_NOTE_NONE);
+		case VOICE_ARP_PLAYED:
+			// carry on through the order list if our note is still held
+			if(note != VOICE_NOTE_NONE &&
+					(voice_held[0][note >> 5] & (1 << (note & 0x1f)))) {
+				note = voice_held_next[0][note];
+				if(note != VOICE_NOTE_NONE) return note;
+				voice_arp_oct ++;
+				if(voice_arp_oct >= voice_arp_octaves) voice_arp_oct = 0;
+			}
+			else if(note == VOICE_NOTE_NONE) {
+				voice_arp_oct = 0;
+			}
+			return voice_held_first[0];
+		case VOICE_ARP_UP:
+		default:
+			if(note != VOICE_NOTE_NONE) {
+				note = voice_held_above(0, note);
+				if(note != VOICE_NOTE_NONE) return note;
+				voice_arp_oct ++;
+				if(voice_arp_oct >= voice_arp_octaves) voice_arp_oct = 0;
+			}
+			else {
+				voice_arp_oct = 0;
+			}
+			return voice_held_above(0, VOICE_NOTE_NONE);
 	}
 }
 
 // handle poly mode note on
+// - every unit sees the same note stream and runs the same allocation
+//   so all units end up with the same slot table without talking
 void voice_poly_note_on(unsigned char note) {
 	unsigned char i;
 	unsigned char slot = 255;
+	unsigned char num_slots = voice_units << 1;
 	unsigned char voice;
 	unsigned char retrig = 0;
 
-	// check if note is on or find a free slot
-	for(i = 0; i < NOTE_POLY_MAX; i ++) {
-		// note already playing - need to retrig
+	// note already playing - need to retrig
+	for(i = 0; i < num_slots; i ++) {
 		if(note_poly_slots[i] == note) {
 			retrig = 1;
 			slot = i;
 			break;
 		}
-		// slot is available
-		else if(note_poly_slots[i] == 0) {
-			slot = i;
-			break;
+	}
+	// find the next free slot - round robin
+	if(slot == 255) {
+		slot = voice_poly_next;
+		for(i = 0; i < num_slots; i ++) {
+			if(note_poly_slots[slot] == 0) break;
+			slot ++;
+			if(slot >= num_slots) slot = 0;
 		}
 	}
-
-	if(slot != 255) {
-		// assign this slot
-		note_poly_slots[slot] = note;
-		note_poly_hold[slot] = note;
-		// this slot is ours
+	// no free slots - steal the oldest note
+	if(note_poly_slots[slot] && !retrig) {
+		slot = voice_poly_oldest(num_slots);
 		if((slot >> 1) == voice_unit) {
-			voice = slot & 0x01;
-			voice_output_ctrl(voice, note, 1);
-			// we need to retrigger this voice
-			if(retrig) {
-				if(voice) voice2_retrig = VOICE_RETRIG_START;
-				else voice1_retrig = VOICE_RETRIG_START;
-			}
+			retrig = 1;
+		}
+	}
+
+	// assign this slot
+	note_poly_slots[slot] = note;
+	note_poly_hold[slot] = note;
+	note_poly_time[slot] = voice_poly_count ++;
+	voice_poly_next = slot + 1;
+	if(voice_poly_next >= num_slots) voice_poly_next = 0;
+	// this slot is ours
+	if((slot >> 1) == voice_unit) {
+		voice = slot & 0x01;
+		voice_output_ctrl(voice, note, 1);
+		// we need to retrigger this voice
+		if(retrig) {
+			if(voice) voice2_retrig = VOICE_RETRIG_START;
+			else voice1_retrig = VOICE_RETRIG_START;
+		}
+	}
+}
+
+// find the oldest poly slot - notes only held by the damper go first
+unsigned char voice_poly_oldest(unsigned char num_slots) {
+	unsigned char i;
+	unsigned char oldest = 0;
+	unsigned char oldest_free = 255;
+	for(i = 1; i < num_slots; i ++) {
+		if((voice_poly_count - note_poly_time[i]) >
+				(voice_poly_count - note_poly_time[oldest])) {
+			oldest = i;
+		}
+	}
+	for(i = 0; i < num_slots; i ++) {
+		if(note_poly_hold[i]) continue;
+		if(oldest_free == 255 || (voice_poly_count - note_poly_time[i]) >
+				(voice_poly_count - note_poly_time[oldest_free])) {
+			oldest_free = i;
 		}
 	}
+	if(oldest_free != 255) return oldest_free;
+	return oldest;
 }
 
 // handle poly mode note off
@@ -505,57 +687,35 @@ void voice_poly_note_off(unsigned char note) {
 
 // handle mono note on
 void voice_mono_note_on(unsigned char voice, unsigned char note) {
-	unsigned char i;
+	voice_held_on(voice, note);
 	if(voice) {
-		// clear this note if it already exists
-		for(i = 0; i < NOTE_MONO_MAX; i ++) {
-			if(voice2_mono_prio[i] == note) {
-				voice2_mono_prio[i] = 0;
-			}
-		}
+		voice2_mono_keypressed = 1;
+		// a lower priority note doesn't change the output
+		if(voice_held_pick(1) != note) return;
 		if(voice2_cur == note) voice2_retrig = VOICE_RETRIG_START;
-		voice2_mono_pos = (voice2_mono_pos + 1) & 0x07;
-		voice2_mono_prio[voice2_mono_pos] = note;
 		voice_output_ctrl(1, note, 1);
-		voice2_mono_keypressed = 1;	
 	}
 	else {
-		// clear this note if it already exists
-		for(i = 0; i < NOTE_MONO_MAX; i ++) {
-			if(voice1_mono_prio[i] == note) {
-				voice1_mono_prio[i] = 0;
-			}
-		}
+		voice1_mono_keypressed = 1;
+		// a lower priority note doesn't change the output
+		if(voice_held_pick(0) != note) return;
 		if(voice1_cur == note) voice1_retrig = VOICE_RETRIG_START;
-		voice1_mono_pos = (voice1_mono_pos + 1) & 0x07;
-		voice1_mono_prio[voice1_mono_pos] = note;
 		voice_output_ctrl(0, note, 1);
-		voice1_mono_keypressed = 1;
 	}
 }
 
 // handle mono note off
 void voice_mono_note_off(unsigned char voice, unsigned char note) {
-	unsigned char i;
+	unsigned char new_note;
+	voice_held_off(voice, note);
+	new_note = voice_held_pick(voice);
 	if(voice) {
-		// clear this note from the list
-		for(i = 0; i < NOTE_MONO_MAX; i ++) {
-			if(voice2_mono_prio[i] == note) {
-				voice2_mono_prio[i] = 0;
-			}
-		}
-		// if our current note is still active, return
-		if(voice2_mono_prio[voice2_mono_pos]) return;
-		// our current note is off, time to find a new note
-		unsigned char rev_count = (voice2_mono_pos - 1) & 0x07;
-		while(rev_count != voice2_mono_pos) {
-			// we found another active note
-			if(voice2_mono_prio[rev_count]) {
-				voice_output_ctrl(1, voice2_mono_prio[rev_count], 1);
-				voice2_mono_pos = rev_count;
-				return;
-			}
-			rev_count = (rev_count - 1) & 0x07;
+		// another note is still held
+		if(new_note != VOICE_NOTE_NONE) {
+			// our current note is still active
+			if(voice2_playing && voice2_cur == new_note) return;
+			voice_output_ctrl(1, new_note, 1);
+			return;
 		}
 		// no notes were found
 		voice2_mono_keypressed = 0;
@@ -564,24 +724,12 @@ void voice_mono_note_off(unsigned char voice, unsigned char note) {
 		}
 	}
 	else {
-		// clear this note from the list
-		for(i = 0; i < NOTE_MONO_MAX; i ++) {
-			if(voice1_mono_prio[i] == note) {
-				voice1_mono_prio[i] = 0;
-			}
-		}
-		// if our current note is still active, return
-		if(voice1_mono_prio[voice1_mono_pos]) return;
-		// our current note is off, time to find a new note
-		unsigned char rev_count = (voice1_mono_pos - 1) & 0x07;
-		while(rev_count != voice1_mono_pos) {
-			// we found another active note
-			if(voice1_mono_prio[rev_count]) {
-				voice_output_ctrl(0, voice1_mono_prio[rev_count], 1);
-				voice1_mono_pos = rev_count;
-				return;
-			}
-			rev_count = (rev_count - 1) & 0x07;
+		// another note is still held
+		if(new_note != VOICE_NOTE_NONE) {
+			// our current note is still active
+			if(voice1_playing && voice1_cur == new_note) return;
+			voice_output_ctrl(0, new_note, 1);
+			return;
 		}
 		// no notes were found
 		voice1_mono_keypressed = 0;
@@ -591,6 +739,105 @@ void voice_mono_note_off(unsigned char voice, unsigned char note) {
 	}
 }
 
+// add a note to the held notes - it becomes the most recent note
+void voice_held_on(unsigned char voice, unsigned char note) {
+	unsigned char last;
+	note &= 0x7f;
+	voice_held_off(voice, note);
+	voice_held[voice][note >> 5] |= (1 << (note & 0x1f));
+	// link it onto the end of the order list
+	last = voice_held_last[voice];
+	voice_held_prev[voice][note] = last;
+	voice_held_next[voice][note] = VOICE_NOTE_NONE;
+	if(last != VOICE_NOTE_NONE) voice_held_next[voice][last] = note;
+	else voice_held_first[voice] = note;
+	voice_held_last[voice] = note;
+}
+
+// remove a note from the held notes
+void voice_held_off(unsigned char voice, unsigned char note) {
+	unsigned char prev, next;
+	note &= 0x7f;
+	if(!(voice_held[voice][note >> 5] & (1 << (note & 0x1f)))) return;
+	voice_held[voice][note >> 5] &= ~(1 << (note & 0x1f));
+	// unlink it from the order list
+	prev = voice_held_prev[voice][note];
+	next = voice_held_next[voice][note];
+	if(prev != VOICE_NOTE_NONE) voice_held_next[voice][prev] = next;
+	else voice_held_first[voice] = next;
+	if(next != VOICE_NOTE_NONE) voice_held_prev[voice][next] = prev;
+	else voice_held_last[voice] = prev;
+}
+
+// clear all held notes
+void voice_held_clear(unsigned char voice) {
+	unsigned char i;
+	for(i = 0; i < 4; i ++) {
+		voice_held[voice][i] = 0;
+	}
+	voice_held_first[voice] = VOICE_NOTE_NONE;
+	voice_held_last[voice] = VOICE_NOTE_NONE;
+}
+
+// get the lowest held note above a note - VOICE_NOTE_NONE if none
+// - VOICE_NOTE_NONE as the start note finds the lowest held note
+unsigned char voice_held_above(unsigned char voice, unsigned char note) {
+	unsigned int bits;
+	unsigned char i, start;
+	if(note == VOICE_NOTE_NONE) start = 0;
+	else if(note >= 127) return VOICE_NOTE_NONE;
+	else start = note + 1;
+	i = start >> 5;
+	bits = voice_held[voice][i] & (0xffffffff << (start & 0x1f));
+	while(1) {
+		// isolate the lowest set bit
+		if(bits) return (i << 5) + 31 - __builtin_clz(bits & -bits);
+		i ++;
+		if(i == 4) return VOICE_NOTE_NONE;
+		bits = voice_held[voice][i];
+	}
+}
+
+// get the highest held note below a note - VOICE_NOTE_NONE if none
+// - VOICE_NOTE_NONE as the start note finds the highest held note
+unsigned char voice_held_below(unsigned char voice, unsigned char note) {
+	unsigned int bits;
+	signed char i;
+	unsigned char end;
+	if(note == VOICE_NOTE_NONE) end = 127;
+	else if(note == 0) return VOICE_NOTE_NONE;
+	else end = note - 1;
+	i = end >> 5;
+	bits = voice_held[voice][i] & (0xffffffff >> (31 - (end & 0x1f)));
+	while(1) {
+		if(bits) return (i << 5) + 31 - __builtin_clz(bits);
+		i --;
+		if(i < 0) return VOICE_NOTE_NONE;
+		bits = voice_held[voice][i];
+	}
+}
+
+// get the held note with the highest priority - VOICE_NOTE_NONE if none
+// - CLZ is a single instruction so this takes at most 4 steps
+unsigned char voice_held_pick(unsigned char voice) {
+	unsigned int *held = voice_held[voice];
+	int i;
+	if(voice_prio == VOICE_PRIO_HIGH) {
+		for(i = 3; i >= 0; i --) {
+			if(held[i]) return (i << 5) + 31 - __builtin_clz(held[i]);
+		}
+		return VOICE_NOTE_NONE;
+	}
+	if(voice_prio == VOICE_PRIO_LOW) {
+		for(i = 0; i < 4; i ++) {
+			// isolate the lowest set bit
+			if(held[i]) return (i << 5) + 31 - __builtin_clz(held[i] & -held[i]);
+		}
+		return VOICE_NOTE_NONE;
+	}
+	return voice_held_last[voice];
+}
+
 // voice output control
 void voice_output_ctrl(unsigned char voice, unsigned char note, unsigned char on) {
 	if(voice == 1) {
@@ -617,6 +864,46 @@ void voice_output_ctrl(unsigned char voice, unsigned char note, unsigned char on
 	}
 }
 
+// set the voice mode without saving it
+void voice_apply_mode(unsigned char mode, unsigned char split) {
+	if(mode == VOICE_MODE_SPLIT) {
+		voice_mode = mode;
+		voice_split = split & 0x7f;
+	}
+	else if(mode == VOICE_MODE_POLY) {
+		voice_mode = mode;
+		voice_split = 0;
+	}
+	else if(mode == VOICE_MODE_ARP) {
+		voice_mode = mode;
+		voice_split = 0;
+	}
+	else if(mode == VOICE_MODE_VELO) {
+		voice_mode = mode;
+		voice_split = 0;
+	}
+	else {
+		voice_mode = VOICE_MODE_SINGLE;
+		voice_split = 0;
+	}
+	voice_state_reset();
+}
+
+// set the voice unit without saving it
+void voice_apply_unit(unsigned char unit) {
+	voice_unit = unit;
+	if(voice_unit > 7) voice_unit = 7;
+	voice_state_reset();
+}
+
+// set the number of chained units without saving it
+void voice_apply_units(unsigned char units) {
+	voice_units = units;
+	if(voice_units < 1) voice_units = 1;
+	if(voice_units > (NOTE_POLY_MAX >> 1)) voice_units = NOTE_POLY_MAX >> 1;
+	voice_state_reset();
+}
+
 // reset all voice state 
 void voice_state_reset(void) {
 	unsigned char i;
@@ -627,18 +914,18 @@ void voice_state_reset(void) {
 	voice2_retrig = VOICE_RETRIG_IDLE;
 
 	// clear note stuff
-	for(i = 0; i < NOTE_MONO_MAX; i ++) {
-		voice1_mono_prio[i] = 0;
-		voice2_mono_prio[i] = 0;
-	}
-	voice1_mono_pos = 0;
-	voice2_mono_pos = 0;
+	voice_held_clear(0);
+	voice_held_clear(1);
+	voice_arp_reset();
 	voice1_mono_keypressed = 0;
 	voice2_mono_keypressed = 0;
 	for(i = 0; i < NOTE_POLY_MAX; i ++) {
 		note_poly_slots[i] = 0;
 		note_poly_hold[i] = 0;
+		note_poly_time[i] = 0;
 	}
+	voice_poly_count = 0;
+	voice_poly_next = 0;
 	voice1_playing = 0;
 	voice2_playing = 0;
 
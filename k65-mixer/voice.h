@@ -11,6 +11,17 @@
 #define VOICE_MODE_ARP 3
 #define VOICE_MODE_VELO 4
 
+// note priority for single and split mode
+#define VOICE_PRIO_LAST 0
+#define VOICE_PRIO_HIGH 1
+#define VOICE_PRIO_LOW 2
+
+// arp note orders
+#define VOICE_ARP_UP 0
+#define VOICE_ARP_DOWN 1
+#define VOICE_ARP_RANDOM 2
+#define VOICE_ARP_PLAYED 3
+
 // init the voice manager
 void voice_init(void);
 
@@ -23,9 +34,36 @@ void voice_set_mode(unsigned char mode, unsigned char split);
 // set up the voice unit
 void voice_set_unit(unsigned char unit);
 
+// get the voice unit
+unsigned char voice_get_unit(void);
+
+// set the number of chained units for poly mode - 1-8
+void voice_set_units(unsigned char units);
+
+// get the number of chained units for poly mode
+unsigned char voice_get_units(void);
+
 // set the pitch bend range for a voice
 void voice_set_pitch_bend_range(unsigned char voice, unsigned char bend);
 
+// set the note priority for single and split mode
+void voice_set_priority(unsigned char prio);
+
+// set the arp note order
+void voice_set_arp_order(unsigned char order);
+
+// set the arp octave range - 1-4
+void voice_set_arp_octaves(unsigned char octaves);
+
+// set the arp rate in clock ticks per step - 1-96
+void voice_set_arp_rate(unsigned char ticks);
+
+// set the arp gate length - 0-127 = 0-100% of the step
+void voice_set_arp_gate(unsigned char gate);
+
+// run the arp - call on every sequencer clock tick
+void voice_clock_tick(void);
+
 // set the note offset (transpose) for generating pitches
 void voice_set_transpose(unsigned char voice, int transpose);
 
@@ -0,0 +1,520 @@
+// envelope segment curve lookup - bend 4 - made by tools/table_gen.c
+// value << 16 | rise to the next entry - value is 4095 << 4 at the top
+unsigned int env_curve_exp[] = {
+19	,
+1245204	,
+2555924	,
+3866644	,
+5177364	,
+6488085	,
+7864341	,
+9240598	,
+10682390	,
+12124182	,
+13565974	,
+15007767	,
+16515095	,
+18022424	,
+19595288	,
+21168152	,
+22741017	,
+24379417	,
+26017818	,
+27721753	,
+29360155	,
+31129626	,
+32833564	,
+34668571	,
+36438044	,
+38273053	,
+40173597	,
+42074141	,
+43974686	,
+45940766	,
+47906847	,
+49938463	,
+51970080	,
+54067232	,
+56164385	,
+58327073	,
+60489762	,
+62717986	,
+64946211	,
+67239971	,
+69533732	,
+71893029	,
+74317861	,
+76742694	,
+79233062	,
+81723431	,
+84279335	,
+86835240	,
+89456681	,
+92143658	,
+94896170	,
+97648682	,
+100401196	,
+103284780	,
+106168365	,
+109117485	,
+112066606	,
+115081263	,
+118161456	,
+121307184	,
+124452913	,
+127664178	,
+130940979	,
+134283315	,
+137625653	,
+141099061	,
+144572470	,
+148111415	,
+151715895	,
+155320377	,
+159055930	,
+162857018	,
+166658107	,
+170524732	,
+174456894	,
+178520126	,
+182583359	,
+186712128	,
+190906433	,
+195166274	,
+199491651	,
+203882565	,
+208404549	,
+212926534	,
+217514056	,
+222232649	,
+227016777	,
+231800907	,
+236716109	,
+241762381	,
+246808654	,
+251920464	,
+257163345	,
+262471763	,
+267911251	,
+273350741	,
+278921302	,
+284557400	,
+290324569	,
+296157274	,
+302055516	,
+308084830	,
+314245214	,
+320405601	,
+326762593	,
+333119588	,
+339673189	,
+346292326	,
+352977000	,
+359792746	,
+366739563	,
+373751917	,
+380895343	,
+388169840	,
+395509875	,
+403046516	,
+410648694	,
+418381944	,
+426246265	,
+434176124	,
+442302589	,
+450494592	,
+458883201	,
+467337348	,
+475988102	,
+484769927	,
+493617290	,
+502661260	,
+511836302	,
+521142417	,
+530645139	,
+540278933	,
+550043799	,
+559939738	,
+570032284	,
+580255903	,
+590676129	,
+601227428	,
+611975334	,
+622854313	,
+633929900	,
+645202094	,
+656605361	,
+668205236	,
+680001718	,
+691929274	,
+704118972	,
+716439744	,
+729022658	,
+741736646	,
+754712776	,
+767819980	,
+781189327	,
+794755282	,
+808517846	,
+822542553	,
+836763868	,
+851181792	,
+865861859	,
+880738535	,
+895877354	,
+911212783	,
+926875890	,
+942735605	,
+958791930	,
+975175934	,
+991822081	,
+1008664838	,
+1025835273	,
+1043202318	,
+1060897043	,
+1078919446	,
+1097138459	,
+1115685151	,
+1134493988	,
+1153630505	,
+1173094701	,
+1192821042	,
+1212875062	,
+1233191228	,
+1253900608	,
+1274872134	,
+1296236875	,
+1317929296	,
+1339949397	,
+1362297178	,
+1384972641	,
+1408106853	,
+1431503211	,
+1455292785	,
+1479475575	,
+1504051581	,
+1529020802	,
+1554317705	,
+1580073359	,
+1606222229	,
+1632764316	,
+1659765154	,
+1687159209	,
+1715012015	,
+1743258038	,
+1771962813	,
+1801126340	,
+1830748619	,
+1860829651	,
+1891434969	,
+1922433506	,
+1954021864	,
+1986003441	,
+2018574840	,
+2051604992	,
+2085159433	,
+2119303696	,
+2153906713	,
+2189099553	,
+2224816682	,
+2261123635	,
+2298020411	,
+2335441477	,
+2373517901	,
+2412118615	,
+2451374688	,
+2491220586	,
+2531721844	,
+2572878461	,
+2614624904	,
+2657092242	,
+2700214940	,
+2743992998	,
+2788426418	,
+2833646268	,
+2879521479	,
+2926117586	,
+2973434590	,
+3021538025	,
+3070362357	,
+3119973121	,
+3170370317	,
+3221553946	,
+3273589542	,
+3326411570	,
+3380020032	,
+3434545996	,
+3489858394	,
+3546088295	,
+3603170165	,
+3661169539	,
+3720086418	,
+3779986335	,
+3840738222	,
+3902473149	,
+3965191116	,
+4028892124	,
+4093641707	,
+4159374330	,
+4226089995	,
+4293918720	
+};
+unsigned int env_curve_log[] = {
+1035	,
+67830778	,
+134546411	,
+200279004	,
+265028556	,
+328729533	,
+391447470	,
+453182367	,
+513934226	,
+573834115	,
+632750965	,
+690750311	,
+747832154	,
+804062028	,
+859374400	,
+913900338	,
+967508774	,
+1020330778	,
+1072366349	,
+1123549953	,
+1173947125	,
+1223557865	,
+1272382174	,
+1320485586	,
+1367802567	,
+1414398652	,
+1460273842	,
+1505493670	,
+1549927068	,
+1593705106	,
+1636827784	,
+1679295101	,
+1721041524	,
+1762198122	,
+1802699360	,
+1842545239	,
+1881801293	,
+1920401989	,
+1958478395	,
+1995899443	,
+2032796202	,
+2069103137	,
+2104820249	,
+2140013072	,
+2174616073	,
+2208760320	,
+2242314744	,
+2275344881	,
+2307916264	,
+2339897826	,
+2371486169	,
+2402484691	,
+2433089995	,
+2463171012	,
+2492793277	,
+2521956790	,
+2550661551	,
+2578907561	,
+2606760354	,
+2634154396	,
+2661155221	,
+2687697295	,
+2713846153	,
+2739601794	,
+2764898685	,
+2789867895	,
+2814443889	,
+2838626667	,
+2862416229	,
+2885812577	,
+2908946778	,
+2931622229	,
+2953970000	,
+2975990091	,
+2997682502	,
+3019047232	,
+3040018748	,
+3060728118	,
+3081044274	,
+3101098285	,
+3120824617	,
+3140288804	,
+3159425311	,
+3178234139	,
+3196780822	,
+3214999827	,
+3233022222	,
+3250716937	,
+3268083974	,
+3285254401	,
+3302097150	,
+3318743290	,
+3335127285	,
+3351183602	,
+3367043311	,
+3382706410	,
+3398041831	,
+3413180643	,
+3428057312	,
+3442737372	,
+3457155289	,
+3471376598	,
+3485401298	,
+3499163855	,
+3512729804	,
+3526099144	,
+3539206342	,
+3552182466	,
+3564896448	,
+3577479356	,
+3589800122	,
+3601989814	,
+3613917364	,
+3625713841	,
+3637313710	,
+3648716972	,
+3659989161	,
+3671064742	,
+3681943716	,
+3692691617	,
+3703242911	,
+3713663132	,
+3723886746	,
+3733979287	,
+3743875221	,
+3753640083	,
+3763273873	,
+3772776590	,
+3782082700	,
+3791257738	,
+3800301703	,
+3809149062	,
+3817930884	,
+3826581633	,
+3835035776	,
+3843424381	,
+3851616380	,
+3859742841	,
+3867672696	,
+3875537014	,
+3883270260	,
+3890872435	,
+3898409072	,
+3905749103	,
+3913023597	,
+3920167019	,
+3927179370	,
+3934126184	,
+3940941926	,
+3947626597	,
+3954245732	,
+3960799329	,
+3967156321	,
+3973513310	,
+3979673694	,
+3985834076	,
+3991863386	,
+3997761625	,
+4003594328	,
+4009361494	,
+4014997589	,
+4020568147	,
+4026007635	,
+4031447121	,
+4036755536	,
+4041998414	,
+4047110221	,
+4052156493	,
+4057202763	,
+4062117961	,
+4066902089	,
+4071686216	,
+4076404806	,
+4080992325	,
+4085514309	,
+4090036291	,
+4094427202	,
+4098752577	,
+4103012416	,
+4107206719	,
+4111335486	,
+4115398718	,
+4119461948	,
+4123394107	,
+4127260730	,
+4131061818	,
+4134862905	,
+4138598455	,
+4142202935	,
+4145807414	,
+4149346357	,
+4152819765	,
+4156293171	,
+4159635507	,
+4162977842	,
+4166254641	,
+4169465904	,
+4172611632	,
+4175757359	,
+4178837550	,
+4181852205	,
+4184801325	,
+4187750444	,
+4190634028	,
+4193517610	,
+4196270122	,
+4199022634	,
+4201775145	,
+4204462120	,
+4207083559	,
+4209639463	,
+4212195366	,
+4214685734	,
+4217176101	,
+4219600933	,
+4222025764	,
+4224385059	,
+4226678819	,
+4228972578	,
+4231200802	,
+4233429025	,
+4235591713	,
+4237754400	,
+4239851552	,
+4241948703	,
+4243980319	,
+4246011934	,
+4247978014	,
+4249944093	,
+4251844637	,
+4253745181	,
+4255645724	,
+4257480731	,
+4259250204	,
+4261085210	,
+4262789147	,
+4264558617	,
+4266197018	,
+4267900953	,
+4269539353	,
+4271177752	,
+4272750616	,
+4274323480	,
+4275896343	,
+4277403671	,
+4278910998	,
+4280352790	,
+4281794582	,
+4283236374	,
+4284678165	,
+4286054421	,
+4287430676	,
+4288741396	,
+4290052116	,
+4291362836	,
+4292673555	,
+4293918720	
+};
@@ -1,3 +1,4 @@
+// envelope time lookup - 10s longest ramp - power 2 - 10000Hz sample rate - made by tools/table_gen.c
 unsigned int env_freq_table[] = {
 175921860	,
 78187494	,
@@ -255,4 +256,4 @@ unsigned int env_freq_table[] = {
 10822	,
 10737	,
 10654	
-};
\ No newline at end of file
+};
@@ -5,19 +5,25 @@
  * Written by: Andrew Kilpatrick
  *
  */
+#include <stddef.h>
 #include "env_proc.h"
 #include "dac.h"
 #include "ioctl.h"
 #include "switch_filter.h"
 #include "lfo_freq.h"
 #include "env_freq.h"
+#include "env_curve.h"
 #include "clamp.h"
-#include "sine.h"
 #include "scale.h"
 #include "note_to_val.h"
 #include "steps.h"
 #include "scales.h"
-#include <stdlib.h>
+#include "noise.h"
+#include "lfo.h"
+
+// speed CV is read every sample instead of every 4ms - for audio rate / fast LFO FM
+// - the ADC scans all inputs in about 63us on its RC clock so each sample sees a fresh value
+#define ENV_CV_AUDIO_RATE
 
 // modes
 #define ENV_TYPE_AHR 0
@@ -30,6 +36,14 @@
 #define ENV_OUT_INVERT 1
 #define ENV_OUT_ABS 2
 
+// segment curves - output vs. accumulator
+#define ENV_CURVE_LINEAR 0
+#define ENV_CURVE_EXP 1  // slow at the bottom - gives an RC shaped fall
+#define ENV_CURVE_LOG 2  // fast at the bottom - gives an RC shaped rise
+#define ENV_CURVE_LEN 257  // curve table length - see tools/table_gen.c
+#define ENV_UP_CURVE ENV_CURVE_LINEAR  // curve for the up segment
+#define ENV_DOWN_CURVE ENV_CURVE_LINEAR  // curve for the down segment
+
 // trigger
 #define ENV_TRIG_IDLE 0
 #define ENV_TRIG_RISING 1
@@ -69,15 +83,22 @@ int env12_delay_count[ENV_NUM_CHANS];   // delay counter
 int env12_run_state[ENV_NUM_CHANS];  // running state
 int env12_up_freq[ENV_NUM_CHANS];  // freq from speed lookup table
 int env12_down_freq[ENV_NUM_CHANS];  // freq from speed lookup table
+const unsigned int *env12_freq_table[ENV_NUM_CHANS];  // speed lookup table for the type
+int env12_up_offset[ENV_NUM_CHANS];  // -128 to +127 = up speed added to the speed CV
+int env12_down_offset[ENV_NUM_CHANS];  // -128 to +127 = down speed added to the speed CV
 int env12_acc[ENV_NUM_CHANS];  // current accumulator value
+const unsigned int *env12_up_curve[ENV_NUM_CHANS];  // up segment curve table - NULL for linear
+const unsigned int *env12_down_curve[ENV_NUM_CHANS];  // down segment curve table - NULL for linear
+void (*env12_kernel[ENV_NUM_CHANS])(int chan);  // kernel for the current mode
 
 // settings and state - mod 3
 #define ENV3_RAND_BREAKPOINT 0xff  // a mask used to set random updates vs. sine
+#define ENV3_NOISE_COLOR NOISE_WHITE  // noise at the top of the speed pot - NOISE_WHITE, NOISE_PINK or NOISE_VELVET
+#define ENV3_SHAPE LFO_SINE  // shape on the sine output - see lfo.h
 int env3_speed_setting;  // 0-255% = 0-100% speed
 int env3_freq;  // freq from speed lookup table
 
 // running vars - mod 3
-int env3_acc;  // current accumulator value
 int env3_rand;  // keeps track of random output state
 
 // local functions
@@ -85,7 +106,10 @@ void env_proc_set_type(int chan, int type);
 void env_proc_set_mod(int chan, int mod);
 void env_proc_set_out(int chan, int out);
 void env_proc_update_leds(int chan);
-void env_proc_run12(int chan);
+void env_proc_update_freq(int chan, int speed_cv);
+void env_proc_update_kernel(int chan);
+const unsigned int *env_proc_curve_table(int curve);
+void env_proc_curve_switch(int chan, const unsigned int *from, const unsigned int *to);
 void env_proc_run3(void);
 void env_proc_reset(int chan);
 
@@ -111,24 +135,30 @@ void env_proc_init(void) {
 		env12_gate[i] = 0;
 		env12_up_freq[i] = lfo_freq_table[0];
 		env12_down_freq[i] = lfo_freq_table[0];
+		env12_freq_table[i] = lfo_freq_table;
+		env12_up_offset[i] = -128;
+		env12_down_offset[i] = -128;
 		env12_acc[i] = 0;
+		env12_up_curve[i] = env_proc_curve_table(ENV_UP_CURVE);
+		env12_down_curve[i] = env_proc_curve_table(ENV_DOWN_CURVE);
 		env12_type[i] = ENV_TYPE_AHR;
 		env12_mod[i] = ENV_MOD_STEPS;
 		env12_out[i] = ENV_OUT_NORMAL;
 		env_proc_reset(i);
 		env_proc_update_leds(i);
+		env_proc_update_kernel(i);
 	}
 	env3_freq = lfo_freq_table[0];
-	env3_acc = 0;
+	lfo_init();
 
-	srand(0xbababa);
+	noise_init();
+	noise_set_color(ENV3_NOISE_COLOR);
 }
 
 // run the timer task
 void env_proc_timer_task(void) {
 	int sw;
 	int val;
-	int temp;
 	int i;
 
 	// check gate inputs
@@ -209,25 +239,24 @@ void env_proc_timer_task(void) {
 	}
 	env_scan_phase ++;
 
-	// update frequencies
+	// update frequencies - the speed CV is added when the freqs are looked up
 	for(i = 0; i < ENV_NUM_CHANS; i ++) {
 		switch(env12_type[i]) {
 			case ENV_TYPE_AR:
 			case ENV_TYPE_AHR:
-				temp = env12_speed_cv[i] - 128;  // -128 to +127
-				temp += env12_up_time_setting[i];
-				env12_up_freq[i] = env_freq_table[clamp(temp, 0, 255)];
-				temp = env12_speed_cv[i] - 128;  // -128 to +127
-				temp += env12_down_time_setting[i];
-				env12_down_freq[i] = env_freq_table[clamp(temp, 0, 255)];
+				env12_freq_table[i] = env_freq_table;
+				env12_up_offset[i] = env12_up_time_setting[i] - 128;
+				env12_down_offset[i] = env12_down_time_setting[i] - 128;
 				break;
 			case ENV_TYPE_OSC:
-				temp = env12_speed_cv[i] - 128;  // -128 to +127
-				temp += env12_up_time_setting[i];
-				env12_up_freq[i] = lfo_freq_table[clamp(temp, 0, 255)];
-				env12_down_freq[i] = env12_up_freq[i];
+				env12_freq_table[i] = lfo_freq_table;
+				env12_up_offset[i] = env12_up_time_setting[i] - 128;
+				env12_down_offset[i] = env12_up_offset[i];
 				break;
 		}
+#ifndef ENV_CV_AUDIO_RATE
+		env_proc_update_freq(i, env12_speed_cv[i]);
+#endif
 	}
 	env3_freq = lfo_freq_table[env3_speed_setting];
 
@@ -243,27 +272,33 @@ void env_proc_timer_task(void) {
 					env12_type[0] = (env12_type[0] + 1) % 3;
 					env_proc_reset(0);
 					env_proc_update_leds(0);
+					env_proc_update_kernel(0);
 					break;
 				case SW_MOD1_SW2:  // mod
 					env12_mod[0] = (env12_mod[0] + 1) % 3;
 					env_proc_update_leds(0);
+					env_proc_update_kernel(0);
 					break;
 				case SW_MOD1_SW3:  // out
 					env12_out[0] = (env12_out[0] + 1) % 3;
 					env_proc_update_leds(0);
+					env_proc_update_kernel(0);
 					break;
 				case SW_MOD2_SW1:  // type
 					env12_type[1] = (env12_type[1] + 1) % 3;
 					env_proc_reset(1);
 					env_proc_update_leds(1);
+					env_proc_update_kernel(1);
 					break;
 				case SW_MOD2_SW2:  // mod
 					env12_mod[1] = (env12_mod[1] + 1) % 3;
 					env_proc_update_leds(1);
+					env_proc_update_kernel(1);
 					break;
 				case SW_MOD2_SW3:  // out
 					env12_out[1] = (env12_out[1] + 1) % 3;
 					env_proc_update_leds(1);
+					env_proc_update_kernel(1);
 					break;
 			}
 		}
@@ -275,7 +310,10 @@ void env_proc_sample_task(void) {
 	int i;
 	// run each channel
 	for(i = 0; i < ENV_NUM_CHANS; i ++) {
-		env_proc_run12(i);
+#ifdef ENV_CV_AUDIO_RATE
+		env_proc_update_freq(i, ioctl_get_cv_fast(i) >> 4);
+#endif
+		env12_kernel[i](i);
 	}
 	env_proc_run3();
 }
@@ -290,13 +328,35 @@ void env_proc_update_leds(int chan) {
 	ioctl_set_mode_led(chan, 2, env12_out[chan]);
 }
 
+// look up the up and down freqs for mod 1 and 2 - speed_cv = 0-255
+void env_proc_update_freq(int chan, int speed_cv) {
+	env12_up_freq[chan] = env12_freq_table[chan][clamp(speed_cv + env12_up_offset[chan], 0, 255)];
+	env12_down_freq[chan] = env12_freq_table[chan][clamp(speed_cv + env12_down_offset[chan], 0, 255)];
+}
+
+// get the curve output for an accumulator value - 16 bit - 4096 << 4 at the top for linear
+// - one table read and one multiply - the table has the rise to the next entry in the bottom half
+static inline __attribute__((always_inline)) int env_proc_curve(const unsigned int *curve, int acc) {
+	unsigned int entry;
+	if(acc < 0) {
+		acc = 0;
+	}
+	else if(acc > ENV_MAXVAL) {
+		acc = ENV_MAXVAL;
+	}
+	if(curve == NULL) {
+		return acc >> 14;
+	}
+	entry = curve[acc >> 22];
+	return (entry >> 16) + (((entry & 0xffff) * ((acc >> 10) & 0xfff)) >> 12);
+}
+
 // run envelope processors for mod 1 and 2
-void env_proc_run12(int chan) {
+// - always inlined into one kernel per type / mod / out so the mode tests fold away
+static inline __attribute__((always_inline)) void env_proc_run12(int chan,
+		int type, int mod, int out) {
 	int temp, temp2;
 	int oct, semi;
-	if(chan < 0 || chan > 1) {
-		return;
-	}
 
 	// compute the trigger state
 	if(env12_trig[chan] == ENV_TRIG_IDLE) {
@@ -322,7 +382,7 @@ void env_proc_run12(int chan) {
 			env12_acc[chan] += env12_up_freq[chan];
 			// reached top
 			if(env12_acc[chan] > ENV_MAXVAL) {
-				switch(env12_type[chan]) {
+				switch(type) {
 					case ENV_TYPE_AR:
 						env12_run_state[chan] = ENV_STATE_DOWN;
 						break;
@@ -335,8 +395,9 @@ void env_proc_run12(int chan) {
 				}
 			}
 			// trigger was released in AHR mode
-			else if(env12_type[chan] == ENV_TYPE_AHR && env12_trig[chan] == ENV_TRIG_FALLING) {
+			else if(type == ENV_TYPE_AHR && env12_trig[chan] == ENV_TRIG_FALLING) {
 				env12_run_state[chan] = ENV_STATE_DOWN;
+				env_proc_curve_switch(chan, env12_up_curve[chan], env12_down_curve[chan]);
 			}
 			break;
 		case ENV_STATE_HOLD:
@@ -352,7 +413,7 @@ void env_proc_run12(int chan) {
 			env12_acc[chan] -= env12_down_freq[chan];
 			// reached bottom
 			if(env12_acc[chan] < 0) {
-				switch(env12_type[chan]) {
+				switch(type) {
 					case ENV_TYPE_AR:
 					case ENV_TYPE_AHR:
 						env12_run_state[chan] = ENV_STATE_IDLE;
@@ -368,9 +429,10 @@ void env_proc_run12(int chan) {
 				}
 			}
 			// trigger was applied in env mode
-			else if((env12_type[chan] == ENV_TYPE_AR ||
-						env12_type[chan] == ENV_TYPE_AHR) && env12_trig[chan] == ENV_TRIG_RISING) {
+			else if((type == ENV_TYPE_AR ||
+						type == ENV_TYPE_AHR) && env12_trig[chan] == ENV_TRIG_RISING) {
 				env12_run_state[chan] = ENV_STATE_UP;
+				env_proc_curve_switch(chan, env12_down_curve[chan], env12_up_curve[chan]);
 			}
 			break;
 		case ENV_STATE_IDLE:
@@ -380,14 +442,21 @@ void env_proc_run12(int chan) {
 			}
 			break;
 	}
-	temp = clamp(env12_acc[chan] >> 18, 0x000, 0xfff);
+	// apply the segment curve
+	if(env12_run_state[chan] == ENV_STATE_DOWN) {
+		temp = env_proc_curve(env12_down_curve[chan], env12_acc[chan]);
+	}
+	else {
+		temp = env_proc_curve(env12_up_curve[chan], env12_acc[chan]);
+	}
+	temp = clamp(temp >> 4, 0x000, 0xfff);
 
 	// mod / level mode
-	switch(env12_mod[chan]) {
+	switch(mod) {
 		case ENV_MOD_STEPS:
 			temp2 = env12_steps_setting[chan];  // step pot (0-15)
 			// use steps table
-			if(temp2 < 14) {
+			if(temp2 < (int)(sizeof(steps) / sizeof(steps[0]))) {
 				temp = scale_find_note(temp);  // convert value into note (0-120)
 				temp = steps[temp2][temp];  // look up the quantization
 				temp = note_to_val[temp];  // convert note back to value (0-4095)
@@ -396,14 +465,14 @@ void env_proc_run12(int chan) {
 			break;
 		case ENV_MOD_SCALE:
 			// do scaling of input for osc mode
-			if(env12_type[chan] == ENV_TYPE_OSC) {
+			if(type == ENV_TYPE_OSC) {
 				temp = (temp * env12_level_setting[chan]) >> 8;  // scale
-				if(env12_out[chan] != ENV_OUT_ABS) {
+				if(out != ENV_OUT_ABS) {
 					temp += 0x7ff - (env12_level_setting[chan] << 3);  // offset
 				}
 			}
 			// abs output precalc
-			if(env12_out[chan] == ENV_OUT_ABS) {
+			if(out == ENV_OUT_ABS) {
 				temp = (temp >> 1) + 0x7ff;
 			}
 			temp2 = env12_steps_setting[chan];  // step pot (0-15)
@@ -412,27 +481,27 @@ void env_proc_run12(int chan) {
 			semi = scales[temp2][semi];  // look up the quantization
 			temp = note_to_val[(oct * 12) + semi];  // convert note back to value (0-4095)
 			// abs output postcalc
-			if(env12_out[chan] == ENV_OUT_ABS) {
+			if(out == ENV_OUT_ABS) {
 				temp += DAC_OFFSET;
 			}
 			// invert output postcalc
-			else if(env12_out[chan] == ENV_OUT_INVERT) {
+			else if(out == ENV_OUT_INVERT) {
 				temp = 0xfff - temp;
 			}
 			break;
 	}
 
 	// output processing for non-scale modes
-	if(env12_mod[chan] != ENV_MOD_SCALE) {
+	if(mod != ENV_MOD_SCALE) {
 		// osc mode level - not for scale mode
-		if(env12_type[chan] == ENV_TYPE_OSC) {
+		if(type == ENV_TYPE_OSC) {
 			temp = (temp * env12_level_setting[chan]) >> 8;  // scale
-			if(env12_out[chan] != ENV_OUT_ABS) {
+			if(out != ENV_OUT_ABS) {
 				temp += 0x7ff - (env12_level_setting[chan] << 3);  // offset
 			}
 		}
 		// output processing
-		switch(env12_out[chan]) {
+		switch(out) {
 			case ENV_OUT_INVERT:
 				temp = 0xfff - temp;
 				break;
@@ -447,24 +516,113 @@ void env_proc_run12(int chan) {
 	dac_write_dac(DAC_MOD1 + chan, clamp(temp, 0x000, 0xfff));
 }
 
+//
+// kernels for mod 1 and 2 - one for each type / mod / out combination
+//
+#define ENV_KERNEL_NAME(type, mod, out) env_proc_run12_##type##_##mod##_##out
+#define ENV_KERNEL(type, mod, out) \
+	void ENV_KERNEL_NAME(type, mod, out)(int chan) { \
+		env_proc_run12(chan, ENV_TYPE_##type, ENV_MOD_##mod, ENV_OUT_##out); \
+	}
+#define ENV_KERNEL_OUTS(type, mod) \
+	ENV_KERNEL(type, mod, NORMAL) \
+	ENV_KERNEL(type, mod, INVERT) \
+	ENV_KERNEL(type, mod, ABS)
+#define ENV_KERNEL_MODS(type) \
+	ENV_KERNEL_OUTS(type, STEPS) \
+	ENV_KERNEL_OUTS(type, DELAY) \
+	ENV_KERNEL_OUTS(type, SCALE)
+ENV_KERNEL_MODS(AHR)
+ENV_KERNEL_MODS(OSC)
+ENV_KERNEL_MODS(AR)
+
+// kernel lookup - indexed by type, mod and out setting
+#define ENV_KERNEL_OUT_LIST(type, mod) { \
+	ENV_KERNEL_NAME(type, mod, NORMAL), \
+	ENV_KERNEL_NAME(type, mod, INVERT), \
+	ENV_KERNEL_NAME(type, mod, ABS) }
+#define ENV_KERNEL_MOD_LIST(type) { \
+	ENV_KERNEL_OUT_LIST(type, STEPS), \
+	ENV_KERNEL_OUT_LIST(type, DELAY), \
+	ENV_KERNEL_OUT_LIST(type, SCALE) }
+void (* const env12_kernels[3][3][3])(int chan) = {
+	ENV_KERNEL_MOD_LIST(AHR),
+	ENV_KERNEL_MOD_LIST(OSC),
+	ENV_KERNEL_MOD_LIST(AR)
+};
+
+// select the kernel for the current mode - call after any mode change
+void env_proc_update_kernel(int chan) {
+	if(chan < 0 || chan > 1) {
+		return;
+	}
+	env12_kernel[chan] = env12_kernels[env12_type[chan]][env12_mod[chan]][env12_out[chan]];
+}
+
+// get the table for a segment curve - NULL for linear
+const unsigned int *env_proc_curve_table(int curve) {
+	switch(curve) {
+		case ENV_CURVE_EXP:
+			return env_curve_exp;
+		case ENV_CURVE_LOG:
+			return env_curve_log;
+		case ENV_CURVE_LINEAR:
+		default:
+			return NULL;
+	}
+}
+
+// move the accumulator so the output doesn't jump when the segment curve changes
+// - only needed when the segment is turned around part way
+void env_proc_curve_switch(int chan, const unsigned int *from, const unsigned int *to) {
+	int val, lo, hi, mid, base, rise, frac;
+	if(from == to) {
+		return;
+	}
+	val = env_proc_curve(from, env12_acc[chan]);
+	if(to == NULL) {
+		env12_acc[chan] = val << 14;
+		return;
+	}
+	// find the entry below the value - the curves always rise
+	lo = 0;
+	hi = ENV_CURVE_LEN - 1;
+	while(hi - lo > 1) {
+		mid = (lo + hi) >> 1;
+		if((int)(to[mid] >> 16) <= val) {
+			lo = mid;
+		}
+		else {
+			hi = mid;
+		}
+	}
+	base = to[lo] >> 16;
+	rise = to[lo] & 0xffff;
+	frac = 0;
+	if(rise) {
+		frac = clamp(((val - base) << 12) / rise, 0, 0xfff);
+	}
+	env12_acc[chan] = (lo << 22) | (frac << 10);
+}
+
 // run the process for mod 3
 void env_proc_run3(void) {
 	int temp;	
-	env3_acc += env3_freq;
-	temp = clamp((env3_acc >> 19) & 0xfff, 0, 0xfff);
+	lfo_run(env3_freq);
+	temp = lfo_phase >> 20;
 
 	// sine
-	dac_write_dac(DAC_MOD3_SINE, sine1024[temp >> 2]);
+	dac_write_dac(DAC_MOD3_SINE, lfo_out[ENV3_SHAPE]);
 
 	// noise output
 	if(env3_speed_setting > 253) {
-		dac_write_dac(DAC_MOD3_RAND, rand() & 0xfff);
+		dac_write_dac(DAC_MOD3_RAND, noise_sample());
 	}
 	// random output
 	else {
 		temp = temp & (ENV3_RAND_BREAKPOINT << 1);
 		if(env3_rand && (temp > ENV3_RAND_BREAKPOINT)) {
-			dac_write_dac(DAC_MOD3_RAND, rand() & 0xfff);
+			dac_write_dac(DAC_MOD3_RAND, noise_rand() >> 20);
 			env3_rand = 0;
 		}
 		else if(temp < ENV3_RAND_BREAKPOINT) {
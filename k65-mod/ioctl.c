@@ -234,6 +234,18 @@ int ioctl_get_cv(unsigned char cv) {
 	return 0;
 }
 
+// get the value of a CV input without filtering - output is 12 bit
+// - reads the ADC scan buffer directly so it is quick enough for the sample rate
+int ioctl_get_cv_fast(unsigned char cv) {
+	switch(cv) {
+		case CV_MOD1:
+			return clamp((ReadADC10(AN_CV_MOD1) << 2) + CV_MOD_OFFSET, 0x000, 0xfff);
+		case CV_MOD2:
+			return clamp((ReadADC10(AN_CV_MOD2) << 2) + CV_MOD_OFFSET, 0x000, 0xfff);
+	}
+	return 0;
+}
+
 // get a switch filter event - encoders
 int ioctl_get_sw_event(void) {
 	return switch_filter_get_event();
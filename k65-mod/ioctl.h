@@ -44,6 +44,9 @@ int ioctl_get_pot(unsigned char pot);
 // get the value of a CV input - output is 12 bit
 int ioctl_get_cv(unsigned char cv);
 
+// get the value of a CV input without filtering - output is 12 bit
+int ioctl_get_cv_fast(unsigned char cv);
+
 // get a switch filter event - encoders
 int ioctl_get_sw_event(void);
 
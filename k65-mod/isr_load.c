@@ -0,0 +1,84 @@
+/*
+ * K65 Phenol - Mod Processor ISR Load Meter
+ *
+ * Copyright 2015: Andrew Kilpatrick
+ * Written by: Andrew Kilpatrick
+ *
+ * Each ISR run is timed with the core timer. The time includes any higher
+ * priority ISR that cuts in - the same as timing a debug pin on a scope.
+ * The busy time is turned into a load once per window.
+ *
+ */
+#include <plib.h>
+#include "HardwareProfile.h"
+#include "isr_load.h"
+
+#define ISR_LOAD_TICKS_US (GetSystemClock() / 2000000)  // core timer runs at half the CPU clock
+#define ISR_LOAD_WINDOW (GetSystemClock() / 2)  // core timer ticks per window - 1 second
+
+// state
+unsigned int isr_load_window_start;  // core timer at the start of the window
+unsigned int isr_load_busy[ISR_LOAD_NUM];  // busy time this window - core timer ticks
+unsigned int isr_load_run_max[ISR_LOAD_NUM];  // longest run this window - core timer ticks
+int isr_load_load[ISR_LOAD_NUM];  // load over the last window - 0-1000
+int isr_load_max[ISR_LOAD_NUM];  // longest run in the last window - us
+
+// init the load meter
+void isr_load_init(void) {
+	int i;
+	for(i = 0; i < ISR_LOAD_NUM; i ++) {
+		isr_load_busy[i] = 0;
+		isr_load_run_max[i] = 0;
+		isr_load_load[i] = 0;
+		isr_load_max[i] = 0;
+	}
+	isr_load_window_start = _CP0_GET_COUNT();
+}
+
+// mark the start of an ISR run - returns the start time
+unsigned int isr_load_start(void) {
+	return _CP0_GET_COUNT();
+}
+
+// mark the end of an ISR run - start is from isr_load_start()
+void isr_load_end(int isr, unsigned int start) {
+	unsigned int run = _CP0_GET_COUNT() - start;
+	isr_load_busy[isr] += run;
+	if(run > isr_load_run_max[isr]) {
+		isr_load_run_max[isr] = run;
+	}
+}
+
+// run the load meter task - call from the task timer ISR
+void isr_load_timer_task(void) {
+	unsigned int elapsed;
+	int i;
+	elapsed = _CP0_GET_COUNT() - isr_load_window_start;
+	if(elapsed < ISR_LOAD_WINDOW) {
+		return;
+	}
+	// a run that ends while this is working is counted in the next window
+	isr_load_window_start += elapsed;
+	for(i = 0; i < ISR_LOAD_NUM; i ++) {
+		isr_load_load[i] = ((unsigned long long)isr_load_busy[i] * 1000) / elapsed;
+		isr_load_max[i] = isr_load_run_max[i] / ISR_LOAD_TICKS_US;
+		isr_load_busy[i] = 0;
+		isr_load_run_max[i] = 0;
+	}
+}
+
+// get the load of an ISR over the last window - 0-1000 = 0-100.0%
+int isr_load_get_load(int isr) {
+	if(isr < 0 || isr >= ISR_LOAD_NUM) {
+		return 0;
+	}
+	return isr_load_load[isr];
+}
+
+// get the longest run of an ISR in the last window - us
+int isr_load_get_max(int isr) {
+	if(isr < 0 || isr >= ISR_LOAD_NUM) {
+		return 0;
+	}
+	return isr_load_max[isr];
+}
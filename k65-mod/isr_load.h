@@ -0,0 +1,34 @@
+/*
+ * K65 Phenol - Mod Processor ISR Load Meter
+ *
+ * Copyright 2015: Andrew Kilpatrick
+ * Written by: Andrew Kilpatrick
+ *
+ */
+#ifndef ISR_LOAD_H
+#define ISR_LOAD_H
+
+// ISRs
+#define ISR_LOAD_TIMER1 0  // task timer
+#define ISR_LOAD_TIMER2 1  // sample clock
+#define ISR_LOAD_NUM 2
+
+// init the load meter
+void isr_load_init(void);
+
+// mark the start of an ISR run - returns the start time
+unsigned int isr_load_start(void);
+
+// mark the end of an ISR run - start is from isr_load_start()
+void isr_load_end(int isr, unsigned int start);
+
+// run the load meter task - call from the task timer ISR
+void isr_load_timer_task(void);
+
+// get the load of an ISR over the last window - 0-1000 = 0-100.0%
+int isr_load_get_load(int isr);
+
+// get the longest run of an ISR in the last window - us
+int isr_load_get_max(int isr);
+
+#endif
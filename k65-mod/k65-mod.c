@@ -49,6 +49,7 @@
 #include "dac.h"
 #include "ioctl.h"
 #include "env_proc.h"
+#include "isr_load.h"
 
 // fuse settings
 #pragma config UPLLEN   = OFF      // USB PLL disabled
@@ -107,6 +108,7 @@ int main(void) {
 	ConfigIntTimer2(T2_INT_ON | T2_INT_PRIOR_2);
 
 	// set up modules
+	isr_load_init();
 	ioctl_init();
 	dac_init();
 	env_proc_init();  // ioctl and dac must be set up already
@@ -132,10 +134,12 @@ int main(void) {
 void __ISR(_TIMER_1_VECTOR, ipl1) Timer1Handler(void) {
 	int temp;
     static int startup_delay = STARTUP_DELAY_TIMEOUT;
+	unsigned int load_start = isr_load_start();
 	INTClearFlag(INT_T1);
 
 	// run always
 	ioctl_timer_task();
+	isr_load_timer_task();
 	
 	temp = ioctl_get_analog_power_ctrl();
 	if(power_state != temp) {
@@ -187,10 +191,12 @@ void __ISR(_TIMER_1_VECTOR, ipl1) Timer1Handler(void) {
 	}
 
 	timer_div ++;
+	isr_load_end(ISR_LOAD_TIMER1, load_start);
 }
 
 // timer 2 interrupt - sample clock
 void __ISR(_TIMER_2_VECTOR, ipl2) Timer2Handler(void) {
+	unsigned int load_start = isr_load_start();
 	INTClearFlag(INT_T2);
 #ifdef TIMER2_INT_DEBUG
     LATAbits.LATA10 = 1;
@@ -201,4 +207,5 @@ void __ISR(_TIMER_2_VECTOR, ipl2) Timer2Handler(void) {
 #ifdef TIMER2_INT_DEBUG
     LATAbits.LATA10 = 0;
 #endif
+	isr_load_end(ISR_LOAD_TIMER2, load_start);
 }
@@ -0,0 +1,88 @@
+/*
+ * K65 Phenol - Mod Processor LFO Waveforms
+ *
+ * Copyright 2015: Andrew Kilpatrick
+ * Written by: Andrew Kilpatrick
+ *
+ * All shapes are made from the full 32 bit phase on every sample:
+ *	- sine - linear interpolation between sine1024 entries using the 16
+ *	  bits of phase below the table index - rounded
+ *	- triangle, saw and square - worked out directly from the phase
+ *	- random - a new random level is picked when the phase wraps and the
+ *	  output glides from the last level to it on a half cosine from
+ *	  sine1024 so the slope is 0 at each level - interpolated the same
+ *	  as the sine
+ *
+ */
+#include "lfo.h"
+#include "sine.h"
+#include "noise.h"
+
+#define LFO_SINE_BITS 10  // sine1024 has 2^10 entries
+#define LFO_SINE_SHIFT (32 - LFO_SINE_BITS)
+#define LFO_FRAC_SHIFT (LFO_SINE_SHIFT - 16)  // 16 bits of interpolation
+#define LFO_QUARTER 0x40000000  // 90 degrees of phase
+#define LFO_HALF 0x80000000  // 180 degrees of phase
+
+// state
+uint32_t lfo_phase;
+int lfo_out[LFO_NUM_SHAPES];
+int lfo_rand_start;  // random level at the start of the cycle
+int lfo_rand_end;  // random level at the end of the cycle
+
+// init the LFO
+void lfo_init(void) {
+	int i;
+	lfo_phase = 0;
+	for(i = 0; i < LFO_NUM_SHAPES; i ++) {
+		lfo_out[i] = 0x7ff;
+	}
+	lfo_rand_start = 0x7ff;
+	lfo_rand_end = 0x7ff;
+}
+
+// run the LFO for one sample - freq is a phase step from lfo_freq.h
+// - every shape is worked out from the new phase and stored in lfo_out
+void lfo_run(int freq) {
+	uint32_t inc, phase, tri;
+	int index, frac, a, b;
+
+	// lfo_freq.h steps are for a 2^31 cycle
+	inc = ((uint32_t)freq) << 1;
+	phase = lfo_phase + inc;
+	if(phase < inc) {
+		// wrapped - pick the next random level
+		lfo_rand_start = lfo_rand_end;
+		lfo_rand_end = noise_rand() >> 20;
+	}
+	lfo_phase = phase;
+
+	// sine
+	index = phase >> LFO_SINE_SHIFT;
+	frac = (phase >> LFO_FRAC_SHIFT) & 0xffff;
+	a = sine1024[index];
+	b = sine1024[(index + 1) & ((1 << LFO_SINE_BITS) - 1)];
+	lfo_out[LFO_SINE] = a + (((b - a) * frac + 0x8000) >> 16);
+
+	// triangle - 13 bits of phase from the start of the rising edge folded to 12
+	tri = (phase + LFO_QUARTER) >> 19;
+	if(tri & 0x1000) {
+		tri ^= 0x1fff;
+	}
+	lfo_out[LFO_TRIANGLE] = tri;
+
+	// saw
+	lfo_out[LFO_SAW] = (phase + LFO_HALF) >> 20;
+
+	// square
+	lfo_out[LFO_SQUARE] = (phase < LFO_HALF) ? 0xfff : 0x000;
+
+	// random - sine1024 from 270 to 90 degrees is a half cosine from 0 to 4094
+	// - half a table per cycle so the fraction is one bit further down
+	index = ((phase >> (LFO_SINE_SHIFT + 1)) + 768) & ((1 << LFO_SINE_BITS) - 1);
+	frac = (phase >> (LFO_FRAC_SHIFT + 1)) & 0xffff;
+	a = sine1024[index];
+	b = sine1024[(index + 1) & ((1 << LFO_SINE_BITS) - 1)];
+	a += ((b - a) * frac + 0x8000) >> 16;
+	lfo_out[LFO_RANDOM] = lfo_rand_start + (((lfo_rand_end - lfo_rand_start) * a) >> 12);
+}
@@ -0,0 +1,31 @@
+/*
+ * K65 Phenol - Mod Processor LFO Waveforms
+ *
+ * Copyright 2015: Andrew Kilpatrick
+ * Written by: Andrew Kilpatrick
+ *
+ */
+#ifndef LFO_H
+#define LFO_H
+
+#include <inttypes.h>
+
+// LFO shapes - all start rising through the centre at phase 0
+#define LFO_SINE 0
+#define LFO_TRIANGLE 1
+#define LFO_SAW 2  // rising
+#define LFO_SQUARE 3  // high for the first half of the cycle
+#define LFO_RANDOM 4  // smoothed random - glides to a new random level every cycle
+#define LFO_NUM_SHAPES 5
+
+extern uint32_t lfo_phase;  // phase accumulator - one cycle is 2^32
+extern int lfo_out[LFO_NUM_SHAPES];  // output for each shape - 12 bit
+
+// init the LFO
+void lfo_init(void);
+
+// run the LFO for one sample - freq is a phase step from lfo_freq.h
+// - every shape is worked out from the new phase and stored in lfo_out
+void lfo_run(int freq);
+
+#endif
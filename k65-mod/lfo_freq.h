@@ -1,3 +1,4 @@
+// LFO speed lookup - 60s period x 0.97 per step - 10000Hz sample rate - made by tools/table_gen.c
 unsigned int lfo_freq_table[] = {
 3579	,
 3690	,
@@ -0,0 +1,102 @@
+/*
+ * K65 Phenol - Mod Processor Noise Generator
+ *
+ * Copyright 2015: Andrew Kilpatrick
+ * Written by: Andrew Kilpatrick
+ *
+ * Every colour uses one xorshift random number per sample and has no
+ * loops so it is safe to run from the sample interrupt:
+ *	- white - the top 12 bits of the random number
+ *	- pink - Voss-McCartney - NOISE_PINK_ROWS random values where each row
+ *	  is changed half as often as the one before, plus one that changes
+ *	  every sample - one row is changed per sample and a running sum is kept
+ *	- velvet - one full scale impulse of random sign at a random place in
+ *	  every NOISE_VELVET_PERIOD samples - centre value the rest of the time
+ *
+ */
+#include "noise.h"
+#include "clamp.h"
+
+#define NOISE_DEFAULT_SEED 0xbababa
+#define NOISE_CENTER 0x7ff
+#define NOISE_PINK_ROWS 12  // slowest row changes every 4096 samples - about 2.4Hz
+#define NOISE_PINK_MASK ((1 << NOISE_PINK_ROWS) - 1)
+#define NOISE_VELVET_PERIOD 8  // about 1240 impulses per second - must be a power of 2
+
+// state
+uint32_t noise_state;
+int noise_color;  // current colour
+// pink
+int noise_pink_count;  // sample count - the trailing zeros pick the row to change
+int noise_pink_rows[NOISE_PINK_ROWS];  // held random values - -256 to +255
+int noise_pink_sum;  // sum of all rows
+// velvet
+int noise_velvet_count;  // sample within the period
+int noise_velvet_pos;  // sample in the period that gets the impulse
+int noise_velvet_val;  // impulse value
+
+// init the noise generator
+void noise_init(void) {
+	int i;
+	noise_seed(NOISE_DEFAULT_SEED);
+	noise_color = NOISE_WHITE;
+	noise_pink_count = 0;
+	for(i = 0; i < NOISE_PINK_ROWS; i ++) {
+		noise_pink_rows[i] = 0;
+	}
+	noise_pink_sum = 0;
+	noise_velvet_count = 0;
+	noise_velvet_pos = 0;
+	noise_velvet_val = NOISE_CENTER;
+}
+
+// reseed the generator - 0 is replaced by the default seed
+void noise_seed(uint32_t seed) {
+	if(seed == 0) {
+		seed = NOISE_DEFAULT_SEED;  // xorshift gets stuck at 0
+	}
+	noise_state = seed;
+}
+
+// set the noise colour
+void noise_set_color(int color) {
+	if(color < 0 || color >= NOISE_NUM_COLORS) {
+		return;
+	}
+	noise_color = color;
+}
+
+// get the next noise sample in the current colour - output is 12 bit
+int noise_sample(void) {
+	uint32_t r = noise_rand();
+	int row, val;
+	switch(noise_color) {
+		case NOISE_PINK:
+			// row 0 changes every 2nd sample, row 1 every 4th, etc.
+			noise_pink_count = (noise_pink_count + 1) & NOISE_PINK_MASK;
+			if(noise_pink_count) {
+				row = __builtin_ctz(noise_pink_count);
+				val = ((int32_t)r) >> 23;  // top 9 bits - -256 to +255
+				noise_pink_sum += val - noise_pink_rows[row];
+				noise_pink_rows[row] = val;
+			}
+			// add the row that changes every sample - the next 9 bits
+			val = ((int32_t)(r << 9)) >> 23;
+			return clamp(NOISE_CENTER + noise_pink_sum + val, 0x000, 0xfff);
+		case NOISE_VELVET:
+			// pick the place and sign of the impulse at the start of the period
+			if(noise_velvet_count == 0) {
+				noise_velvet_pos = r & (NOISE_VELVET_PERIOD - 1);
+				noise_velvet_val = (r & 0x80000000) ? 0xfff : 0x000;
+			}
+			val = NOISE_CENTER;
+			if(noise_velvet_count == noise_velvet_pos) {
+				val = noise_velvet_val;
+			}
+			noise_velvet_count = (noise_velvet_count + 1) & (NOISE_VELVET_PERIOD - 1);
+			return val;
+		case NOISE_WHITE:
+		default:
+			return r >> 20;
+	}
+}
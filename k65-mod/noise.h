@@ -0,0 +1,43 @@
+/*
+ * K65 Phenol - Mod Processor Noise Generator
+ *
+ * Copyright 2015: Andrew Kilpatrick
+ * Written by: Andrew Kilpatrick
+ *
+ */
+#ifndef NOISE_H
+#define NOISE_H
+
+#include <inttypes.h>
+
+// noise colours
+#define NOISE_WHITE 0  // flat spectrum
+#define NOISE_PINK 1  // -3dB / octave
+#define NOISE_VELVET 2  // sparse random impulses - flat spectrum
+#define NOISE_NUM_COLORS 3
+
+extern uint32_t noise_state;  // xorshift state - never 0
+
+// init the noise generator
+void noise_init(void);
+
+// reseed the generator - 0 is replaced by the default seed
+void noise_seed(uint32_t seed);
+
+// set the noise colour
+void noise_set_color(int color);
+
+// get the next noise sample in the current colour - output is 12 bit
+int noise_sample(void);
+
+// get a 32 bit random number - xorshift32 - period is 2^32 - 1
+static inline uint32_t noise_rand(void) {
+	uint32_t x = noise_state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	noise_state = x;
+	return x;
+}
+
+#endif
@@ -1,4 +1,4 @@
-// note to val lookup
+// note to val lookup - 12 bit - made by tools/table_gen.c
 int note_to_val[] = {
 0	,
 34	,
@@ -121,4 +121,4 @@ int note_to_val[] = {
 4027	,
 4061	,
 4095	
-};
\ No newline at end of file
+};
@@ -1,3 +1,4 @@
+// sine lookup - 12 bit - made by tools/table_gen.c
 unsigned int sine1024[] = {
 2047	,
 2060	,
@@ -1023,4 +1024,4 @@ unsigned int sine1024[] = {
 2009	,
 2022	,
 2034	
-};
\ No newline at end of file
+};
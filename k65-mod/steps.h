@@ -1,3 +1,4 @@
+// steps lookup - made by tools/table_gen.c
 unsigned char steps[14][121] = {
 {
   0,
@@ -1721,4 +1722,4 @@ unsigned char steps[14][121] = {
   119,
   120
 }
-};
\ No newline at end of file
+};
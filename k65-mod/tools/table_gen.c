@@ -0,0 +1,383 @@
+/*
+ * K65 Phenol - Mod Processor Lookup Table Generator
+ *
+ * Copyright 2015: Andrew Kilpatrick
+ * Written by: Andrew Kilpatrick
+ *
+ * Host tool - makes the lookup table headers used by the mod processor:
+ *	- sine.h - sine1024 - one cycle of sine for the DAC
+ *	- lfo_freq.h - lfo_freq_table - LFO phase increment for each speed
+ *	- env_freq.h - env_freq_table - envelope ramp increment for each time
+ *	- note_to_val.h - note_to_val - DAC value for each note
+ *	- steps.h - steps - note quantizing for each step setting
+ *	- env_curve.h - env_curve_exp / env_curve_log - envelope segment curves
+ *
+ * Build and run from the k65-mod directory:
+ *	gcc -o table_gen tools/table_gen.c -lm
+ *	./table_gen -check  - check the headers match the default settings
+ *	./table_gen  - write the headers
+ *
+ * Options:
+ *	-rate hz  - sample rate the increments are worked out for (10000)
+ *	-dac-bits n  - bit depth of the sine and note tables (12)
+ *	-lfo-slow s  - LFO period at speed 0 in seconds (60)
+ *	-lfo-ratio r  - LFO period of each speed vs. the one before (0.97)
+ *	-env-long s  - envelope time at speed 255 in seconds (10)
+ *	-env-curve n  - envelope time vs. speed power curve (2)
+ *	-steps a,b,..  - note steps for each step setting (120,60,...,1)
+ *	-curve-bend k  - bend of the exp / log segment curves (4)
+ *	-narrow  - const tables so they stay in flash - sine and note tables in
+ *	  the smallest type that fits
+ *	-dir path  - where the headers are (.)
+ *
+ * The table lengths are set by the code that uses them: 256 speeds for the
+ * 8 bit pot / CV, 121 notes and 1024 sine steps for the 12 bit phase. Up to
+ * 16 step settings can be made - settings past the last one pass notes through.
+ * The segment curves have 256 segments for the top 8 bits of the envelope
+ * accumulator plus an end point. Each entry is the 16 bit value (4095 << 4 at
+ * the top) in the top half and the rise to the next entry in the bottom half.
+ *
+ */
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define TABLE_GEN_SPEEDS 256  // speed settings - 8 bit pot / CV
+#define TABLE_GEN_NOTES 121  // notes - 10 octaves
+#define TABLE_GEN_SINE_LEN 1024  // sine steps - 12 bit phase >> 2
+#define TABLE_GEN_MAX_STEPS 16  // step settings
+#define TABLE_GEN_CURVE_LEN 257  // curve segments - top 8 bits of the envelope accumulator - plus the end
+#define TABLE_GEN_CURVE_FULL 65520.0  // curve value at the top - 12 bit full scale << 4
+#define TABLE_GEN_LFO_CYCLE 2147483648.0  // LFO accumulator counts per cycle - 2^31
+#define TABLE_GEN_ENV_RAMP 1073741824.0  // envelope accumulator counts per ramp - 2^30
+#define TABLE_GEN_BUF_SIZE 65536
+
+// settings
+double table_gen_rate = 10000.0;
+int table_gen_dac_bits = 12;
+double table_gen_lfo_slow = 60.0;
+double table_gen_lfo_ratio = 0.97;
+double table_gen_env_long = 10.0;
+double table_gen_env_curve = 2.0;
+int table_gen_steps[TABLE_GEN_MAX_STEPS] = {120, 60, 40, 30, 24, 17, 13, 11, 8, 6, 4, 3, 2, 1};
+int table_gen_num_steps = 14;
+double table_gen_curve_bend = 4.0;
+int table_gen_narrow = 0;
+const char *table_gen_dir = ".";
+
+// output
+char table_gen_buf[TABLE_GEN_BUF_SIZE];
+int table_gen_len;
+int table_gen_errors;
+
+// local functions
+void table_gen_printf(const char *fmt, ...);
+void table_gen_list(const char *type, const char *decl, long *vals, int len, int can_narrow);
+const char *table_gen_type(long *vals, int len);
+void table_gen_finish(const char *name, int check);
+void table_gen_sine(void);
+void table_gen_lfo(void);
+void table_gen_env(void);
+void table_gen_note(void);
+void table_gen_step(void);
+void table_gen_curve(void);
+void table_gen_curve_list(const char *decl, double bend);
+int table_gen_parse_steps(const char *arg);
+void table_gen_usage(void);
+
+// main
+int main(int argc, char **argv) {
+	int i, check = 0;
+	for(i = 1; i < argc; i ++) {
+		if(strcmp(argv[i], "-check") == 0) {
+			check = 1;
+		}
+		else if(strcmp(argv[i], "-narrow") == 0) {
+			table_gen_narrow = 1;
+		}
+		else if(i + 1 >= argc) {
+			table_gen_usage();
+			return 1;
+		}
+		else if(strcmp(argv[i], "-rate") == 0) {
+			table_gen_rate = atof(argv[++ i]);
+		}
+		else if(strcmp(argv[i], "-dac-bits") == 0) {
+			table_gen_dac_bits = atoi(argv[++ i]);
+		}
+		else if(strcmp(argv[i], "-lfo-slow") == 0) {
+			table_gen_lfo_slow = atof(argv[++ i]);
+		}
+		else if(strcmp(argv[i], "-lfo-ratio") == 0) {
+			table_gen_lfo_ratio = atof(argv[++ i]);
+		}
+		else if(strcmp(argv[i], "-env-long") == 0) {
+			table_gen_env_long = atof(argv[++ i]);
+		}
+		else if(strcmp(argv[i], "-env-curve") == 0) {
+			table_gen_env_curve = atof(argv[++ i]);
+		}
+		else if(strcmp(argv[i], "-steps") == 0) {
+			if(!table_gen_parse_steps(argv[++ i])) {
+				table_gen_usage();
+				return 1;
+			}
+		}
+		else if(strcmp(argv[i], "-curve-bend") == 0) {
+			table_gen_curve_bend = atof(argv[++ i]);
+		}
+		else if(strcmp(argv[i], "-dir") == 0) {
+			table_gen_dir = argv[++ i];
+		}
+		else {
+			table_gen_usage();
+			return 1;
+		}
+	}
+	if(table_gen_rate <= 0.0 || table_gen_dac_bits < 2 || table_gen_dac_bits > 16 ||
+			table_gen_lfo_slow <= 0.0 || table_gen_lfo_ratio <= 0.0 ||
+			table_gen_env_long <= 0.0 || table_gen_env_curve <= 0.0 ||
+			table_gen_curve_bend <= 0.0 || table_gen_curve_bend > 8.0) {
+		table_gen_usage();
+		return 1;
+	}
+
+	table_gen_sine();
+	table_gen_finish("sine.h", check);
+	table_gen_lfo();
+	table_gen_finish("lfo_freq.h", check);
+	table_gen_env();
+	table_gen_finish("env_freq.h", check);
+	table_gen_note();
+	table_gen_finish("note_to_val.h", check);
+	table_gen_step();
+	table_gen_finish("steps.h", check);
+	table_gen_curve();
+	table_gen_finish("env_curve.h", check);
+	return table_gen_errors ? 1 : 0;
+}
+
+//
+// tables
+//
+// sine - one cycle centred on half scale
+void table_gen_sine(void) {
+	long vals[TABLE_GEN_SINE_LEN];
+	double half = (double)((1 << (table_gen_dac_bits - 1)) - 1);
+	int i;
+	for(i = 0; i < TABLE_GEN_SINE_LEN; i ++) {
+		vals[i] = (long)floor(half + (half * sin(2.0 * M_PI * i / TABLE_GEN_SINE_LEN)) + 0.5);
+	}
+	table_gen_printf("// sine lookup - %d bit - made by tools/table_gen.c\r\n",
+		table_gen_dac_bits);
+	table_gen_list("unsigned int", "sine1024[]", vals, TABLE_GEN_SINE_LEN, 1);
+}
+
+// LFO - each speed has a period a fixed ratio shorter than the one before
+void table_gen_lfo(void) {
+	long vals[TABLE_GEN_SPEEDS];
+	double period;
+	int i;
+	for(i = 0; i < TABLE_GEN_SPEEDS; i ++) {
+		period = table_gen_lfo_slow * pow(table_gen_lfo_ratio, i);
+		vals[i] = (long)floor((TABLE_GEN_LFO_CYCLE / (period * table_gen_rate)) + 0.5);
+	}
+	table_gen_printf("// LFO speed lookup - %gs period x %g per step - %gHz sample rate - made by tools/table_gen.c\r\n",
+		table_gen_lfo_slow, table_gen_lfo_ratio, table_gen_rate);
+	table_gen_list("unsigned int", "lfo_freq_table[]", vals, TABLE_GEN_SPEEDS, 0);
+}
+
+// envelope - ramp time follows a power curve up to the longest time
+// - the curve starts 2 steps in so the fastest ramp still takes a few samples
+void table_gen_env(void) {
+	long vals[TABLE_GEN_SPEEDS];
+	double ramp;
+	int i;
+	for(i = 0; i < TABLE_GEN_SPEEDS; i ++) {
+		ramp = table_gen_env_long * pow((i + 2) / (double)TABLE_GEN_SPEEDS, table_gen_env_curve);
+		vals[i] = (long)floor((TABLE_GEN_ENV_RAMP / (ramp * table_gen_rate)) + 0.5);
+	}
+	table_gen_printf("// envelope time lookup - %gs longest ramp - power %g - %gHz sample rate - made by tools/table_gen.c\r\n",
+		table_gen_env_long, table_gen_env_curve, table_gen_rate);
+	table_gen_list("unsigned int", "env_freq_table[]", vals, TABLE_GEN_SPEEDS, 0);
+}
+
+// note to DAC value - notes spread evenly over full scale
+void table_gen_note(void) {
+	long vals[TABLE_GEN_NOTES];
+	double full = (double)((1 << table_gen_dac_bits) - 1);
+	int i;
+	for(i = 0; i < TABLE_GEN_NOTES; i ++) {
+		vals[i] = (long)floor((full * i / (TABLE_GEN_NOTES - 1)) + 0.5);
+	}
+	table_gen_printf("// note to val lookup - %d bit - made by tools/table_gen.c\r\n",
+		table_gen_dac_bits);
+	table_gen_list("int", "note_to_val[]", vals, TABLE_GEN_NOTES, 1);
+}
+
+// steps - each note moved to the nearest multiple of the step - top note is the limit
+void table_gen_step(void) {
+	long vals[TABLE_GEN_NOTES];
+	int i, j, step;
+	table_gen_printf("// steps lookup - made by tools/table_gen.c\r\n");
+	table_gen_printf("%sunsigned char steps[%d][%d] = {\r\n",
+		table_gen_narrow ? "const " : "", table_gen_num_steps, TABLE_GEN_NOTES);
+	for(i = 0; i < table_gen_num_steps; i ++) {
+		step = table_gen_steps[i];
+		table_gen_printf("{\r\n");
+		for(j = 0; j < TABLE_GEN_NOTES; j ++) {
+			vals[j] = ((j + j + step) / (step + step)) * step;
+			if(vals[j] > TABLE_GEN_NOTES - 1) {
+				vals[j] = TABLE_GEN_NOTES - 1;
+			}
+			table_gen_printf("  %ld%s\r\n", vals[j], j < TABLE_GEN_NOTES - 1 ? "," : "");
+		}
+		table_gen_printf("}%s\r\n", i < table_gen_num_steps - 1 ? "," : "");
+	}
+	table_gen_printf("};\r\n");
+}
+
+// envelope segment curves - exp rises slowly at first, log is exp turned around
+void table_gen_curve(void) {
+	table_gen_printf("// envelope segment curve lookup - bend %g - made by tools/table_gen.c\r\n",
+		table_gen_curve_bend);
+	table_gen_printf("// value << 16 | rise to the next entry - value is 4095 << 4 at the top\r\n");
+	table_gen_curve_list("env_curve_exp[]", table_gen_curve_bend);
+	table_gen_curve_list("env_curve_log[]", -table_gen_curve_bend);
+}
+
+// add one curve - (e^kx - 1) / (e^k - 1) - a negative k bends the other way
+void table_gen_curve_list(const char *decl, double bend) {
+	long vals[TABLE_GEN_CURVE_LEN];
+	long level[TABLE_GEN_CURVE_LEN];
+	double x;
+	int i;
+	for(i = 0; i < TABLE_GEN_CURVE_LEN; i ++) {
+		x = (double)i / (TABLE_GEN_CURVE_LEN - 1);
+		level[i] = (long)floor((TABLE_GEN_CURVE_FULL * (exp(bend * x) - 1.0) /
+			(exp(bend) - 1.0)) + 0.5);
+	}
+	for(i = 0; i < TABLE_GEN_CURVE_LEN; i ++) {
+		vals[i] = level[i] << 16;
+		if(i < TABLE_GEN_CURVE_LEN - 1) {
+			vals[i] |= level[i + 1] - level[i];
+		}
+	}
+	table_gen_list("unsigned int", decl, vals, TABLE_GEN_CURVE_LEN, 0);
+}
+
+//
+// output
+//
+// add text to the output buffer
+void table_gen_printf(const char *fmt, ...) {
+	va_list ap;
+	va_start(ap, fmt);
+	table_gen_len += vsnprintf(table_gen_buf + table_gen_len,
+		TABLE_GEN_BUF_SIZE - table_gen_len, fmt, ap);
+	va_end(ap);
+	if(table_gen_len >= TABLE_GEN_BUF_SIZE) {
+		fprintf(stderr, "table_gen: output too big\n");
+		exit(1);
+	}
+}
+
+// add a one dimensional table
+// - can_narrow = 0 for tables the code keeps pointers to
+void table_gen_list(const char *type, const char *decl, long *vals, int len, int can_narrow) {
+	int i;
+	if(table_gen_narrow && can_narrow) {
+		type = table_gen_type(vals, len);
+	}
+	table_gen_printf("%s%s %s = {\r\n", table_gen_narrow ? "const " : "", type, decl);
+	for(i = 0; i < len; i ++) {
+		table_gen_printf("%ld\t%s\r\n", vals[i], i < len - 1 ? "," : "");
+	}
+	table_gen_printf("};\r\n");
+}
+
+// get the smallest type for a table
+const char *table_gen_type(long *vals, int len) {
+	long max = 0;
+	int i;
+	for(i = 0; i < len; i ++) {
+		if(vals[i] > max) {
+			max = vals[i];
+		}
+	}
+	if(max <= 0xff) {
+		return "unsigned char";
+	}
+	if(max <= 0xffff) {
+		return "unsigned short";
+	}
+	return "unsigned int";
+}
+
+// write the output buffer to a header - or compare it with the header
+void table_gen_finish(const char *name, int check) {
+	char path[1024];
+	static char old[TABLE_GEN_BUF_SIZE];
+	FILE *f;
+	int len, i;
+	snprintf(path, sizeof(path), "%s/%s", table_gen_dir, name);
+	if(check) {
+		f = fopen(path, "rb");
+		if(f == NULL) {
+			fprintf(stderr, "%s: can't open\n", path);
+			table_gen_errors ++;
+		}
+		else {
+			len = fread(old, 1, TABLE_GEN_BUF_SIZE, f);
+			fclose(f);
+			for(i = 0; i < len && i < table_gen_len && old[i] == table_gen_buf[i]; i ++);
+			if(i == len && i == table_gen_len) {
+				printf("%s: ok\n", path);
+			}
+			else {
+				printf("%s: differs at byte %d\n", path, i);
+				table_gen_errors ++;
+			}
+		}
+	}
+	else {
+		f = fopen(path, "wb");
+		if(f == NULL || fwrite(table_gen_buf, 1, table_gen_len, f) != (size_t)table_gen_len) {
+			fprintf(stderr, "%s: can't write\n", path);
+			table_gen_errors ++;
+		}
+		if(f != NULL) {
+			fclose(f);
+		}
+	}
+	table_gen_len = 0;
+}
+
+// parse a list of steps - returns 0 on error
+int table_gen_parse_steps(const char *arg) {
+	char *end;
+	long step;
+	table_gen_num_steps = 0;
+	while(*arg) {
+		step = strtol(arg, &end, 10);
+		if(end == arg || step < 1 || step > TABLE_GEN_NOTES - 1 ||
+				table_gen_num_steps == TABLE_GEN_MAX_STEPS) {
+			return 0;
+		}
+		table_gen_steps[table_gen_num_steps ++] = step;
+		arg = end;
+		if(*arg == ',') {
+			arg ++;
+		}
+	}
+	return table_gen_num_steps > 0;
+}
+
+// show the usage
+void table_gen_usage(void) {
+	fprintf(stderr, "usage: table_gen [-check] [-narrow] [-rate hz] [-dac-bits n]\n"
+		"\t[-lfo-slow s] [-lfo-ratio r] [-env-long s] [-env-curve n]\n"
+		"\t[-steps a,b,...] [-curve-bend k] [-dir path]\n");
+}
@@ -0,0 +1,246 @@
+/*
+ * K65 Phenol - Mixer ADC Scan Test
+ *
+ * Copyright 2015: Andrew Kilpatrick
+ * Written by: Andrew Kilpatrick
+ *
+ * Runs the mixer ioctl.c against the ADC model in stubs/plib.c. The model
+ * scans the pin levels into the result buffer and the 250us timer task
+ * reads it after a random number of conversions, so at any point in the
+ * scan:
+ *	- the scan is AN0, AN4, AN5, AN6, AN7, AN8, AN11 and AN12 into
+ *	  ADC1BUF0-7 - each one set to analog and one input per slot
+ *	- moving one pin at a time, only the pot or the DC in sense that is
+ *	  wired to that pin follows it - the others stay where they were
+ *	- every channel settles on full scale and on zero, and the smoothed
+ *	  value with its ANALOG_FRAC_BITS gets to within 2 counts of a level
+ *	  in between
+ * The time each channel takes to get 63% of the way to a step is printed,
+ * and must be within a quarter of the time in ioctl.h.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "plib.h"
+#include "harness.h"
+#include "ioctl.h"
+#include "analog_filter.h"
+#include "timer_wheel.h"
+#include "dac_led.h"
+
+#define TEST_MIN_CONV 20  // conversions between timer ticks
+#define TEST_MAX_CONV 50
+#define TEST_SETTLE_TICKS 800  // 200ms - many times the slowest smoothing
+#define TEST_WINDOW 32  // ANALOG_WINDOW_THRESH - the outputs only move by more
+#define TEST_POT_MS 8.0  // time to 63% in ioctl.h
+#define TEST_CV_MS 2.0
+#define TEST_DC_IN -1  // not a pot
+
+// a mixer analog input
+struct test_chan {
+	const char *name;
+	int an;  // ANx pin
+	int pot;  // POT_ channel - or TEST_DC_IN
+};
+
+struct test_chan test_chans[ANALOG_CHANS] = {
+	{"master", 0, POT_MIXER_MASTER},
+	{"delay time", 4, POT_MIXER_DELAY_TIME},
+	{"delay mix", 5, POT_MIXER_DELAY_MIX},
+	{"in 1 level", 6, POT_MIXER_IN1_LEVEL},
+	{"in 2 level", 7, POT_MIXER_IN2_LEVEL},
+	{"pan 1", 8, POT_MIXER_PAN1},
+	{"dc in", 11, TEST_DC_IN},
+	{"pan 2", 12, POT_MIXER_PAN2}
+};
+
+// smoothed values in analog_filter.c
+extern int analog_vals[];
+
+uint32_t test_rand_state = 1;
+
+// local functions
+uint32_t test_rand(void);
+void test_tick(int ticks);
+int test_read(int chan);
+int test_smoothed(int chan);
+void test_scan(void);
+void test_follow(void);
+void test_settle(void);
+void test_step(void);
+
+int main(int argc, char *argv[]) {
+	timer_wheel_init();
+	ioctl_init();
+	test_scan();
+	test_follow();
+	test_settle();
+	test_step();
+	return harness_done("adc_scan_test");
+}
+
+//
+// local functions
+//
+// repeatable random numbers
+uint32_t test_rand(void) {
+	test_rand_state ^= test_rand_state << 13;
+	test_rand_state ^= test_rand_state >> 17;
+	test_rand_state ^= test_rand_state << 5;
+	return test_rand_state;
+}
+
+// run the timer task with the ADC converting in between
+void test_tick(int ticks) {
+	while(ticks -- > 0) {
+		plib_adc_convert(TEST_MIN_CONV + (test_rand() % (TEST_MAX_CONV - TEST_MIN_CONV + 1)));
+		ioctl_timer_task();
+	}
+}
+
+// read a channel the way the rest of the firmware does - 12 bit
+int test_read(int chan) {
+	if(test_chans[chan].pot == TEST_DC_IN) {
+		return ioctl_get_dc_vsense();
+	}
+	return ioctl_get_pot(test_chans[chan].pot) << 4;
+}
+
+// get the smoothed value of a channel before the window - 12 bit
+int test_smoothed(int chan) {
+	return analog_vals[chan] >> ANALOG_FRAC_BITS;
+}
+
+// check the scan order and that the slots hold the right pins
+void test_scan(void) {
+	int i, chan, got, bad = 0;
+
+	HARNESS_CHECK(plib_adc_num_scan == ANALOG_CHANS, "%d inputs are scanned - wanted %d",
+		plib_adc_num_scan, ANALOG_CHANS);
+	HARNESS_CHECK(plib_adc_samples == plib_adc_num_scan, "%d samples per interrupt for "
+		"%d inputs", plib_adc_samples, plib_adc_num_scan);
+	for(chan = 0; chan < ANALOG_CHANS && chan < plib_adc_num_scan; chan ++) {
+		HARNESS_CHECK(plib_adc_scan[chan] == test_chans[chan].an, "slot %d is AN%d - "
+			"wanted AN%d", chan, plib_adc_scan[chan], test_chans[chan].an);
+		HARNESS_CHECK(plib_adc_analog & (1 << test_chans[chan].an), "AN%d is not analog",
+			test_chans[chan].an);
+	}
+
+	// a level on each pin - the pins that are not used have their own
+	for(i = 0; i < PLIB_ADC_INPUTS; i ++) {
+		plib_adc_pin[i] = 37 + (i * 71);
+	}
+	for(i = 0; i < 1000; i ++) {
+		plib_adc_convert(TEST_MIN_CONV + (test_rand() % (TEST_MAX_CONV - TEST_MIN_CONV + 1)));
+		for(chan = 0; chan < ANALOG_CHANS; chan ++) {
+			got = ReadADC10(chan);
+			if(got != plib_adc_pin[test_chans[chan].an] && bad < 5) {
+				HARNESS_CHECK(0, "ADC1BUF%d has %d - AN%d is at %d", chan, got,
+					test_chans[chan].an, plib_adc_pin[test_chans[chan].an]);
+				bad ++;
+			}
+		}
+	}
+}
+
+// move each pin on its own and check only its own channel follows it
+void test_follow(void) {
+	int chan, other, level, before[ANALOG_CHANS];
+
+	for(chan = 0; chan < ANALOG_CHANS; chan ++) {
+		plib_adc_pin[test_chans[chan].an] = 512;
+	}
+	test_tick(TEST_SETTLE_TICKS);
+	for(chan = 0; chan < ANALOG_CHANS; chan ++) {
+		for(level = 128; level < 1024; level += 384) {
+			for(other = 0; other < ANALOG_CHANS; other ++) {
+				before[other] = test_read(other);
+			}
+			plib_adc_pin[test_chans[chan].an] = level;
+			test_tick(TEST_SETTLE_TICKS);
+			HARNESS_CHECK(abs(test_read(chan) - (level << 2)) <= TEST_WINDOW, "%s: AN%d is at "
+				"%d - read %d", test_chans[chan].name, test_chans[chan].an, level << 2,
+				test_read(chan));
+			for(other = 0; other < ANALOG_CHANS; other ++) {
+				if(other != chan) {
+					HARNESS_CHECK(test_read(other) == before[other], "%s: moved from %d to %d "
+						"with AN%d", test_chans[other].name, before[other], test_read(other),
+						test_chans[chan].an);
+				}
+			}
+		}
+		plib_adc_pin[test_chans[chan].an] = 512;
+		test_tick(TEST_SETTLE_TICKS);
+	}
+}
+
+// all the channels get to full scale, zero and close to a level between
+void test_settle(void) {
+	static int levels[] = {1023, 0, 700, 0, 300, 1023};
+	int i, chan;
+
+	for(i = 0; i < (int)(sizeof(levels) / sizeof(int)); i ++) {
+		for(chan = 0; chan < ANALOG_CHANS; chan ++) {
+			plib_adc_pin[test_chans[chan].an] = levels[i];
+		}
+		test_tick(TEST_SETTLE_TICKS);
+		for(chan = 0; chan < ANALOG_CHANS; chan ++) {
+			if(levels[i] == 1023) {
+				HARNESS_CHECK(analog_filter_get_val(chan) == ANALOG_MAXVAL, "%s: settled on %d "
+					"at full scale", test_chans[chan].name, analog_filter_get_val(chan));
+			}
+			else if(levels[i] == 0) {
+				HARNESS_CHECK(analog_filter_get_val(chan) == ANALOG_MINVAL, "%s: settled on %d "
+					"at zero", test_chans[chan].name, analog_filter_get_val(chan));
+			}
+			HARNESS_CHECK(abs(test_smoothed(chan) - (levels[i] << 2)) <= 2, "%s: smoothed "
+				"value settled on %d - input is %d", test_chans[chan].name,
+				test_smoothed(chan), levels[i] << 2);
+		}
+	}
+}
+
+// time a step from zero to full scale to 63% on each channel
+void test_step(void) {
+	int chan, ticks[ANALOG_CHANS], tick, done;
+	double ms, want;
+
+	for(chan = 0; chan < ANALOG_CHANS; chan ++) {
+		plib_adc_pin[test_chans[chan].an] = 0;
+		ticks[chan] = -1;
+	}
+	test_tick(TEST_SETTLE_TICKS);
+	for(chan = 0; chan < ANALOG_CHANS; chan ++) {
+		plib_adc_pin[test_chans[chan].an] = 1023;
+	}
+	for(tick = 1, done = 0; tick <= TEST_SETTLE_TICKS && done < ANALOG_CHANS; tick ++) {
+		test_tick(1);
+		for(chan = 0; chan < ANALOG_CHANS; chan ++) {
+			if(ticks[chan] == -1 && test_smoothed(chan) >= (1023 << 2) * 0.632) {
+				ticks[chan] = tick;
+				done ++;
+			}
+		}
+	}
+	for(chan = 0; chan < ANALOG_CHANS; chan ++) {
+		ms = ticks[chan] * 0.25;
+		want = (test_chans[chan].pot == TEST_DC_IN) ? TEST_CV_MS : TEST_POT_MS;
+		fprintf(stderr, "adc_scan_test: %-10s AN%-2d - ADC1BUF%d - 63%% of a step in %.2fms\n",
+			test_chans[chan].name, test_chans[chan].an, chan, ms);
+		HARNESS_CHECK(ticks[chan] != -1 && ms >= want * 0.75 && ms <= want * 1.25,
+			"%s: 63%% of a step took %.2fms - wanted about %.1fms", test_chans[chan].name,
+			ms, want);
+	}
+}
+
+//
+// dac_led.c - the LEDs and DACs are not looked at
+//
+void dac_led_init(void) {
+}
+
+void dac_led_write_dac(unsigned char chan, unsigned int val) {
+}
+
+void dac_led_write_led(unsigned int val) {
+}
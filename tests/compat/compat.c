@@ -0,0 +1,61 @@
+/*
+ * K65 Phenol - Stand-Ins for Modules Older Trees Don't Have
+ *
+ * Copyright 2015: Andrew Kilpatrick
+ * Written by: Andrew Kilpatrick
+ *
+ * Weak do-nothing versions of the functions the runners call - the real
+ * module is used when the tree has it. See compat.h.
+ *
+ */
+#include "compat.h"
+
+// timer wheel
+COMPAT_WEAK void timer_wheel_init(void) {
+}
+
+COMPAT_WEAK void timer_wheel_task(void) {
+}
+
+// flash store
+COMPAT_WEAK void seq_store_init(void) {
+}
+
+COMPAT_WEAK void seq_store_poll(void) {
+}
+
+COMPAT_WEAK void seq_store_set_idle(int idle) {
+}
+
+// sequencer main loop task
+COMPAT_WEAK void seq_poll(void) {
+}
+
+// ISR load meter
+COMPAT_WEAK void isr_load_init(void) {
+}
+
+COMPAT_WEAK unsigned int isr_load_start(void) {
+	return 0;
+}
+
+COMPAT_WEAK void isr_load_end(int isr, unsigned int start) {
+}
+
+COMPAT_WEAK void isr_load_timer_task(void) {
+}
+
+COMPAT_WEAK int isr_load_get_load(int isr) {
+	return 0;
+}
+
+COMPAT_WEAK int isr_load_get_max(int isr) {
+	return 0;
+}
+
+// telemetry
+COMPAT_WEAK void telem_init(void) {
+}
+
+COMPAT_WEAK void telem_timer_task(void) {
+}
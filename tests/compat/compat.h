@@ -0,0 +1,29 @@
+/*
+ * K65 Phenol - Stand-Ins for Modules Older Trees Don't Have
+ *
+ * Copyright 2015: Andrew Kilpatrick
+ * Written by: Andrew Kilpatrick
+ *
+ * The runners call the timer wheel, flash store, ISR load meter,
+ * telemetry and sequencer main loop task, which were added after the
+ * baseline firmware. When the traces are run against an older tree (make
+ * ref) this directory is on the include path after the firmware, so only
+ * the headers the tree is missing are taken from here, and compat.c gives
+ * weak do-nothing functions that the real ones take the place of. This
+ * header is included ahead of every file so the runner sees the CV and
+ * sequencer functions the baseline headers don't declare.
+ *
+ */
+#ifndef COMPAT_H
+#define COMPAT_H
+
+#define COMPAT_WEAK __attribute__((weak))
+
+// cv_gate_ctrl.c
+void cv_gate_ctrl_off(void);
+void cv_gate_ctrl_timer_task(void);
+
+// seq.c
+void seq_poll(void);
+
+#endif
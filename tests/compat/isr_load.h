@@ -0,0 +1,24 @@
+/*
+ * K65 Phenol - ISR Load Meter Stand-In
+ *
+ * Copyright 2015: Andrew Kilpatrick
+ * Written by: Andrew Kilpatrick
+ *
+ */
+#ifndef ISR_LOAD_H
+#define ISR_LOAD_H
+
+// ISRs - mixer and mod
+#define ISR_LOAD_TIMER1 0
+#define ISR_LOAD_UART2 1
+#define ISR_LOAD_SPI1 2
+#define ISR_LOAD_TIMER2 1
+
+void isr_load_init(void);
+unsigned int isr_load_start(void);
+void isr_load_end(int isr, unsigned int start);
+void isr_load_timer_task(void);
+int isr_load_get_load(int isr);
+int isr_load_get_max(int isr);
+
+#endif
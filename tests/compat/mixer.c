@@ -0,0 +1,24 @@
+/*
+ * K65 Phenol - Stand-Ins for Mixer Functions Older Trees Don't Have
+ *
+ * Copyright 2015: Andrew Kilpatrick
+ * Written by: Andrew Kilpatrick
+ *
+ * Weak versions of the mixer functions the runner calls that were added
+ * after the baseline firmware - each does what the baseline did in its
+ * place. See compat.h.
+ *
+ */
+#include "compat.h"
+#include "ioctl.h"
+
+// the output off code from the baseline Timer1 ISR
+COMPAT_WEAK void cv_gate_ctrl_off(void) {
+	ioctl_set_midi_cv_out(0, DAC_VAL_NOM);
+	ioctl_set_midi_cv_out(1, DAC_VAL_NOM);
+	ioctl_set_midi_gate_out(0);
+}
+
+// the baseline has no CV timer task
+COMPAT_WEAK void cv_gate_ctrl_timer_task(void) {
+}
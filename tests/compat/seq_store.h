@@ -0,0 +1,20 @@
+/*
+ * K65 Phenol - Flash Store Stand-In
+ *
+ * Copyright 2015: Andrew Kilpatrick
+ * Written by: Andrew Kilpatrick
+ *
+ */
+#ifndef SEQ_STORE_H
+#define SEQ_STORE_H
+
+// init the store
+void seq_store_init(void);
+
+// run the store - call from the main loop
+void seq_store_poll(void);
+
+// set whether the unit is off or in standby - 1 = idle
+void seq_store_set_idle(int idle);
+
+#endif
@@ -0,0 +1,14 @@
+/*
+ * K65 Phenol - Telemetry Stand-In
+ *
+ * Copyright 2015: Andrew Kilpatrick
+ * Written by: Andrew Kilpatrick
+ *
+ */
+#ifndef TELEM_H
+#define TELEM_H
+
+void telem_init(void);
+void telem_timer_task(void);
+
+#endif
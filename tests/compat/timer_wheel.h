@@ -0,0 +1,17 @@
+/*
+ * K65 Phenol - Timer Wheel Stand-In
+ *
+ * Copyright 2015: Andrew Kilpatrick
+ * Written by: Andrew Kilpatrick
+ *
+ */
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+// init the timer wheel
+void timer_wheel_init(void);
+
+// run the timer wheel task - call once per tick (250us)
+void timer_wheel_task(void);
+
+#endif
@@ -0,0 +1,201 @@
+/*
+ * K65 Phenol - CV Calibration Test
+ *
+ * Copyright 2015: Andrew Kilpatrick
+ * Written by: Andrew Kilpatrick
+ *
+ * Runs the CV / gate control code on its own with random calibrations set
+ * up with the calibration select and adjust calls, including the largest
+ * corrections in opposite directions in neighbouring octaves. For each
+ * one the note table is checked against the corrections interpolated
+ * with real numbers:
+ *	- every note from NOTE_LOW to NOTE_HIGH is above the one below it
+ *	- the calibration notes are exactly on their corrected values
+ *	- the other notes are less than 1 DAC step from the straight line
+ *	  between the points
+ *	- a one semitone bend lands within 1 DAC step of the next note
+ * The calibration is saved, the store is remounted and the loaded table
+ * must be the same.
+ *
+ * The cost of a note on is printed with no calibration and with the
+ * largest corrections - it should be the same since it is one table read.
+ *
+ */
+#include <stdio.h>
+#include <string.h>
+#include "plib.h"
+#include "harness.h"
+#include "cv_gate_ctrl.h"
+#include "seq_store.h"
+
+#define TEST_CALS 2000  // random calibrations
+#define TEST_DAC_OFFSET 79  // the DAC value for note 0 with no correction
+#define TEST_CAL_RANGE 127
+
+// note table in cv_gate_ctrl.c
+extern unsigned int note_lookup[];
+
+int test_dac[2];  // the DAC outputs
+int test_point[CV_CAL_POINTS];  // the corrections set
+uint32_t test_rand_state = 1;
+
+// local functions
+uint32_t test_rand(void);
+void test_set(void);
+void test_check(int cal);
+void test_save_load(void);
+double test_note_on_ns(void);
+
+int main(int argc, char *argv[]) {
+	int cal, i;
+	double flat_ns, cal_ns = 0;
+
+	plib_flash_reset();
+	seq_store_init();
+	cv_gate_ctrl_init();
+
+	// no calibration
+	memset(test_point, 0, sizeof(test_point));
+	test_set();
+	test_check(-1);
+	flat_ns = test_note_on_ns();
+
+	// random calibrations - the first ones zig zag as far as they go
+	for(cal = 0; cal < TEST_CALS; cal ++) {
+		for(i = 0; i < CV_CAL_POINTS; i ++) {
+			if(cal < 2) {
+				test_point[i] = ((i + cal) & 0x01) ? TEST_CAL_RANGE : -TEST_CAL_RANGE;
+			}
+			else {
+				test_point[i] = (int)(test_rand() % ((TEST_CAL_RANGE * 2) + 1)) -
+					TEST_CAL_RANGE;
+			}
+		}
+		test_set();
+		test_check(cal);
+		if(cal == 0) {
+			cal_ns = test_note_on_ns();
+		}
+	}
+	test_save_load();
+
+	fprintf(stderr, "cv_cal_test: note on: %.1fns with no calibration - "
+		"%.1fns calibrated\n", flat_ns, cal_ns);
+	return harness_done("cv_cal_test");
+}
+
+//
+// local functions
+//
+// repeatable random numbers
+uint32_t test_rand(void) {
+	test_rand_state ^= test_rand_state << 13;
+	test_rand_state ^= test_rand_state >> 17;
+	test_rand_state ^= test_rand_state << 5;
+	return test_rand_state;
+}
+
+// set the calibration points like the calibration CCs do
+void test_set(void) {
+	int i;
+	for(i = 0; i < CV_CAL_POINTS; i ++) {
+		cv_gate_ctrl_cal_select(i);
+		cv_gate_ctrl_cal_adjust(test_point[i]);
+	}
+}
+
+// check the note table against the calibration
+void test_check(int cal) {
+	int note, point, errors = 0;
+	double corr, expect, err, bend;
+
+	for(note = NOTE_LOW; note <= NOTE_HIGH && errors < 5; note ++) {
+		if(note > NOTE_LOW && note_lookup[note] <= note_lookup[note - 1]) {
+			HARNESS_CHECK(0, "cal %d: note %d is %d - not above note %d", cal,
+				note, note_lookup[note], note - 1);
+			errors ++;
+		}
+
+		// the correction with real numbers
+		point = (note / 12) - 1;
+		if(point < 0) {
+			corr = test_point[0];
+		}
+		else if(point >= CV_CAL_POINTS - 1) {
+			corr = test_point[CV_CAL_POINTS - 1];
+		}
+		else {
+			corr = test_point[point] + ((test_point[point + 1] - test_point[point]) *
+				(note % 12)) / 12.0;
+		}
+		expect = TEST_DAC_OFFSET + (note * NOTE_STEP_SIZE) + corr;
+		err = note_lookup[note] - expect;
+		if(err <= -1.0 || err >= 1.0 || ((note % 12) == 0 && err != 0.0)) {
+			HARNESS_CHECK(0, "cal %d: note %d is %d - wanted %.2f", cal,
+				note, note_lookup[note], expect);
+			errors ++;
+		}
+
+		// bend up a semitone
+		if(note < NOTE_HIGH) {
+			cv_gate_ctrl_bend(0, 0);
+			cv_gate_ctrl_note(0, note, 1);
+			cv_gate_ctrl_bend(0, NOTE_STEP_SIZE);
+			bend = test_dac[0] - (double)note_lookup[note + 1];
+			if(bend < -1.0 || bend > 1.0) {
+				HARNESS_CHECK(0, "cal %d: note %d bent up a semitone is %d - wanted %d",
+					cal, note, test_dac[0], note_lookup[note + 1]);
+				errors ++;
+			}
+			cv_gate_ctrl_bend(0, 0);
+			cv_gate_ctrl_note(0, note, 0);
+		}
+	}
+}
+
+// save the calibration and load it again after a reboot
+void test_save_load(void) {
+	static unsigned int saved[128];
+	int i;
+
+	memcpy(saved, note_lookup, sizeof(saved));
+	cv_gate_ctrl_cal_save();
+	seq_store_set_idle(0);
+	for(i = 0; i < 200; i ++) {
+		seq_store_poll();
+	}
+
+	// mess it up and reboot
+	for(i = 0; i < CV_CAL_POINTS; i ++) {
+		cv_gate_ctrl_cal_select(i);
+		cv_gate_ctrl_cal_adjust(0);
+	}
+	seq_store_init();
+	cv_gate_ctrl_init();
+	HARNESS_CHECK(memcmp(saved, note_lookup, sizeof(saved)) == 0,
+		"the loaded note table is not the one that was saved");
+}
+
+// get the cost of a note on
+double test_note_on_ns(void) {
+	int i;
+	double start;
+	start = harness_now_ns();
+	for(i = 0; i < 1000000; i ++) {
+		cv_gate_ctrl_note(0, NOTE_LOW + (i % (NOTE_HIGH - NOTE_LOW + 1)), 1);
+	}
+	return (harness_now_ns() - start) / 1000000;
+}
+
+//
+// ioctl.c - only what the CV / gate control code uses
+//
+void ioctl_set_midi_cv_out(int chan, int val) {
+	test_dac[chan & 0x01] = val;
+}
+
+void ioctl_set_midi_gate_out(int state) {
+}
+
+void ioctl_set_midi_clock_out(int state) {
+}
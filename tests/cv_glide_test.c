@@ -0,0 +1,222 @@
+/*
+ * K65 Phenol - CV Glide Test
+ *
+ * Copyright 2015: Andrew Kilpatrick
+ * Written by: Andrew Kilpatrick
+ *
+ * Runs the CV / gate control code on its own with the 1ms timer task.
+ * Glides between notes of different intervals in both directions on
+ * both CV outputs are compared with a straight line each ms:
+ *	- constant time - every glide takes the glide time
+ *	- constant rate - the glide time is per octave
+ * The DAC output must stay within 1 step of the line, never go back, and
+ * land on the new note by the end of the line. In legato mode
+ * a note played with the gate off must jump straight to the note.
+ *
+ * Then random notes and glide times are played for a while and the DAC
+ * writes are counted against the writes the glide code asks for, to show
+ * how many are saved by only writing when the 12 bit value changes.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "plib.h"
+#include "harness.h"
+#include "cv_gate_ctrl.h"
+#include "seq_store.h"
+
+#define TEST_RANDOM_MS 600000  // random playing time
+
+// glide state in cv_gate_ctrl.c
+extern unsigned int note_lookup[];
+extern int glide_pos[];
+extern int dac1_cur;
+extern int dac2_cur;
+
+int test_dac[2];  // the DAC outputs
+int test_writes;  // DAC writes done
+int test_same;  // DAC writes with the same value as the last one
+uint32_t test_rand_state = 1;
+
+// local functions
+uint32_t test_rand(void);
+int test_target(int chan);
+void test_glide(int chan, int mode, int time, int from, int to);
+void test_legato(int chan);
+void test_random(void);
+
+int main(int argc, char *argv[]) {
+	static int times[] = {1, 10, 100, 1000, 5000};
+	static int notes[][2] = {{60, 72}, {72, 60}, {36, 96}, {60, 61}, {96, 24}};
+	int chan, mode, t, n;
+
+	plib_flash_reset();
+	seq_store_init();
+	cv_gate_ctrl_init();
+	for(chan = 0; chan < 2; chan ++) {
+		for(mode = CV_GLIDE_TIME; mode <= CV_GLIDE_RATE; mode ++) {
+			for(t = 0; t < (int)(sizeof(times) / sizeof(int)); t ++) {
+				for(n = 0; n < (int)(sizeof(notes) / sizeof(notes[0])); n ++) {
+					test_glide(chan, mode, times[t], notes[n][0], notes[n][1]);
+				}
+			}
+		}
+		test_legato(chan);
+	}
+	test_random();
+	HARNESS_CHECK(test_same == 0, "%d DAC writes did not change the value", test_same);
+	return harness_done("cv_glide_test");
+}
+
+//
+// local functions
+//
+// repeatable random numbers
+uint32_t test_rand(void) {
+	test_rand_state ^= test_rand_state << 13;
+	test_rand_state ^= test_rand_state >> 17;
+	test_rand_state ^= test_rand_state << 5;
+	return test_rand_state;
+}
+
+// get the note a CV output is gliding to in DAC steps
+int test_target(int chan) {
+	return chan ? dac2_cur : dac1_cur;
+}
+
+// glide between two notes and compare the output with a straight line
+void test_glide(int chan, int mode, int time, int from, int to) {
+	double start, end, len, expect;
+	int ms, last, ends;
+
+	// jump to the first note and hold it
+	cv_gate_ctrl_set_glide(0, mode, 0);
+	cv_gate_ctrl_note(chan, from, 1);
+	cv_gate_ctrl_set_glide(time, mode, 0);
+	start = note_lookup[from];
+	end = note_lookup[to];
+	HARNESS_CHECK(test_dac[chan] == (int)start, "CV%d: note %d is %d - wanted %d",
+		chan + 1, from, test_dac[chan], (int)start);
+
+	// the glide time in ms
+	if(mode == CV_GLIDE_TIME) {
+		len = time;
+	}
+	else {
+		len = (time * abs((int)end - (int)start)) / (12.0 * NOTE_STEP_SIZE);
+	}
+	cv_gate_ctrl_note(chan, to, 1);
+	last = test_dac[chan];
+	ends = -1;
+	for(ms = 1; ms <= (int)len + 2; ms ++) {
+		cv_gate_ctrl_timer_task();
+		if(ms < len) {
+			expect = start + ((end - start) * ms) / len;
+		}
+		else {
+			expect = end;
+		}
+		if(test_dac[chan] < expect - 1.0 || test_dac[chan] > expect + 1.0) {
+			HARNESS_CHECK(0, "CV%d mode %d time %d: %d to %d: %d at %dms - wanted %.1f",
+				chan + 1, mode, time, from, to, test_dac[chan], ms, expect);
+			break;
+		}
+		if((end > start && test_dac[chan] < last) || (end < start && test_dac[chan] > last)) {
+			HARNESS_CHECK(0, "CV%d mode %d time %d: %d to %d: went back at %dms",
+				chan + 1, mode, time, from, to, ms);
+			break;
+		}
+		if(ends < 0 && glide_pos[chan] == test_target(chan) << 16) {
+			ends = ms;
+		}
+		last = test_dac[chan];
+	}
+	HARNESS_CHECK(ends >= 0 && ends <= (int)ceil(len) && test_dac[chan] == (int)end,
+		"CV%d mode %d time %d: %d to %d: ended at %dms on %d - wanted %.1fms on %d",
+		chan + 1, mode, time, from, to, ends, test_dac[chan], len, (int)end);
+	cv_gate_ctrl_note(chan, to, 0);
+}
+
+// check that legato only glides between overlapping notes
+void test_legato(int chan) {
+	cv_gate_ctrl_set_glide(100, CV_GLIDE_TIME, 1);
+
+	// gate off - jump straight to the note
+	cv_gate_ctrl_note(chan, 48, 0);
+	cv_gate_ctrl_note(chan, 60, 1);
+	HARNESS_CHECK(test_dac[chan] == (int)note_lookup[60],
+		"CV%d legato: first note did not jump", chan + 1);
+
+	// gate on - glide
+	cv_gate_ctrl_note(chan, 72, 1);
+	cv_gate_ctrl_timer_task();
+	HARNESS_CHECK(test_dac[chan] > (int)note_lookup[60] &&
+		test_dac[chan] < (int)note_lookup[72],
+		"CV%d legato: overlapping note did not glide", chan + 1);
+
+	// gate off again part way through - jump
+	cv_gate_ctrl_note(chan, 72, 0);
+	cv_gate_ctrl_note(chan, 36, 1);
+	HARNESS_CHECK(test_dac[chan] == (int)note_lookup[36],
+		"CV%d legato: note after a gap did not jump", chan + 1);
+	cv_gate_ctrl_note(chan, 36, 0);
+	cv_gate_ctrl_set_glide(0, CV_GLIDE_TIME, 0);
+}
+
+// play random notes with random glides and count the DAC writes saved
+void test_random(void) {
+	int ms, chan, asked = 0, next[2] = {0, 0};
+	int mode = 0;
+
+	test_writes = 0;
+	for(ms = 0; ms < TEST_RANDOM_MS; ms ++) {
+		for(chan = 0; chan < 2; chan ++) {
+			if(ms < next[chan]) {
+				continue;
+			}
+			// a new note every 20 to 500ms with up to 2s of glide
+			if((test_rand() & 0x0f) == 0) {
+				mode ^= 1;
+			}
+			cv_gate_ctrl_set_glide(test_rand() % 2000, mode, test_rand() & 0x01);
+			cv_gate_ctrl_note(chan, 24 + (test_rand() % 72), test_rand() & 0x01);
+			asked ++;
+			next[chan] = ms + 20 + (test_rand() % 480);
+		}
+		// the timer task asks for a write on each channel that is gliding
+		for(chan = 0; chan < 2; chan ++) {
+			if(glide_pos[chan] != test_target(chan) << 16) {
+				asked ++;
+			}
+		}
+		cv_gate_ctrl_timer_task();
+		for(chan = 0; chan < 2; chan ++) {
+			if(test_dac[chan] != (glide_pos[chan] + 0x8000) >> 16) {
+				HARNESS_CHECK(0, "random: CV%d is %d at %dms - glide is at %d",
+					chan + 1, test_dac[chan], ms, (glide_pos[chan] + 0x8000) >> 16);
+				return;
+			}
+		}
+	}
+	fprintf(stderr, "cv_glide_test: %d of %d DAC writes saved by change detection "
+		"(%.1f%%)\n", asked - test_writes, asked,
+		(100.0 * (asked - test_writes)) / asked);
+}
+
+//
+// ioctl.c - only what the CV / gate control code uses
+//
+void ioctl_set_midi_cv_out(int chan, int val) {
+	if(val == test_dac[chan & 0x01]) {
+		test_same ++;
+	}
+	test_dac[chan & 0x01] = val;
+	test_writes ++;
+}
+
+void ioctl_set_midi_gate_out(int state) {
+}
+
+void ioctl_set_midi_clock_out(int state) {
+}
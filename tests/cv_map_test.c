@@ -0,0 +1,242 @@
+/*
+ * K65 Phenol - CV Output Mapping Test
+ *
+ * Copyright 2015: Andrew Kilpatrick
+ * Written by: Andrew Kilpatrick
+ *
+ * Runs the whole mixer firmware with the clock out used as gate 2. Each
+ * CV / gate output is mapped in turn to each source with the channel 16
+ * CCs, on two different channels, with the other output turned off:
+ *	- off - nothing changes
+ *	- note - the CV follows the note and pitch bend, the gate the keys
+ *	- CC - the CV follows the CC, the gate is on from 64
+ *	- pitch bend - the CV follows the bend, the gate is on past the
+ *	  trigger point in the set direction
+ *	- velocity - the CV is the note on velocity, the gate the keys
+ *	- channel pressure - the CV follows the pressure, the gate is on
+ *	  from 64
+ * Every message is also sent on another channel, where it must not
+ * change any output. Last the mappings are set, the unit is rebooted and
+ * the saved mappings must still work.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include "harness.h"
+#include "mixer_run.h"
+#include "cv_gate_ctrl.h"
+#include "ioctl.h"
+
+#define TEST_DAC_OFFSET 79
+#define TEST_DAC_HI 3800
+#define TEST_CC 74  // CC number for CC mappings - not used for anything else
+
+// mappings - CC values for the map CCs are these << 4
+#define TEST_MAP_OFF 0
+#define TEST_MAP_NOTE 1
+#define TEST_MAP_CC 2
+#define TEST_MAP_BEND 3
+#define TEST_MAP_VELOCITY 4
+#define TEST_MAP_PRESSURE 5
+
+int test_cv[2];  // CV outputs
+int test_gate[2];  // gate outputs - gate 2 is the clock out
+int test_changes;  // output changes
+
+// local functions
+void test_hook(const char *line);
+void test_run_ms(int ms);
+void test_midi(int len, ...);
+void test_set_map(int out, int map, int chan, int val);
+void test_map(int out, int map, int chan);
+void test_send(int out, int map, int chan, int check, int dir);
+void test_out(int out, int check, int cv, int gate, const char *what, int val);
+int test_dac(int val);
+
+int main(int argc, char *argv[]) {
+	static int chans[] = {0, 9};
+	int out, map, c;
+
+	harness_set_trace_hook(test_hook);
+	mixer_run_init();
+	test_run_ms(5000);  // startup settings time
+	test_midi(3, 0xbf, 30, 127);  // clock out is gate 2
+	test_run_ms(5);
+
+	for(out = 0; out < 2; out ++) {
+		for(map = TEST_MAP_OFF; map <= TEST_MAP_PRESSURE; map ++) {
+			for(c = 0; c < (int)(sizeof(chans) / sizeof(int)); c ++) {
+				test_map(out, map, chans[c]);
+			}
+		}
+	}
+
+	// the mappings are saved
+	test_set_map(0, TEST_MAP_CC, 2, TEST_CC);
+	test_set_map(1, TEST_MAP_PRESSURE, 3, 0);
+	test_run_ms(500);
+	mixer_run_init();
+	test_run_ms(5000);
+	test_midi(3, 0xb2, TEST_CC, 20);
+	test_midi(2, 0xd3, 100);
+	test_run_ms(5);
+	test_out(0, 1, test_dac(20 << 5), 0, "CC after a reboot", 20);
+	test_out(1, 1, test_dac(100 << 5), 1, "pressure after a reboot", 100);
+
+	// back to the default
+	test_set_map(0, TEST_MAP_NOTE, 0, 0);
+	test_set_map(1, TEST_MAP_CC, 0, 1);
+	test_midi(3, 0xbf, 30, 0);
+	test_run_ms(500);
+	return harness_done("cv_map_test");
+}
+
+//
+// local functions
+//
+// take the CV and gate outputs from the trace
+void test_hook(const char *line) {
+	int chan, val;
+	if(sscanf(line, "cv_out %d %d", &chan, &val) == 2) {
+		test_cv[chan & 0x01] = val;
+		test_changes ++;
+	}
+	else if(sscanf(line, "gate_out %d %d", &chan, &val) == 2) {
+		test_gate[0] = val;
+		test_changes ++;
+	}
+	else if(sscanf(line, "clock_out %d", &val) == 1) {
+		test_gate[1] = (val == IOCTL_CLOCK_OUT_ON);
+		test_changes ++;
+	}
+}
+
+// run the firmware for a while
+void test_run_ms(int ms) {
+	int i;
+	for(i = 0; i < ms * 4; i ++) {
+		mixer_run_tick();
+	}
+}
+
+// send MIDI bytes and give them time to arrive
+void test_midi(int len, ...) {
+	va_list ap;
+	int i;
+	va_start(ap, len);
+	for(i = 0; i < len; i ++) {
+		mixer_run_midi_send(va_arg(ap, int));
+	}
+	va_end(ap);
+	test_run_ms(3);
+}
+
+// map an output with the channel 16 CCs
+void test_set_map(int out, int map, int chan, int val) {
+	test_midi(3, 0xbf, 24 + out, map << 4);
+	test_midi(3, 0xbf, 26 + out, chan);
+	test_midi(3, 0xbf, 28 + out, val);
+}
+
+// map an output and check it on its channel and another one
+void test_map(int out, int map, int chan) {
+	int other = (chan + 3) & 0x0f;
+	test_set_map(out ^ 1, TEST_MAP_OFF, other, 0);
+	test_set_map(out, map, chan, map == TEST_MAP_CC ? TEST_CC : 0);
+	test_run_ms(10);
+
+	test_changes = 0;
+	test_send(out, map, chan, map != TEST_MAP_OFF, 0);
+	HARNESS_CHECK(map != TEST_MAP_OFF || test_changes == 0,
+		"output %d off on channel %d: %d outputs changed", out + 1, chan + 1, test_changes);
+	test_changes = 0;
+	test_send(out, map, other, 0, 0);
+	HARNESS_CHECK(test_changes == 0, "output %d map %d on channel %d: "
+		"%d outputs changed from channel %d", out + 1, map, chan + 1, test_changes,
+		other + 1);
+
+	// pitch bend in the other direction
+	if(map == TEST_MAP_BEND) {
+		test_set_map(out, map, chan, 1);
+		test_send(out, map, chan, 1, 1);
+	}
+}
+
+// send the messages for a mapping on a channel and check the outputs
+// - dir = the pitch bend gate direction - 0 = up, 1 = down
+void test_send(int out, int map, int chan, int check, int dir) {
+	static int vals[] = {0, 1, 63, 64, 100, 127};
+	static int bends[] = {0, 0x17fe, 0x17ff, 0x2000, 0x27ff, 0x2800, 0x3fff};
+	int i, note;
+
+	// notes
+	for(i = 0; i < (int)(sizeof(vals) / sizeof(int)); i ++) {
+		note = 36 + (i * 7);
+		test_midi(3, 0x90 | chan, note, vals[i] | 0x01);
+		if(map == TEST_MAP_NOTE) {
+			test_out(out, check, test_dac(note * NOTE_STEP_SIZE), 1, "note", note);
+		}
+		else if(map == TEST_MAP_VELOCITY) {
+			test_out(out, check, test_dac((vals[i] | 0x01) << 5), 1, "velocity", vals[i] | 0x01);
+		}
+		test_midi(3, 0x80 | chan, note, 0);
+		if(map == TEST_MAP_NOTE || map == TEST_MAP_VELOCITY) {
+			test_out(out, check, test_cv[out], 0, "note off", note);
+		}
+	}
+
+	// bend a held note
+	test_midi(3, 0x90 | chan, 60, 100);
+	for(i = 0; i < (int)(sizeof(bends) / sizeof(int)); i ++) {
+		test_midi(3, 0xe0 | chan, bends[i] & 0x7f, bends[i] >> 7);
+		if(map == TEST_MAP_NOTE) {
+			if(bends[i] == 0x2000) {
+				test_out(out, check, test_dac(60 * NOTE_STEP_SIZE), 1, "bend", bends[i]);
+			}
+			HARNESS_CHECK(!check || (bends[i] > 0x2000) == (test_cv[out] > test_dac(60 * NOTE_STEP_SIZE)),
+				"output %d note: bend %d is %d", out + 1, bends[i], test_cv[out]);
+		}
+		else if(map == TEST_MAP_BEND) {
+			test_out(out, check, test_dac(bends[i] >> 2),
+				dir ? (bends[i] < 0x17ff) : (bends[i] > 0x27ff), "bend", bends[i]);
+		}
+	}
+	test_midi(3, 0xe0 | chan, 0x00, 0x40);
+	test_midi(3, 0x80 | chan, 60, 0);
+
+	// CCs and pressure
+	for(i = 0; i < (int)(sizeof(vals) / sizeof(int)); i ++) {
+		test_midi(3, 0xb0 | chan, TEST_CC, vals[i]);
+		if(map == TEST_MAP_CC) {
+			test_out(out, check, test_dac(vals[i] << 5), vals[i] >= 64, "CC", vals[i]);
+		}
+		test_midi(3, 0xb0 | chan, TEST_CC + 1, 127 - vals[i]);
+		if(map == TEST_MAP_CC) {
+			test_out(out, check, test_dac(vals[i] << 5), vals[i] >= 64, "other CC", vals[i]);
+		}
+		test_midi(2, 0xd0 | chan, vals[i]);
+		if(map == TEST_MAP_PRESSURE) {
+			test_out(out, check, test_dac(vals[i] << 5), vals[i] >= 64, "pressure", vals[i]);
+		}
+	}
+}
+
+// check an output
+void test_out(int out, int check, int cv, int gate, const char *what, int val) {
+	if(!check) {
+		return;
+	}
+	HARNESS_CHECK(test_cv[out] == cv && test_gate[out] == gate,
+		"output %d %s %d: CV %d gate %d - wanted CV %d gate %d", out + 1, what, val,
+		test_cv[out], test_gate[out], cv, gate);
+}
+
+// get the DAC value for a CV value
+int test_dac(int val) {
+	val += TEST_DAC_OFFSET;
+	if(val > TEST_DAC_HI) {
+		val = TEST_DAC_HI;
+	}
+	return val;
+}
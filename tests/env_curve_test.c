@@ -0,0 +1,317 @@
+/*
+ * K65 Phenol - Envelope Curve Test
+ *
+ * Copyright 2015: Andrew Kilpatrick
+ * Written by: Andrew Kilpatrick
+ *
+ * Checks the exp / log envelope segment curves against the analytic curve
+ * they are made from - (e^kx - 1) / (e^k - 1) with k = 4 for exp and -4
+ * for log:
+ *	- the table lookup with interpolation over every 256th accumulator
+ *	  value must be within half an LSB of the curve at 12 bits, and must
+ *	  never go down
+ *	- an AR envelope on mod 1 with a log rise and an exp fall must follow
+ *	  the curve on every sample to within an LSB, and must take the same
+ *	  number of samples as a linear one
+ *	- turning a segment around part way - a gate release on the rise in
+ *	  AHR mode or a retrigger on the fall - must carry on from the same
+ *	  output to within an LSB
+ *
+ * The cost per sample of the envelope with linear segments, with curved
+ * segments and of working out the curve with exp() instead are printed.
+ *
+ */
+#include <stdio.h>
+#include <math.h>
+#include "harness.h"
+#include "mod_io.h"
+#include "env_proc.h"
+
+#define TEST_BEND 4.0  // curve bend - as made by tools/table_gen.c
+#define TEST_FULL 65520.0  // curve value at the top - 12 bit full scale << 4
+#define TEST_MAXVAL 1073741824  // top of the accumulator
+#define TEST_RAMP 1000  // samples in a ramp
+#define TEST_TURNS 500  // turnarounds each way
+#define TEST_BENCH_SAMPLES 4000000
+
+// modes and states - as in env_proc.c
+#define ENV_TYPE_AHR 0
+#define ENV_TYPE_OSC 1
+#define ENV_TYPE_AR 2
+#define ENV_MOD_STEPS 0
+#define ENV_OUT_NORMAL 0
+#define ENV_TRIG_IDLE 0
+#define ENV_STATE_IDLE 0
+#define ENV_STATE_UP 1
+#define ENV_STATE_DOWN 3
+#define TEST_STEPS_OFF 15  // steps setting past the steps table - the value passes through
+
+// envelope state in env_proc.c
+extern int env12_type[];
+extern int env12_mod[];
+extern int env12_out[];
+extern int env12_gate[];
+extern int env12_trig[];
+extern int env12_steps_setting[];
+extern int env12_level_setting[];
+extern int env12_run_state[];
+extern int env12_up_freq[];
+extern int env12_down_freq[];
+extern int env12_acc[];
+extern const unsigned int *env12_up_curve[];
+extern const unsigned int *env12_down_curve[];
+extern void (*env12_kernel[])(int chan);
+extern unsigned int env_curve_exp[];
+extern unsigned int env_curve_log[];
+
+// local functions in env_proc.c
+void env_proc_update_kernel(int chan);
+void env_proc_curve_switch(int chan, const unsigned int *from, const unsigned int *to);
+
+// DAC outputs in stubs/mod_io.c
+extern int mod_io_dacs[];
+
+uint32_t test_rand_state = 1;
+
+// local functions
+uint32_t test_rand(void);
+void test_hook(const char *line);
+double test_curve(double bend, int acc);
+void test_table(const char *name, const unsigned int *table, double bend);
+void test_mode(int type, const unsigned int *up, const unsigned int *down);
+void test_sample(void);
+void test_ramp(void);
+void test_turns(void);
+void test_bench(void);
+double test_bench_run(void);
+
+int main(int argc, char *argv[]) {
+	harness_set_trace_hook(test_hook);
+	mod_io_init();
+	env_proc_init();
+	test_table("exp", env_curve_exp, TEST_BEND);
+	test_table("log", env_curve_log, -TEST_BEND);
+	test_ramp();
+	test_turns();
+	test_bench();
+	return harness_done("env_curve_test");
+}
+
+//
+// local functions
+//
+// repeatable random numbers
+uint32_t test_rand(void) {
+	test_rand_state ^= test_rand_state << 13;
+	test_rand_state ^= test_rand_state >> 17;
+	test_rand_state ^= test_rand_state << 5;
+	return test_rand_state;
+}
+
+// the LEDs are not looked at - keep the trace off stdout
+void test_hook(const char *line) {
+}
+
+// get the analytic curve at an accumulator value - 16 bit
+// - the DAC drops the low 4 bits so it is half an LSB under this on average
+double test_curve(double bend, int acc) {
+	double x = (double)acc / TEST_MAXVAL;
+	return TEST_FULL * (exp(bend * x) - 1.0) / (exp(bend) - 1.0);
+}
+
+// look up a table over the accumulator range - switching a curve to linear
+// puts the 16 bit curve value in the accumulator
+void test_table(const char *name, const unsigned int *table, double bend) {
+	int acc, val, last = -1;
+	double err, worst = 0;
+
+	for(acc = 0; acc <= TEST_MAXVAL; acc += 256) {
+		env12_acc[0] = acc;
+		env_proc_curve_switch(0, table, NULL);
+		val = env12_acc[0] >> 14;
+		err = (val - test_curve(bend, acc)) / 16.0;
+		if(fabs(err) > fabs(worst)) {
+			worst = err;
+		}
+		if(val < last) {
+			HARNESS_CHECK(0, "%s: value goes down from %d to %d at %d", name, last, val, acc);
+			break;
+		}
+		last = val;
+	}
+	HARNESS_CHECK(fabs(worst) < 0.5, "%s: lookup is %.2f LSB from the curve", name, worst);
+	HARNESS_CHECK(last == (int)TEST_FULL, "%s: top is %d", name, last);
+	fprintf(stderr, "env_curve_test: %s table within %.2f LSB of the curve at 12 bits\n", name,
+		fabs(worst));
+}
+
+// set mod 1 to a mode with the value passed straight to the DAC
+void test_mode(int type, const unsigned int *up, const unsigned int *down) {
+	env12_type[0] = type;
+	env12_mod[0] = ENV_MOD_STEPS;
+	env12_out[0] = ENV_OUT_NORMAL;
+	env12_steps_setting[0] = TEST_STEPS_OFF;
+	env12_level_setting[0] = 255;
+	env12_up_curve[0] = up;
+	env12_down_curve[0] = down;
+	env12_up_freq[0] = TEST_MAXVAL / TEST_RAMP;
+	env12_down_freq[0] = TEST_MAXVAL / TEST_RAMP;
+	env12_gate[0] = 0;
+	env12_trig[0] = ENV_TRIG_IDLE;
+	env12_run_state[0] = ENV_STATE_IDLE;
+	env12_acc[0] = 0;
+	env_proc_update_kernel(0);
+}
+
+// run one sample of mod 1
+void test_sample(void) {
+	env12_kernel[0](0);
+}
+
+// run a whole AR envelope - log up and exp down - and a linear one
+void test_ramp(void) {
+	int s, acc, up_len = 0, down_len = 0, lin_len = 0, errors = 0;
+	double want, err, worst = 0;
+
+	test_mode(ENV_TYPE_AR, env_curve_log, env_curve_exp);
+	env12_gate[0] = 1;
+	test_sample();  // trigger - the rise starts on the next sample
+	for(s = 0; s < TEST_RAMP * 4 && env12_run_state[0] != ENV_STATE_IDLE; s ++) {
+		test_sample();
+		// the segments run past the ends by a step before they turn around
+		acc = env12_acc[0];
+		if(acc < 0) {
+			acc = 0;
+		}
+		else if(acc > TEST_MAXVAL) {
+			acc = TEST_MAXVAL;
+		}
+		if(env12_run_state[0] == ENV_STATE_UP) {
+			want = (test_curve(-TEST_BEND, acc) / 16.0) - 0.5;
+			up_len ++;
+		}
+		else if(env12_run_state[0] == ENV_STATE_DOWN) {
+			want = (test_curve(TEST_BEND, acc) / 16.0) - 0.5;
+			down_len ++;
+		}
+		else {
+			want = 0;
+		}
+		err = mod_io_dacs[0] - want;
+		if(fabs(err) > fabs(worst)) {
+			worst = err;
+		}
+		if(fabs(err) > 1.0 && errors < 5) {
+			HARNESS_CHECK(0, "sample %d: DAC %d - wanted %.1f", s, mod_io_dacs[0], want);
+			errors ++;
+		}
+	}
+	env12_gate[0] = 0;
+
+	test_mode(ENV_TYPE_AR, NULL, NULL);
+	env12_gate[0] = 1;
+	test_sample();
+	for(s = 0; s < TEST_RAMP * 4 && env12_run_state[0] != ENV_STATE_IDLE; s ++) {
+		test_sample();
+		if(env12_run_state[0] != ENV_STATE_IDLE) {
+			lin_len ++;
+		}
+	}
+	HARNESS_CHECK(up_len + down_len == lin_len, "curved envelope took %d samples - linear "
+		"took %d", up_len + down_len, lin_len);
+	fprintf(stderr, "env_curve_test: AR log rise %d samples - exp fall %d samples - within "
+		"%.2f LSB of the curve\n", up_len, down_len, fabs(worst));
+}
+
+// turn the segments around at random points and check the output carries on
+void test_turns(void) {
+	int i, s, acc, last;
+	double want, err, worst_up = 0, worst_down = 0;
+
+	// gate released on the rise - AHR
+	for(i = 0; i < TEST_TURNS; i ++) {
+		test_mode(ENV_TYPE_AHR, env_curve_log, env_curve_exp);
+		env12_gate[0] = 1;
+		test_sample();
+		for(s = 1 + (test_rand() % (TEST_RAMP - 2)); s > 0; s --) {
+			test_sample();
+		}
+		last = mod_io_dacs[0];
+		acc = env12_acc[0];
+		env12_gate[0] = 0;
+		test_sample();
+		HARNESS_CHECK(env12_run_state[0] == ENV_STATE_DOWN, "release %d: did not turn around", i);
+		want = (test_curve(-TEST_BEND, acc + env12_up_freq[0]) / 16.0) - 0.5;
+		err = mod_io_dacs[0] - want;
+		HARNESS_CHECK(fabs(err) <= 1.0, "release %d: DAC went from %d to %d - wanted %.1f", i,
+			last, mod_io_dacs[0], want);
+		if(fabs(err) > worst_up) {
+			worst_up = fabs(err);
+		}
+	}
+
+	// retriggered on the fall - AR
+	for(i = 0; i < TEST_TURNS; i ++) {
+		test_mode(ENV_TYPE_AR, env_curve_log, env_curve_exp);
+		env12_gate[0] = 1;
+		test_sample();
+		env12_gate[0] = 0;
+		for(s = 0; s < TEST_RAMP * 2 && env12_run_state[0] != ENV_STATE_DOWN; s ++) {
+			test_sample();
+		}
+		for(s = 1 + (test_rand() % (TEST_RAMP - 2)); s > 0; s --) {
+			test_sample();
+		}
+		last = mod_io_dacs[0];
+		acc = env12_acc[0];
+		env12_gate[0] = 1;
+		test_sample();
+		HARNESS_CHECK(env12_run_state[0] == ENV_STATE_UP, "retrigger %d: did not turn around", i);
+		want = (test_curve(TEST_BEND, acc - env12_down_freq[0]) / 16.0) - 0.5;
+		err = mod_io_dacs[0] - want;
+		HARNESS_CHECK(fabs(err) <= 1.0, "retrigger %d: DAC went from %d to %d - wanted %.1f", i,
+			last, mod_io_dacs[0], want);
+		if(fabs(err) > worst_down) {
+			worst_down = fabs(err);
+		}
+	}
+	fprintf(stderr, "env_curve_test: %d releases within %.2f LSB and %d retriggers within "
+		"%.2f LSB of the curve they turned around from\n", TEST_TURNS, worst_up, TEST_TURNS,
+		worst_down);
+}
+
+// time mod 1 as an oscillator with each kind of segment
+void test_bench(void) {
+	int s, sum = 0;
+	double start, lin_ns, curve_ns, exp_ns;
+
+	test_mode(ENV_TYPE_OSC, NULL, NULL);
+	lin_ns = test_bench_run();
+	test_mode(ENV_TYPE_OSC, env_curve_log, env_curve_exp);
+	curve_ns = test_bench_run();
+
+	// the curve worked out each sample
+	start = harness_now_ns();
+	for(s = 0; s < TEST_BENCH_SAMPLES; s ++) {
+		sum += (int)test_curve(TEST_BEND, (s & 0xffff) << 14);
+	}
+	exp_ns = (harness_now_ns() - start) / TEST_BENCH_SAMPLES;
+
+	fprintf(stderr, "env_curve_test: per sample - linear %.1fns - curve tables %.1fns - "
+		"exp() alone %.1fns (%d)\n", lin_ns, curve_ns, exp_ns, sum & 0x01);
+}
+
+// run the oscillator for a while and get the time per sample
+double test_bench_run(void) {
+	int s;
+	double start;
+
+	env12_up_freq[0] = TEST_MAXVAL / 100;
+	env12_down_freq[0] = TEST_MAXVAL / 70;
+	env12_gate[0] = 1;
+	start = harness_now_ns();
+	for(s = 0; s < TEST_BENCH_SAMPLES; s ++) {
+		test_sample();
+	}
+	return (harness_now_ns() - start) / TEST_BENCH_SAMPLES;
+}
@@ -0,0 +1,187 @@
+/*
+ * K65 Phenol - Speed CV FM Test
+ *
+ * Copyright 2015: Andrew Kilpatrick
+ * Written by: Andrew Kilpatrick
+ *
+ * Runs the mod processor envelope code with mod 1 as an oscillator and a
+ * sine on its speed CV input, swept from 1Hz to 4kHz. At each modulating
+ * frequency the up / down speed used for every sample is compared with
+ * the speed looked up from the CV at that sample:
+ *	- every sample must use the speed for its own CV value
+ *	- the swing of the speed must be the full swing of the lookup - the
+ *	  response is printed for each frequency
+ *	- the oscillator must run the number of cycles the speeds add up to
+ *
+ * The cost of the sample task is printed with the speed CV moving, along
+ * with the part of it that is the per sample speed lookup.
+ *
+ */
+#include <stdio.h>
+#include <math.h>
+#include "harness.h"
+#include "mod_io.h"
+#include "env_proc.h"
+#include "ioctl.h"
+
+#define TEST_RATE 10000  // sample rate
+#define TEST_SAMPLES 20000  // samples at each modulating frequency
+#define TEST_SPEED 128  // speed pot - no offset on the CV
+#define TEST_CV_MID 2048
+#define TEST_CV_DEPTH 1500
+#define TEST_MAXVAL 1073741824  // top of the accumulator
+#define TEST_BENCH_SAMPLES 2000000
+
+// envelope state in env_proc.c
+extern int env12_up_freq[];
+extern int env12_down_freq[];
+extern int env12_run_state[];
+extern unsigned int lfo_freq_table[];
+
+// local functions in env_proc.c
+void env_proc_update_freq(int chan, int speed_cv);
+
+// local functions
+void test_hook(const char *line);
+int test_cv(double freq, int sample);
+int test_freq(int cv);
+void test_run_ms(int ms);
+void test_sweep(double freq);
+void test_bench(void);
+
+int main(int argc, char *argv[]) {
+	static double freqs[] = {1, 10, 100, 200, 500, 1000, 2000, 4000};
+	int i;
+
+	harness_set_trace_hook(test_hook);
+	mod_io_init();
+	env_proc_init();
+	// mod 1 to osc with a full level and the gate held
+	mod_io_set_pot(POT_MOD1_POT1, TEST_SPEED);
+	mod_io_set_pot(POT_MOD1_POT2, 255);
+	mod_io_set_sw(SW_MOD1_SW1, 1);
+	mod_io_set_sw(SW_MOD1_SW1, 0);
+	mod_io_set_gate_in(0, 1);
+	mod_io_set_cv(0, TEST_CV_MID);
+	test_run_ms(100);
+
+	for(i = 0; i < (int)(sizeof(freqs) / sizeof(double)); i ++) {
+		test_sweep(freqs[i]);
+	}
+	test_bench();
+	return harness_done("env_cv_test");
+}
+
+//
+// local functions
+//
+// the LEDs are not looked at - keep the trace off stdout
+void test_hook(const char *line) {
+}
+
+// get the modulating CV at a sample
+int test_cv(double freq, int sample) {
+	return TEST_CV_MID + (int)(TEST_CV_DEPTH * sin((2 * M_PI * freq * sample) / TEST_RATE));
+}
+
+// get the speed for a CV value - mod 1 in osc mode
+int test_freq(int cv) {
+	int index = (cv >> 4) + TEST_SPEED - 128;
+	if(index < 0) {
+		index = 0;
+	}
+	if(index > 255) {
+		index = 255;
+	}
+	return lfo_freq_table[index];
+}
+
+// run the firmware for a while - 1ms timer task like the Timer1 ISR
+void test_run_ms(int ms) {
+	int i, j;
+	for(i = 0; i < ms; i ++) {
+		env_proc_timer_task();
+		for(j = 0; j < TEST_RATE / 1000; j ++) {
+			env_proc_sample_task();
+		}
+	}
+}
+
+// modulate the speed CV with a sine and check the speeds used
+void test_sweep(double freq) {
+	int s, want, errors = 0, cycles = 0, state, last_state;
+	int seen_low = 0x7fffffff, seen_high = 0, want_low = 0x7fffffff, want_high = 0;
+	double travel = 0, response;
+
+	last_state = env12_run_state[0];
+	for(s = 0; s < TEST_SAMPLES; s ++) {
+		if((s % (TEST_RATE / 1000)) == 0) {
+			env_proc_timer_task();
+		}
+		mod_io_set_cv(0, test_cv(freq, s));
+		env_proc_sample_task();
+
+		// the speed for this sample
+		want = test_freq(test_cv(freq, s));
+		if(env12_up_freq[0] != want || env12_down_freq[0] != want) {
+			if(errors < 5) {
+				HARNESS_CHECK(0, "%.0fHz: sample %d used speed %d / %d - wanted %d", freq, s,
+					env12_up_freq[0], env12_down_freq[0], want);
+			}
+			errors ++;
+		}
+		if(env12_up_freq[0] < seen_low) seen_low = env12_up_freq[0];
+		if(env12_up_freq[0] > seen_high) seen_high = env12_up_freq[0];
+		if(want < want_low) want_low = want;
+		if(want > want_high) want_high = want;
+
+		// cycles of the oscillator - one at each turn at the top
+		travel += want;
+		state = env12_run_state[0];
+		if(state != last_state && last_state == 1) {
+			cycles ++;
+		}
+		last_state = state;
+	}
+	response = (double)(seen_high - seen_low) / (want_high - want_low);
+	HARNESS_CHECK(response > 0.99, "%.0fHz: speed swing is %.2f of the CV swing", freq,
+		response);
+	HARNESS_CHECK(fabs(cycles - (travel / (2.0 * TEST_MAXVAL))) <= 1.5,
+		"%.0fHz: %d oscillator cycles - the speeds add up to %.1f", freq, cycles,
+		travel / (2.0 * TEST_MAXVAL));
+	fprintf(stderr, "env_cv_test: speed CV at %4.0fHz: response %.2f - %d samples off - "
+		"%d cycles\n", freq, response, errors, cycles);
+}
+
+// time the sample task and the per sample speed lookup
+void test_bench(void) {
+	int s;
+	double start, task_ns, lookup_ns, cv_ns;
+
+	start = harness_now_ns();
+	for(s = 0; s < TEST_BENCH_SAMPLES; s ++) {
+		mod_io_set_cv(0, test_cv(1000, s & 0xff));
+		env_proc_sample_task();
+	}
+	task_ns = (harness_now_ns() - start) / TEST_BENCH_SAMPLES;
+
+	start = harness_now_ns();
+	for(s = 0; s < TEST_BENCH_SAMPLES; s ++) {
+		mod_io_set_cv(0, test_cv(1000, s & 0xff));
+		env_proc_update_freq(0, ioctl_get_cv_fast(0) >> 4);
+		env_proc_update_freq(1, ioctl_get_cv_fast(1) >> 4);
+	}
+	lookup_ns = (harness_now_ns() - start) / TEST_BENCH_SAMPLES;
+
+	// the sine for the CV is in both loops
+	start = harness_now_ns();
+	for(s = 0; s < TEST_BENCH_SAMPLES; s ++) {
+		mod_io_set_cv(0, test_cv(1000, s & 0xff));
+	}
+	cv_ns = (harness_now_ns() - start) / TEST_BENCH_SAMPLES;
+	task_ns -= cv_ns;
+	lookup_ns -= cv_ns;
+
+	fprintf(stderr, "env_cv_test: sample task %.1fns per sample - %.1fns of it is the "
+		"speed CV lookup for both channels\n", task_ns, lookup_ns);
+}
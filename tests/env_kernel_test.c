@@ -0,0 +1,401 @@
+/*
+ * K65 Phenol - Envelope Kernel Test
+ *
+ * Copyright 2015: Andrew Kilpatrick
+ * Written by: Andrew Kilpatrick
+ *
+ * Runs every type / mod / out kernel for mod 1 and 2 next to a copy of
+ * the envelope code from before the kernels, which tests the modes on
+ * every sample. Each mode is run on both channels with random gates,
+ * speeds, steps, levels and delays, and on every sample the kernel and
+ * the old code are run from the same state:
+ *	- the kernel selected must be the one for the mode
+ *	- the DAC value, the accumulator, the run state and the trigger state
+ *	  must be the same
+ *
+ * The host time per sample of each kernel and of the old code is added
+ * up over all of the modes and printed.
+ *
+ */
+#include <stdio.h>
+#include "harness.h"
+#include "mod_io.h"
+#include "env_proc.h"
+#include "ioctl.h"
+#include "dac.h"
+#include "clamp.h"
+#include "scale.h"
+
+#define TEST_SAMPLES 40000  // samples for each mode on each channel
+#define TEST_BENCH_SAMPLES 200000  // samples timed for each mode
+#define TEST_RATE 10000
+#define TEST_NUM_MODES 3
+
+// modes and states - as in env_proc.c
+#define ENV_TYPE_AHR 0
+#define ENV_TYPE_OSC 1
+#define ENV_TYPE_AR 2
+#define ENV_MOD_STEPS 0
+#define ENV_MOD_DELAY 1
+#define ENV_MOD_SCALE 2
+#define ENV_OUT_NORMAL 0
+#define ENV_OUT_INVERT 1
+#define ENV_OUT_ABS 2
+#define ENV_TRIG_IDLE 0
+#define ENV_TRIG_RISING 1
+#define ENV_TRIG_HOLDING 2
+#define ENV_TRIG_FALLING 3
+#define ENV_STATE_IDLE 0
+#define ENV_STATE_UP 1
+#define ENV_STATE_HOLD 2
+#define ENV_STATE_DOWN 3
+#define ENV_MAXVAL 1073741824
+#define DAC_OFFSET -65
+
+// envelope state in env_proc.c
+extern int env12_type[];
+extern int env12_mod[];
+extern int env12_out[];
+extern int env12_gate[];
+extern int env12_trig[];
+extern int env12_steps_setting[];
+extern int env12_level_setting[];
+extern int env12_run_state[];
+extern int env12_up_freq[];
+extern int env12_down_freq[];
+extern int env12_acc[];
+extern void (*env12_kernel[])(int chan);
+extern void (* const env12_kernels[3][3][3])(int chan);
+extern unsigned char steps[14][121];
+extern unsigned char scales[16][12];
+extern int note_to_val[];
+
+// local functions in env_proc.c
+void env_proc_update_freq(int chan, int speed_cv);
+void env_proc_update_kernel(int chan);
+
+// DAC outputs in stubs/mod_io.c
+extern int mod_io_dacs[];
+
+// envelope state that a sample changes
+struct test_state {
+	int trig;
+	int run_state;
+	int acc;
+	int dac;
+};
+
+uint32_t test_rand_state = 1;
+
+// local functions
+uint32_t test_rand(void);
+void test_hook(const char *line);
+void test_mode(int chan, int type, int mod, int out);
+void test_inputs(int chan, int sample);
+void test_get(int chan, struct test_state *s);
+void test_set(int chan, struct test_state *s);
+void test_bench(int type, int mod, int out, double *kernel_ns, double *old_ns);
+void test_run12(int chan);
+
+int main(int argc, char *argv[]) {
+	int chan, type, mod, out;
+	double kernel_ns = 0, old_ns = 0;
+
+	harness_set_trace_hook(test_hook);
+	mod_io_init();
+	env_proc_init();
+
+	for(chan = 0; chan < 2; chan ++) {
+		for(type = 0; type < TEST_NUM_MODES; type ++) {
+			for(mod = 0; mod < TEST_NUM_MODES; mod ++) {
+				for(out = 0; out < TEST_NUM_MODES; out ++) {
+					test_mode(chan, type, mod, out);
+				}
+			}
+		}
+	}
+	for(type = 0; type < TEST_NUM_MODES; type ++) {
+		for(mod = 0; mod < TEST_NUM_MODES; mod ++) {
+			for(out = 0; out < TEST_NUM_MODES; out ++) {
+				test_bench(type, mod, out, &kernel_ns, &old_ns);
+			}
+		}
+	}
+	kernel_ns /= TEST_NUM_MODES * TEST_NUM_MODES * TEST_NUM_MODES;
+	old_ns /= TEST_NUM_MODES * TEST_NUM_MODES * TEST_NUM_MODES;
+	fprintf(stderr, "env_kernel_test: mod 1 / 2 per channel per sample over all 27 modes: "
+		"kernels %.1fns - old code %.1fns\n", kernel_ns, old_ns);
+	return harness_done("env_kernel_test");
+}
+
+//
+// local functions
+//
+// repeatable random numbers
+uint32_t test_rand(void) {
+	test_rand_state ^= test_rand_state << 13;
+	test_rand_state ^= test_rand_state >> 17;
+	test_rand_state ^= test_rand_state << 5;
+	return test_rand_state;
+}
+
+// the LEDs are not looked at - keep the trace off stdout
+void test_hook(const char *line) {
+}
+
+// set a mode like the mode switches do and compare the kernel with the old code
+void test_mode(int chan, int type, int mod, int out) {
+	int s, errors = 0;
+	struct test_state start, kernel, old;
+
+	env12_type[chan] = type;
+	env12_mod[chan] = mod;
+	env12_out[chan] = out;
+	env_proc_update_kernel(chan);
+	HARNESS_CHECK(env12_kernel[chan] == env12_kernels[type][mod][out],
+		"mod %d mode %d %d %d: wrong kernel", chan + 1, type, mod, out);
+
+	for(s = 0; s < TEST_SAMPLES && errors < 5; s ++) {
+		test_inputs(chan, s);
+		test_get(chan, &start);
+		env12_kernel[chan](chan);
+		test_get(chan, &kernel);
+		test_set(chan, &start);
+		test_run12(chan);
+		test_get(chan, &old);
+		if(kernel.dac != old.dac || kernel.acc != old.acc ||
+				kernel.run_state != old.run_state || kernel.trig != old.trig) {
+			HARNESS_CHECK(0, "mod %d mode %d %d %d: sample %d: DAC %d acc %d state %d "
+				"trig %d - old code DAC %d acc %d state %d trig %d", chan + 1, type, mod, out,
+				s, kernel.dac, kernel.acc, kernel.run_state, kernel.trig, old.dac, old.acc,
+				old.run_state, old.trig);
+			errors ++;
+		}
+	}
+}
+
+// move the inputs on for a sample - new gates, pots and CV every so often
+void test_inputs(int chan, int sample) {
+	int r;
+	if((sample % 50) == 0) {
+		r = test_rand();
+		// gate - short and long
+		if((r & 0x07) == 0) {
+			mod_io_set_gate_in(chan, (r >> 3) & 0x01);
+		}
+		// speed and level pots - steps / delay pot
+		if(((r >> 4) & 0x0f) == 0) {
+			mod_io_set_pot(POT_MOD1_POT1 + (chan * POTS_PER_BANK), (r >> 8) & 0xff);
+			mod_io_set_pot(POT_MOD1_POT2 + (chan * POTS_PER_BANK), (r >> 16) & 0xff);
+			mod_io_set_pot(POT_MOD1_POT3 + (chan * POTS_PER_BANK), (r >> 24) & 0xff);
+		}
+		if(((r >> 12) & 0x0f) == 0) {
+			mod_io_set_cv(chan, test_rand() & 0xfff);
+		}
+	}
+	// the timer task every 1ms
+	if((sample % (TEST_RATE / 1000)) == 0) {
+		env_proc_timer_task();
+	}
+	env_proc_update_freq(chan, ioctl_get_cv_fast(chan) >> 4);
+}
+
+// get the state that a sample changes
+void test_get(int chan, struct test_state *s) {
+	s->trig = env12_trig[chan];
+	s->run_state = env12_run_state[chan];
+	s->acc = env12_acc[chan];
+	s->dac = mod_io_dacs[chan];
+}
+
+// put the state back
+void test_set(int chan, struct test_state *s) {
+	env12_trig[chan] = s->trig;
+	env12_run_state[chan] = s->run_state;
+	env12_acc[chan] = s->acc;
+	mod_io_dacs[chan] = s->dac;
+}
+
+// time a mode - the kernel and the old code
+void test_bench(int type, int mod, int out, double *kernel_ns, double *old_ns) {
+	int s;
+	double start;
+	struct test_state state;
+
+	env12_type[0] = type;
+	env12_mod[0] = mod;
+	env12_out[0] = out;
+	env_proc_update_kernel(0);
+	mod_io_set_gate_in(0, 1);
+	env_proc_timer_task();
+	test_get(0, &state);
+
+	start = harness_now_ns();
+	for(s = 0; s < TEST_BENCH_SAMPLES; s ++) {
+		env12_kernel[0](0);
+	}
+	*kernel_ns += (harness_now_ns() - start) / TEST_BENCH_SAMPLES;
+
+	test_set(0, &state);
+	start = harness_now_ns();
+	for(s = 0; s < TEST_BENCH_SAMPLES; s ++) {
+		test_run12(0);
+	}
+	*old_ns += (harness_now_ns() - start) / TEST_BENCH_SAMPLES;
+}
+
+//
+// env_proc.c - env_proc_run12() from before the kernels
+//
+void test_run12(int chan) {
+	int temp, temp2;
+	int oct, semi;
+	if(chan < 0 || chan > 1) {
+		return;
+	}
+
+	// compute the trigger state
+	if(env12_trig[chan] == ENV_TRIG_IDLE) {
+		if(env12_gate[chan]) {
+			env12_trig[chan] = ENV_TRIG_RISING;
+		}
+	}
+	else if(env12_trig[chan] == ENV_TRIG_RISING) {
+		env12_trig[chan] = ENV_TRIG_HOLDING;
+	}
+	else if(env12_trig[chan] == ENV_TRIG_HOLDING) {
+		if(!env12_gate[chan]) {
+			env12_trig[chan] = ENV_TRIG_FALLING;
+		}
+	}
+	else if(env12_trig[chan] == ENV_TRIG_FALLING) {
+		env12_trig[chan] = ENV_TRIG_IDLE;
+	}
+
+	// do ramp calculations
+	switch(env12_run_state[chan]) {
+		case ENV_STATE_UP:
+			env12_acc[chan] += env12_up_freq[chan];
+			// reached top
+			if(env12_acc[chan] > ENV_MAXVAL) {
+				switch(env12_type[chan]) {
+					case ENV_TYPE_AR:
+						env12_run_state[chan] = ENV_STATE_DOWN;
+						break;
+					case ENV_TYPE_AHR:
+						env12_run_state[chan] = ENV_STATE_HOLD;
+						break;
+					case ENV_TYPE_OSC:
+						env12_run_state[chan] = ENV_STATE_DOWN;
+						break;
+				}
+			}
+			// trigger was released in AHR mode
+			else if(env12_type[chan] == ENV_TYPE_AHR && env12_trig[chan] == ENV_TRIG_FALLING) {
+				env12_run_state[chan] = ENV_STATE_DOWN;
+			}
+			break;
+		case ENV_STATE_HOLD:
+			env12_acc[chan] = ENV_MAXVAL;
+			if(env12_trig[chan] == ENV_TRIG_FALLING ||
+					env12_trig[chan] == ENV_TRIG_IDLE) {
+				env12_run_state[chan] = ENV_STATE_DOWN;
+			}
+			break;
+		case ENV_STATE_DOWN:
+			env12_acc[chan] -= env12_down_freq[chan];
+			// reached bottom
+			if(env12_acc[chan] < 0) {
+				switch(env12_type[chan]) {
+					case ENV_TYPE_AR:
+					case ENV_TYPE_AHR:
+						env12_run_state[chan] = ENV_STATE_IDLE;
+						break;
+					case ENV_TYPE_OSC:
+						if(env12_trig[chan] == ENV_TRIG_HOLDING) {
+							env12_run_state[chan] = ENV_STATE_UP;
+						}
+						else {
+							env12_run_state[chan] = ENV_STATE_IDLE;
+						}
+						break;
+				}
+			}
+			// trigger was applied in env mode
+			else if((env12_type[chan] == ENV_TYPE_AR ||
+						env12_type[chan] == ENV_TYPE_AHR) && env12_trig[chan] == ENV_TRIG_RISING) {
+				env12_run_state[chan] = ENV_STATE_UP;
+			}
+			break;
+		case ENV_STATE_IDLE:
+		default:
+			if(env12_trig[chan] == ENV_TRIG_RISING) {
+				env12_run_state[chan] = ENV_STATE_UP;
+			}
+			break;
+	}
+	temp = clamp(env12_acc[chan] >> 18, 0x000, 0xfff);
+
+	// mod / level mode
+	switch(env12_mod[chan]) {
+		case ENV_MOD_STEPS:
+			temp2 = env12_steps_setting[chan];  // step pot (0-15)
+			// use steps table
+			if(temp2 < 14) {
+				temp = scale_find_note(temp);  // convert value into note (0-120)
+				temp = steps[temp2][temp];  // look up the quantization
+				temp = note_to_val[temp];  // convert note back to value (0-4095)
+			}
+			// otherwise just pass through the raw value
+			break;
+		case ENV_MOD_SCALE:
+			// do scaling of input for osc mode
+			if(env12_type[chan] == ENV_TYPE_OSC) {
+				temp = (temp * env12_level_setting[chan]) >> 8;  // scale
+				if(env12_out[chan] != ENV_OUT_ABS) {
+					temp += 0x7ff - (env12_level_setting[chan] << 3);  // offset
+				}
+			}
+			// abs output precalc
+			if(env12_out[chan] == ENV_OUT_ABS) {
+				temp = (temp >> 1) + 0x7ff;
+			}
+			temp2 = env12_steps_setting[chan];  // step pot (0-15)
+			oct = scale_find_octave(temp);  // find octave
+			semi = scale_find_semitone(oct, temp);  // find semitone
+			semi = scales[temp2][semi];  // look up the quantization
+			temp = note_to_val[(oct * 12) + semi];  // convert note back to value (0-4095)
+			// abs output postcalc
+			if(env12_out[chan] == ENV_OUT_ABS) {
+				temp += DAC_OFFSET;
+			}
+			// invert output postcalc
+			else if(env12_out[chan] == ENV_OUT_INVERT) {
+				temp = 0xfff - temp;
+			}
+			break;
+	}
+
+	// output processing for non-scale modes
+	if(env12_mod[chan] != ENV_MOD_SCALE) {
+		// osc mode level - not for scale mode
+		if(env12_type[chan] == ENV_TYPE_OSC) {
+			temp = (temp * env12_level_setting[chan]) >> 8;  // scale
+			if(env12_out[chan] != ENV_OUT_ABS) {
+				temp += 0x7ff - (env12_level_setting[chan] << 3);  // offset
+			}
+		}
+		// output processing
+		switch(env12_out[chan]) {
+			case ENV_OUT_INVERT:
+				temp = 0xfff - temp;
+				break;
+			case ENV_OUT_ABS:
+				temp = (temp >> 1) + 0x7ff + DAC_OFFSET;  // zero it on the centre line
+				break;
+		}
+	}
+
+	// output DAC
+	dac_write_dac(DAC_MOD1 + chan, clamp(temp, 0x000, 0xfff));
+}
@@ -0,0 +1,259 @@
+/*
+ * K65 Phenol - Host Test Harness
+ *
+ * Copyright 2015: Andrew Kilpatrick
+ * Written by: Andrew Kilpatrick
+ *
+ * Shared parts of the host tests:
+ *	- scripts - lines of "time_ms command args..." sorted by time, read by
+ *	  the trace programs to drive the firmware inputs in virtual time
+ *	- traces - text lines stamped with the virtual time, written to stdout
+ *	  and compared with the golden traces by the Makefile - unit tests
+ *	  can take the lines with a hook and check them instead
+ *	- checks and timing for the unit tests and benchmarks
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include "harness.h"
+
+// script
+struct harness_cmd harness_cmds[HARNESS_MAX_CMDS];
+int harness_num_cmds;
+int harness_cmd_pos;
+int harness_end_time;
+
+// trace
+int harness_time;
+void (*harness_trace_hook)(const char *line);
+struct harness_out_state {
+	const char *name;
+	int chan;
+	int val;
+};
+struct harness_out_state harness_outs[HARNESS_MAX_OUTS];
+int harness_num_outs;
+
+// timing and checks
+struct timespec harness_start;
+int harness_fails;
+
+// load a script - returns the number of commands or -1 on error
+// - the run ends at the time of the end command
+int harness_script_load(const char *path) {
+	char line[256], *tok, *p;
+	struct harness_cmd *cmd;
+	FILE *f;
+	int num = 0, last = 0;
+
+	f = fopen(path, "r");
+	if(f == NULL) {
+		perror(path);
+		return -1;
+	}
+	harness_num_cmds = 0;
+	harness_cmd_pos = 0;
+	harness_end_time = 0;
+	while(fgets(line, sizeof(line), f)) {
+		num ++;
+		p = strchr(line, '#');
+		if(p) {
+			*p = 0;
+		}
+		tok = strtok(line, " \t\r\n");
+		if(tok == NULL) {
+			continue;
+		}
+		if(harness_num_cmds == HARNESS_MAX_CMDS) {
+			fprintf(stderr, "%s:%d: too many commands\n", path, num);
+			fclose(f);
+			return -1;
+		}
+		cmd = &harness_cmds[harness_num_cmds];
+		cmd->time = atoi(tok);
+		if(cmd->time < last) {
+			fprintf(stderr, "%s:%d: time goes backwards\n", path, num);
+			fclose(f);
+			return -1;
+		}
+		last = cmd->time;
+		tok = strtok(NULL, " \t\r\n");
+		if(tok == NULL) {
+			fprintf(stderr, "%s:%d: no command\n", path, num);
+			fclose(f);
+			return -1;
+		}
+		snprintf(cmd->name, sizeof(cmd->name), "%s", tok);
+		cmd->argc = 0;
+		while((tok = strtok(NULL, " \t\r\n")) != NULL && cmd->argc < HARNESS_MAX_ARGS) {
+			snprintf(cmd->argv[cmd->argc], sizeof(cmd->argv[0]), "%s", tok);
+			cmd->argc ++;
+		}
+		if(strcmp(cmd->name, "end") == 0) {
+			harness_end_time = cmd->time;
+		}
+		harness_num_cmds ++;
+	}
+	fclose(f);
+	if(harness_end_time == 0) {
+		fprintf(stderr, "%s: no end command\n", path);
+		return -1;
+	}
+	return harness_num_cmds;
+}
+
+// get the length of the loaded script in ms
+int harness_script_length(void) {
+	return harness_end_time;
+}
+
+// get the next command due at or before a time - returns NULL if none
+struct harness_cmd *harness_script_next(int time) {
+	if(harness_cmd_pos == harness_num_cmds) {
+		return NULL;
+	}
+	if(harness_cmds[harness_cmd_pos].time > time) {
+		return NULL;
+	}
+	return &harness_cmds[harness_cmd_pos ++];
+}
+
+// get a command argument as a number - decimal, or 0x.. for hex
+int harness_arg(struct harness_cmd *cmd, int arg) {
+	if(arg >= cmd->argc) {
+		fprintf(stderr, "%d %s: missing argument %d\n", cmd->time, cmd->name, arg + 1);
+		exit(1);
+	}
+	return strtol(cmd->argv[arg], NULL, 0);
+}
+
+// get a command argument as a hex byte - for MIDI data
+int harness_arg_hex(struct harness_cmd *cmd, int arg) {
+	if(arg >= cmd->argc) {
+		fprintf(stderr, "%d %s: missing argument %d\n", cmd->time, cmd->name, arg + 1);
+		exit(1);
+	}
+	return strtol(cmd->argv[arg], NULL, 16) & 0xff;
+}
+
+// set the virtual time that trace lines are stamped with
+void harness_set_time(int time) {
+	harness_time = time;
+}
+
+// get the virtual time in ms
+int harness_get_time(void) {
+	return harness_time;
+}
+
+// write a trace line - stamped with the virtual time
+void harness_trace(const char *fmt, ...) {
+	char line[256];
+	va_list ap;
+	va_start(ap, fmt);
+	vsnprintf(line, sizeof(line), fmt, ap);
+	va_end(ap);
+	if(harness_trace_hook) {
+		harness_trace_hook(line);
+		return;
+	}
+	printf("%d %s\n", harness_time, line);
+}
+
+// send trace lines to a function instead of stdout - NULL = stdout
+void harness_set_trace_hook(void (*hook)(const char *line)) {
+	harness_trace_hook = hook;
+}
+
+// trace an output only when its value changes
+void harness_out(const char *name, int chan, int val) {
+	int i;
+	for(i = 0; i < harness_num_outs; i ++) {
+		if(harness_outs[i].chan == chan && strcmp(harness_outs[i].name, name) == 0) {
+			break;
+		}
+	}
+	if(i == harness_num_outs) {
+		if(harness_num_outs == HARNESS_MAX_OUTS) {
+			fprintf(stderr, "harness: too many outputs\n");
+			exit(1);
+		}
+		harness_outs[i].name = name;
+		harness_outs[i].chan = chan;
+		harness_num_outs ++;
+	}
+	else if(harness_outs[i].val == val) {
+		return;
+	}
+	harness_outs[i].val = val;
+	harness_trace("%s %d %d", name, chan, val);
+}
+
+// add a word to a CRC-32 - used for hashing high rate outputs
+uint32_t harness_crc(uint32_t crc, uint32_t val) {
+	int i;
+	crc = ~crc;
+	for(i = 0; i < 32; i ++) {
+		if((crc ^ val) & 1) {
+			crc = (crc >> 1) ^ 0xedb88320;
+		}
+		else {
+			crc >>= 1;
+		}
+		val >>= 1;
+	}
+	return ~crc;
+}
+
+// start the throughput timer
+void harness_time_start(void) {
+	clock_gettime(CLOCK_MONOTONIC, &harness_start);
+}
+
+// report throughput - virtual_ms of virtual time was run since the timer
+// was started - printed on stderr so it stays out of the trace
+void harness_time_report(const char *what, double virtual_ms) {
+	struct timespec now;
+	double secs;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	secs = (now.tv_sec - harness_start.tv_sec) + (now.tv_nsec - harness_start.tv_nsec) * 1e-9;
+	fprintf(stderr, "%s: %.1fs virtual in %.3fs - %.0fx real time\n",
+		what, virtual_ms / 1000.0, secs, (virtual_ms / 1000.0) / secs);
+}
+
+// get a monotonic time in ns - for benchmarks
+double harness_now_ns(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1e9 + now.tv_nsec;
+}
+
+// count a failed check
+void harness_check(int ok, const char *file, int line, const char *fmt, ...) {
+	va_list ap;
+	if(ok) {
+		return;
+	}
+	harness_fails ++;
+	if(harness_fails > 20) {
+		return;
+	}
+	fprintf(stderr, "%s:%d: FAIL: ", file, line);
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	fprintf(stderr, "\n");
+}
+
+// print the number of failed checks - returns the exit code for main
+int harness_done(const char *what) {
+	if(harness_fails) {
+		fprintf(stderr, "%s: %d checks failed\n", what, harness_fails);
+		return 1;
+	}
+	fprintf(stderr, "%s: ok\n", what);
+	return 0;
+}
@@ -0,0 +1,79 @@
+/*
+ * K65 Phenol - Host Test Harness
+ *
+ * Copyright 2015: Andrew Kilpatrick
+ * Written by: Andrew Kilpatrick
+ *
+ */
+#ifndef HARNESS_H
+#define HARNESS_H
+
+#include <inttypes.h>
+
+// settings
+#define HARNESS_MAX_CMDS 8192  // commands in a script
+#define HARNESS_MAX_ARGS 16  // arguments on a command line
+#define HARNESS_MAX_OUTS 64  // outputs traced for changes
+
+// a scripted input - one line of a script
+// - lines are: time_ms command args... - # starts a comment
+struct harness_cmd {
+	int time;  // virtual time in ms
+	char name[16];  // command name
+	int argc;  // number of arguments
+	char argv[HARNESS_MAX_ARGS][16];  // arguments as text
+};
+
+// load a script - returns the number of commands or -1 on error
+// - the run ends at the time of the end command
+int harness_script_load(const char *path);
+
+// get the length of the loaded script in ms
+int harness_script_length(void);
+
+// get the next command due at or before a time - returns NULL if none
+struct harness_cmd *harness_script_next(int time);
+
+// get a command argument as a number - decimal, or 0x.. for hex
+int harness_arg(struct harness_cmd *cmd, int arg);
+
+// get a command argument as a hex byte - for MIDI data
+int harness_arg_hex(struct harness_cmd *cmd, int arg);
+
+// set the virtual time that trace lines are stamped with
+void harness_set_time(int time);
+
+// get the virtual time in ms
+int harness_get_time(void);
+
+// write a trace line - stamped with the virtual time
+void harness_trace(const char *fmt, ...);
+
+// send trace lines to a function instead of stdout - NULL = stdout
+// - the line is passed without the time stamp
+void harness_set_trace_hook(void (*hook)(const char *line));
+
+// trace an output only when its value changes
+void harness_out(const char *name, int chan, int val);
+
+// add a word to a CRC-32 - used for hashing high rate outputs
+uint32_t harness_crc(uint32_t crc, uint32_t val);
+
+// start the throughput timer
+void harness_time_start(void);
+
+// report throughput - virtual_ms of virtual time was run since the timer
+// was started - printed on stderr so it stays out of the trace
+void harness_time_report(const char *what, double virtual_ms);
+
+// get a monotonic time in ns - for benchmarks
+double harness_now_ns(void);
+
+// count a failed check
+#define HARNESS_CHECK(cond, ...) harness_check((cond) != 0, __FILE__, __LINE__, __VA_ARGS__)
+void harness_check(int ok, const char *file, int line, const char *fmt, ...);
+
+// print the number of failed checks - returns the exit code for main
+int harness_done(const char *what);
+
+#endif
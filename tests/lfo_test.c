@@ -0,0 +1,255 @@
+/*
+ * K65 Phenol - Mod 3 LFO Test
+ *
+ * Copyright 2015: Andrew Kilpatrick
+ * Written by: Andrew Kilpatrick
+ *
+ * Runs the mod 3 LFO on its own at the 10kHz sample rate for one whole
+ * cycle at a few speeds, from about the slowest speed setting to 40Hz,
+ * next to the old lookup that threw away the bottom 2 bits of the phase:
+ *	- sine - the biggest step between samples must be no more than the
+ *	  slope of the sine allows, within 1.5 LSB of a true sine, and the
+ *	  THD must stay at the 12 bit floor
+ *	- triangle and saw - cover the 12 bit range with steps no more than
+ *	  their slope allows
+ *	- square - high for the first half of the cycle and low for the rest
+ *	- random - set to glide from the bottom to the top, it moves no faster
+ *	  than a half cosine between them and ends the cycle on the top
+ * The biggest step and the THD over all harmonics of the old and new
+ * sine are printed for each speed.
+ *
+ * The cost per sample of working out all the shapes is printed next to
+ * the old lookup. They are timed in blocks that take turns, so the host
+ * being busy slows both, and the fastest block of all the shapes must
+ * cost no more than a fixed number of times the fastest old block. The
+ * host time in ns is only printed.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "harness.h"
+#include "lfo.h"
+
+#define TEST_CYCLE 2147483648.0  // phase step cycle - 2^31 as in lfo_freq.h
+#define TEST_MAX_PERIOD 524288  // about the slowest speed - 52s
+#define TEST_CENTRE 2047.0  // sine1024 centre and height
+#define TEST_SINE_ERR 1.5  // most the sine can be from a true sine in LSB
+#define TEST_THD_MAX 0.03  // percent - the 12 bit floor is about 0.02%
+#define TEST_BENCH_BLOCK 2000  // samples in a timed block
+#define TEST_BENCH_BLOCKS 2000
+#define TEST_BUDGET_RATIO 20.0  // most all the shapes can cost over the old lookup - about 9 here
+
+// sine table and random levels in lfo.c
+extern unsigned int sine1024[];
+extern int lfo_rand_start;
+extern int lfo_rand_end;
+
+int test_out[LFO_NUM_SHAPES][TEST_MAX_PERIOD];
+int test_old[TEST_MAX_PERIOD];
+int test_sum;  // keeps the timed work from being left out
+
+// local functions
+void test_render(int period);
+int test_max_step(int *out, int period);
+double test_thd(int *out, int period);
+void test_speed(int period);
+void test_bench(void);
+double test_bench_block(int old, uint32_t *acc);
+
+int main(int argc, char *argv[]) {
+	static int periods[] = {TEST_MAX_PERIOD, 65536, 4096, 256};
+	int i;
+
+	for(i = 0; i < (int)(sizeof(periods) / sizeof(int)); i ++) {
+		test_speed(periods[i]);
+	}
+	test_bench();
+	return harness_done("lfo_test");
+}
+
+//
+// local functions
+//
+// run one cycle of the new and old LFO - the random shape glides over the
+// whole range
+void test_render(int period) {
+	int freq = (int)(TEST_CYCLE / period);
+	int s, i;
+	uint32_t acc = 0;
+
+	lfo_init();
+	lfo_rand_start = 0x000;
+	lfo_rand_end = 0xfff;
+	for(s = 0; s < period; s ++) {
+		lfo_run(freq);
+		for(i = 0; i < LFO_NUM_SHAPES; i ++) {
+			test_out[i][s] = lfo_out[i];
+		}
+		// the old mod 3 sine
+		acc += freq;
+		test_old[s] = sine1024[((acc >> 19) & 0xfff) >> 2];
+	}
+}
+
+// get the biggest step between samples - over the end of the cycle too
+int test_max_step(int *out, int period) {
+	int s, step, max = 0;
+	for(s = 0; s < period; s ++) {
+		step = abs(out[(s + 1) % period] - out[s]);
+		if(step > max) {
+			max = step;
+		}
+	}
+	return max;
+}
+
+// get the THD over all harmonics of one whole cycle - in percent
+double test_thd(int *out, int period) {
+	double mean = 0, power = 0, re = 0, im = 0, ang, x, fund;
+	int s;
+	for(s = 0; s < period; s ++) {
+		mean += out[s];
+	}
+	mean /= period;
+	for(s = 0; s < period; s ++) {
+		x = out[s] - mean;
+		ang = (2 * M_PI * s) / period;
+		re += x * cos(ang);
+		im += x * sin(ang);
+		power += x * x;
+	}
+	// the fundamental has half its power in each of the two bins
+	fund = (2 * ((re * re) + (im * im))) / period;
+	return 100.0 * sqrt((power - fund) / fund);
+}
+
+// check one speed
+void test_speed(int period) {
+	int s, old_step, new_step, next, step, err_s = 0, highs = 0, bad_high = 0;
+	double slope, err, worst = 0, old_thd, new_thd, want;
+	int *sine = test_out[LFO_SINE];
+	int *rnd = test_out[LFO_RANDOM];
+
+	test_render(period);
+
+	// sine
+	slope = (TEST_CENTRE * 2 * M_PI) / period;
+	old_step = test_max_step(test_old, period);
+	new_step = test_max_step(sine, period);
+	old_thd = test_thd(test_old, period);
+	new_thd = test_thd(sine, period);
+	for(s = 0; s < period; s ++) {
+		want = TEST_CENTRE + (TEST_CENTRE * sin((2 * M_PI * (s + 1)) / period));
+		err = fabs(sine[s] - want);
+		if(err > worst) {
+			worst = err;
+			err_s = s;
+		}
+	}
+	fprintf(stderr, "lfo_test: period %6d samples: sine biggest step %2d LSB - was %2d - "
+		"THD %.4f%% - was %.4f%%\n", period, new_step, old_step, new_thd, old_thd);
+	HARNESS_CHECK(new_step <= ceil(slope) + 1, "period %d: sine step %d LSB - slope is %.2f",
+		period, new_step, slope);
+	HARNESS_CHECK(worst <= TEST_SINE_ERR, "period %d: sine is %.2f LSB off at sample %d",
+		period, worst, err_s);
+	HARNESS_CHECK(new_thd <= TEST_THD_MAX, "period %d: sine THD %.4f%%", period, new_thd);
+
+	// triangle and saw
+	HARNESS_CHECK(test_max_step(test_out[LFO_TRIANGLE], period) <= ceil(8192.0 / period) + 1,
+		"period %d: triangle step %d LSB", period,
+		test_max_step(test_out[LFO_TRIANGLE], period));
+	for(s = 0; s < period - 1; s ++) {
+		next = test_out[LFO_SAW][s + 1];
+		if(next < test_out[LFO_SAW][s] || next - test_out[LFO_SAW][s] > ceil(4096.0 / period) + 1) {
+			// the saw only drops where it goes back to the bottom
+			if(next > test_out[LFO_SAW][s] || s + 2 != period / 2) {
+				HARNESS_CHECK(0, "period %d: saw goes from %d to %d at sample %d", period,
+					test_out[LFO_SAW][s], next, s);
+				break;
+			}
+		}
+	}
+	HARNESS_CHECK(test_out[LFO_TRIANGLE][(period / 4) - 1] >= 4095 - ceil(8192.0 / period) &&
+		test_out[LFO_TRIANGLE][((period * 3) / 4) - 1] <= ceil(8192.0 / period) &&
+		test_out[LFO_SAW][(period / 2) - 2] >= 4095 - ceil(4096.0 / period) &&
+		test_out[LFO_SAW][(period / 2) - 1] <= ceil(4096.0 / period),
+		"period %d: triangle %d to %d - saw %d to %d", period,
+		test_out[LFO_TRIANGLE][((period * 3) / 4) - 1], test_out[LFO_TRIANGLE][(period / 4) - 1],
+		test_out[LFO_SAW][(period / 2) - 1], test_out[LFO_SAW][(period / 2) - 2]);
+
+	// square
+	for(s = 0; s < period; s ++) {
+		if(test_out[LFO_SQUARE][s] == 0xfff) {
+			highs ++;
+			if(s >= period / 2 - 1 && s != period - 1) {
+				bad_high ++;
+			}
+		}
+		else if(test_out[LFO_SQUARE][s] != 0x000) {
+			bad_high ++;
+		}
+	}
+	HARNESS_CHECK(highs == period / 2 && bad_high == 0,
+		"period %d: square is high for %d samples - %d out of place", period, highs, bad_high);
+
+	// random - the phase wraps on the last sample and the next glide
+	// starts from the level this one went to
+	slope = ((M_PI / 2) * 4095.0) / period;
+	for(s = 0; s < period - 1; s ++) {
+		step = rnd[s + 1] - rnd[s];
+		if(rnd[s] < 0 || rnd[s] > 0xfff || step < 0 || step > ceil(slope) + 1) {
+			HARNESS_CHECK(0, "period %d: random goes from %d to %d at sample %d - slope "
+				"is %.2f", period, rnd[s], rnd[s + 1], s, slope);
+			break;
+		}
+	}
+	HARNESS_CHECK(rnd[0] <= ceil(slope) && rnd[period - 1] == 0xfff,
+		"period %d: random glides from %d to %d", period, rnd[0], rnd[period - 1]);
+}
+
+// time the new LFO and the old lookup in turns
+void test_bench(void) {
+	double ns[2], total[2] = {0, 0}, fastest[2] = {1e9, 1e9}, ratio;
+	uint32_t acc = 0;
+	int b, old;
+
+	lfo_init();
+	for(b = 0; b < TEST_BENCH_BLOCKS; b ++) {
+		for(old = 0; old < 2; old ++) {
+			ns[old] = test_bench_block(old, &acc);
+			total[old] += ns[old];
+			if(ns[old] < fastest[old]) {
+				fastest[old] = ns[old];
+			}
+		}
+	}
+	ratio = fastest[0] / fastest[1];
+	fprintf(stderr, "lfo_test: per sample - all shapes %.1fns - fastest block %.1fns - "
+		"old sine lookup %.1fns - fastest block %.1fns - %.1f times the old (%d)\n",
+		total[0] / TEST_BENCH_BLOCKS, fastest[0], total[1] / TEST_BENCH_BLOCKS,
+		fastest[1], ratio, test_sum & 0x01);
+	HARNESS_CHECK(ratio <= TEST_BUDGET_RATIO, "all shapes cost %.1f times the old lookup - "
+		"most is %.1f", ratio, TEST_BUDGET_RATIO);
+}
+
+// run a block of the new LFO or the old lookup - returns the time per sample
+double test_bench_block(int old, uint32_t *acc) {
+	int s, freq = (int)(TEST_CYCLE / 4096);
+	uint32_t phase = *acc;
+	double start = harness_now_ns();
+	if(old) {
+		for(s = 0; s < TEST_BENCH_BLOCK; s ++) {
+			phase += freq;
+			test_sum += sine1024[((phase >> 19) & 0xfff) >> 2];
+		}
+		*acc = phase;
+	}
+	else {
+		for(s = 0; s < TEST_BENCH_BLOCK; s ++) {
+			lfo_run(freq);
+			test_sum += lfo_out[LFO_SINE];
+		}
+	}
+	return (harness_now_ns() - start) / TEST_BENCH_BLOCK;
+}
@@ -0,0 +1,296 @@
+/*
+ * K65 Phenol - Mixer Firmware Runner
+ *
+ * Copyright 2015: Andrew Kilpatrick
+ * Written by: Andrew Kilpatrick
+ *
+ * Runs the mixer firmware on the host in virtual time. The firmware
+ * modules are built unchanged - only ioctl.c, switch_filter.c,
+ * audio_sys.c and TimeDelay.c are replaced with the fakes in
+ * stubs/mixer_io.c, and plib with stubs/plib.c.
+ *
+ * Virtual time runs in 250us ticks like Timer1. Each tick does the same
+ * work as the Timer1 ISR in k65-mixer.c with the power on, after any
+ * MIDI bytes due from the UART and the 12 codec frames that the SPI ISR
+ * moves in 250us at 48kHz. The main loop work (seq_poll and
+ * seq_store_poll) runs after each tick. USB and the WM8731 are not run.
+ * The power control is only run when it is turned on - otherwise the
+ * power is on from the start.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "plib.h"
+#include "harness.h"
+#include "mixer_run.h"
+#include "mixer_io.h"
+#include "timer_wheel.h"
+#include "seq_store.h"
+#include "cv_gate_ctrl.h"
+#include "voice.h"
+#include "phenol_midi.h"
+#include "audio_proc.h"
+#include "midi_clock.h"
+#include "pulse_div.h"
+#include "seq.h"
+#include "midi.h"
+#include "isr_load.h"
+#include "telem.h"
+#include "power_ctrl.h"
+#include "ioctl.h"
+
+#define MIXER_RUN_MIDI_QUEUE 4096
+#define MIXER_RUN_STARTUP_DELAY 2000  // as in k65-mixer.c
+#define MIXER_RUN_SPI_FRAMES 2  // frames moved on each SPI1 interrupt - the FIFO is refilled from half empty
+
+// MIDI in
+unsigned char mixer_run_midi_queue[MIXER_RUN_MIDI_QUEUE];
+int mixer_run_midi_in_pos;
+int mixer_run_midi_out_pos;
+int mixer_run_midi_us;  // time until the UART can take the next byte
+int mixer_run_clock_us;  // MIDI clock interval - 0 = off
+int mixer_run_clock_count;  // time until the next clock
+
+// audio
+void (*mixer_run_audio)(int16_t *in, int16_t *out);
+
+// timer
+int mixer_run_ticks;
+int timer_div;
+
+// power
+int mixer_run_power;  // 1 = run the power control
+int mixer_run_power_state;
+int mixer_run_startup_delay;
+
+// local functions
+void mixer_run_uart(void);
+void mixer_run_spi(void);
+void mixer_run_timer1(void);
+
+// set up the firmware like main() in k65-mixer.c
+void mixer_run_init(void) {
+	mixer_run_ticks = 0;
+	timer_div = 0;
+	mixer_run_midi_in_pos = 0;
+	mixer_run_midi_out_pos = 0;
+	mixer_run_midi_us = 0;
+	mixer_run_clock_us = 0;
+	mixer_run_clock_count = 0;
+	mixer_run_audio = NULL;
+	mixer_run_power = 0;
+	mixer_run_power_state = POWER_STATE_ON;
+	mixer_run_startup_delay = 0;
+	harness_set_time(0);
+
+	mixer_io_init();
+	isr_load_init();
+	timer_wheel_init();
+	seq_store_init();
+	cv_gate_ctrl_init();
+	voice_init();
+	phenol_midi_init();
+	audio_proc_init();
+	midi_clock_init();
+	pulse_div_init();
+	seq_init();
+	telem_init();
+
+	// end of the startup delay
+	phenol_midi_reset();
+	seq_init();
+}
+
+// run the power control like on the hardware - call after mixer_run_init()
+void mixer_run_power_ctrl(void) {
+	mixer_run_power = 1;
+	mixer_run_power_state = POWER_STATE_BOOT;
+	mixer_run_startup_delay = MIXER_RUN_STARTUP_DELAY;
+	power_ctrl_init();
+}
+
+// run one tick - UART, SPI and Timer1 ISRs, then the main loop
+void mixer_run_tick(void) {
+	harness_set_time(mixer_run_ticks >> 2);
+	mixer_run_uart();
+	mixer_run_spi();
+	mixer_run_timer1();
+	seq_poll();
+	seq_store_poll();
+	mixer_run_ticks ++;
+}
+
+// get the number of ticks run since init
+int mixer_run_get_tick(void) {
+	return mixer_run_ticks;
+}
+
+// queue a byte for the DIN MIDI in
+void mixer_run_midi_send(unsigned char byte) {
+	int next = (mixer_run_midi_in_pos + 1) & (MIXER_RUN_MIDI_QUEUE - 1);
+	if(next == mixer_run_midi_out_pos) {
+		fprintf(stderr, "mixer_run: MIDI in queue full\n");
+		exit(1);
+	}
+	mixer_run_midi_queue[mixer_run_midi_in_pos] = byte;
+	mixer_run_midi_in_pos = next;
+}
+
+// get the number of bytes waiting for the DIN MIDI in
+int mixer_run_midi_queued(void) {
+	return (mixer_run_midi_in_pos - mixer_run_midi_out_pos) & (MIXER_RUN_MIDI_QUEUE - 1);
+}
+
+// send MIDI clock to the DIN MIDI in - interval in us per clock - 0 = off
+void mixer_run_clock(int interval) {
+	mixer_run_clock_us = interval;
+	mixer_run_clock_count = 0;
+}
+
+// set the codec frame handler - called for each frame the SPI ISR moves
+void mixer_run_set_audio(void (*func)(int16_t *in, int16_t *out)) {
+	mixer_run_audio = func;
+}
+
+// get the load of an ISR over the last second - 0-1000 = 0-100.0%
+int mixer_run_get_load(int isr) {
+	return isr_load_get_load(isr);
+}
+
+// get the longest run of an ISR in the last second - us
+int mixer_run_get_max(int isr) {
+	return isr_load_get_max(isr);
+}
+
+//
+// local functions
+//
+// receive the MIDI bytes that arrive in one tick - like the UART2 ISR
+void mixer_run_uart(void) {
+	unsigned int load_start;
+	if(mixer_run_clock_us) {
+		mixer_run_clock_count -= MIXER_RUN_TICK_US;
+		if(mixer_run_clock_count <= 0) {
+			mixer_run_midi_send(0xf8);
+			mixer_run_clock_count += mixer_run_clock_us;
+		}
+	}
+	mixer_run_midi_us -= MIXER_RUN_TICK_US;
+	while(mixer_run_midi_us <= 0 && mixer_run_midi_out_pos != mixer_run_midi_in_pos) {
+		load_start = isr_load_start();
+		midi_rx_byte(MIDI_PORT_DIN, mixer_run_midi_queue[mixer_run_midi_out_pos]);
+		isr_load_end(ISR_LOAD_UART2, load_start);
+		mixer_run_midi_out_pos = (mixer_run_midi_out_pos + 1) & (MIXER_RUN_MIDI_QUEUE - 1);
+		mixer_run_midi_us += MIXER_RUN_MIDI_BYTE_US;
+	}
+	if(mixer_run_midi_us < 0) {
+		mixer_run_midi_us = 0;  // line is idle
+	}
+}
+
+// move the codec frames for one tick - like the SPI1 ISR in audio_sys.c
+void mixer_run_spi(void) {
+	unsigned int load_start = 0;
+	int i;
+	for(i = 0; i < MIXER_RUN_FRAMES_PER_TICK; i ++) {
+		if((i % MIXER_RUN_SPI_FRAMES) == 0) {
+			load_start = isr_load_start();
+		}
+		if(mixer_run_audio) {
+			mixer_run_audio(&audio_rec_buf[audio_stream_p], &audio_play_buf[audio_stream_p]);
+		}
+		else {
+			audio_rec_buf[audio_stream_p] = 0;
+			audio_rec_buf[audio_stream_p + 1] = 0;
+		}
+		audio_stream_p = (audio_stream_p + 2) & AUDIO_BUF_MASK;
+		if((i % MIXER_RUN_SPI_FRAMES) == (MIXER_RUN_SPI_FRAMES - 1)) {
+			isr_load_end(ISR_LOAD_SPI1, load_start);
+		}
+	}
+}
+
+// the Timer1 ISR from k65-mixer.c
+void mixer_run_timer1(void) {
+	unsigned int load_start = isr_load_start();
+
+	// run always
+	timer_wheel_task();
+	isr_load_timer_task();
+
+	// we are on - run normally
+	if(mixer_run_power_state == POWER_STATE_ON) {
+		seq_store_set_idle(0);  // a flash erase would stop the audio
+		// startup delay - lamp check
+		if(mixer_run_startup_delay) {
+			mixer_run_startup_delay --;
+			ioctl_set_midi_rec_led(SEQ_LED_ON);
+			ioctl_set_midi_play_led(SEQ_LED_ON);
+			ioctl_set_divider_outputs(1, 1, 1, 1);
+			cv_gate_ctrl_note(0, NOTE_LOW, 1);
+			ioctl_set_midi_clock_out(1);
+			ioctl_set_midi_in_led(1);
+			ioctl_set_mixer_delay_led(255);
+			ioctl_set_mixer_output_leds(255, 255);
+			if(mixer_run_startup_delay == 0) {
+				ioctl_set_midi_rec_led(SEQ_LED_OFF);
+				ioctl_set_midi_play_led(SEQ_LED_OFF);
+				ioctl_set_divider_outputs(0, 0, 0, 0);
+				cv_gate_ctrl_note(0, 60, 1);
+				cv_gate_ctrl_note(0, 60, 0);
+				ioctl_set_midi_clock_out(0);
+				ioctl_set_midi_in_led(0);
+				ioctl_set_mixer_delay_led(0);
+				ioctl_set_mixer_output_leds(0, 0);
+				phenol_midi_reset();
+				seq_init();  // reinit the seq
+			}
+		}
+		// normal processing
+		else {
+			audio_proc_process();
+			pulse_div_timer_task();
+			phenol_midi_timer_task();
+			midi_rx_task(MIDI_PORT_DIN);
+			midi_rx_task(MIDI_PORT_USB);
+			// sequencer interval = 1ms
+			if((timer_div & 0x03) == 0) {
+				midi_clock_timer_task();
+				seq_timer_task();
+				cv_gate_ctrl_timer_task();
+				telem_timer_task();
+			}
+		}
+	}
+	// we are off - force everything off
+	else {
+		// error LED blinky
+		if(mixer_run_power_state == POWER_STATE_ERROR) {
+			ioctl_set_mixer_delay_led((timer_div >> 8) & 0x01);
+			ioctl_set_mixer_output_leds((timer_div >> 8) & 0x01, (timer_div >> 8) & 0x01);
+		}
+		else {
+			ioctl_set_mixer_delay_led(0);
+			ioctl_set_mixer_output_leds(0, 0);
+		}
+		ioctl_set_midi_rec_led(SEQ_LED_OFF);
+		ioctl_set_midi_play_led(SEQ_LED_OFF);
+		ioctl_set_divider_outputs(0, 0, 0, 0);
+		cv_gate_ctrl_off();
+		ioctl_set_midi_clock_out(0);
+		ioctl_set_midi_in_led(0);
+		ioctl_set_mixer_output_leds(0, 0);
+		audio_proc_silence();
+		seq_store_set_idle(1);  // flash erases are okay while off / in standby
+		mixer_run_startup_delay = MIXER_RUN_STARTUP_DELAY;
+	}
+
+	// 64ms - power control
+	if(mixer_run_power && (timer_div & 0xff) == 0) {
+		power_ctrl_timer_task();
+		mixer_run_power_state = power_ctrl_get_state();
+	}
+
+	timer_div ++;
+	isr_load_end(ISR_LOAD_TIMER1, load_start);
+}
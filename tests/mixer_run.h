@@ -0,0 +1,53 @@
+/*
+ * K65 Phenol - Mixer Firmware Runner
+ *
+ * Copyright 2015: Andrew Kilpatrick
+ * Written by: Andrew Kilpatrick
+ *
+ */
+#ifndef MIXER_RUN_H
+#define MIXER_RUN_H
+
+#include <inttypes.h>
+
+// settings
+#define MIXER_RUN_TICK_US 250  // Timer1 period
+#define MIXER_RUN_MIDI_BYTE_US 320  // 10 bits at 31250 baud
+#define MIXER_RUN_FRAMES_PER_TICK 12  // 48kHz
+#define MIXER_RUN_RATE 48000
+
+// set up the firmware like main() in k65-mixer.c
+// - the power is on from the start and the startup lamp test is not run
+void mixer_run_init(void);
+
+// run the power control like on the hardware - call after mixer_run_init()
+// - the firmware starts off and waits for the power switch
+void mixer_run_power_ctrl(void);
+
+// run one tick - UART, SPI and Timer1 ISRs, then the main loop
+void mixer_run_tick(void);
+
+// get the number of ticks run since init
+int mixer_run_get_tick(void);
+
+// queue a byte for the DIN MIDI in
+void mixer_run_midi_send(unsigned char byte);
+
+// get the number of bytes waiting for the DIN MIDI in
+int mixer_run_midi_queued(void);
+
+// send MIDI clock to the DIN MIDI in - interval in us per clock - 0 = off
+void mixer_run_clock(int interval);
+
+// set the codec frame handler - called for each frame the SPI ISR moves
+// - in = the 2 samples to record - out = the 2 samples that were played
+void mixer_run_set_audio(void (*func)(int16_t *in, int16_t *out));
+
+// get the load of an ISR over the last second - 0-1000 = 0-100.0%
+// - isr is one of ISR_LOAD_ in isr_load.h
+int mixer_run_get_load(int isr);
+
+// get the longest run of an ISR in the last second - us
+int mixer_run_get_max(int isr);
+
+#endif
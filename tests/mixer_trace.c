@@ -0,0 +1,210 @@
+/*
+ * K65 Phenol - Mixer Trace
+ *
+ * Copyright 2015: Andrew Kilpatrick
+ * Written by: Andrew Kilpatrick
+ *
+ * Runs the mixer firmware on the host from a script and writes a trace of
+ * the outputs to stdout. The firmware is run in virtual time by
+ * mixer_run.c - see there for what each 250us tick does.
+ *
+ * Usage:
+ *	./mixer_trace script.txt > trace.txt
+ *
+ * Script commands - after the time in ms:
+ *	midi <hex bytes...>  - send bytes to the DIN MIDI in - 320us per byte
+ *	clock <bpm> | off  - send MIDI clock to the DIN MIDI in
+ *	sw <0=rec|1=play> <0|1>  - release / press a switch
+ *	pot <n> <0-255>  - set a pot - see POT_MIXER_ in ioctl.h
+ *	div <0|1>  - set the divider input
+ *	audio <0|1> sine <hz> <level> | noise <level> | off  - set a codec input
+ *	end  - end of the run
+ *
+ * Trace lines - after the time in ms:
+ *	tx <port> <hex bytes...>  - MIDI sent in the last ms
+ *	audio <crc> <peak L> <peak R>  - codec output every 32ms once audio is on
+ *	others are outputs from the fakes in stubs/mixer_io.c
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "harness.h"
+#include "mixer_run.h"
+#include "mixer_io.h"
+#include "midi.h"
+
+#define TRACE_AUDIO_MS 32
+
+// audio input generator
+struct trace_gen {
+	int type;  // 0 = off, 1 = sine, 2 = noise
+	double phase;
+	double step;
+	int level;
+};
+
+// audio
+struct trace_gen trace_gens[2];
+uint32_t trace_noise;
+uint32_t trace_audio_crc;
+int trace_audio_peak[2];
+int trace_audio_on;
+
+// local functions
+void trace_init(void);
+void trace_cmd(struct harness_cmd *cmd);
+void trace_audio(int16_t *in, int16_t *out);
+int16_t trace_gen_sample(struct trace_gen *gen);
+void trace_tx(void);
+
+int main(int argc, char *argv[]) {
+	struct harness_cmd *cmd;
+	int tick, ms, end;
+
+	if(argc != 2) {
+		fprintf(stderr, "usage: %s script.txt\n", argv[0]);
+		return 1;
+	}
+	if(harness_script_load(argv[1]) < 0) {
+		return 1;
+	}
+	end = harness_script_length();
+	trace_init();
+
+	harness_time_start();
+	for(tick = 0; tick < (end * 4); tick ++) {
+		ms = tick >> 2;
+		harness_set_time(ms);
+		if((tick & 0x03) == 0) {
+			while((cmd = harness_script_next(ms)) != NULL) {
+				trace_cmd(cmd);
+			}
+		}
+		mixer_run_tick();
+		if((tick & 0x03) == 0x03) {
+			trace_tx();
+		}
+		if(trace_audio_on && ((tick + 1) % (TRACE_AUDIO_MS * 4)) == 0) {
+			harness_trace("audio %08x %d %d", trace_audio_crc,
+				trace_audio_peak[0], trace_audio_peak[1]);
+			trace_audio_crc = 0;
+			trace_audio_peak[0] = 0;
+			trace_audio_peak[1] = 0;
+		}
+	}
+	harness_time_report(argv[1], end);
+	return 0;
+}
+
+//
+// local functions
+//
+// set up the firmware and the inputs
+void trace_init(void) {
+	memset(trace_gens, 0, sizeof(trace_gens));
+	trace_noise = 1;
+	trace_audio_crc = 0;
+	trace_audio_peak[0] = 0;
+	trace_audio_peak[1] = 0;
+	trace_audio_on = 0;
+	mixer_run_init();
+	mixer_run_set_audio(trace_audio);
+}
+
+// run a script command
+void trace_cmd(struct harness_cmd *cmd) {
+	struct trace_gen *gen;
+	int i;
+	if(strcmp(cmd->name, "midi") == 0) {
+		for(i = 0; i < cmd->argc; i ++) {
+			mixer_run_midi_send(harness_arg_hex(cmd, i));
+		}
+	}
+	else if(strcmp(cmd->name, "clock") == 0) {
+		if(cmd->argc && strcmp(cmd->argv[0], "off") == 0) {
+			mixer_run_clock(0);
+		}
+		else {
+			mixer_run_clock(2500000 / harness_arg(cmd, 0));  // 24 PPQ
+		}
+	}
+	else if(strcmp(cmd->name, "sw") == 0) {
+		mixer_io_set_sw(harness_arg(cmd, 0), harness_arg(cmd, 1));
+	}
+	else if(strcmp(cmd->name, "pot") == 0) {
+		mixer_io_set_pot(harness_arg(cmd, 0), harness_arg(cmd, 1));
+	}
+	else if(strcmp(cmd->name, "div") == 0) {
+		mixer_io_set_divider_in(harness_arg(cmd, 0));
+	}
+	else if(strcmp(cmd->name, "audio") == 0) {
+		gen = &trace_gens[harness_arg(cmd, 0) & 0x01];
+		if(cmd->argc > 1 && strcmp(cmd->argv[1], "sine") == 0) {
+			gen->type = 1;
+			gen->step = (2.0 * M_PI * harness_arg(cmd, 2)) / MIXER_RUN_RATE;
+			gen->level = harness_arg(cmd, 3);
+		}
+		else if(cmd->argc > 1 && strcmp(cmd->argv[1], "noise") == 0) {
+			gen->type = 2;
+			gen->level = harness_arg(cmd, 2);
+		}
+		else {
+			gen->type = 0;
+		}
+		trace_audio_on = 1;
+	}
+	else if(strcmp(cmd->name, "end") != 0) {
+		fprintf(stderr, "%d: unknown command: %s\n", cmd->time, cmd->name);
+		exit(1);
+	}
+}
+
+// make and check the samples for one codec frame
+void trace_audio(int16_t *in, int16_t *out) {
+	int i;
+	for(i = 0; i < 2; i ++) {
+		in[i] = trace_gen_sample(&trace_gens[i]);
+		trace_audio_crc = harness_crc(trace_audio_crc, out[i] & 0xffff);
+		if(abs(out[i]) > trace_audio_peak[i]) {
+			trace_audio_peak[i] = abs(out[i]);
+		}
+	}
+}
+
+// get the next sample from an audio input generator
+int16_t trace_gen_sample(struct trace_gen *gen) {
+	switch(gen->type) {
+		case 1:
+			gen->phase += gen->step;
+			if(gen->phase > (2.0 * M_PI)) {
+				gen->phase -= (2.0 * M_PI);
+			}
+			return (int16_t)lrint(sin(gen->phase) * gen->level);
+		case 2:
+			trace_noise = (trace_noise * 1664525) + 1013904223;
+			return (int16_t)(((int32_t)trace_noise >> 16) * gen->level / 32768);
+	}
+	return 0;
+}
+
+// trace the MIDI sent on each port
+void trace_tx(void) {
+	char line[256];
+	int port, len;
+	for(port = 0; port < MIDI_NUMPORTS; port ++) {
+		len = 0;
+		while(midi_tx_avail(port)) {
+			if(len < (int)sizeof(line) - 4) {
+				len += sprintf(line + len, " %02x", midi_tx_get_byte(port));
+			}
+			else {
+				midi_tx_get_byte(port);
+			}
+		}
+		if(len) {
+			harness_trace("tx %d%s", port, line);
+		}
+	}
+}
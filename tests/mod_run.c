@@ -0,0 +1,160 @@
+/*
+ * K65 Phenol - Mod Processor Firmware Runner
+ *
+ * Copyright 2015: Andrew Kilpatrick
+ * Written by: Andrew Kilpatrick
+ *
+ * Runs the mod processor firmware on the host in virtual time. The
+ * firmware modules are built unchanged - only ioctl.c, switch_filter.c
+ * and dac.c are replaced with the fakes in stubs/mod_io.c, and plib with
+ * stubs/plib.c.
+ *
+ * Virtual time runs in 50us steps. The Timer2 ISR from k65-mod.c runs
+ * every 100us and the Timer1 ISR every 250us - Timer2 first when both are
+ * due since it has the higher priority. The power control input is read
+ * from stubs/mod_io.c - it starts on, with the startup lamp test done.
+ *
+ */
+#include <stdio.h>
+#include "plib.h"
+#include "mod_run.h"
+#include "mod_io.h"
+#include "ioctl.h"
+#include "dac.h"
+#include "env_proc.h"
+#include "isr_load.h"
+
+#define MOD_RUN_STARTUP_DELAY 2000  // as in k65-mod.c
+
+// sample handler
+void (*mod_run_sample)(void);
+
+// timer
+int mod_run_steps;
+int timer_div;
+int power_state;
+int mod_run_startup_delay;
+
+// local functions
+void mod_run_timer1(void);
+void mod_run_timer2(void);
+
+// set up the firmware like main() in k65-mod.c
+void mod_run_init(void) {
+	mod_run_steps = 0;
+	mod_run_sample = NULL;
+	timer_div = 0;
+	power_state = 1;
+	mod_run_startup_delay = 0;
+	mod_io_init();
+	isr_load_init();
+	env_proc_init();
+}
+
+// run one step - Timer2 and Timer1 ISRs if they are due
+void mod_run_step(void) {
+	int us = mod_run_steps * MOD_RUN_STEP_US;
+	if((us % MOD_RUN_TIMER2_US) == 0) {
+		if(mod_run_sample) {
+			mod_run_sample();
+		}
+		mod_run_timer2();
+	}
+	if((us % MOD_RUN_TIMER1_US) == 0) {
+		mod_run_timer1();
+	}
+	mod_run_steps ++;
+}
+
+// get the number of steps run since init
+int mod_run_get_step(void) {
+	return mod_run_steps;
+}
+
+// set the sample handler - called before each Timer2 ISR
+void mod_run_set_sample(void (*func)(void)) {
+	mod_run_sample = func;
+}
+
+// get the load of an ISR over the last second - 0-1000 = 0-100.0%
+int mod_run_get_load(int isr) {
+	return isr_load_get_load(isr);
+}
+
+// get the longest run of an ISR in the last second - us
+int mod_run_get_max(int isr) {
+	return isr_load_get_max(isr);
+}
+
+//
+// local functions
+//
+// the Timer1 ISR from k65-mod.c
+void mod_run_timer1(void) {
+	int temp;
+	unsigned int load_start = isr_load_start();
+
+	// run always
+	isr_load_timer_task();
+
+	temp = ioctl_get_analog_power_ctrl();
+	if(power_state != temp) {
+		power_state = temp;
+	}
+	// we are off - force everything off
+	if(!power_state) {
+		ioctl_set_gate_led(0, 0);
+		ioctl_set_gate_led(1, 0);
+		ioctl_set_mode_led(0, 0, 0);
+		ioctl_set_mode_led(0, 1, 0);
+		ioctl_set_mode_led(0, 2, 0);
+		ioctl_set_mode_led(1, 0, 0);
+		ioctl_set_mode_led(1, 1, 0);
+		ioctl_set_mode_led(1, 2, 0);
+		dac_write_dac(0, DAC_VAL_OFF);
+		dac_write_dac(1, DAC_VAL_OFF);
+		dac_write_dac(2, DAC_VAL_OFF);
+		dac_write_dac(3, DAC_VAL_OFF);
+		mod_run_startup_delay = MOD_RUN_STARTUP_DELAY;
+	}
+	// startup delay
+	else if(mod_run_startup_delay) {
+		mod_run_startup_delay --;
+		// lamp test
+		ioctl_set_gate_led(0, 1);
+		ioctl_set_gate_led(1, 1);
+		ioctl_set_mode_led(0, 0, 1);
+		ioctl_set_mode_led(0, 1, 1);
+		ioctl_set_mode_led(0, 2, 1);
+		ioctl_set_mode_led(1, 0, 1);
+		ioctl_set_mode_led(1, 1, 1);
+		ioctl_set_mode_led(1, 2, 1);
+		dac_write_dac(0, DAC_VAL_OFF);
+		dac_write_dac(1, DAC_VAL_OFF);
+		dac_write_dac(2, DAC_VAL_OFF);
+		dac_write_dac(3, DAC_VAL_OFF);
+		// init stuff at the end
+		if(mod_run_startup_delay == 0) {
+			env_proc_init();
+		}
+	}
+	// we are on - run normally
+	else {
+		// 1ms
+		if((timer_div & 0x03) == 0) {
+			env_proc_timer_task();
+		}
+	}
+
+	timer_div ++;
+	isr_load_end(ISR_LOAD_TIMER1, load_start);
+}
+
+// the Timer2 ISR from k65-mod.c - sample clock
+void mod_run_timer2(void) {
+	unsigned int load_start = isr_load_start();
+	if(power_state) {
+		env_proc_sample_task();
+	}
+	isr_load_end(ISR_LOAD_TIMER2, load_start);
+}
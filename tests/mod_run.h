@@ -0,0 +1,36 @@
+/*
+ * K65 Phenol - Mod Processor Firmware Runner
+ *
+ * Copyright 2015: Andrew Kilpatrick
+ * Written by: Andrew Kilpatrick
+ *
+ */
+#ifndef MOD_RUN_H
+#define MOD_RUN_H
+
+// settings
+#define MOD_RUN_STEP_US 50  // virtual time step
+#define MOD_RUN_TIMER1_US 250  // Timer1 period
+#define MOD_RUN_TIMER2_US 100  // Timer2 period - 10kHz sample clock
+
+// set up the firmware like main() in k65-mod.c
+// - the power is on from the start and the startup lamp test is not run
+void mod_run_init(void);
+
+// run one step - Timer2 and Timer1 ISRs if they are due
+void mod_run_step(void);
+
+// get the number of steps run since init
+int mod_run_get_step(void);
+
+// set the sample handler - called before each Timer2 ISR
+void mod_run_set_sample(void (*func)(void));
+
+// get the load of an ISR over the last second - 0-1000 = 0-100.0%
+// - isr is one of ISR_LOAD_ in isr_load.h
+int mod_run_get_load(int isr);
+
+// get the longest run of an ISR in the last second - us
+int mod_run_get_max(int isr);
+
+#endif
@@ -0,0 +1,148 @@
+/*
+ * K65 Phenol - Mod Trace
+ *
+ * Copyright 2015: Andrew Kilpatrick
+ * Written by: Andrew Kilpatrick
+ *
+ * Runs the mod processor firmware on the host from a script and writes a
+ * trace of the outputs to stdout. The firmware is run in virtual time by
+ * mod_run.c - see there for when each ISR runs. The CV input sweeps move
+ * on before each sample.
+ *
+ * Usage:
+ *	./mod_trace script.txt > trace.txt
+ *
+ * Script commands - after the time in ms:
+ *	pot <n> <0-255>  - set a pot - see POT_MOD in ioctl.h
+ *	cv <n> <0-4095>  - set a CV input
+ *	cv <n> tri <period ms> <low> <high>  - sweep a CV input
+ *	gate <n> <0|1>  - set a gate input
+ *	gatesw <n> <0|1>  - release / press a gate switch
+ *	sw <n> <0|1>  - release / press a mode switch - see SW_MOD in ioctl.h
+ *	end  - end of the run
+ *
+ * Trace lines - after the time in ms:
+ *	dac <crc> <mod1> <mod2> <rand> <sine>  - every 16ms if a DAC changed
+ *	others are outputs from the fakes in stubs/mod_io.c
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "harness.h"
+#include "mod_run.h"
+#include "mod_io.h"
+
+#define TRACE_DAC_MS 16
+
+// CV input sweep
+struct trace_sweep {
+	int period;  // in 100us samples - 0 = off
+	int pos;
+	int low;
+	int high;
+};
+
+struct trace_sweep trace_sweeps[2];
+
+// local functions
+void trace_cmd(struct harness_cmd *cmd);
+void trace_sample(void);
+void trace_sweep(int cv);
+
+int main(int argc, char *argv[]) {
+	struct harness_cmd *cmd;
+	int step, ms, end;
+
+	if(argc != 2) {
+		fprintf(stderr, "usage: %s script.txt\n", argv[0]);
+		return 1;
+	}
+	if(harness_script_load(argv[1]) < 0) {
+		return 1;
+	}
+	end = harness_script_length();
+
+	memset(trace_sweeps, 0, sizeof(trace_sweeps));
+	mod_run_init();
+	mod_run_set_sample(trace_sample);
+
+	harness_time_start();
+	for(step = 0; step < (end * (1000 / MOD_RUN_STEP_US)); step ++) {
+		ms = (step * MOD_RUN_STEP_US) / 1000;
+		harness_set_time(ms);
+		if(((step * MOD_RUN_STEP_US) % 1000) == 0) {
+			while((cmd = harness_script_next(ms)) != NULL) {
+				trace_cmd(cmd);
+			}
+		}
+		mod_run_step();
+		if((((step + 1) * MOD_RUN_STEP_US) % (TRACE_DAC_MS * 1000)) == 0) {
+			mod_io_dac_flush();
+		}
+	}
+	harness_time_report(argv[1], end);
+	return 0;
+}
+
+//
+// local functions
+//
+// run a script command
+void trace_cmd(struct harness_cmd *cmd) {
+	struct trace_sweep *sweep;
+	if(strcmp(cmd->name, "pot") == 0) {
+		mod_io_set_pot(harness_arg(cmd, 0), harness_arg(cmd, 1));
+	}
+	else if(strcmp(cmd->name, "cv") == 0) {
+		sweep = &trace_sweeps[harness_arg(cmd, 0) & 0x01];
+		if(cmd->argc > 1 && strcmp(cmd->argv[1], "tri") == 0) {
+			sweep->period = harness_arg(cmd, 2) * 10;
+			sweep->pos = 0;
+			sweep->low = harness_arg(cmd, 3);
+			sweep->high = harness_arg(cmd, 4);
+		}
+		else {
+			sweep->period = 0;
+			mod_io_set_cv(harness_arg(cmd, 0), harness_arg(cmd, 1));
+		}
+	}
+	else if(strcmp(cmd->name, "gate") == 0) {
+		mod_io_set_gate_in(harness_arg(cmd, 0), harness_arg(cmd, 1));
+	}
+	else if(strcmp(cmd->name, "gatesw") == 0) {
+		mod_io_set_gate_sw(harness_arg(cmd, 0), harness_arg(cmd, 1));
+	}
+	else if(strcmp(cmd->name, "sw") == 0) {
+		mod_io_set_sw(harness_arg(cmd, 0), harness_arg(cmd, 1));
+	}
+	else if(strcmp(cmd->name, "end") != 0) {
+		fprintf(stderr, "%d: unknown command: %s\n", cmd->time, cmd->name);
+		exit(1);
+	}
+}
+
+// move the CV input sweeps on - called before each sample
+void trace_sample(void) {
+	trace_sweep(0);
+	trace_sweep(1);
+}
+
+// move a CV input sweep on by one sample - triangle wave
+void trace_sweep(int cv) {
+	struct trace_sweep *sweep = &trace_sweeps[cv];
+	int half, pos;
+	if(sweep->period < 2) {
+		return;
+	}
+	half = sweep->period >> 1;
+	pos = sweep->pos;
+	if(pos >= half) {
+		pos = sweep->period - pos;
+	}
+	mod_io_set_cv(cv, sweep->low + (((sweep->high - sweep->low) * pos) / half));
+	sweep->pos ++;
+	if(sweep->pos == sweep->period) {
+		sweep->pos = 0;
+	}
+}
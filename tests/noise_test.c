@@ -0,0 +1,340 @@
+/*
+ * K65 Phenol - Noise Generator Test
+ *
+ * Copyright 2015: Andrew Kilpatrick
+ * Written by: Andrew Kilpatrick
+ *
+ * Runs the mod 3 noise generator on its own at the 10kHz sample rate and
+ * measures the spectrum of each colour in octave bands with an averaged
+ * FFT:
+ *	- white - every band within 1dB of the average, the values evenly
+ *	  spread over the 12 bit range with every bit set half the time and no
+ *	  correlation between samples
+ *	- pink - the bands fall by 3dB per octave, each band within 1.5dB of
+ *	  the line
+ *	- velvet - one full scale impulse of either sign in every 8 samples,
+ *	  the centre value the rest of the time, and a flat spectrum
+ * Reseeding must repeat the same noise, and a seed of 0 must not get the
+ * generator stuck.
+ *
+ * The cost per sample of each colour is printed next to the cost of
+ * libc rand() - the longest of many timed blocks is printed as well to
+ * show the cost does not move around.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "harness.h"
+#include "noise.h"
+
+#define TEST_RATE 10000
+#define TEST_FFT_BITS 13
+#define TEST_FFT_LEN (1 << TEST_FFT_BITS)
+#define TEST_BLOCKS 64  // FFT blocks averaged
+#define TEST_LOW_BAND 10.0  // lowest band start in Hz
+#define TEST_NUM_BANDS 8  // 10Hz to 2560Hz
+#define TEST_HIST_BINS 64
+#define TEST_MAX_LAG 16
+#define TEST_BENCH_BLOCK 1000  // samples in a timed block
+#define TEST_BENCH_BLOCKS 2000
+
+double test_re[TEST_FFT_LEN];
+double test_im[TEST_FFT_LEN];
+double test_psd[TEST_FFT_LEN / 2];
+double test_band_db[TEST_NUM_BANDS];
+int test_samples[TEST_FFT_LEN * TEST_BLOCKS];
+
+// local functions
+void test_render(int color, int len);
+void test_fft(double *re, double *im);
+void test_spectrum(void);
+void test_white(void);
+void test_pink(void);
+void test_velvet(void);
+void test_seed(void);
+void test_bench(const char *name, int color);
+
+int main(int argc, char *argv[]) {
+	noise_init();
+	test_white();
+	test_pink();
+	test_velvet();
+	test_seed();
+	test_bench("white", NOISE_WHITE);
+	test_bench("pink", NOISE_PINK);
+	test_bench("velvet", NOISE_VELVET);
+	test_bench("libc rand()", -1);
+	return harness_done("noise_test");
+}
+
+//
+// local functions
+//
+// get noise samples in a colour
+void test_render(int color, int len) {
+	int i;
+	noise_set_color(color);
+	for(i = 0; i < len; i ++) {
+		test_samples[i] = noise_sample();
+	}
+}
+
+// in place radix 2 FFT
+void test_fft(double *re, double *im) {
+	int i, j, k, len, half;
+	double t, ang, wr, wi, xr, xi;
+
+	// bit reverse
+	for(i = 1, j = 0; i < TEST_FFT_LEN; i ++) {
+		k = TEST_FFT_LEN >> 1;
+		for(; j & k; k >>= 1) {
+			j ^= k;
+		}
+		j ^= k;
+		if(i < j) {
+			t = re[i]; re[i] = re[j]; re[j] = t;
+			t = im[i]; im[i] = im[j]; im[j] = t;
+		}
+	}
+	for(len = 2; len <= TEST_FFT_LEN; len <<= 1) {
+		half = len >> 1;
+		for(k = 0; k < half; k ++) {
+			ang = (-2 * M_PI * k) / len;
+			wr = cos(ang);
+			wi = sin(ang);
+			for(i = k; i < TEST_FFT_LEN; i += len) {
+				j = i + half;
+				xr = (re[j] * wr) - (im[j] * wi);
+				xi = (re[j] * wi) + (im[j] * wr);
+				re[j] = re[i] - xr;
+				im[j] = im[i] - xi;
+				re[i] += xr;
+				im[i] += xi;
+			}
+		}
+	}
+}
+
+// get the power in octave bands of the rendered samples - dB per bin
+// - Hann windowed blocks with the mean taken out
+void test_spectrum(void) {
+	int b, i, band, lo, hi;
+	double mean, win, sum;
+
+	memset(test_psd, 0, sizeof(test_psd));
+	for(b = 0; b < TEST_BLOCKS; b ++) {
+		mean = 0;
+		for(i = 0; i < TEST_FFT_LEN; i ++) {
+			mean += test_samples[(b * TEST_FFT_LEN) + i];
+		}
+		mean /= TEST_FFT_LEN;
+		for(i = 0; i < TEST_FFT_LEN; i ++) {
+			win = 0.5 - (0.5 * cos((2 * M_PI * i) / TEST_FFT_LEN));
+			test_re[i] = (test_samples[(b * TEST_FFT_LEN) + i] - mean) * win;
+			test_im[i] = 0;
+		}
+		test_fft(test_re, test_im);
+		for(i = 0; i < TEST_FFT_LEN / 2; i ++) {
+			test_psd[i] += (test_re[i] * test_re[i]) + (test_im[i] * test_im[i]);
+		}
+	}
+	for(band = 0; band < TEST_NUM_BANDS; band ++) {
+		lo = (int)((TEST_LOW_BAND * (1 << band) * TEST_FFT_LEN) / TEST_RATE);
+		hi = (int)((TEST_LOW_BAND * (2 << band) * TEST_FFT_LEN) / TEST_RATE);
+		sum = 0;
+		for(i = lo; i < hi; i ++) {
+			sum += test_psd[i];
+		}
+		test_band_db[band] = 10 * log10(sum / (hi - lo));
+	}
+}
+
+// white - flat, even and not correlated
+void test_white(void) {
+	static int hist[TEST_HIST_BINS];
+	int bits[12] = {0};
+	int i, bit, lag, band, len = TEST_FFT_LEN * TEST_BLOCKS;
+	double avg = 0, mean = 0, var = 0, corr, worst_corr = 0, chi = 0, expect;
+
+	test_render(NOISE_WHITE, len);
+	test_spectrum();
+	for(band = 0; band < TEST_NUM_BANDS; band ++) {
+		avg += test_band_db[band] / TEST_NUM_BANDS;
+	}
+	for(band = 0; band < TEST_NUM_BANDS; band ++) {
+		HARNESS_CHECK(fabs(test_band_db[band] - avg) < 1.0, "white: %.0fHz band is %.2fdB "
+			"from the average", TEST_LOW_BAND * (1 << band), test_band_db[band] - avg);
+	}
+
+	// spread over the range - chi squared with 63 degrees of freedom
+	memset(hist, 0, sizeof(hist));
+	for(i = 0; i < len; i ++) {
+		HARNESS_CHECK(test_samples[i] >= 0 && test_samples[i] <= 0xfff,
+			"white: sample %d is %d", i, test_samples[i]);
+		hist[(test_samples[i] >> 6) & (TEST_HIST_BINS - 1)] ++;
+		for(bit = 0; bit < 12; bit ++) {
+			bits[bit] += (test_samples[i] >> bit) & 0x01;
+		}
+		mean += test_samples[i];
+	}
+	// every bit is set half the time - the histogram does not see the low bits
+	for(bit = 0; bit < 12; bit ++) {
+		HARNESS_CHECK(abs(bits[bit] - (len / 2)) < (len / 100), "white: bit %d is set in "
+			"%d of %d samples", bit, bits[bit], len);
+	}
+	expect = (double)len / TEST_HIST_BINS;
+	for(i = 0; i < TEST_HIST_BINS; i ++) {
+		chi += ((hist[i] - expect) * (hist[i] - expect)) / expect;
+	}
+	HARNESS_CHECK(chi < 110, "white: histogram chi squared is %.1f", chi);
+
+	// correlation with the samples just before
+	mean /= len;
+	for(i = 0; i < len; i ++) {
+		var += (test_samples[i] - mean) * (test_samples[i] - mean);
+	}
+	for(lag = 1; lag <= TEST_MAX_LAG; lag ++) {
+		corr = 0;
+		for(i = lag; i < len; i ++) {
+			corr += (test_samples[i] - mean) * (test_samples[i - lag] - mean);
+		}
+		corr /= var;
+		if(fabs(corr) > fabs(worst_corr)) {
+			worst_corr = corr;
+		}
+	}
+	HARNESS_CHECK(fabs(worst_corr) < 0.01, "white: correlation up to %.4f", worst_corr);
+	fprintf(stderr, "noise_test: white: mean %.1f - chi squared %.1f - worst correlation "
+		"%.4f - bands %.2fdB to %.2fdB from the average\n", mean, chi, worst_corr,
+		test_band_db[0] - avg, test_band_db[TEST_NUM_BANDS - 1] - avg);
+}
+
+// pink - -3dB per octave
+void test_pink(void) {
+	int band;
+	double sx = 0, sy = 0, sxx = 0, sxy = 0, slope, offset, err, worst = 0;
+
+	test_render(NOISE_PINK, TEST_FFT_LEN * TEST_BLOCKS);
+	test_spectrum();
+	// straight line fit of dB against octave
+	for(band = 0; band < TEST_NUM_BANDS; band ++) {
+		sx += band;
+		sy += test_band_db[band];
+		sxx += band * band;
+		sxy += band * test_band_db[band];
+	}
+	slope = ((TEST_NUM_BANDS * sxy) - (sx * sy)) / ((TEST_NUM_BANDS * sxx) - (sx * sx));
+	offset = (sy - (slope * sx)) / TEST_NUM_BANDS;
+	for(band = 0; band < TEST_NUM_BANDS; band ++) {
+		err = test_band_db[band] - (offset + (slope * band));
+		if(fabs(err) > fabs(worst)) {
+			worst = err;
+		}
+	}
+	HARNESS_CHECK(slope > -3.5 && slope < -2.5, "pink: slope is %.2fdB per octave", slope);
+	HARNESS_CHECK(fabs(worst) < 1.5, "pink: a band is %.2fdB off the line", worst);
+	fprintf(stderr, "noise_test: pink: %.2fdB per octave from %.0fHz to %.0fHz - "
+		"bands within %.2fdB of the line\n", slope, TEST_LOW_BAND,
+		TEST_LOW_BAND * (1 << TEST_NUM_BANDS), fabs(worst));
+}
+
+// velvet - sparse impulses
+void test_velvet(void) {
+	int i, j, band, impulses, ups = 0, len = TEST_FFT_LEN * TEST_BLOCKS;
+	double avg = 0, worst = 0;
+
+	noise_init();
+	test_render(NOISE_VELVET, len);
+	for(i = 0; i < len; i += 8) {
+		impulses = 0;
+		for(j = i; j < i + 8; j ++) {
+			if(test_samples[j] == 0xfff || test_samples[j] == 0x000) {
+				impulses ++;
+				ups += (test_samples[j] == 0xfff);
+			}
+			else if(test_samples[j] != 0x7ff) {
+				HARNESS_CHECK(0, "velvet: sample %d is %d", j, test_samples[j]);
+			}
+		}
+		if(impulses != 1) {
+			HARNESS_CHECK(0, "velvet: %d impulses at %d", impulses, i);
+			break;
+		}
+	}
+	HARNESS_CHECK(abs(ups - (len / 16)) < (len / 160), "velvet: %d of %d impulses are up",
+		ups, len / 8);
+	test_spectrum();
+	for(band = 0; band < TEST_NUM_BANDS; band ++) {
+		avg += test_band_db[band] / TEST_NUM_BANDS;
+	}
+	for(band = 0; band < TEST_NUM_BANDS; band ++) {
+		if(fabs(test_band_db[band] - avg) > fabs(worst)) {
+			worst = test_band_db[band] - avg;
+		}
+	}
+	HARNESS_CHECK(fabs(worst) < 1.0, "velvet: a band is %.2fdB from the average", worst);
+	fprintf(stderr, "noise_test: velvet: %d of %d impulses up - bands within %.2fdB of "
+		"the average\n", ups, len / 8, fabs(worst));
+}
+
+// the same seed gives the same noise - 0 doesn't get stuck
+void test_seed(void) {
+	int i, color, same = 1, stuck = 1;
+	static int first[1000];
+
+	for(color = 0; color < NOISE_NUM_COLORS; color ++) {
+		noise_init();
+		noise_seed(12345);
+		test_render(color, 1000);
+		memcpy(first, test_samples, sizeof(first));
+		noise_init();
+		noise_seed(12345);
+		test_render(color, 1000);
+		if(memcmp(first, test_samples, sizeof(first)) != 0) {
+			same = 0;
+		}
+	}
+	HARNESS_CHECK(same, "reseeding did not repeat the noise");
+
+	noise_init();
+	noise_seed(0);
+	test_render(NOISE_WHITE, 1000);
+	for(i = 1; i < 1000; i ++) {
+		if(test_samples[i] != test_samples[0]) {
+			stuck = 0;
+		}
+	}
+	HARNESS_CHECK(!stuck && noise_state != 0, "a seed of 0 got the generator stuck");
+}
+
+// time a colour - color -1 = libc rand()
+void test_bench(const char *name, int color) {
+	int b, i, sum = 0;
+	double start, ns, total = 0, longest = 0;
+
+	if(color >= 0) {
+		noise_set_color(color);
+	}
+	for(b = 0; b < TEST_BENCH_BLOCKS; b ++) {
+		start = harness_now_ns();
+		if(color >= 0) {
+			for(i = 0; i < TEST_BENCH_BLOCK; i ++) {
+				sum += noise_sample();
+			}
+		}
+		else {
+			for(i = 0; i < TEST_BENCH_BLOCK; i ++) {
+				sum += rand() >> 20;
+			}
+		}
+		ns = (harness_now_ns() - start) / TEST_BENCH_BLOCK;
+		total += ns;
+		if(ns > longest) {
+			longest = ns;
+		}
+	}
+	fprintf(stderr, "noise_test: %-11s %.2fns per sample - longest block %.2fns (%d)\n",
+		name, total / TEST_BENCH_BLOCKS, longest, sum & 0x01);
+}
@@ -0,0 +1,774 @@
+/*
+ * K65 Phenol - Simulator
+ *
+ * Copyright 2015: Andrew Kilpatrick
+ * Written by: Andrew Kilpatrick
+ *
+ * Runs the mixer and the mod processor firmware together on one virtual
+ * clock, in 50us steps. Each step runs the mixer tick from mixer_run.c
+ * when it is due (UART2, SPI1 and Timer1 ISRs every 250us), then the mod
+ * processor step from mod_run.c (Timer2 every 100us, Timer1 every 250us).
+ * The power control line from the mixer drives the mod processor, so both
+ * come up together when the power switch is pressed.
+ *
+ * The peripherals are virtual: MIDI comes into the DIN UART from the
+ * script or a MIDI file, the codec SPI stream is read from and written
+ * to WAV files, and the DAC, gate and clock outputs are written to a
+ * CSV file of changes and a 10kHz WAV file. Patches join mixer outputs
+ * to mod processor inputs like cables on the front panel.
+ *
+ * The ISR load meters in the firmware read the core timer. It is set to
+ * the virtual time at each step, and the host time taken in an ISR is
+ * added to it scaled by -cpu-scale, so the meters show how busy the
+ * PIC32s would be. The load and the longest run of each ISR are printed
+ * at the end with the speed of the run. The loads are only as good as the
+ * scale - compare one with the telem load report from the hardware to
+ * set it. Use -cpu-scale 0 to make runs repeat exactly. Windows are only
+ * counted once the power has been on for a while, since the host runs the
+ * startup work from a cold cache.
+ *
+ * Usage:
+ *	./phenol_sim [options] script.txt
+ *
+ * Options:
+ *	-t <seconds>  - run time - default is the end of the script
+ *	-midi <file.mid>  - play a type 0 or 1 MIDI file into the DIN MIDI in
+ *	-loop  - play the MIDI file over and over
+ *	-audio-in <file.wav>  - codec input - 48kHz 16 bit mono or stereo
+ *	-audio-out <file.wav>  - codec output - 48kHz 16 bit stereo
+ *	-cv-out <file.wav>  - 10kHz 16 bit with 8 channels: mod DAC 0-3,
+ *	  mixer CV 0-1, gate and clock - full scale is the DAC range
+ *	-csv <file.csv>  - output changes: time_us,output,chan,value
+ *	-off  - don't press the power switch at the start
+ *	-cpu-scale <n>  - PIC32 time for each unit of host time - default 50
+ *	-min-speed <x>  - fail if the run is slower than x times real time
+ *
+ * The power switch is held for the first 2s unless -off is given. The
+ * units go through the boot timeout and the lamp test and are running
+ * about 1.6s in.
+ *
+ * Script commands - after the time in ms:
+ *	midi <hex bytes...>  - send bytes to the DIN MIDI in - 320us per byte
+ *	clock <bpm> | off  - send MIDI clock to the DIN MIDI in
+ *	sw <0=rec|1=play> <0|1>  - release / press a mixer switch
+ *	pot <n> <0-255>  - set a mixer pot - see POT_MIXER_ in ioctl.h
+ *	div <0|1>  - set the mixer divider input
+ *	power <0|1>  - release / press the power switch
+ *	dc <0-4095>  - set the DC in sense value
+ *	mod_pot <n> <0-255>  - set a mod processor pot
+ *	mod_cv <n> <0-4095>  - set a mod processor CV input
+ *	mod_gate <n> <0|1>  - set a mod processor gate input
+ *	mod_gatesw <n> <0|1>  - release / press a mod processor gate switch
+ *	mod_sw <n> <0|1>  - release / press a mod processor mode switch
+ *	patch <from> <to>  - from: cv0 cv1 gate clock div0-3 mod_dac0-3 off
+ *	  to: mod_cv0 mod_cv1 mod_gate0 mod_gate1 div
+ *	expect <output> <chan> <value>  - check an output - see the CSV names
+ *	end  - end of the run
+ *
+ * Outputs - as named in the CSV and by expect:
+ *	cv_out gate_out clock_out div_out rec_led play_led delay_led - mixer
+ *	mod_dac gate_led mode_led - mod processor - mod_dac is written each ms
+ *	midi_tx - MIDI sent on a port in the last ms - the value is hex bytes
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "harness.h"
+#include "plib.h"
+#include "mixer_run.h"
+#include "mixer_io.h"
+#include "mod_run.h"
+#include "mod_io.h"
+#include "midi.h"
+#include "isr_load.h"
+#include "sim_midi.h"
+#include "sim_wav.h"
+
+#define SIM_STEP_US 50
+#define SIM_STEPS_PER_MS (1000 / SIM_STEP_US)
+#define SIM_CORE_PER_STEP 1000  // core timer ticks - 20MHz
+#define SIM_CPU_SCALE 50.0
+#define SIM_POWER_HOLD_MS 2000
+#define SIM_LOAD_SETTLE_MS 2500  // windows with the startup work in them are not counted
+#define SIM_CV_RATE 10000
+#define SIM_CV_CHANS 8
+#define SIM_MIDI_QUEUE_MAX 1024  // hold MIDI file events while the UART is this far behind
+#define SIM_MAX_OUTS 32
+#define SIM_MAX_PATCHES 8
+#define SIM_DAC_MAX 4095
+
+// mod processor ISRs - the same numbers as the mixer ones
+#define SIM_MOD_TIMER1 0
+#define SIM_MOD_TIMER2 1
+
+// an output seen from the trace hook
+struct sim_out {
+	char name[16];
+	int chan;
+	int val;
+	int changes;
+};
+
+// patch sources
+#define SIM_SRC_CV 0
+#define SIM_SRC_GATE 1
+#define SIM_SRC_CLOCK 2
+#define SIM_SRC_DIV 3
+#define SIM_SRC_MOD_DAC 4
+
+// patch destinations
+#define SIM_DEST_MOD_CV 0
+#define SIM_DEST_MOD_GATE 1
+#define SIM_DEST_DIV 2
+
+// a patch cable
+struct sim_patch {
+	int src;
+	int src_chan;
+	int dest;
+	int dest_chan;
+};
+
+// an ISR load meter
+struct sim_load {
+	const char *name;
+	int mod;  // 0 = mixer, 1 = mod processor
+	int isr;
+	long long sum;
+	int peak;
+	int windows;
+	int max_windows;
+	int *max_runs;  // longest run in each window
+};
+
+// DAC outputs in stubs/mod_io.c
+extern int mod_io_dacs[];
+
+// options
+double sim_cpu_scale;
+double sim_min_speed;
+int sim_power_hold;
+
+// time
+int64_t sim_us;
+int sim_on_ms;  // time the power came on - -1 = off
+
+// outputs
+struct sim_out sim_outs[SIM_MAX_OUTS];
+int sim_num_outs;
+int sim_cv[2];
+int sim_gate;
+int sim_clock;
+int64_t sim_clock_off;  // time the clock pulse ends - -1 = held on
+int sim_div;
+
+// patches
+struct sim_patch sim_patches[SIM_MAX_PATCHES];
+int sim_num_patches;
+
+// files
+FILE *sim_csv;
+int sim_midi_on;  // 1 = a MIDI file is playing
+struct sim_wav sim_audio_in;
+struct sim_wav sim_audio_out;
+struct sim_wav sim_cv_out;
+long sim_midi_tx_bytes;
+int sim_audio_peak[2];
+
+// load meters
+struct sim_load sim_loads[] = {
+	{"mixer Timer1", 0, ISR_LOAD_TIMER1},
+	{"mixer UART2", 0, ISR_LOAD_UART2},
+	{"mixer SPI1", 0, ISR_LOAD_SPI1},
+	{"mod Timer1", 1, SIM_MOD_TIMER1},
+	{"mod Timer2", 1, SIM_MOD_TIMER2},
+};
+#define SIM_NUM_LOADS (int)(sizeof(sim_loads) / sizeof(struct sim_load))
+
+// local functions
+void sim_usage(const char *prog);
+void sim_init(void);
+void sim_cmd(struct harness_cmd *cmd);
+void sim_patch_cmd(struct harness_cmd *cmd);
+void sim_hook(const char *line);
+struct sim_out *sim_out_set(const char *name, int chan, int val);
+struct sim_out *sim_out_find(const char *name, int chan);
+void sim_csv_row(const char *name, int chan, int val);
+void sim_run_patches(void);
+void sim_audio(int16_t *in, int16_t *out);
+void sim_cv_frame(void);
+void sim_midi_in(int ms);
+void sim_midi_tx(void);
+void sim_mod_dacs(void);
+void sim_load_sample(void);
+void sim_load_report(void);
+int16_t sim_dac_sample(int val);
+int sim_int_cmp(const void *a, const void *b);
+
+int main(int argc, char *argv[]) {
+	const char *script = NULL, *midi = NULL, *audio_in = NULL;
+	const char *audio_out = NULL, *cv_out = NULL, *csv = NULL;
+	struct harness_cmd *cmd;
+	int i, ms, end, step, loop = 0, secs = 0;
+	double start, speed;
+
+	sim_cpu_scale = SIM_CPU_SCALE;
+	sim_min_speed = 0.0;
+	sim_power_hold = 1;
+	for(i = 1; i < argc; i ++) {
+		if(strcmp(argv[i], "-loop") == 0) loop = 1;
+		else if(strcmp(argv[i], "-off") == 0) sim_power_hold = 0;
+		else if(argv[i][0] == '-' && i == argc - 1) sim_usage(argv[0]);
+		else if(strcmp(argv[i], "-t") == 0) secs = atoi(argv[++ i]);
+		else if(strcmp(argv[i], "-midi") == 0) midi = argv[++ i];
+		else if(strcmp(argv[i], "-audio-in") == 0) audio_in = argv[++ i];
+		else if(strcmp(argv[i], "-audio-out") == 0) audio_out = argv[++ i];
+		else if(strcmp(argv[i], "-cv-out") == 0) cv_out = argv[++ i];
+		else if(strcmp(argv[i], "-csv") == 0) csv = argv[++ i];
+		else if(strcmp(argv[i], "-cpu-scale") == 0) sim_cpu_scale = atof(argv[++ i]);
+		else if(strcmp(argv[i], "-min-speed") == 0) sim_min_speed = atof(argv[++ i]);
+		else if(argv[i][0] == '-' || script != NULL) sim_usage(argv[0]);
+		else script = argv[i];
+	}
+	if(script == NULL) {
+		sim_usage(argv[0]);
+	}
+	if(harness_script_load(script) < 0) {
+		return 1;
+	}
+	end = secs ? (secs * 1000) : harness_script_length();
+
+	// inputs and outputs
+	if(midi != NULL) {
+		if(sim_midi_load(midi) < 0) {
+			return 1;
+		}
+		sim_midi_set_loop(loop);
+		sim_midi_on = 1;
+	}
+	if(audio_in != NULL) {
+		if(sim_wav_open_read(&sim_audio_in, audio_in) < 0) {
+			return 1;
+		}
+		if(sim_audio_in.rate != MIXER_RUN_RATE || sim_audio_in.chans > 2) {
+			fprintf(stderr, "%s: audio in must be %dHz mono or stereo\n", audio_in,
+				MIXER_RUN_RATE);
+			return 1;
+		}
+	}
+	if(audio_out != NULL && sim_wav_open_write(&sim_audio_out, audio_out, 2,
+			MIXER_RUN_RATE) < 0) {
+		return 1;
+	}
+	if(cv_out != NULL && sim_wav_open_write(&sim_cv_out, cv_out, SIM_CV_CHANS,
+			SIM_CV_RATE) < 0) {
+		return 1;
+	}
+	if(csv != NULL) {
+		sim_csv = fopen(csv, "w");
+		if(sim_csv == NULL) {
+			perror(csv);
+			return 1;
+		}
+		fprintf(sim_csv, "time_us,output,chan,value\n");
+	}
+	sim_init();
+
+	harness_time_start();
+	start = harness_now_ns();
+	for(ms = 0; ms < end; ms ++) {
+		harness_set_time(ms);
+		while((cmd = harness_script_next(ms)) != NULL) {
+			sim_cmd(cmd);
+		}
+		if(sim_power_hold && ms == SIM_POWER_HOLD_MS) {
+			mixer_io_set_power_sw(0);
+			sim_power_hold = 0;
+		}
+		sim_midi_in(ms);
+
+		for(step = 0; step < SIM_STEPS_PER_MS; step ++) {
+			sim_us = ((int64_t)ms * 1000) + (step * SIM_STEP_US);
+			plib_core_set((unsigned int)((ms * SIM_STEPS_PER_MS) + step) * SIM_CORE_PER_STEP);
+			if((step % (MIXER_RUN_TICK_US / SIM_STEP_US)) == 0) {
+				mixer_run_tick();
+				mod_io_set_power_ctrl(mixer_io_get_power_ctrl());
+				if(sim_clock && sim_clock_off >= 0 && sim_us >= sim_clock_off) {
+					sim_out_set("clock_out", 0, 0);
+					sim_clock = 0;
+				}
+			}
+			sim_run_patches();
+			mod_run_step();
+			// Timer2 has run on the even steps
+			if((step & 0x01) == 0) {
+				sim_cv_frame();
+			}
+		}
+
+		sim_midi_tx();
+		sim_mod_dacs();
+		if(!mixer_io_get_power_ctrl()) {
+			sim_on_ms = -1;
+		}
+		else if(sim_on_ms < 0) {
+			sim_on_ms = ms;
+		}
+		if((ms % 1000) == 500 && sim_on_ms >= 0 && ms >= (sim_on_ms + SIM_LOAD_SETTLE_MS)) {
+			sim_load_sample();
+		}
+	}
+	speed = (end * 1000000.0) / (harness_now_ns() - start);
+
+	sim_wav_close(&sim_audio_in);
+	sim_wav_close(&sim_audio_out);
+	sim_wav_close(&sim_cv_out);
+	if(sim_csv != NULL) {
+		fclose(sim_csv);
+	}
+
+	harness_time_report(script, end);
+	sim_load_report();
+	fprintf(stderr, "phenol_sim: %ld MIDI bytes sent - audio peaks %d %d\n",
+		sim_midi_tx_bytes, sim_audio_peak[0], sim_audio_peak[1]);
+	if(sim_min_speed > 0.0) {
+		HARNESS_CHECK(speed >= sim_min_speed, "ran at %.0fx real time - needs %.0fx",
+			speed, sim_min_speed);
+	}
+	return harness_done("phenol_sim");
+}
+
+//
+// local functions
+//
+// print the usage and exit
+void sim_usage(const char *prog) {
+	fprintf(stderr, "usage: %s [-t secs] [-midi file.mid [-loop]] "
+		"[-audio-in file.wav] [-audio-out file.wav] [-cv-out file.wav] [-csv file.csv] "
+		"[-off] [-cpu-scale n] [-min-speed x] script.txt\n", prog);
+	exit(1);
+}
+
+// set up both firmwares and the virtual peripherals
+void sim_init(void) {
+	int i;
+	sim_num_outs = 0;
+	sim_on_ms = -1;
+	sim_num_patches = 0;
+	sim_cv[0] = 0;
+	sim_cv[1] = 0;
+	sim_gate = 0;
+	sim_clock = 0;
+	sim_clock_off = 0;
+	sim_div = 0;
+	sim_midi_tx_bytes = 0;
+	sim_audio_peak[0] = 0;
+	sim_audio_peak[1] = 0;
+	for(i = 0; i < SIM_NUM_LOADS; i ++) {
+		sim_loads[i].sum = 0;
+		sim_loads[i].peak = 0;
+		sim_loads[i].windows = 0;
+	}
+	plib_core_scale = sim_cpu_scale;
+	plib_core_set(0);
+	harness_set_trace_hook(sim_hook);
+
+	mixer_run_init();
+	mixer_run_power_ctrl();
+	mixer_run_set_audio(sim_audio);
+	mod_run_init();
+	mod_io_set_power_ctrl(mixer_io_get_power_ctrl());
+	if(sim_power_hold) {
+		mixer_io_set_power_sw(1);
+	}
+}
+
+// run a script command
+void sim_cmd(struct harness_cmd *cmd) {
+	struct sim_out *out;
+	int i;
+	if(strcmp(cmd->name, "midi") == 0) {
+		for(i = 0; i < cmd->argc; i ++) {
+			mixer_run_midi_send(harness_arg_hex(cmd, i));
+		}
+	}
+	else if(strcmp(cmd->name, "clock") == 0) {
+		if(cmd->argc && strcmp(cmd->argv[0], "off") == 0) {
+			mixer_run_clock(0);
+		}
+		else {
+			mixer_run_clock(2500000 / harness_arg(cmd, 0));  // 24 PPQ
+		}
+	}
+	else if(strcmp(cmd->name, "sw") == 0) {
+		mixer_io_set_sw(harness_arg(cmd, 0), harness_arg(cmd, 1));
+	}
+	else if(strcmp(cmd->name, "pot") == 0) {
+		mixer_io_set_pot(harness_arg(cmd, 0), harness_arg(cmd, 1));
+	}
+	else if(strcmp(cmd->name, "div") == 0) {
+		mixer_io_set_divider_in(harness_arg(cmd, 0));
+	}
+	else if(strcmp(cmd->name, "power") == 0) {
+		mixer_io_set_power_sw(harness_arg(cmd, 0));
+		sim_power_hold = 0;
+	}
+	else if(strcmp(cmd->name, "dc") == 0) {
+		mixer_io_set_dc_in(harness_arg(cmd, 0));
+	}
+	else if(strcmp(cmd->name, "mod_pot") == 0) {
+		mod_io_set_pot(harness_arg(cmd, 0), harness_arg(cmd, 1));
+	}
+	else if(strcmp(cmd->name, "mod_cv") == 0) {
+		mod_io_set_cv(harness_arg(cmd, 0), harness_arg(cmd, 1));
+	}
+	else if(strcmp(cmd->name, "mod_gate") == 0) {
+		mod_io_set_gate_in(harness_arg(cmd, 0), harness_arg(cmd, 1));
+	}
+	else if(strcmp(cmd->name, "mod_gatesw") == 0) {
+		mod_io_set_gate_sw(harness_arg(cmd, 0), harness_arg(cmd, 1));
+	}
+	else if(strcmp(cmd->name, "mod_sw") == 0) {
+		mod_io_set_sw(harness_arg(cmd, 0), harness_arg(cmd, 1));
+	}
+	else if(strcmp(cmd->name, "patch") == 0) {
+		sim_patch_cmd(cmd);
+	}
+	else if(strcmp(cmd->name, "expect") == 0 && cmd->argc == 3) {
+		out = sim_out_find(cmd->argv[0], harness_arg(cmd, 1));
+		HARNESS_CHECK(out != NULL && out->val == harness_arg(cmd, 2),
+			"%d: %s %d is %d - expected %d", cmd->time, cmd->argv[0], harness_arg(cmd, 1),
+			(out == NULL) ? 0 : out->val, harness_arg(cmd, 2));
+	}
+	else if(strcmp(cmd->name, "end") != 0) {
+		fprintf(stderr, "%d: unknown command: %s\n", cmd->time, cmd->name);
+		exit(1);
+	}
+}
+
+// add or remove a patch cable
+void sim_patch_cmd(struct harness_cmd *cmd) {
+	struct sim_patch patch;
+	const char *from, *to;
+	int i;
+	if(cmd->argc != 2) {
+		fprintf(stderr, "%d: patch needs a source and a destination\n", cmd->time);
+		exit(1);
+	}
+	from = cmd->argv[0];
+	to = cmd->argv[1];
+	if(strcmp(to, "mod_cv0") == 0 || strcmp(to, "mod_cv1") == 0) {
+		patch.dest = SIM_DEST_MOD_CV;
+		patch.dest_chan = to[6] - '0';
+	}
+	else if(strcmp(to, "mod_gate0") == 0 || strcmp(to, "mod_gate1") == 0) {
+		patch.dest = SIM_DEST_MOD_GATE;
+		patch.dest_chan = to[8] - '0';
+	}
+	else if(strcmp(to, "div") == 0) {
+		patch.dest = SIM_DEST_DIV;
+		patch.dest_chan = 0;
+	}
+	else {
+		fprintf(stderr, "%d: unknown patch destination: %s\n", cmd->time, to);
+		exit(1);
+	}
+
+	// take out any cable already in the destination
+	for(i = 0; i < sim_num_patches; i ++) {
+		if(sim_patches[i].dest == patch.dest && sim_patches[i].dest_chan == patch.dest_chan) {
+			sim_patches[i] = sim_patches[-- sim_num_patches];
+			break;
+		}
+	}
+	if(strcmp(from, "off") == 0) {
+		return;
+	}
+	if(strcmp(from, "cv0") == 0 || strcmp(from, "cv1") == 0) {
+		patch.src = SIM_SRC_CV;
+		patch.src_chan = from[2] - '0';
+	}
+	else if(strcmp(from, "gate") == 0) {
+		patch.src = SIM_SRC_GATE;
+		patch.src_chan = 0;
+	}
+	else if(strcmp(from, "clock") == 0) {
+		patch.src = SIM_SRC_CLOCK;
+		patch.src_chan = 0;
+	}
+	else if(strncmp(from, "div", 3) == 0 && from[3] >= '0' && from[3] <= '3' && !from[4]) {
+		patch.src = SIM_SRC_DIV;
+		patch.src_chan = from[3] - '0';
+	}
+	else if(strncmp(from, "mod_dac", 7) == 0 && from[7] >= '0' && from[7] <= '3' &&
+			!from[8]) {
+		patch.src = SIM_SRC_MOD_DAC;
+		patch.src_chan = from[7] - '0';
+	}
+	else {
+		fprintf(stderr, "%d: unknown patch source: %s\n", cmd->time, from);
+		exit(1);
+	}
+	sim_patches[sim_num_patches ++] = patch;
+}
+
+// take the outputs from the trace lines of both firmwares
+void sim_hook(const char *line) {
+	char name[16];
+	int a, b, num;
+	num = sscanf(line, "%15s %d %d", name, &a, &b);
+	if(num < 2) {
+		return;
+	}
+	// clock pulse - timeout in 250us units - 255 = held on
+	if(strcmp(name, "clock_out") == 0) {
+		sim_clock = (a != 0);
+		sim_clock_off = (a == 255) ? -1 : sim_us + (a * MIXER_RUN_TICK_US);
+		sim_out_set("clock_out", 0, sim_clock);
+		return;
+	}
+	// blink - each one is written
+	if(num == 2) {
+		sim_csv_row(name, 0, a);
+		sim_out_set(name, 0, a)->changes ++;
+		return;
+	}
+	sim_out_set(name, a, b);
+	if(strcmp(name, "cv_out") == 0) {
+		sim_cv[a & 0x01] = b;
+	}
+	else if(strcmp(name, "gate_out") == 0) {
+		sim_gate = b;
+	}
+	else if(strcmp(name, "div_out") == 0) {
+		sim_div = b;
+	}
+}
+
+// set an output - written to the CSV when it changes
+struct sim_out *sim_out_set(const char *name, int chan, int val) {
+	struct sim_out *out = sim_out_find(name, chan);
+	if(out == NULL) {
+		if(sim_num_outs == SIM_MAX_OUTS) {
+			fprintf(stderr, "phenol_sim: too many outputs\n");
+			exit(1);
+		}
+		out = &sim_outs[sim_num_outs ++];
+		strncpy(out->name, name, sizeof(out->name) - 1);
+		out->name[sizeof(out->name) - 1] = 0;
+		out->chan = chan;
+		out->val = val;
+		out->changes = 1;
+		sim_csv_row(name, chan, val);
+		return out;
+	}
+	if(out->val != val) {
+		out->val = val;
+		out->changes ++;
+		sim_csv_row(name, chan, val);
+	}
+	return out;
+}
+
+// find an output - NULL if it hasn't been written
+struct sim_out *sim_out_find(const char *name, int chan) {
+	int i;
+	for(i = 0; i < sim_num_outs; i ++) {
+		if(sim_outs[i].chan == chan && strcmp(sim_outs[i].name, name) == 0) {
+			return &sim_outs[i];
+		}
+	}
+	return NULL;
+}
+
+// write a CSV row
+void sim_csv_row(const char *name, int chan, int val) {
+	if(sim_csv != NULL) {
+		fprintf(sim_csv, "%lld,%s,%d,%d\n", (long long)sim_us, name, chan, val);
+	}
+}
+
+// move the patched outputs to their inputs
+void sim_run_patches(void) {
+	struct sim_patch *patch;
+	int i, val = 0;
+	for(i = 0; i < sim_num_patches; i ++) {
+		patch = &sim_patches[i];
+		switch(patch->src) {
+			case SIM_SRC_CV:
+				val = sim_cv[patch->src_chan];
+				break;
+			case SIM_SRC_GATE:
+				val = sim_gate ? SIM_DAC_MAX : 0;
+				break;
+			case SIM_SRC_CLOCK:
+				val = sim_clock ? SIM_DAC_MAX : 0;
+				break;
+			case SIM_SRC_DIV:
+				val = (sim_div & (0x08 >> patch->src_chan)) ? SIM_DAC_MAX : 0;
+				break;
+			case SIM_SRC_MOD_DAC:
+				val = mod_io_dacs[patch->src_chan];
+				break;
+		}
+		switch(patch->dest) {
+			case SIM_DEST_MOD_CV:
+				mod_io_set_cv(patch->dest_chan, val);
+				break;
+			case SIM_DEST_MOD_GATE:
+				mod_io_set_gate_in(patch->dest_chan, val > (SIM_DAC_MAX / 2));
+				break;
+			case SIM_DEST_DIV:
+				mixer_io_set_divider_in(val > (SIM_DAC_MAX / 2));
+				break;
+		}
+	}
+}
+
+// move one codec frame
+void sim_audio(int16_t *in, int16_t *out) {
+	int16_t frame[2];
+	int i;
+	if(sim_wav_read(&sim_audio_in, frame)) {
+		in[0] = frame[0];
+		in[1] = (sim_audio_in.chans == 2) ? frame[1] : frame[0];
+	}
+	else {
+		in[0] = 0;
+		in[1] = 0;
+	}
+	sim_wav_write(&sim_audio_out, out);
+	for(i = 0; i < 2; i ++) {
+		if(abs(out[i]) > sim_audio_peak[i]) {
+			sim_audio_peak[i] = abs(out[i]);
+		}
+	}
+}
+
+// write one frame of the DAC, gate and clock outputs
+void sim_cv_frame(void) {
+	int16_t frame[SIM_CV_CHANS];
+	if(sim_cv_out.f == NULL) {
+		return;
+	}
+	frame[0] = sim_dac_sample(mod_io_dacs[0]);
+	frame[1] = sim_dac_sample(mod_io_dacs[1]);
+	frame[2] = sim_dac_sample(mod_io_dacs[2]);
+	frame[3] = sim_dac_sample(mod_io_dacs[3]);
+	frame[4] = sim_dac_sample(sim_cv[0]);
+	frame[5] = sim_dac_sample(sim_cv[1]);
+	frame[6] = sim_dac_sample(sim_gate ? SIM_DAC_MAX : 0);
+	frame[7] = sim_dac_sample(sim_clock ? SIM_DAC_MAX : 0);
+	sim_wav_write(&sim_cv_out, frame);
+}
+
+// send the MIDI from the file that is due
+void sim_midi_in(int ms) {
+	struct sim_midi_event *ev;
+	int i;
+	if(!sim_midi_on) {
+		return;
+	}
+	while(mixer_run_midi_queued() < SIM_MIDI_QUEUE_MAX &&
+			(ev = sim_midi_next((int64_t)ms * 1000)) != NULL) {
+		for(i = 0; i < ev->len; i ++) {
+			mixer_run_midi_send(ev->data[i]);
+		}
+	}
+}
+
+// take the MIDI sent in the last ms - like the UART TX ISRs
+void sim_midi_tx(void) {
+	int port, len;
+	char line[256];
+	for(port = 0; port < MIDI_NUMPORTS; port ++) {
+		len = 0;
+		while(midi_tx_avail(port)) {
+			if(len < (int)sizeof(line) - 4) {
+				len += sprintf(line + len, " %02x", midi_tx_get_byte(port));
+			}
+			else {
+				midi_tx_get_byte(port);
+			}
+			sim_midi_tx_bytes ++;
+		}
+		if(len && sim_csv != NULL) {
+			fprintf(sim_csv, "%lld,midi_tx,%d,%s\n", (long long)sim_us, port, line + 1);
+		}
+	}
+}
+
+// record the mod processor DACs - once per ms keeps the CSV small
+void sim_mod_dacs(void) {
+	int i;
+	for(i = 0; i < MOD_IO_NUM_DACS; i ++) {
+		sim_out_set("mod_dac", i, mod_io_dacs[i]);
+	}
+}
+
+// add the last load meter window to the totals
+void sim_load_sample(void) {
+	struct sim_load *load;
+	int i, val, max;
+	for(i = 0; i < SIM_NUM_LOADS; i ++) {
+		load = &sim_loads[i];
+		if(load->mod) {
+			val = mod_run_get_load(load->isr);
+			max = mod_run_get_max(load->isr);
+		}
+		else {
+			val = mixer_run_get_load(load->isr);
+			max = mixer_run_get_max(load->isr);
+		}
+		load->sum += val;
+		if(val > load->peak) {
+			load->peak = val;
+		}
+		if(load->windows == load->max_windows) {
+			load->max_windows = (load->max_windows * 2) + 64;
+			load->max_runs = realloc(load->max_runs, sizeof(int) * load->max_windows);
+		}
+		load->max_runs[load->windows ++] = max;
+	}
+}
+
+// print the ISR loads and output counts
+// - the longest run is the median of the windows - the host gets interrupted
+// now and then, which makes one run in a window look far too long
+void sim_load_report(void) {
+	struct sim_load *load;
+	int i;
+	if(sim_cpu_scale <= 0.0) {
+		fprintf(stderr, "phenol_sim: ISR loads are off - -cpu-scale is 0\n");
+	}
+	else if(sim_loads[0].windows == 0) {
+		fprintf(stderr, "phenol_sim: ISR loads need a longer run with the power on\n");
+	}
+	else {
+		fprintf(stderr, "phenol_sim: ISR load at a CPU scale of %.0f - average / peak "
+			"over %d 1s windows with the power on - typical longest run\n", sim_cpu_scale,
+			sim_loads[0].windows);
+		for(i = 0; i < SIM_NUM_LOADS; i ++) {
+			load = &sim_loads[i];
+			qsort(load->max_runs, load->windows, sizeof(int), sim_int_cmp);
+			fprintf(stderr, "phenol_sim:   %-14s %5.1f%% / %5.1f%% - %dus\n", load->name,
+				load->sum / (10.0 * load->windows), load->peak / 10.0,
+				load->max_runs[load->windows / 2]);
+		}
+	}
+	for(i = 0; i < sim_num_outs; i ++) {
+		fprintf(stderr, "phenol_sim:   %s %d: %d changes - now %d\n", sim_outs[i].name,
+			sim_outs[i].chan, sim_outs[i].changes, sim_outs[i].val);
+	}
+}
+
+// scale a DAC value to a WAV sample
+int16_t sim_dac_sample(int val) {
+	return (int16_t)((val - 2048) * 16);
+}
+
+// sort ints from low to high
+int sim_int_cmp(const void *a, const void *b) {
+	return *(const int *)a - *(const int *)b;
+}
@@ -0,0 +1,253 @@
+/*
+ * K65 Phenol - Pitch Bend Resolution Test
+ *
+ * Copyright 2015: Andrew Kilpatrick
+ * Written by: Andrew Kilpatrick
+ *
+ * Runs the whole mixer firmware on an external MIDI clock and plays bend
+ * wheel gestures on a held note, sent every ms as a 14 bit wheel and as a
+ * 7 bit wheel that only sends the MSB:
+ *	- a slow sweep from the center to the top and back over 4 seconds
+ *	- a real gesture - a quick bend up, vibrato and a spring back
+ * Live, the sweep on the 14 bit wheel must move the CV output by 1 DAC
+ * step at a time and hit every step on the way, with 2 and 12 semitone
+ * bend ranges. Each gesture is also recorded in its own pattern and
+ * looped - the 14 bit sweep must still play back in 1 DAC steps, and the
+ * pattern must not be bigger than the old stream, which kept every bend
+ * message as bend >> 8 in 2 bytes. The largest step and the bytes used
+ * are printed.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <math.h>
+#include "harness.h"
+#include "mixer_run.h"
+#include "mixer_io.h"
+
+#define TEST_CLOCK_US 20833  // 120 BPM
+#define TEST_SWEEP_MS 4000
+#define TEST_REAL_MS 3000
+#define TEST_OLD_BEND_LEN 2  // old bytes per bend message - a time byte and bend >> 8
+#define TEST_NOTE 60
+#define TEST_NOTE_LEN 4  // bytes for the note on and off and the bend type
+
+// gestures
+#define TEST_SWEEP 0
+#define TEST_REAL 1
+
+// sequencer state in seq.c
+extern int seq_play_size;
+extern int seq_num_events;
+
+int test_cv;  // CV1 output
+int test_cv_changes;  // CV1 changes since the last test_steps_start()
+int test_max_step;  // largest CV1 change
+uint8_t test_hit[4096];  // CV1 values seen
+
+// local functions
+void test_hook(const char *line);
+void test_run_ms(int ms);
+void test_midi(int len, ...);
+void test_sw(int sw, int state, int ms);
+int test_bend(int gesture, int ms);
+int test_play(int gesture, int fine);
+void test_steps_start(void);
+void test_live(int range);
+void test_record(int gesture, int fine, int pattern);
+
+int main(int argc, char *argv[]) {
+	harness_set_trace_hook(test_hook);
+	mixer_run_init();
+	test_run_ms(5000);  // startup settings time
+	mixer_run_clock(TEST_CLOCK_US);
+	test_midi(1, 0xfa);
+	test_run_ms(1000);
+
+	test_live(2);
+	test_live(12);
+	test_midi(2, 0xc0, 1);  // 2 semitones
+	test_run_ms(10);
+	test_record(TEST_SWEEP, 1, 0);
+	test_record(TEST_SWEEP, 0, 1);
+	test_record(TEST_REAL, 1, 2);
+	test_record(TEST_REAL, 0, 3);
+	test_midi(2, 0xc0, 0x18);
+	return harness_done("seq_bend_test");
+}
+
+//
+// local functions
+//
+// take the CV output from the trace
+void test_hook(const char *line) {
+	int chan, val;
+	if(sscanf(line, "cv_out %d %d", &chan, &val) == 2 && chan == 0) {
+		if(test_cv_changes && abs(val - test_cv) > test_max_step) {
+			test_max_step = abs(val - test_cv);
+		}
+		test_cv = val;
+		test_hit[val & 0xfff] = 1;
+		test_cv_changes ++;
+	}
+}
+
+// run the firmware for a while
+void test_run_ms(int ms) {
+	int i;
+	for(i = 0; i < ms * 4; i ++) {
+		mixer_run_tick();
+	}
+}
+
+// send MIDI bytes
+void test_midi(int len, ...) {
+	va_list ap;
+	int i;
+	va_start(ap, len);
+	for(i = 0; i < len; i ++) {
+		mixer_run_midi_send(va_arg(ap, int));
+	}
+	va_end(ap);
+}
+
+// press or release a switch and run for a while
+void test_sw(int sw, int state, int ms) {
+	mixer_io_set_sw(sw, state);
+	test_run_ms(ms + 50);
+}
+
+// get the bend of a gesture at a time
+int test_bend(int gesture, int ms) {
+	double pos;
+	if(gesture == TEST_SWEEP) {
+		pos = (double)ms / (TEST_SWEEP_MS / 2);
+		if(pos > 1.0) {
+			pos = 2.0 - pos;
+		}
+		return 0x2000 + (int)(pos * 0x1fff);
+	}
+	// bend up a whole tone in 150ms
+	if(ms < 150) {
+		pos = sin((M_PI / 2) * ms / 150);
+		return 0x2000 + (int)(pos * 0x1800);
+	}
+	// vibrato at 5.5Hz getting deeper
+	if(ms < 2400) {
+		pos = sin(2 * M_PI * 5.5 * (ms - 150) / 1000) * (ms - 150) / 2250;
+		return 0x3800 + (int)(pos * 0x600);
+	}
+	// let go - the wheel springs back
+	pos = exp(-(ms - 2400) / 60.0);
+	return 0x2000 + (int)(pos * 0x1800);
+}
+
+// play a gesture on a held note - fine = 1 for a 14 bit wheel
+// - the CV steps are looked at from after the note on
+// returns the number of bend messages sent
+int test_play(int gesture, int fine) {
+	int ms, len, bend, last = 0x2000, sent = 0;
+	len = (gesture == TEST_SWEEP) ? TEST_SWEEP_MS : TEST_REAL_MS;
+	test_midi(3, 0x90, TEST_NOTE, 100);
+	test_run_ms(1);
+	test_steps_start();
+	for(ms = 0; ms <= len; ms ++) {
+		bend = test_bend(gesture, ms);
+		if(!fine) {
+			bend &= 0x3f80;
+		}
+		if(bend != last) {
+			test_midi(3, 0xe0, bend & 0x7f, bend >> 7);
+			last = bend;
+			sent ++;
+		}
+		test_run_ms(1);
+	}
+	test_midi(3, 0xe0, 0x00, 0x40);
+	test_run_ms(5);
+	test_midi(3, 0x80, TEST_NOTE, 0);
+	test_run_ms(5);
+	return sent + 1;
+}
+
+// start looking at the CV steps
+void test_steps_start(void) {
+	int i;
+	for(i = 0; i < 4096; i ++) {
+		test_hit[i] = 0;
+	}
+	test_hit[test_cv] = 1;
+	test_max_step = 0;
+	test_cv_changes = 0;
+}
+
+// sweep the wheel live and check the CV steps
+void test_live(int range) {
+	int i, low, high, missed;
+	test_midi(2, 0xc0, range - 1);
+	test_run_ms(10);
+	test_play(TEST_SWEEP, 1);
+	low = 4095;
+	high = 0;
+	for(i = 0; i < 4096; i ++) {
+		if(test_hit[i] && i < low) low = i;
+		if(test_hit[i] && i > high) high = i;
+	}
+	missed = 0;
+	for(i = low; i <= high; i ++) {
+		if(!test_hit[i]) {
+			missed ++;
+		}
+	}
+	HARNESS_CHECK(test_max_step == 1 && missed == 0 && high - low >= range * 31 - 1,
+		"live %d semitones: steps of up to %d - %d of %d values missed", range,
+		test_max_step, missed, high - low + 1);
+	fprintf(stderr, "seq_bend_test: live 14 bit sweep over %d semitones: %d values - "
+		"largest step %d\n", range, high - low + 1, test_max_step);
+
+	// the 7 bit wheel - only printed
+	test_play(TEST_SWEEP, 0);
+	fprintf(stderr, "seq_bend_test: live 7 bit sweep over %d semitones: largest step %d\n",
+		range, test_max_step);
+}
+
+// record a gesture and loop it
+void test_record(int gesture, int fine, int pattern) {
+	static const char *names[] = {"sweep", "gesture"};
+	int bends, sent, old;
+
+	test_midi(2, 0xc0, 0x18 + pattern);
+	test_run_ms(100);
+	test_sw(0, 1, 100);
+	test_sw(1, 1, 0);
+	test_sw(1, 0, 0);
+	test_sw(0, 0, 200);
+	sent = test_play(gesture, fine);
+	// hold play - loop it
+	test_sw(1, 1, 550);
+	test_sw(1, 0, 0);
+
+	// bytes used - every event but the note on and off is a bend
+	bends = seq_num_events - 2;
+	old = TEST_NOTE_LEN + (((sent > bends) ? sent : bends) * TEST_OLD_BEND_LEN);
+	fprintf(stderr, "seq_bend_test: %2d bit %-7s %4d bends sent - %3d recorded in "
+		"%4d bytes - old stream %4d bytes", fine ? 14 : 7, names[gesture], sent, bends,
+		seq_play_size, old);
+	HARNESS_CHECK(bends > 10 && seq_play_size <= old, "%d bit %s: %d bends in %d bytes - "
+		"old stream %d bytes", fine ? 14 : 7, names[gesture], bends, seq_play_size, old);
+
+	// play it back
+	test_run_ms(gesture == TEST_SWEEP ? TEST_SWEEP_MS : TEST_REAL_MS);
+	test_steps_start();
+	test_run_ms((gesture == TEST_SWEEP ? TEST_SWEEP_MS : TEST_REAL_MS) + 500);
+	fprintf(stderr, " - largest step played back: %d\n", test_max_step);
+	if(gesture == TEST_SWEEP && fine) {
+		HARNESS_CHECK(test_max_step == 1, "14 bit sweep played back in steps of %d",
+			test_max_step);
+	}
+
+	// stop at the end of the loop
+	test_sw(1, 1, 0);
+	test_sw(1, 0, 5000);
+}
@@ -0,0 +1,432 @@
+/*
+ * K65 Phenol - Overdub Test
+ *
+ * Copyright 2015: Andrew Kilpatrick
+ * Written by: Andrew Kilpatrick
+ *
+ * Runs the whole mixer firmware on an external MIDI clock. A short loop
+ * is recorded, a second pattern is put after it in the buffer, and then
+ * the loop is overdubbed for 150 passes, with a few random notes played
+ * on each pass. When it is done the pattern is read back:
+ *	- every overdub note the sequencer took is on its own track at the
+ *	  clock tick it was played on, with its note off where it was let go
+ *	- there are no other overdub notes, and every note on has a note off
+ *	- the recorded loop is still there as it was
+ *	- the second pattern, which is moved up and back down for every
+ *	  merge, is still there as it was right after the loop
+ *
+ * The host time of every 250us tick is kept while the loop plays and
+ * while it is overdubbed. The merge is spread over the ticks just ahead
+ * of playback and the room for it is opened a chunk at a time, so the
+ * longest tick that starts the loop again must stay inside a fixed
+ * budget. The percentiles, the longest clock tick and the longest tick
+ * of all are only printed - the percentiles never see the few ticks that
+ * start the loop, and the longest tick of all is mostly the host.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include "harness.h"
+#include "mixer_run.h"
+#include "mixer_io.h"
+#include "seq_pack.h"
+
+#define TEST_CLOCK_US 20000  // 125 BPM
+#define TEST_PASSES 150
+#define TEST_MAX_NOTES 1024
+#define TEST_MAX_TICKS 2000000
+#define TEST_NOTE_CLOCKS 2  // overdub notes are held for this many clocks
+#define TEST_DUB_TRACK 2  // overdubs on voice 1 go on this track
+#define TEST_TICK_BUDGET_NS 50000  // for the longest tick that starts the loop again - about 5us here
+#define TEST_MAX_CLOCKS 512  // longest loop
+#define TEST_BASE_NOTES 4  // note ons and offs in the recorded loop - it also has an end event
+#define TEST_OTHER 1  // the second pattern
+#define TEST_OTHER_NOTES 150  // notes in the second pattern
+#define TEST_BUF_SIZE 4096  // SEQ_BUF_SIZE in seq.c
+
+// a pattern in seq.c
+struct test_pattern {
+	uint16_t start;
+	uint16_t len;
+	uint16_t num_events;
+	uint8_t index_start;
+	uint8_t index_len;
+	int length;
+};
+
+// host tick times
+struct test_times {
+	double ns[TEST_MAX_TICKS];
+	int num;
+	double clock_max;  // longest tick with a clock tick
+	double loop_max;  // longest tick that started the loop again
+};
+
+// an overdub note that was taken
+struct test_note {
+	int note;
+	int on;  // time from the start of the loop in clock ticks
+	int off;
+	int found;
+};
+
+// sequencer state in seq.c
+extern int seq_run_timer;
+extern int seq_loop_base;
+extern int seq_length;
+extern int seq_num_events;
+extern int seq_dub_head;
+extern uint8_t *seq_play_buf;
+extern int seq_play_size;
+extern int seq_buf_used;
+extern uint8_t seq_event_buf[];
+extern struct test_pattern seq_patterns[];
+void seq_index_build(int pattern);
+
+struct test_note test_notes[TEST_MAX_NOTES];
+int test_num_notes;
+int test_tried;
+uint8_t test_used[128][TEST_MAX_CLOCKS];  // clocks each note is held on
+struct test_times test_playing;
+struct test_times test_dubbing;
+uint8_t test_other[TEST_BUF_SIZE];  // copy of the second pattern
+int test_other_len;
+uint32_t test_rand_state = 1;
+
+// local functions
+uint32_t test_rand(void);
+void test_hook(const char *line);
+void test_run_ms(int ms);
+double test_tick(struct test_times *t);
+void test_midi(int len, ...);
+void test_sw(int sw, int state, int ms);
+int test_pos(void);
+void test_wait_pos(int pos, struct test_times *t);
+void test_wait_loop(struct test_times *t);
+void test_pass(int loop_len);
+void test_other_make(void);
+void test_check(void);
+void test_check_other(void);
+int test_cmp(const void *a, const void *b);
+void test_report(const char *what, struct test_times *t);
+
+int main(int argc, char *argv[]) {
+	int pass, loop_len, base_events;
+
+	harness_set_trace_hook(test_hook);
+	mixer_run_init();
+	test_run_ms(5000);  // startup settings time
+	mixer_run_clock(TEST_CLOCK_US);
+	test_midi(1, 0xfa);
+	test_run_ms(1000);
+
+	// record a loop of two notes
+	test_sw(0, 1, 100);
+	test_sw(1, 1, 0);
+	test_sw(1, 0, 0);
+	test_sw(0, 0, 200);
+	test_midi(3, 0x90, 0x3c, 0x64);
+	test_run_ms(200);
+	test_midi(3, 0x80, 0x3c, 0x00);
+	test_run_ms(800);
+	test_midi(3, 0x90, 0x43, 0x64);
+	test_run_ms(200);
+	test_midi(3, 0x80, 0x43, 0x00);
+	test_run_ms(800);
+	test_sw(1, 1, 550);
+	test_sw(1, 0, 0);
+	loop_len = seq_length;
+	base_events = seq_num_events;
+	HARNESS_CHECK(loop_len > 20 && loop_len < TEST_MAX_CLOCKS &&
+		base_events == TEST_BASE_NOTES + 1,
+		"loop of %d clocks with %d events",
+		loop_len, base_events);
+	test_other_make();
+
+	// plain playback
+	for(pass = 0; pass < 10; pass ++) {
+		test_wait_loop(&test_playing);
+	}
+
+	// overdub
+	test_sw(0, 1, 0);
+	test_sw(0, 0, 0);
+	for(pass = 0; pass < TEST_PASSES; pass ++) {
+		test_wait_loop(&test_dubbing);
+		test_pass(loop_len);
+	}
+	test_sw(0, 1, 0);
+	test_sw(0, 0, 0);
+	test_wait_loop(&test_dubbing);
+	test_wait_loop(&test_dubbing);
+
+	test_check();
+	fprintf(stderr, "seq_dub_test: %d passes - %d of %d overdub notes taken - "
+		"pattern is %d bytes\n", TEST_PASSES, test_num_notes, test_tried, seq_play_size);
+	test_report("playing", &test_playing);
+	test_report("overdubbing", &test_dubbing);
+
+	// stop at the end of the loop
+	test_sw(1, 1, 0);
+	test_sw(1, 0, 5000);
+	test_check_other();
+	return harness_done("seq_dub_test");
+}
+
+//
+// local functions
+//
+// repeatable random numbers
+uint32_t test_rand(void) {
+	test_rand_state ^= test_rand_state << 13;
+	test_rand_state ^= test_rand_state >> 17;
+	test_rand_state ^= test_rand_state << 5;
+	return test_rand_state;
+}
+
+// the outputs are not looked at - keep the trace off stdout
+void test_hook(const char *line) {
+}
+
+// run the firmware for a while
+void test_run_ms(int ms) {
+	int i;
+	for(i = 0; i < ms * 4; i ++) {
+		mixer_run_tick();
+	}
+}
+
+// run one tick and keep its host time - returns the time
+double test_tick(struct test_times *t) {
+	int timer = seq_run_timer;
+	double start = harness_now_ns();
+	double ns;
+	mixer_run_tick();
+	ns = harness_now_ns() - start;
+	if(t->num < TEST_MAX_TICKS) {
+		t->ns[t->num ++] = ns;
+	}
+	if(seq_run_timer != timer && ns > t->clock_max) {
+		t->clock_max = ns;
+	}
+	return ns;
+}
+
+// send MIDI bytes
+void test_midi(int len, ...) {
+	va_list ap;
+	int i;
+	va_start(ap, len);
+	for(i = 0; i < len; i ++) {
+		mixer_run_midi_send(va_arg(ap, int));
+	}
+	va_end(ap);
+}
+
+// press or release a switch and run for a while
+void test_sw(int sw, int state, int ms) {
+	mixer_io_set_sw(sw, state);
+	test_run_ms(ms + 50);
+}
+
+// get the time from the start of the loop in clock ticks
+int test_pos(void) {
+	return seq_run_timer - seq_loop_base;
+}
+
+// run until the loop gets to a time - just after the clock tick
+void test_wait_pos(int pos, struct test_times *t) {
+	int i;
+	for(i = 0; i < 100000; i ++) {
+		if(test_pos() == pos) {
+			return;
+		}
+		test_tick(t);
+	}
+	HARNESS_CHECK(0, "the loop did not get to %d", pos);
+}
+
+// run until the loop starts again
+void test_wait_loop(struct test_times *t) {
+	int i, last = test_pos();
+	double ns;
+	for(i = 0; i < 1000000; i ++) {
+		ns = test_tick(t);
+		if(test_pos() < last) {
+			if(ns > t->loop_max) {
+				t->loop_max = ns;
+			}
+			return;
+		}
+		last = test_pos();
+	}
+	HARNESS_CHECK(0, "the loop did not start again");
+}
+
+// overdub a few notes on a pass - they don't overlap the loop start or end
+// - a note is never played over itself from an earlier pass
+void test_pass(int loop_len) {
+	int i, j, num, pos, head, first, note, t;
+	struct test_note *n;
+
+	num = 1 + (test_rand() % 6);
+	pos = 2;
+	for(i = 0; i < num; i ++) {
+		pos += 1 + (test_rand() % 12);
+		if(pos + TEST_NOTE_CLOCKS >= loop_len - 2) {
+			break;
+		}
+		// the first note from a random one that is free here
+		first = test_rand() % 48;
+		for(j = 0; j < 48; j ++) {
+			note = 36 + ((first + j) % 48);
+			for(t = pos; t <= pos + TEST_NOTE_CLOCKS && !test_used[note][t]; t ++);
+			if(t > pos + TEST_NOTE_CLOCKS) {
+				break;
+			}
+		}
+		if(j == 48) {
+			continue;
+		}
+		for(t = pos; t <= pos + TEST_NOTE_CLOCKS; t ++) {
+			test_used[note][t] = 1;
+		}
+		n = &test_notes[test_num_notes];
+		n->note = note;
+		n->on = pos;
+		n->off = pos + TEST_NOTE_CLOCKS;
+		n->found = 0;
+		test_wait_pos(n->on, &test_dubbing);
+		head = seq_dub_head;
+		test_midi(3, 0x90, n->note, 0x64);
+		test_wait_pos(n->off, &test_dubbing);
+		test_midi(3, 0x80, n->note, 0x00);
+		test_tried ++;
+		// the side buffer or pattern memory may be full
+		if(seq_dub_head != head && test_num_notes < TEST_MAX_NOTES - 1) {
+			test_num_notes ++;
+		}
+		pos = n->off;
+	}
+}
+
+// put a second pattern after the loop in the buffer and keep a copy
+// - it is never played
+void test_other_make(void) {
+	struct test_pattern *pat = &seq_patterns[TEST_OTHER];
+	struct seq_pack_state s;
+	int i, note, track, ok = 1;
+
+	seq_pack_init(&s, seq_event_buf + seq_buf_used, TEST_BUF_SIZE - seq_buf_used);
+	for(i = 0; i < TEST_OTHER_NOTES; i ++) {
+		note = 36 + (test_rand() % 48);
+		track = test_rand() % 2;
+		ok &= seq_pack_write(&s, 1 + (test_rand() % 4), track, SEQ_EVENT_NOTE_ON, note);
+		ok &= seq_pack_write(&s, 1, track, SEQ_EVENT_NOTE_OFF, note);
+	}
+	ok &= seq_pack_write(&s, 1, 0, SEQ_EVENT_END, 0);
+	HARNESS_CHECK(ok, "the second pattern does not fit");
+	pat->start = seq_buf_used;
+	pat->len = s.pos;
+	pat->num_events = (TEST_OTHER_NOTES * 2) + 1;
+	seq_buf_used += s.pos;
+	seq_index_build(TEST_OTHER);
+	test_other_len = s.pos;
+	memcpy(test_other, seq_event_buf + pat->start, s.pos);
+}
+
+// read the pattern back and check the overdub notes
+void test_check(void) {
+	struct seq_pack_state s;
+	struct seq_event ev;
+	int time = 0, i, events = 0, dub_ons = 0, base = 0;
+	int held[128];
+
+	for(i = 0; i < 128; i ++) {
+		held[i] = -1;
+	}
+	seq_pack_init(&s, seq_play_buf, seq_play_size);
+	while(events < seq_num_events && seq_pack_read(&s, &ev) == SEQ_PACK_READ_OK) {
+		time += ev.time;
+		events ++;
+		if(ev.track != TEST_DUB_TRACK) {
+			if(ev.type == SEQ_EVENT_NOTE_ON || ev.type == SEQ_EVENT_NOTE_OFF) {
+				base ++;
+			}
+			continue;
+		}
+		if(ev.type == SEQ_EVENT_NOTE_ON) {
+			HARNESS_CHECK(held[ev.value] < 0, "note %d at %d played again before its note off",
+				ev.value, time);
+			held[ev.value] = time;
+			dub_ons ++;
+		}
+		else if(ev.type == SEQ_EVENT_NOTE_OFF) {
+			HARNESS_CHECK(held[ev.value] >= 0, "note off %d at %d was not on", ev.value, time);
+			// match it with a note that was played
+			for(i = 0; i < test_num_notes; i ++) {
+				if(!test_notes[i].found && test_notes[i].note == ev.value &&
+						test_notes[i].on == held[ev.value] && test_notes[i].off == time) {
+					test_notes[i].found = 1;
+					break;
+				}
+			}
+			HARNESS_CHECK(i < test_num_notes, "note %d from %d to %d was not played",
+				ev.value, held[ev.value], time);
+			held[ev.value] = -1;
+		}
+	}
+	HARNESS_CHECK(events == seq_num_events, "read %d of %d events", events, seq_num_events);
+	HARNESS_CHECK(base == TEST_BASE_NOTES, "the loop has %d notes ons and offs - was %d",
+		base, TEST_BASE_NOTES);
+	for(i = 0; i < 128; i ++) {
+		HARNESS_CHECK(held[i] < 0, "note %d at %d has no note off", i, held[i]);
+	}
+	for(i = 0; i < test_num_notes; i ++) {
+		if(!test_notes[i].found) {
+			HARNESS_CHECK(0, "note %d from %d to %d is not in the pattern",
+				test_notes[i].note, test_notes[i].on, test_notes[i].off);
+			break;
+		}
+	}
+	HARNESS_CHECK(dub_ons == test_num_notes, "%d overdub notes in the pattern - %d taken",
+		dub_ons, test_num_notes);
+}
+
+// check that the second pattern is right after the loop as it was
+void test_check_other(void) {
+	struct test_pattern *pat = &seq_patterns[TEST_OTHER];
+	struct test_pattern *loop = &seq_patterns[0];
+	HARNESS_CHECK(pat->start == loop->start + loop->len && pat->len == test_other_len &&
+		seq_buf_used == pat->start + pat->len &&
+		memcmp(seq_event_buf + pat->start, test_other, test_other_len) == 0,
+		"the second pattern is %d bytes at %d - was %d bytes - the loop ends at %d - "
+		"%d bytes are used", pat->len, pat->start, test_other_len,
+		loop->start + loop->len, seq_buf_used);
+}
+
+// sort doubles
+int test_cmp(const void *a, const void *b) {
+	double da = *(const double *)a;
+	double db = *(const double *)b;
+	return (da > db) - (da < db);
+}
+
+// print the tick times and check the longest tick that started the loop
+void test_report(const char *what, struct test_times *t) {
+	double *ns = t->ns;
+	int num = t->num;
+	if(num == 0) {
+		return;
+	}
+	qsort(ns, num, sizeof(double), test_cmp);
+	fprintf(stderr, "seq_dub_test: host tick time %s: median %.0fns - p99 %.0fns - "
+		"p99.9 %.0fns - longest loop start %.0fns - longest clock tick %.0fns - "
+		"longest %.0fns\n", what, ns[num / 2], ns[(num * 99) / 100],
+		ns[(num * 999) / 1000], t->loop_max, t->clock_max, ns[num - 1]);
+	HARNESS_CHECK(t->loop_max <= TEST_TICK_BUDGET_NS,
+		"%s: the longest tick that started the loop took %.0fns - most is %dns",
+		what, t->loop_max, TEST_TICK_BUDGET_NS);
+}
@@ -0,0 +1,375 @@
+/*
+ * K65 Phenol - Packed Event Stream Test
+ *
+ * Copyright 2015: Andrew Kilpatrick
+ * Written by: Andrew Kilpatrick
+ *
+ * Packs made up performances and reads them back:
+ *	- every event must come back with the same time, type, track and
+ *	  value - times and values limited like the writer limits them
+ *	- the stream must take at most half the bytes of the old 4 byte
+ *	  events for notes played on one track - the others have their own
+ *	  floor and print why they get less:
+ *		- wheel - a bend is a token and a value byte at the least, so
+ *		  2x is the most bends can get, and the fine steps of 37 here
+ *		  take 2 value bytes
+ *		- tracks - a note on that switches tracks takes 3 bytes
+ *		- random - not checked - long gaps take up to 3 more bytes
+ *		  and odd events need their type byte, where the old events
+ *		  held any of these in 4 bytes
+ *	- a stream cut short at every byte must stop cleanly
+ *	- reading on from a saved mark must give the same events again
+ *
+ * The decode cost is printed per event and per clock tick.
+ *
+ */
+#include <stdio.h>
+#include <string.h>
+#include "harness.h"
+#include "seq_pack.h"
+
+#define TEST_MAX_EVENTS 20000
+#define TEST_BUF_SIZE (TEST_MAX_EVENTS * SEQ_PACK_MAX_EVENT_LEN)
+#define TEST_OLD_EVENT_LEN 4  // bytes per event before the packed stream
+#define TEST_NO_FLOOR 0.0  // capacity is only printed
+
+// kinds of performance
+#define TEST_PERF_CHORDS 0  // block chords - all off together
+#define TEST_PERF_LEGATO 1  // overlapping single notes
+#define TEST_PERF_WHEEL 2  // notes with the bend wheel moving
+#define TEST_PERF_TRACKS 3  // all four tracks at once
+#define TEST_PERF_RANDOM 4  // anything at all - long gaps and odd events
+#define TEST_NUM_PERFS 5
+
+struct test_event {
+	int time;
+	int track;
+	int type;
+	int value;
+};
+
+struct test_event test_events[TEST_MAX_EVENTS];
+int test_num_events;
+int test_ticks;  // length of the performance in clock ticks
+uint8_t test_buf[TEST_BUF_SIZE];
+uint32_t test_rand_state = 1;
+
+// local functions
+uint32_t test_rand(void);
+void test_add(int time, int track, int type, int value);
+void test_make(int perf);
+int test_pack(void);
+void test_read_back(const char *what, int len);
+void test_cut_short(const char *what, int len);
+void test_marks(const char *what, int len);
+void test_bench(const char *what, int len);
+
+int main(int argc, char *argv[]) {
+	static const char *names[] = {"chords", "legato", "wheel", "tracks", "random"};
+	// least capacity over the old events for each performance
+	static const double floors[] = {2.0, 2.0, 1.6, 1.8, TEST_NO_FLOOR};
+	static const char *why[] = {
+		NULL,
+		NULL,
+		"every bend needs a token and a value byte - fine steps need 2 value bytes",
+		"a note on that switches tracks takes 3 bytes",
+		"long gaps and odd events take more bytes - held in 4 bytes before"
+	};
+	double ratio;
+	int perf, len;
+
+	for(perf = 0; perf < TEST_NUM_PERFS; perf ++) {
+		test_make(perf);
+		len = test_pack();
+		HARNESS_CHECK(len > 0, "%s: did not fit", names[perf]);
+		if(len <= 0) {
+			continue;
+		}
+		ratio = (double)(test_num_events * TEST_OLD_EVENT_LEN) / len;
+		fprintf(stderr, "seq_pack_test: %-6s %5d events in %5d bytes - "
+			"%.2f bytes per event - %.2fx the old capacity\n", names[perf],
+			test_num_events, len, (double)len / test_num_events, ratio);
+		if(why[perf] != NULL) {
+			fprintf(stderr, "seq_pack_test: %-6s under 2x: %s\n", names[perf], why[perf]);
+		}
+		HARNESS_CHECK(ratio >= floors[perf], "%s: %.2fx the old capacity - wanted %.1fx",
+			names[perf], ratio, floors[perf]);
+		test_read_back(names[perf], len);
+		test_marks(names[perf], len);
+		test_bench(names[perf], len);
+	}
+	// cutting is slow on long streams
+	test_rand_state = 7;
+	test_make(TEST_PERF_RANDOM);
+	test_num_events = 400;
+	len = test_pack();
+	test_cut_short("random", len);
+	test_make(TEST_PERF_WHEEL);
+	test_num_events = 400;
+	len = test_pack();
+	test_cut_short("wheel", len);
+	return harness_done("seq_pack_test");
+}
+
+//
+// local functions
+//
+// repeatable random numbers
+uint32_t test_rand(void) {
+	test_rand_state ^= test_rand_state << 13;
+	test_rand_state ^= test_rand_state >> 17;
+	test_rand_state ^= test_rand_state << 5;
+	return test_rand_state;
+}
+
+// add an event to the performance
+void test_add(int time, int track, int type, int value) {
+	if(test_num_events >= TEST_MAX_EVENTS) {
+		return;
+	}
+	test_events[test_num_events].time = time;
+	test_events[test_num_events].track = track;
+	test_events[test_num_events].type = type;
+	test_events[test_num_events].value = value;
+	test_num_events ++;
+	test_ticks += time;
+}
+
+// make up a performance - delta times are in clock ticks (24 per beat)
+void test_make(int perf) {
+	int notes[SEQ_PACK_NUM_TRACKS];
+	int held[4];
+	int i, j, num, bend, step, track, prev;
+
+	test_num_events = 0;
+	test_ticks = 0;
+	switch(perf) {
+		case TEST_PERF_CHORDS:
+			while(test_num_events < TEST_MAX_EVENTS - 8) {
+				num = 3 + (test_rand() % 2);
+				for(i = 0; i < num; i ++) {
+					held[i] = 48 + (test_rand() % 24);
+					test_add(i ? 0 : 6 + (test_rand() % 18), 0, SEQ_EVENT_NOTE_ON, held[i]);
+				}
+				for(i = num - 1; i >= 0; i --) {
+					test_add(i == num - 1 ? 12 + (test_rand() % 36) : 0, 0,
+						SEQ_EVENT_NOTE_OFF, held[(test_rand() & 1) ? i : num - 1 - i]);
+				}
+			}
+			break;
+		case TEST_PERF_LEGATO:
+			prev = -1;
+			while(test_num_events < TEST_MAX_EVENTS - 2) {
+				i = 36 + (test_rand() % 48);
+				test_add(3 + (test_rand() % 9), 0, SEQ_EVENT_NOTE_ON, i);
+				if(prev >= 0) {
+					test_add(test_rand() % 2, 0, SEQ_EVENT_NOTE_OFF, prev);
+				}
+				prev = i;
+			}
+			break;
+		case TEST_PERF_WHEEL:
+			bend = 0x2000;
+			while(test_num_events < TEST_MAX_EVENTS - 40) {
+				i = 40 + (test_rand() % 40);
+				test_add(6, 0, SEQ_EVENT_NOTE_ON, i);
+				// a sweep up and back - some wheels only send the MSB
+				step = 1 + (test_rand() % 3);
+				if(test_rand() & 1) {
+					step *= 128;
+				}
+				else {
+					step *= 37;
+				}
+				for(j = 0; j < 16; j ++) {
+					bend += (j < 8) ? step : -step;
+					test_add(1, 0, SEQ_EVENT_PITCH_BEND, bend & 0x3fff);
+				}
+				test_add(2, 0, SEQ_EVENT_NOTE_OFF, i);
+			}
+			break;
+		case TEST_PERF_TRACKS:
+			for(i = 0; i < SEQ_PACK_NUM_TRACKS; i ++) {
+				notes[i] = -1;
+			}
+			while(test_num_events < TEST_MAX_EVENTS - 2) {
+				track = test_rand() % SEQ_PACK_NUM_TRACKS;
+				if(notes[track] >= 0) {
+					test_add(test_rand() % 6, track, SEQ_EVENT_NOTE_OFF, notes[track]);
+					notes[track] = -1;
+				}
+				else {
+					notes[track] = 24 + (track * 12) + (test_rand() % 12);
+					test_add(test_rand() % 6, track, SEQ_EVENT_NOTE_ON, notes[track]);
+				}
+			}
+			break;
+		default:
+			while(test_num_events < TEST_MAX_EVENTS) {
+				switch(test_rand() % 7) {
+					case 0:
+						i = SEQ_EVENT_NOTE_OFF;
+						break;
+					case 1:
+					case 2:
+						i = SEQ_EVENT_NOTE_ON;
+						break;
+					case 3:
+						i = SEQ_EVENT_PITCH_BEND;
+						break;
+					case 4:
+						i = SEQ_EVENT_REST;
+						break;
+					case 5:
+						i = 0xb0;
+						break;
+					default:
+						i = SEQ_EVENT_NOTE_OFF;
+						break;
+				}
+				j = test_rand() % 100;
+				if(j < 70) {
+					j = test_rand() % 70;
+				}
+				else if(j < 95) {
+					j = test_rand() % 20000;
+				}
+				else {
+					j = 60000 + (test_rand() % 6000);  // past the limit
+				}
+				num = test_rand() % 0x4000;
+				// notes in one octave so the same note is often held on more than one track
+				if(i == SEQ_EVENT_NOTE_ON || i == SEQ_EVENT_NOTE_OFF) {
+					num = 60 + (num % 12);
+				}
+				else if(i != SEQ_EVENT_PITCH_BEND) {
+					num &= 0x7f;
+				}
+				if(i != SEQ_EVENT_NOTE_ON && i != SEQ_EVENT_NOTE_OFF &&
+						i != SEQ_EVENT_PITCH_BEND) {
+					num = 0;
+				}
+				test_add(j, test_rand() % SEQ_PACK_NUM_TRACKS, i, num);
+			}
+			break;
+	}
+}
+
+// pack the performance - returns the stream length or -1 if it did not fit
+int test_pack(void) {
+	struct seq_pack_state s;
+	int i;
+	seq_pack_init(&s, test_buf, TEST_BUF_SIZE);
+	for(i = 0; i < test_num_events; i ++) {
+		if(!seq_pack_write(&s, test_events[i].time, test_events[i].track,
+				test_events[i].type, test_events[i].value)) {
+			return -1;
+		}
+	}
+	return s.pos;
+}
+
+// read back the stream and check every event
+void test_read_back(const char *what, int len) {
+	struct seq_pack_state s;
+	struct seq_event ev;
+	struct test_event *want;
+	int i, errors = 0, time;
+
+	seq_pack_init(&s, test_buf, len);
+	for(i = 0; i < test_num_events; i ++) {
+		want = &test_events[i];
+		time = want->time;
+		if(time > 0xffff) {
+			time = 0xffff;
+		}
+		if(seq_pack_read(&s, &ev) != SEQ_PACK_READ_OK) {
+			HARNESS_CHECK(0, "%s: event %d did not read", what, i);
+			return;
+		}
+		if((ev.time != time || ev.track != want->track || ev.type != want->type ||
+				ev.value != want->value) && errors < 10) {
+			HARNESS_CHECK(0, "%s: event %d: got %d %d %02x %d - wanted %d %d %02x %d",
+				what, i, ev.time, ev.track, ev.type, ev.value,
+				time, want->track, want->type, want->value);
+			errors ++;
+		}
+	}
+	HARNESS_CHECK(seq_pack_read(&s, &ev) == SEQ_PACK_READ_END, "%s: no end", what);
+	HARNESS_CHECK(s.pos == len, "%s: read %d of %d bytes", what, s.pos, len);
+}
+
+// a stream cut short at any byte reads the whole events and then stops
+void test_cut_short(const char *what, int len) {
+	static uint8_t cut[TEST_BUF_SIZE];
+	struct seq_pack_state s;
+	struct seq_event ev;
+	int size, count, ret;
+
+	for(size = 0; size <= len; size ++) {
+		// a copy so reads past the end would see junk
+		memset(cut, 0xa5, sizeof(cut));
+		memcpy(cut, test_buf, size);
+		seq_pack_init(&s, cut, size);
+		count = 0;
+		while((ret = seq_pack_read(&s, &ev)) == SEQ_PACK_READ_OK) {
+			count ++;
+		}
+		HARNESS_CHECK(s.pos <= size, "%s: cut at %d: read past the end", what, size);
+		HARNESS_CHECK(seq_pack_read(&s, &ev) == SEQ_PACK_READ_END,
+			"%s: cut at %d: read again after the end", what, size);
+		HARNESS_CHECK(count <= test_num_events, "%s: cut at %d: too many events", what, size);
+		if(size == len) {
+			HARNESS_CHECK(ret == SEQ_PACK_READ_END && count == test_num_events,
+				"%s: whole stream read %d of %d events", what, count, test_num_events);
+		}
+	}
+}
+
+// reading on from a mark gives the same events as before
+// - marks hold a 16 bit position so only the first 64k is checked
+void test_marks(const char *what, int len) {
+	struct seq_pack_state s;
+	struct seq_pack_mark mark;
+	struct seq_event first[8], again;
+	int i, j, n;
+
+	seq_pack_init(&s, test_buf, len);
+	for(i = 0; i < test_num_events && s.pos <= 0xffff; i ++) {
+		if((test_rand() & 0x3f) == 0) {
+			seq_pack_get_mark(&s, &mark);
+			for(n = 0; n < 8 && seq_pack_read(&s, &first[n]) == SEQ_PACK_READ_OK; n ++);
+			seq_pack_set_mark(&s, &mark);
+			for(j = 0; j < n; j ++) {
+				seq_pack_read(&s, &again);
+				if(memcmp(&again, &first[j], sizeof(again)) != 0) {
+					HARNESS_CHECK(0, "%s: event %d from a mark is different", what, i + j);
+					return;
+				}
+			}
+			seq_pack_set_mark(&s, &mark);
+		}
+		seq_pack_read(&s, &again);
+	}
+}
+
+// print the decode cost
+void test_bench(const char *what, int len) {
+	struct seq_pack_state s;
+	struct seq_event ev;
+	volatile int sink = 0;
+	double start, ns;
+	int runs, i;
+
+	runs = 200;
+	start = harness_now_ns();
+	for(i = 0; i < runs; i ++) {
+		seq_pack_init(&s, test_buf, len);
+		while(seq_pack_read(&s, &ev) == SEQ_PACK_READ_OK) {
+			sink += ev.value;
+		}
+	}
+	ns = (harness_now_ns() - start) / runs;
+	fprintf(stderr, "seq_pack_test: %-6s decode: %.1fns per event - %.2fns per clock tick\n",
+		what, ns / test_num_events, ns / (test_ticks ? test_ticks : 1));
+}
@@ -0,0 +1,311 @@
+/*
+ * K65 Phenol - Pattern Switch Test
+ *
+ * Copyright 2015: Andrew Kilpatrick
+ * Written by: Andrew Kilpatrick
+ *
+ * Runs the whole mixer firmware on an external MIDI clock. Two patterns
+ * of different lengths are recorded, and their loop lengths are measured
+ * from the gate output. Then while one pattern loops the other one is
+ * queued with a program change at different points in the loop, and a
+ * chain of patterns is played. Every pattern must start on exactly the
+ * 250us tick where the one before it would have looped - no late starts
+ * and no lost or extra clock ticks.
+ *
+ * The host cost of the ticks where a pattern switch happens is printed
+ * next to the cost of the ticks where a pattern just loops.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include "harness.h"
+#include "mixer_run.h"
+#include "mixer_io.h"
+
+#define TEST_CLOCK_US 20000  // 125 BPM
+#define TEST_CLOCK_TICKS (TEST_CLOCK_US / MIXER_RUN_TICK_US)
+#define TEST_MAX_GATES 4096
+#define TEST_MAX_TICKS 400000
+
+// a gate output rising edge
+struct test_gate {
+	int tick;
+	int cv;  // CV at the time of the gate
+};
+
+struct test_gate test_gates[TEST_MAX_GATES];
+int test_num_gates;
+int test_cv;
+int test_gate_state;
+double test_tick_ns[TEST_MAX_TICKS];
+
+// local functions
+void test_hook(const char *line);
+void test_run_ms(int ms);
+void test_midi(int len, ...);
+void test_sw(int sw, int state, int ms);
+int test_first_note(int from, int cv);
+int test_record(int note1, int note2, int note3, int ms);
+int test_loop_length(int cv);
+void test_stop(void);
+int test_next_start(int from, int cv_a, int cv_b, int *cv);
+
+int main(int argc, char *argv[]) {
+	int cv_a, cv_b, len_a, len_b, start, next, cv, i, pos;
+	int expect_cv, expect_len;
+	double switch_ns = 0, loop_ns = 0;
+	int num_switch = 0, num_loop = 0;
+	static int offsets[] = {1, 5, 13, 37, 61, 90};  // clocks into the loop
+	static int chain[] = {0, 1, 1};
+
+	harness_set_trace_hook(test_hook);
+	mixer_run_init();
+	test_run_ms(5000);  // startup settings time
+	mixer_run_clock(TEST_CLOCK_US);
+	test_midi(1, 0xfa);
+	test_run_ms(1000);
+
+	// record two patterns - the first note starts each one
+	cv_a = test_record(0x3c, 0x40, 0x43, 2100);
+	len_a = test_loop_length(cv_a);
+	test_stop();
+	test_midi(2, 0xc0, 0x19);  // pattern 2
+	test_run_ms(100);
+	cv_b = test_record(0x30, 0x34, 0x37, 1500);
+	len_b = test_loop_length(cv_b);
+	test_stop();
+	HARNESS_CHECK(cv_a != cv_b && cv_a >= 0 && cv_b >= 0, "first notes not found");
+	HARNESS_CHECK(len_a > 0 && len_b > 0 && len_a != len_b,
+		"loop lengths: %d %d ticks", len_a, len_b);
+	HARNESS_CHECK((len_a % TEST_CLOCK_TICKS) == 0 && (len_b % TEST_CLOCK_TICKS) == 0,
+		"loop lengths not whole clocks: %d %d ticks", len_a, len_b);
+	fprintf(stderr, "seq_pattern_test: loops of %d and %d clocks\n",
+		len_a / TEST_CLOCK_TICKS, len_b / TEST_CLOCK_TICKS);
+
+	// loop pattern 1 and queue pattern 2 and back at different points
+	test_midi(2, 0xc0, 0x18);
+	test_run_ms(100);
+	test_sw(1, 1, 550);
+	test_sw(1, 0, 0);
+
+	// queue at each offset - the program change is sent half way between
+	// clocks so its bytes don't hold up a clock byte
+	for(i = 0; i < (int)(sizeof(offsets) / sizeof(int)); i ++) {
+		pos = test_num_gates;
+		// wait for a loop of pattern 1 to start
+		while(test_first_note(pos, cv_a) < 0) {
+			test_run_ms(1);
+		}
+		start = test_gates[test_first_note(pos, cv_a)].tick;
+		while(offsets[i] >= len_a / TEST_CLOCK_TICKS) {
+			offsets[i] -= len_a / TEST_CLOCK_TICKS;
+		}
+		while(mixer_run_get_tick() < start + (offsets[i] * TEST_CLOCK_TICKS) +
+				(TEST_CLOCK_TICKS / 2)) {
+			mixer_run_tick();
+		}
+		pos = test_num_gates;
+		test_midi(2, 0xc0, 0x19);
+		while(test_first_note(pos, cv_b) < 0 && mixer_run_get_tick() < start + (len_a * 3)) {
+			test_run_ms(1);
+		}
+		next = test_first_note(pos, cv_b);
+		HARNESS_CHECK(next >= 0 && test_first_note(pos, cv_a) < 0,
+			"offset %d: pattern 2 did not start after pattern 1 ended", offsets[i]);
+		if(next >= 0) {
+			HARNESS_CHECK(test_gates[next].tick == start + len_a,
+				"offset %d: pattern 2 started %d ticks late", offsets[i],
+				test_gates[next].tick - (start + len_a));
+			switch_ns += test_tick_ns[test_gates[next].tick];
+			num_switch ++;
+		}
+		// back to pattern 1
+		start = test_gates[next].tick;
+		pos = test_num_gates;
+		test_midi(2, 0xc0, 0x18);
+		while(test_first_note(pos, cv_a) < 0 && mixer_run_get_tick() < start + (len_b * 3)) {
+			test_run_ms(1);
+		}
+		next = test_first_note(pos, cv_a);
+		HARNESS_CHECK(next >= 0 && test_gates[next].tick == start + len_b,
+			"offset %d: pattern 1 did not start on time", offsets[i]);
+		// a plain loop
+		if(next >= 0) {
+			start = test_gates[next].tick;
+			test_run_ms((len_a / 4) + 10);
+			next = test_first_note(next + 1, cv_a);
+			if(next >= 0) {
+				HARNESS_CHECK(test_gates[next].tick == start + len_a,
+					"offset %d: pattern 1 loop is %d ticks", offsets[i],
+					test_gates[next].tick - start);
+				loop_ns += test_tick_ns[test_gates[next].tick];
+				num_loop ++;
+			}
+		}
+	}
+
+	// chain of 1, 2, 2 - every loop starts where the last one ends
+	test_run_ms(len_a / 8);
+	test_midi(6, 0xc0, 0x20, 0xc0, 0x21, 0xc0, 0x21);
+	pos = test_num_gates;
+	test_run_ms(((len_a + len_b + len_b) * 3) / 4);
+	start = -1;
+	expect_len = 0;
+	i = 0;
+	while((next = test_next_start(pos, cv_a, cv_b, &cv)) >= 0) {
+		// the first loop after the chain was set up
+		if(start < 0) {
+			HARNESS_CHECK(cv == cv_a, "chain: did not start from pattern 1");
+		}
+		else {
+			expect_cv = chain[(i + 1) % 3] ? cv_b : cv_a;
+			HARNESS_CHECK(cv == expect_cv, "chain: loop %d is the wrong pattern", i);
+			HARNESS_CHECK(test_gates[next].tick == start + expect_len,
+				"chain: loop %d started %d ticks late", i,
+				test_gates[next].tick - (start + expect_len));
+			i ++;
+		}
+		start = test_gates[next].tick;
+		expect_len = (cv == cv_a) ? len_a : len_b;
+		pos = next + 1;
+	}
+	HARNESS_CHECK(i >= 6, "chain: only %d loops", i);
+	test_midi(2, 0xc0, 0x28);
+	test_stop();
+
+	if(num_switch && num_loop) {
+		fprintf(stderr, "seq_pattern_test: host cost of a tick with a pattern switch: "
+			"%.0fns - with a plain loop: %.0fns\n", switch_ns / num_switch,
+			loop_ns / num_loop);
+	}
+	return harness_done("seq_pattern_test");
+}
+
+//
+// local functions
+//
+// take the gate and CV outputs from the trace
+void test_hook(const char *line) {
+	int chan, val;
+	if(sscanf(line, "cv_out %d %d", &chan, &val) == 2 && chan == 0) {
+		test_cv = val;
+	}
+	else if(sscanf(line, "gate_out %d %d", &chan, &val) == 2) {
+		if(val && !test_gate_state && test_num_gates < TEST_MAX_GATES) {
+			test_gates[test_num_gates].tick = mixer_run_get_tick();
+			test_gates[test_num_gates].cv = test_cv;
+			test_num_gates ++;
+		}
+		test_gate_state = val;
+	}
+}
+
+// run the firmware for a while - the host cost of each tick is kept
+void test_run_ms(int ms) {
+	int i, tick;
+	double start;
+	for(i = 0; i < ms * 4; i ++) {
+		tick = mixer_run_get_tick();
+		start = harness_now_ns();
+		mixer_run_tick();
+		if(tick < TEST_MAX_TICKS) {
+			test_tick_ns[tick] = harness_now_ns() - start;
+		}
+	}
+}
+
+// send MIDI bytes
+void test_midi(int len, ...) {
+	va_list ap;
+	int i;
+	va_start(ap, len);
+	for(i = 0; i < len; i ++) {
+		mixer_run_midi_send(va_arg(ap, int));
+	}
+	va_end(ap);
+}
+
+// press or release a switch and run for a while
+void test_sw(int sw, int state, int ms) {
+	mixer_io_set_sw(sw, state);
+	test_run_ms(ms + 50);
+}
+
+// find the first gate with a CV from a gate number - returns -1 if none
+int test_first_note(int from, int cv) {
+	int i;
+	for(i = from; i < test_num_gates; i ++) {
+		if(test_gates[i].cv == cv) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+// find the next loop start of either pattern - returns -1 if none
+int test_next_start(int from, int cv_a, int cv_b, int *cv) {
+	int i;
+	for(i = from; i < test_num_gates; i ++) {
+		if(test_gates[i].cv == cv_a || test_gates[i].cv == cv_b) {
+			*cv = test_gates[i].cv;
+			return i;
+		}
+	}
+	return -1;
+}
+
+// realtime record three notes and loop them - the loop is ms long
+// returns the CV of the first note
+int test_record(int note1, int note2, int note3, int ms) {
+	int pos, cv;
+	test_sw(0, 1, 100);
+	test_sw(1, 1, 0);
+	test_sw(1, 0, 0);
+	test_sw(0, 0, 200);
+	pos = test_num_gates;
+	test_midi(3, 0x90, note1, 0x64);
+	test_run_ms(ms / 6);
+	test_midi(3, 0x80, note1, 0x00);
+	test_run_ms(ms / 6);
+	cv = pos < test_num_gates ? test_gates[pos].cv : -1;
+	test_midi(3, 0x90, note2, 0x64);
+	test_run_ms(ms / 6);
+	test_midi(3, 0x80, note2, 0x00);
+	test_run_ms(ms / 6);
+	test_midi(3, 0x90, note3, 0x64);
+	test_run_ms(ms / 6);
+	test_midi(3, 0x80, note3, 0x00);
+	test_run_ms(ms / 6);
+	// hold play - loop it
+	test_sw(1, 1, 550);
+	test_sw(1, 0, 0);
+	return cv;
+}
+
+// measure the loop length from the first notes of a few loops
+int test_loop_length(int cv) {
+	int pos, i, len = -1, a, b;
+	pos = test_num_gates;
+	test_run_ms(8000);
+	a = test_first_note(pos, cv);
+	for(i = 0; i < 3 && a >= 0; i ++) {
+		b = test_first_note(a + 1, cv);
+		if(b < 0) {
+			break;
+		}
+		if(len >= 0) {
+			HARNESS_CHECK(test_gates[b].tick - test_gates[a].tick == len,
+				"loop length changed: %d - was %d", test_gates[b].tick - test_gates[a].tick, len);
+		}
+		len = test_gates[b].tick - test_gates[a].tick;
+		a = b;
+	}
+	return len;
+}
+
+// stop playing at the end of the loop
+void test_stop(void) {
+	test_sw(1, 1, 0);
+	test_sw(1, 0, 5000);
+}
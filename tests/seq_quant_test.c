@@ -0,0 +1,364 @@
+/*
+ * K65 Phenol - Record Quantize Test
+ *
+ * Copyright 2015: Andrew Kilpatrick
+ * Written by: Andrew Kilpatrick
+ *
+ * Runs the whole mixer firmware on an external MIDI clock and records
+ * humanized playing with each quantize grid and swing set with the
+ * channel 1 CCs. Every note is played up to just under half way to the
+ * grid line next to the one it is meant for, at a random point inside
+ * the clock tick, and held for a random length. The pattern is read back:
+ *	- every note on is on its grid line - every other line is late by the
+ *	  swing
+ *	- every note off moved by the same amount so the note keeps its
+ *	  length
+ *	- with the grid off every note is where it was played
+ *
+ * Each recording is chained with the same kind of playing recorded with
+ * the grid off in another pattern, so the two play in turn, and the host
+ * cost of the playback ticks of each is compared - the pattern is
+ * already on the grid so playback must not cost any more.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include "harness.h"
+#include "mixer_run.h"
+#include "mixer_io.h"
+#include "seq_pack.h"
+
+#define TEST_CLOCK_US 20000  // 125 BPM
+#define TEST_CLOCK_TICKS (TEST_CLOCK_US / MIXER_RUN_TICK_US)
+#define TEST_NOTES 24
+#define TEST_FIRST_NOTE 36  // every note has its own note number
+#define TEST_COST_LOOPS 8  // loops of each pattern timed
+#define TEST_COST_SLACK 1.5  // quantized playback may only be this much slower - host noise
+#define TEST_MAX_TICKS 400000
+
+// a note that was played
+struct test_note {
+	int on;  // clock ticks from the start of the recording
+	int off;
+	int want_on;  // where it must be recorded
+	int want_off;
+	int got_on;  // where it was recorded
+	int got_off;
+};
+
+// sequencer state in seq.c
+extern int seq_state;
+extern int seq_pattern;
+extern int seq_run_timer;
+extern uint8_t *seq_play_buf;
+extern int seq_play_size;
+extern int seq_num_events;
+
+struct test_note test_notes[TEST_NOTES];
+double test_tick_ns[2][TEST_MAX_TICKS];  // playback tick times for patterns 1 and 2
+int test_num_ticks[2];
+uint32_t test_rand_state = 1;
+
+// local functions
+uint32_t test_rand(void);
+void test_hook(const char *line);
+void test_run_ms(int ms);
+void test_midi(int len, ...);
+void test_sw(int sw, int state, int ms);
+int test_line(int grid, int swing, int line);
+void test_make(int grid, int swing);
+void test_wait_clock(int clock);
+void test_record(int pattern, int grid_sel, int swing);
+int test_check(int grid, int swing);
+void test_stop(void);
+void test_cost(double *ns, double *raw_ns);
+double test_mean(double *ns, int num);
+int test_cmp(const void *a, const void *b);
+
+int main(int argc, char *argv[]) {
+	// grid CC values - the grid is the value >> 4
+	static int grid_sels[] = {2, 3, 4, 5, 6, 7};
+	static int grids[] = {0, 24, 12, 8, 6, 4, 3, 2};
+	static int swings[] = {0, 64, 127};
+	int g, s, ok, raw_ok;
+	double raw_ns, ns;
+
+	harness_set_trace_hook(test_hook);
+	mixer_run_init();
+	test_run_ms(5000);  // startup settings time
+	mixer_run_clock(TEST_CLOCK_US);
+	test_midi(1, 0xfa);
+	test_run_ms(1000);
+
+	for(g = 0; g < (int)(sizeof(grid_sels) / sizeof(int)); g ++) {
+		for(s = 0; s < (int)(sizeof(swings) / sizeof(int)); s ++) {
+			// grid off in pattern 2
+			test_make(0, 0);
+			test_record(1, 0, 0);
+			raw_ok = test_check(0, 0);
+			test_stop();
+
+			// quantized in pattern 1
+			test_make(grids[grid_sels[g]], swings[s]);
+			test_record(0, grid_sels[g], swings[s]);
+			ok = test_check(grids[grid_sels[g]], swings[s]);
+			test_cost(&ns, &raw_ns);
+			fprintf(stderr, "seq_quant_test: grid %2d swing %3d: %2d of %d notes on the grid - "
+				"playback %.0fns per tick - grid off: %2d of %d in place - %.0fns per tick\n",
+				grids[grid_sels[g]], swings[s], ok, TEST_NOTES, ns, raw_ok, TEST_NOTES, raw_ns);
+			HARNESS_CHECK(ns <= raw_ns * TEST_COST_SLACK, "grid %d swing %d: playback "
+				"costs %.0fns per tick - %.0fns not quantized", grids[grid_sels[g]], swings[s],
+				ns, raw_ns);
+		}
+	}
+
+	// back to the default
+	test_midi(3, 0xb0, 25, 0);
+	test_midi(3, 0xb0, 26, 0);
+	test_run_ms(10);
+	return harness_done("seq_quant_test");
+}
+
+//
+// local functions
+//
+// repeatable random numbers
+uint32_t test_rand(void) {
+	test_rand_state ^= test_rand_state << 13;
+	test_rand_state ^= test_rand_state >> 17;
+	test_rand_state ^= test_rand_state << 5;
+	return test_rand_state;
+}
+
+// the outputs are not looked at - keep the trace off stdout
+void test_hook(const char *line) {
+}
+
+// run the firmware for a while
+void test_run_ms(int ms) {
+	int i;
+	for(i = 0; i < ms * 4; i ++) {
+		mixer_run_tick();
+	}
+}
+
+// send MIDI bytes
+void test_midi(int len, ...) {
+	va_list ap;
+	int i;
+	va_start(ap, len);
+	for(i = 0; i < len; i ++) {
+		mixer_run_midi_send(va_arg(ap, int));
+	}
+	va_end(ap);
+}
+
+// press or release a switch and run for a while
+void test_sw(int sw, int state, int ms) {
+	mixer_io_set_sw(sw, state);
+	test_run_ms(ms + 50);
+}
+
+// get the time of a grid line in clock ticks - grid 0 = every clock tick
+int test_line(int grid, int swing, int line) {
+	if(grid == 0) {
+		return line;
+	}
+	return ((line >> 1) * (grid << 1)) + ((line & 0x01) ? grid + ((grid * swing) >> 8) : 0);
+}
+
+// make up humanized notes for a grid and swing
+// - each note is moved less than half way to the lines on either side
+// - the first note starts the recording so it is on time
+void test_make(int grid, int swing) {
+	int i, line = 0, before, after, early, late, next;
+	struct test_note *n;
+
+	for(i = 0; i < TEST_NOTES; i ++) {
+		n = &test_notes[i];
+		if(grid == 0) {
+			n->want_on = line * 3 + (test_rand() % 3);
+			n->on = n->want_on;
+		}
+		else {
+			n->want_on = test_line(grid, swing, line);
+			before = line ? n->want_on - test_line(grid, swing, line - 1) : 1;
+			after = test_line(grid, swing, line + 1) - n->want_on;
+			early = (before - 1) >> 1;
+			late = (after - 1) >> 1;
+			n->on = n->want_on - early + (test_rand() % (early + late + 1));
+		}
+		if(i == 0) {
+			n->want_on = 0;
+			n->on = 0;
+		}
+		line += 1 + (test_rand() % 3);
+	}
+	// hold each note up to the next one
+	for(i = 0; i < TEST_NOTES; i ++) {
+		n = &test_notes[i];
+		next = (i < TEST_NOTES - 1) ? test_notes[i + 1].on : n->on + 8;
+		n->off = n->on + 1 + (test_rand() % (next - n->on));
+		n->want_off = n->off + (n->want_on - n->on);
+		if(n->want_off <= n->want_on) {
+			n->want_off = n->want_on + 1;
+		}
+		n->got_on = -1;
+		n->got_off = -1;
+	}
+}
+
+// wait for a clock tick in the recording and then a bit more
+void test_wait_clock(int clock) {
+	int i, extra;
+	if(seq_run_timer == clock) {
+		return;
+	}
+	while(seq_run_timer < clock) {
+		mixer_run_tick();
+	}
+	// the note bytes take about 1ms so don't go too close to the next clock
+	extra = test_rand() % (TEST_CLOCK_TICKS - 16);
+	for(i = 0; i < extra; i ++) {
+		mixer_run_tick();
+	}
+}
+
+// set the grid and swing and record the notes in a pattern and loop them
+void test_record(int pattern, int grid_sel, int swing) {
+	int i, j, ev;
+	test_midi(2, 0xc0, 0x18 + pattern);
+	test_midi(3, 0xb0, 25, grid_sel << 4);
+	test_midi(3, 0xb0, 26, swing);
+	test_run_ms(10);
+	test_sw(0, 1, 100);
+	test_sw(1, 1, 0);
+	test_sw(1, 0, 0);
+	test_sw(0, 0, 200);
+
+	// note ons and offs in time order - offs go first in the same tick
+	i = 0;
+	j = 0;
+	while(j < TEST_NOTES) {
+		if(i < TEST_NOTES && test_notes[i].on < test_notes[j].off) {
+			ev = i;
+			test_wait_clock(test_notes[i].on);
+			test_midi(3, 0x90, TEST_FIRST_NOTE + ev, 100);
+			i ++;
+		}
+		else {
+			ev = j;
+			test_wait_clock(test_notes[j].off);
+			test_midi(3, 0x80, TEST_FIRST_NOTE + ev, 0);
+			j ++;
+		}
+		test_run_ms(1);
+	}
+	test_run_ms(200);
+
+	// hold play - loop it
+	test_sw(1, 1, 550);
+	test_sw(1, 0, 0);
+}
+
+// read the pattern back and check the note times
+// returns the number of notes where they should be
+int test_check(int grid, int swing) {
+	struct seq_pack_state s;
+	struct seq_event ev;
+	int time = 0, events = 0, i, ok = 0, note;
+	struct test_note *n;
+
+	seq_pack_init(&s, seq_play_buf, seq_play_size);
+	while(events < seq_num_events && seq_pack_read(&s, &ev) == SEQ_PACK_READ_OK) {
+		time += ev.time;
+		events ++;
+		note = ev.value - TEST_FIRST_NOTE;
+		if(note < 0 || note >= TEST_NOTES) {
+			continue;
+		}
+		if(ev.type == SEQ_EVENT_NOTE_ON) {
+			test_notes[note].got_on = time;
+		}
+		else if(ev.type == SEQ_EVENT_NOTE_OFF) {
+			test_notes[note].got_off = time;
+		}
+	}
+	HARNESS_CHECK(events == seq_num_events && events == (TEST_NOTES * 2) + 1,
+		"grid %d swing %d: read %d of %d events", grid, swing, events, seq_num_events);
+	for(i = 0; i < TEST_NOTES; i ++) {
+		n = &test_notes[i];
+		if(n->got_on == n->want_on && n->got_off == n->want_off) {
+			ok ++;
+			continue;
+		}
+		HARNESS_CHECK(0, "grid %d swing %d: note %d played %d to %d is at %d to %d - "
+			"wanted %d to %d", grid, swing, i, n->on, n->off, n->got_on, n->got_off,
+			n->want_on, n->want_off);
+	}
+	return ok;
+}
+
+// stop at the end of the loop
+void test_stop(void) {
+	int i;
+	test_sw(1, 1, 0);
+	test_sw(1, 0, 0);
+	for(i = 0; i < TEST_MAX_TICKS && seq_state != 0; i ++) {
+		mixer_run_tick();
+	}
+	HARNESS_CHECK(seq_state == 0, "the loop did not stop");
+	test_run_ms(100);
+}
+
+// chain the looping pattern 1 with pattern 2 and time the playback ticks of each
+// - ns = pattern 1 - raw_ns = pattern 2
+void test_cost(double *ns, double *raw_ns) {
+	int i, pat, last, loops = 0;
+	double start;
+
+	test_midi(4, 0xc0, 0x20, 0xc0, 0x21);
+	test_num_ticks[0] = 0;
+	test_num_ticks[1] = 0;
+	last = seq_pattern;
+	for(i = 0; i < TEST_MAX_TICKS * 2 && loops < TEST_COST_LOOPS * 2; i ++) {
+		pat = seq_pattern & 0x01;
+		start = harness_now_ns();
+		mixer_run_tick();
+		if(test_num_ticks[pat] < TEST_MAX_TICKS) {
+			test_tick_ns[pat][test_num_ticks[pat]] = harness_now_ns() - start;
+			test_num_ticks[pat] ++;
+		}
+		if(seq_pattern != last) {
+			last = seq_pattern;
+			loops ++;
+		}
+	}
+	HARNESS_CHECK(loops == TEST_COST_LOOPS * 2, "only %d patterns played from the chain", loops);
+	test_midi(2, 0xc0, 0x28);
+	test_stop();
+	*ns = test_mean(test_tick_ns[0], test_num_ticks[0]);
+	*raw_ns = test_mean(test_tick_ns[1], test_num_ticks[1]);
+}
+
+// get the mean of tick times without the slowest 1%
+double test_mean(double *ns, int num) {
+	int i;
+	double total = 0;
+	if(num < 100) {
+		return 0;
+	}
+	qsort(ns, num, sizeof(double), test_cmp);
+	for(i = 0; i < (num * 99) / 100; i ++) {
+		total += ns[i];
+	}
+	return total / ((num * 99) / 100);
+}
+
+// sort doubles
+int test_cmp(const void *a, const void *b) {
+	double da = *(const double *)a;
+	double db = *(const double *)b;
+	return (da > db) - (da < db);
+}
@@ -0,0 +1,302 @@
+/*
+ * K65 Phenol - Song Position Test
+ *
+ * Runs the whole mixer firmware on an external MIDI clock and records
+ * patterns of about 64, 256 and 1024 events - random notes with up to 5
+ * held at once and a few on the same clock tick. Each pattern is read back and
+ * played with song positions to random times:
+ *	- playback carries on from the first event at or after the time
+ *	- the notes that should be sounding at the time are held on voice 0
+ *	  and no others - the chase
+ *	- the run timer is at the time
+ * A song position sent to the DIN MIDI in on the 1024 event pattern must
+ * do the same, and so must a DAW locate - MIDI stop, song position and
+ * continue - which has to start the loop again from the new place. A stop
+ * and continue with no song position carries on from where it stopped.
+ *
+ * The host time of a seek is printed for each pattern size, next to the
+ * time of reading the pattern from the start to the same point. The seek
+ * has to stay about the same as the pattern grows.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include "harness.h"
+#include "mixer_run.h"
+#include "mixer_io.h"
+#include "seq.h"
+#include "seq_pack.h"
+
+#define TEST_CLOCK_US 20000  // 125 BPM
+#define TEST_MAX_HELD 5  // held notes while recording - the pack tracks 8
+#define TEST_SEEKS 2000  // checked seeks on each pattern
+#define TEST_BENCH_SEEKS 20000
+#define TEST_MIDI_SEEKS 20
+#define TEST_LOCATES 20
+#define TEST_GROWTH_MAX 2.0  // most the seek time can grow from 64 to 1024 events
+#define TEST_STATE_PLAY_LOOP 7  // SEQ_STATE_PLAY_LOOP in seq.c
+
+// sequencer state in seq.c
+extern int seq_run_timer;
+extern int seq_loop_base;
+extern int seq_length;
+extern int seq_num_events;
+extern int seq_play_event_pos;
+extern uint8_t *seq_play_buf;
+extern int seq_play_size;
+
+// held notes in voice.c
+extern unsigned int voice_held[2][4];
+
+uint32_t test_rand_state = 1;
+
+// local functions
+uint32_t test_rand(void);
+void test_hook(const char *line);
+void test_run_ms(int ms);
+void test_midi(int len, ...);
+void test_sw(int sw, int state, int ms);
+void test_next_clock(void);
+void test_record(int events);
+int test_read_to(int time, unsigned int *held);
+int test_check_seek(int time, const char *how);
+void test_locate(int spp);
+double test_bench_seek(void);
+double test_bench_read(void);
+
+int main(int argc, char *argv[]) {
+	static int sizes[] = {64, 256, 1024};
+	double seek_ns[3], read_ns[3];
+	int i, s, errors;
+
+	harness_set_trace_hook(test_hook);
+	mixer_run_init();
+	test_run_ms(5000);  // startup settings time
+	mixer_run_clock(TEST_CLOCK_US);
+	test_midi(1, 0xfa);
+	test_run_ms(1000);
+
+	for(s = 0; s < 3; s ++) {
+		test_record(sizes[s]);
+		HARNESS_CHECK(seq_num_events > (sizes[s] * 9) / 10 &&
+			seq_get_state() == TEST_STATE_PLAY_LOOP,
+			"%d events: pattern has %d events - state %d", sizes[s], seq_num_events,
+			seq_get_state());
+		errors = 0;
+		for(i = 0; i < TEST_SEEKS && errors < 5; i ++) {
+			errors += test_check_seek(test_rand() % seq_length, "seek");
+		}
+		// the ends of the pattern
+		test_check_seek(0, "seek");
+		test_check_seek(seq_length - 1, "seek");
+		seek_ns[s] = test_bench_seek();
+		read_ns[s] = test_bench_read();
+		fprintf(stderr, "seq_seek_test: %4d events - %4d bytes - %4d clocks: seek %.0fns - "
+			"read from the start %.0fns\n", seq_num_events, seq_play_size, seq_length,
+			seek_ns[s], read_ns[s]);
+	}
+	HARNESS_CHECK(seek_ns[2] < seek_ns[0] * TEST_GROWTH_MAX,
+		"seek took %.0fns with 1024 events - %.0fns with 64", seek_ns[2], seek_ns[0]);
+
+	// song position on the DIN MIDI in - in 16th notes
+	for(i = 0; i < TEST_MIDI_SEEKS; i ++) {
+		s = test_rand() % (seq_length / 6);
+		test_next_clock();
+		test_midi(3, 0xf2, s & 0x7f, s >> 7);
+		test_run_ms(2);
+		test_check_seek(-(s * 6), "MIDI song position");
+	}
+
+	// stop, song position and continue - then stop and continue
+	for(i = 0; i < TEST_LOCATES; i ++) {
+		test_locate(1);
+		test_locate(0);
+	}
+	return harness_done("seq_seek_test");
+}
+
+//
+// local functions
+//
+// repeatable random numbers
+uint32_t test_rand(void) {
+	test_rand_state ^= test_rand_state << 13;
+	test_rand_state ^= test_rand_state >> 17;
+	test_rand_state ^= test_rand_state << 5;
+	return test_rand_state;
+}
+
+// the outputs are not looked at - keep the trace off stdout
+void test_hook(const char *line) {
+}
+
+// run the firmware for a while
+void test_run_ms(int ms) {
+	int i;
+	for(i = 0; i < ms * 4; i ++) {
+		mixer_run_tick();
+	}
+}
+
+// send MIDI bytes
+void test_midi(int len, ...) {
+	va_list ap;
+	int i;
+	va_start(ap, len);
+	for(i = 0; i < len; i ++) {
+		mixer_run_midi_send(va_arg(ap, int));
+	}
+	va_end(ap);
+}
+
+// press or release a switch and run for a while
+void test_sw(int sw, int state, int ms) {
+	mixer_io_set_sw(sw, state);
+	test_run_ms(ms + 50);
+}
+
+// run until just after the next clock tick
+void test_next_clock(void) {
+	int i, timer = seq_run_timer;
+	for(i = 0; i < 1000 && seq_run_timer == timer; i ++) {
+		mixer_run_tick();
+	}
+	HARNESS_CHECK(i < 1000, "the sequencer did not get a clock tick");
+}
+
+// realtime record a pattern of random notes and loop it
+void test_record(int events) {
+	int held[TEST_MAX_HELD], num_held = 0, num = 0, i, note;
+
+	// rec + play - record standby - the first note starts the recording
+	test_sw(0, 1, 100);
+	test_sw(1, 1, 0);
+	test_sw(1, 0, 0);
+	test_sw(0, 0, 200);
+	// leave room for the note offs at the end and the end event
+	while(num < events - TEST_MAX_HELD) {
+		if(num_held && (num_held == TEST_MAX_HELD || (test_rand() & 0x01))) {
+			i = test_rand() % num_held;
+			test_midi(3, 0x80, held[i], 0x00);
+			held[i] = held[-- num_held];
+		}
+		else {
+			do {
+				note = 36 + (test_rand() % 48);
+				for(i = 0; i < num_held && held[i] != note; i ++);
+			} while(i < num_held);
+			test_midi(3, 0x90, note, 0x64);
+			held[num_held ++] = note;
+		}
+		num ++;
+		// a few events go on the same clock tick
+		if(test_rand() % 3) {
+			test_next_clock();
+		}
+	}
+	while(num_held) {
+		test_midi(3, 0x80, held[-- num_held], 0x00);
+	}
+	test_next_clock();
+	test_next_clock();
+	// hold play - end the recording and loop it
+	test_sw(1, 1, 550);
+	test_sw(1, 0, 0);
+}
+
+// read the pattern from the start to a time - the events before it
+// - held gets the notes on at the time - returns the number of events read
+int test_read_to(int time, unsigned int *held) {
+	struct seq_pack_state s;
+	struct seq_event ev;
+	int event_time = 0, events = 0;
+
+	held[0] = held[1] = held[2] = held[3] = 0;
+	seq_pack_init(&s, seq_play_buf, seq_play_size);
+	while(events < seq_num_events && seq_pack_read(&s, &ev) == SEQ_PACK_READ_OK) {
+		if(event_time + ev.time >= time) {
+			break;
+		}
+		event_time += ev.time;
+		events ++;
+		if(ev.type == SEQ_EVENT_NOTE_ON) {
+			held[ev.value >> 5] |= (1 << (ev.value & 0x1f));
+		}
+		else if(ev.type == SEQ_EVENT_NOTE_OFF) {
+			held[ev.value >> 5] &= ~(1 << (ev.value & 0x1f));
+		}
+	}
+	return events;
+}
+
+// seek to a time and check playback and the chased notes - returns 1 on error
+// - a negative time checks a seek that was already done to that time
+int test_check_seek(int time, const char *how) {
+	unsigned int held[4];
+	int events, i, ok;
+
+	if(time >= 0) {
+		seq_clock_handle_song_position(time);
+	}
+	else {
+		time = -time;
+	}
+	time %= seq_length;
+	events = test_read_to(time, held);
+	ok = (seq_play_event_pos == events && seq_run_timer == time);
+	for(i = 0; i < 4; i ++) {
+		if(voice_held[0][i] != held[i]) {
+			ok = 0;
+		}
+	}
+	HARNESS_CHECK(ok, "%s to %d of %d: at event %d - wanted %d - timer %d - held "
+		"%08x%08x%08x%08x - wanted %08x%08x%08x%08x", how, time, seq_length,
+		seq_play_event_pos, events, seq_run_timer, voice_held[0][3], voice_held[0][2],
+		voice_held[0][1], voice_held[0][0], held[3], held[2], held[1], held[0]);
+	return !ok;
+}
+
+// stop and continue on the DIN MIDI in - with a song position to a
+// random 16th note between them if spp is 1
+void test_locate(int spp) {
+	int pos = test_rand() % (seq_length / 6);
+	int time;
+	test_next_clock();
+	time = seq_run_timer - seq_loop_base;
+	test_midi(1, 0xfc);
+	if(spp) {
+		test_midi(3, 0xf2, pos & 0x7f, pos >> 7);
+		time = pos * 6;
+	}
+	test_run_ms(2);
+	HARNESS_CHECK(seq_get_state() != TEST_STATE_PLAY_LOOP, "still playing after stop");
+	test_midi(1, 0xfb);
+	test_run_ms(2);
+	HARNESS_CHECK(seq_get_state() == TEST_STATE_PLAY_LOOP, "%s: state %d after continue",
+		spp ? "locate" : "stop and continue", seq_get_state());
+	test_check_seek(-time, spp ? "locate" : "stop and continue");
+}
+
+// time a seek to random times
+double test_bench_seek(void) {
+	double start;
+	int i;
+	start = harness_now_ns();
+	for(i = 0; i < TEST_BENCH_SEEKS; i ++) {
+		seq_clock_handle_song_position(test_rand() % seq_length);
+	}
+	return (harness_now_ns() - start) / TEST_BENCH_SEEKS;
+}
+
+// time reading from the start to random times - what a seek costs without the index
+double test_bench_read(void) {
+	unsigned int held[4];
+	double start;
+	int i;
+	start = harness_now_ns();
+	for(i = 0; i < TEST_BENCH_SEEKS; i ++) {
+		test_read_to(test_rand() % seq_length, held);
+	}
+	return (harness_now_ns() - start) / TEST_BENCH_SEEKS;
+}
@@ -0,0 +1,412 @@
+/*
+ * K65 Phenol - Flash Store Test
+ *
+ * Copyright 2015: Andrew Kilpatrick
+ * Written by: Andrew Kilpatrick
+ *
+ * Cuts the power at every flash write and erase of a save, in each of
+ * the ways a write can be left (not done, half done, done), then boots
+ * again and checks that the store loads the last sealed commit:
+ *	- the new sequence only if the seal word of its commit was written
+ *	- otherwise the sequence saved before
+ * After each cut a new save has to work and load back. This is done for
+ * saves of different lengths from an empty store and from a store that
+ * has gone around the log a few times. Cuts during the standby page
+ * erases and setting writes must never lose the saved sequence.
+ *
+ * Two long saves in a row while powered on run out of blank pages - the
+ * second one must be counted as failed and then saved in the next standby.
+ * A failed save that the buffer was changed after must not be.
+ *
+ * A random soak then runs many sessions with cuts at random points.
+ *
+ * The mount time is printed against the number of log pages in use.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include "plib.h"
+#include "harness.h"
+#include "seq_store.h"
+
+#define TEST_BUF_SIZE 4096
+#define TEST_FLASH_WORDS (PLIB_FLASH_SIZE >> 2)
+
+// a saved sequence
+struct test_seq {
+	uint8_t data[TEST_BUF_SIZE];
+	int len;
+	int events;
+};
+
+jmp_buf test_cut_jmp;
+uint32_t test_snapshot[TEST_FLASH_WORDS];
+uint8_t test_buf[TEST_BUF_SIZE];  // the sequencer buffer being saved
+uint32_t test_rand_state = 1;
+
+// local functions
+void test_cut(void);
+uint32_t test_rand(void);
+void test_seq_make(struct test_seq *seq, int len);
+void test_save(struct test_seq *seq);
+void test_standby(void);
+int test_load(struct test_seq *seq);
+int test_same(struct test_seq *a, struct test_seq *b);
+void test_cuts(const char *what, int len);
+void test_retry(void);
+void test_soak(int runs);
+void test_mount_bench(void);
+int test_pages_used(void);
+int test_settings_same(int *vals);
+
+int main(int argc, char *argv[]) {
+	int i;
+	static int lens[] = {0, 1, 37, 64, 300, 1000, 2500, 4000};
+
+	// from an empty store
+	for(i = 0; i < (int)(sizeof(lens) / sizeof(int)); i ++) {
+		plib_flash_reset();
+		test_cuts("empty store", lens[i]);
+	}
+	// from a store that has gone around the log
+	for(i = 0; i < (int)(sizeof(lens) / sizeof(int)); i ++) {
+		struct test_seq seq;
+		int j;
+		plib_flash_reset();
+		seq_store_init();
+		for(j = 0; j < 20; j ++) {
+			seq_store_set_setting(j % SEQ_STORE_NUM_SETTINGS, j);
+			test_seq_make(&seq, 500 + (j * 97));
+			test_save(&seq);
+			test_standby();
+		}
+		test_cuts("used store", lens[i]);
+	}
+
+	test_retry();
+	test_soak(3000);
+	test_mount_bench();
+	return harness_done("seq_store_test");
+}
+
+//
+// local functions
+//
+// power cut hook
+void test_cut(void) {
+	longjmp(test_cut_jmp, 1);
+}
+
+// repeatable random numbers
+uint32_t test_rand(void) {
+	test_rand_state ^= test_rand_state << 13;
+	test_rand_state ^= test_rand_state >> 17;
+	test_rand_state ^= test_rand_state << 5;
+	return test_rand_state;
+}
+
+// make a random sequence
+void test_seq_make(struct test_seq *seq, int len) {
+	int i;
+	for(i = 0; i < len; i ++) {
+		seq->data[i] = test_rand();
+	}
+	seq->len = len;
+	seq->events = test_rand() % 1000;
+}
+
+// save a sequence like the sequencer does while powered on
+// - the buffer grows a bit at a time while the main loop polls
+void test_save(struct test_seq *seq) {
+	int len, i;
+	seq_store_set_idle(0);
+	memset(test_buf, 0, sizeof(test_buf));
+	seq_store_rec_start(test_buf);
+	len = 0;
+	while(len < seq->len) {
+		i = len + 1 + (test_rand() % 48);
+		if(i > seq->len) {
+			i = seq->len;
+		}
+		memcpy(test_buf + len, seq->data + len, i - len);
+		len = i;
+		seq_store_rec_update(len);
+		seq_store_poll();
+	}
+	seq_store_rec_commit(seq->len, seq->events);
+	for(i = 0; i < 200; i ++) {
+		seq_store_poll();
+	}
+}
+
+// go to standby - the store erases old pages
+void test_standby(void) {
+	int i;
+	seq_store_set_idle(1);
+	for(i = 0; i < 20; i ++) {
+		seq_store_poll();
+	}
+	seq_store_set_idle(0);
+}
+
+// boot and load the saved sequence
+int test_load(struct test_seq *seq) {
+	seq_store_init();
+	seq->len = seq_store_load(seq->data, TEST_BUF_SIZE, &seq->events);
+	return seq->len;
+}
+
+// check if two sequences are the same
+int test_same(struct test_seq *a, struct test_seq *b) {
+	if(a->len != b->len) {
+		return 0;
+	}
+	if(a->len == 0) {
+		return 1;
+	}
+	return a->events == b->events && memcmp(a->data, b->data, a->len) == 0;
+}
+
+// cut the power at every flash op of a save, a standby and a setting write
+void test_cuts(const char *what, int len) {
+	static struct test_seq old, seq, got, next;
+	unsigned long ops_start, ops;
+	uint32_t rand_start;
+	int k, mode, setting, val, i;
+	int vals[SEQ_STORE_NUM_SETTINGS];
+
+	test_load(&old);
+	for(i = 0; i < SEQ_STORE_NUM_SETTINGS; i ++) {
+		vals[i] = seq_store_get_setting(i, -1);
+	}
+	memcpy(test_snapshot, plib_flash, sizeof(test_snapshot));
+	test_seq_make(&seq, len);
+	test_seq_make(&next, 200);
+
+	// count the flash ops of the save - the seal is the last write
+	rand_start = test_rand_state;
+	seq_store_init();
+	ops_start = plib_flash_writes + plib_flash_erases;
+	test_save(&seq);
+	ops = (plib_flash_writes + plib_flash_erases) - ops_start;
+	test_load(&got);
+	HARNESS_CHECK(test_same(&got, &seq), "%s: save of %d bytes did not load", what, len);
+
+	for(k = 0; k < (int)ops; k ++) {
+		for(mode = PLIB_CUT_NONE; mode <= PLIB_CUT_DONE; mode ++) {
+			memcpy(plib_flash, test_snapshot, sizeof(test_snapshot));
+			test_rand_state = rand_start;
+			seq_store_init();
+			plib_flash_cut(k, mode, test_cut);
+			if(setjmp(test_cut_jmp) == 0) {
+				test_save(&seq);
+			}
+			plib_flash_cut(-1, PLIB_CUT_NONE, NULL);
+			test_load(&got);
+			if(k == (int)ops - 1 && mode == PLIB_CUT_DONE) {
+				HARNESS_CHECK(test_same(&got, &seq),
+					"%s: %d bytes - cut after the seal - new sequence lost", what, len);
+			}
+			else {
+				HARNESS_CHECK(test_same(&got, &old),
+					"%s: %d bytes - cut at op %d of %lu mode %d - got %d bytes, wanted the old %d",
+					what, len, k, ops, mode, got.len, old.len);
+			}
+			// the store has to keep working after the cut - and keep the
+			// settings once the pages from before the cut are erased
+			for(i = 0; i < 3; i ++) {
+				test_standby();
+				test_save(&next);
+			}
+			test_load(&got);
+			HARNESS_CHECK(test_same(&got, &next),
+				"%s: %d bytes - save after a cut at op %d mode %d failed", what, len, k, mode);
+			HARNESS_CHECK(test_settings_same(vals),
+				"%s: %d bytes - settings lost after a cut at op %d mode %d", what, len, k, mode);
+		}
+	}
+
+	// cut during the standby erases - the saved sequence stays
+	memcpy(plib_flash, test_snapshot, sizeof(test_snapshot));
+	seq_store_init();
+	test_save(&seq);
+	memcpy(test_snapshot, plib_flash, sizeof(test_snapshot));
+	seq_store_init();
+	ops_start = plib_flash_writes + plib_flash_erases;
+	test_standby();
+	ops = (plib_flash_writes + plib_flash_erases) - ops_start;
+	for(k = 0; k < (int)ops; k ++) {
+		for(mode = PLIB_CUT_NONE; mode <= PLIB_CUT_DONE; mode ++) {
+			memcpy(plib_flash, test_snapshot, sizeof(test_snapshot));
+			seq_store_init();
+			plib_flash_cut(k, mode, test_cut);
+			if(setjmp(test_cut_jmp) == 0) {
+				test_standby();
+			}
+			plib_flash_cut(-1, PLIB_CUT_NONE, NULL);
+			test_load(&got);
+			HARNESS_CHECK(test_same(&got, &seq),
+				"%s: %d bytes - erase cut at op %d mode %d lost the sequence", what, len, k, mode);
+		}
+	}
+
+	// cut during a setting write - the setting is old or new
+	setting = SEQ_STORE_SETTING_VOICE_MODE;
+	memcpy(plib_flash, test_snapshot, sizeof(test_snapshot));
+	seq_store_init();
+	val = seq_store_get_setting(setting, -1);
+	for(k = 0; k < 2; k ++) {
+		for(mode = PLIB_CUT_NONE; mode <= PLIB_CUT_DONE; mode ++) {
+			memcpy(plib_flash, test_snapshot, sizeof(test_snapshot));
+			seq_store_init();
+			plib_flash_cut(k, mode, test_cut);
+			if(setjmp(test_cut_jmp) == 0) {
+				seq_store_set_setting(setting, val + 1);
+				seq_store_poll();
+			}
+			plib_flash_cut(-1, PLIB_CUT_NONE, NULL);
+			test_load(&got);
+			HARNESS_CHECK(test_same(&got, &seq),
+				"%s: setting cut at op %d mode %d lost the sequence", what, k, mode);
+			HARNESS_CHECK(seq_store_get_setting(setting, -1) == val ||
+				seq_store_get_setting(setting, -1) == val + 1,
+				"%s: setting cut at op %d mode %d - got %d", what, k, mode,
+				seq_store_get_setting(setting, -1));
+		}
+	}
+}
+
+// run out of blank pages while powered on and save again in standby
+void test_retry(void) {
+	static struct test_seq first, second, got;
+	int fails, i;
+
+	// get the log going around so only the kept blank pages are free
+	plib_flash_reset();
+	seq_store_init();
+	for(i = 0; i < 10; i ++) {
+		test_seq_make(&first, 2000);
+		test_save(&first);
+		test_standby();
+	}
+	test_seq_make(&first, 4000);
+	test_seq_make(&second, 4000);
+	fails = seq_store_get_fails();
+	test_save(&first);
+	HARNESS_CHECK(seq_store_get_fails() == fails, "retry: the first save failed");
+	test_save(&second);
+	HARNESS_CHECK(seq_store_get_fails() == fails + 1, "retry: %d saves failed - wanted 1",
+		seq_store_get_fails() - fails);
+
+	// the erases are done in the first few polls and then it is saved
+	seq_store_set_idle(1);
+	for(i = 0; i < 200; i ++) {
+		seq_store_poll();
+	}
+	seq_store_set_idle(0);
+	HARNESS_CHECK(seq_store_get_fails() == fails + 1, "retry: the save in standby failed");
+	test_load(&got);
+	HARNESS_CHECK(test_same(&got, &second), "retry: got %d bytes - wanted the second save",
+		got.len);
+
+	// the buffer was changed after the save failed - the sequencer saves
+	// it again itself, so the one in the store is kept
+	test_seq_make(&first, 4000);
+	test_save(&first);
+	test_save(&second);
+	seq_store_rec_edit();
+	test_standby();
+	test_load(&got);
+	HARNESS_CHECK(test_same(&got, &first), "retry: got %d bytes - wanted the save before the "
+		"change", got.len);
+}
+
+// many sessions with power cuts at random points - each one a standby
+// then a save like a power up after a sequence was recorded
+// - after each cut the store loads the last sealed commit
+void test_soak(int runs) {
+	static struct test_seq sealed, seq, got;
+	unsigned long seal_op;
+	int run;
+
+	plib_flash_reset();
+	test_load(&sealed);
+	for(run = 0; run < runs; run ++) {
+		test_seq_make(&seq, (test_rand() % 5) ? test_rand() % TEST_BUF_SIZE : 0);
+		seal_op = 0;
+		if(test_rand() & 1) {
+			plib_flash_cut(test_rand() % 300, test_rand() % 3, test_cut);
+		}
+		if(setjmp(test_cut_jmp) == 0) {
+			test_standby();
+			test_save(&seq);
+			seal_op = 1;
+		}
+		plib_flash_cut(-1, PLIB_CUT_NONE, NULL);
+		test_load(&got);
+		if(seal_op) {
+			HARNESS_CHECK(test_same(&got, &seq), "soak run %d: save did not load", run);
+			sealed = seq;
+		}
+		else {
+			// a cut on the very last write with it done still seals
+			HARNESS_CHECK(test_same(&got, &sealed) || test_same(&got, &seq),
+				"soak run %d: got %d bytes - wanted the last sealed %d", run, got.len, sealed.len);
+			if(test_same(&got, &seq)) {
+				sealed = seq;
+			}
+		}
+	}
+}
+
+// time the mount against the number of pages in use
+void test_mount_bench(void) {
+	static struct test_seq seq;
+	double start;
+	int used, last, i, j;
+
+	plib_flash_reset();
+	seq_store_init();
+	last = -1;
+	for(i = 0; i < 200; i ++) {
+		used = test_pages_used();
+		if(used != last) {
+			start = harness_now_ns();
+			for(j = 0; j < 2000; j ++) {
+				seq_store_init();
+			}
+			fprintf(stderr, "seq_store_test: mount with %2d pages in use: %.2fus\n",
+				used, (harness_now_ns() - start) / 2000 / 1000);
+			last = used;
+		}
+		test_seq_make(&seq, 60);
+		test_save(&seq);
+		seq_store_set_setting(i & 0x0f, i);
+		seq_store_poll();
+	}
+}
+
+// count the log pages in use
+int test_pages_used(void) {
+	int page, used = 0;
+	uint32_t *base = plib_flash + ((0x1d01cc00 - PLIB_FLASH_BASE) >> 2);
+	for(page = 0; page < 12; page ++) {
+		if(base[page * (PLIB_FLASH_PAGE_SIZE >> 2)] != 0xffffffff) {
+			used ++;
+		}
+	}
+	return used;
+}
+
+// check the saved settings against a list of values
+int test_settings_same(int *vals) {
+	int i;
+	for(i = 0; i < SEQ_STORE_NUM_SETTINGS; i ++) {
+		if(seq_store_get_setting(i, -1) != vals[i]) {
+			return 0;
+		}
+	}
+	return 1;
+}
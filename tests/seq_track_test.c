@@ -0,0 +1,270 @@
+/*
+ * K65 Phenol - Multi-Track Playback Test
+ *
+ * Copyright 2015: Andrew Kilpatrick
+ * Written by: Andrew Kilpatrick
+ *
+ * Runs the whole mixer firmware on an external MIDI clock. A short loop
+ * is recorded to get the sequencer going, and then its pattern is
+ * replaced with dense material - a 4 note chord that changes on every
+ * clock tick, so 8 events on every tick - spread over 1, 2 and 4 tracks.
+ * Each one is looped in turn, 20 times over:
+ *	- after every clock tick the notes held on each voice are the chord
+ *	  notes of the tracks that play on it - even tracks on voice 0, odd
+ *	  tracks on voice 1
+ *
+ * The host time of the 250us ticks that the clock ticks land on is kept -
+ * taking turns keeps the host speeding up or slowing down out of it. The
+ * same events are played on each tick whatever the number of tracks,
+ * so the median must stay about the same as tracks are added, and the
+ * 99th percentile must stay inside a fixed budget. The percentiles are
+ * printed for each number of tracks.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include "harness.h"
+#include "mixer_run.h"
+#include "mixer_io.h"
+#include "seq.h"
+#include "seq_pack.h"
+
+#define TEST_CLOCK_US 20000  // 125 BPM
+#define TEST_LENGTH 96  // clocks in the dense pattern - 1 bar
+#define TEST_CHORD 4  // notes in the chord on each tick
+#define TEST_LOOPS 20  // loops timed for each number of tracks
+#define TEST_MAX_TICKS ((TEST_LENGTH + 1) * TEST_LOOPS)
+#define TEST_TICK_BUDGET_NS 25000  // for the 99th percentile
+#define TEST_GROWTH_MAX 1.5  // most the median can grow from 1 to 4 tracks
+#define TEST_STATE_PLAY_LOOP 7  // SEQ_STATE_PLAY_LOOP in seq.c
+#define TEST_BUF_SIZE 4096  // SEQ_BUF_SIZE in seq.c
+
+// a pattern in seq.c
+struct test_pattern {
+	uint16_t start;
+	uint16_t len;
+	uint16_t num_events;
+	uint8_t index_start;
+	uint8_t index_len;
+	int length;
+};
+
+// sequencer state in seq.c
+extern int seq_run_timer;
+extern int seq_loop_base;
+extern int seq_pattern;
+extern int seq_buf_used;
+extern uint8_t seq_event_buf[];
+extern struct test_pattern seq_patterns[];
+extern int seq_play_size;
+void seq_index_build(int pattern);
+void seq_pattern_select(int pattern);
+
+// held notes in voice.c
+extern unsigned int voice_held[2][4];
+
+double test_tick_ns[3][TEST_MAX_TICKS];  // for 1, 2 and 4 tracks
+int test_num_ticks[3];
+
+// local functions
+void test_hook(const char *line);
+void test_run_ms(int ms);
+void test_midi(int len, ...);
+void test_sw(int sw, int state, int ms);
+int test_note(int slot, int clock);
+void test_make(int tracks);
+void test_play(int tracks, double *ns, int *num);
+int test_cmp(const void *a, const void *b);
+double test_report(int tracks, double *ns, int num);
+
+int main(int argc, char *argv[]) {
+	double median[3];
+	int i, loop, tracks;
+
+	harness_set_trace_hook(test_hook);
+	mixer_run_init();
+	test_run_ms(5000);  // startup settings time
+	mixer_run_clock(TEST_CLOCK_US);
+	test_midi(1, 0xfa);
+	test_run_ms(1000);
+
+	// record a loop of one note and stop it at the end of the loop
+	test_sw(0, 1, 100);
+	test_sw(1, 1, 0);
+	test_sw(1, 0, 0);
+	test_sw(0, 0, 200);
+	test_midi(3, 0x90, 0x3c, 0x64);
+	test_run_ms(200);
+	test_midi(3, 0x80, 0x3c, 0x00);
+	test_run_ms(800);
+	test_sw(1, 1, 550);
+	test_sw(1, 0, 0);
+	test_sw(1, 1, 0);
+	test_sw(1, 0, 5000);
+
+	for(loop = 0; loop < TEST_LOOPS; loop ++) {
+		for(i = 0, tracks = 1; tracks <= 4; i ++, tracks <<= 1) {
+			test_make(tracks);
+			test_play(tracks, test_tick_ns[i], &test_num_ticks[i]);
+		}
+	}
+	for(i = 0, tracks = 1; tracks <= 4; i ++, tracks <<= 1) {
+		test_make(tracks);  // for the size
+		median[i] = test_report(tracks, test_tick_ns[i], test_num_ticks[i]);
+	}
+	HARNESS_CHECK(median[2] < median[0] * TEST_GROWTH_MAX,
+		"the median tick took %.0fns with 4 tracks - %.0fns with 1", median[2], median[0]);
+	return harness_done("seq_track_test");
+}
+
+//
+// local functions
+//
+// the outputs are not looked at - keep the trace off stdout
+void test_hook(const char *line) {
+}
+
+// run the firmware for a while
+void test_run_ms(int ms) {
+	int i;
+	for(i = 0; i < ms * 4; i ++) {
+		mixer_run_tick();
+	}
+}
+
+// send MIDI bytes
+void test_midi(int len, ...) {
+	va_list ap;
+	int i;
+	va_start(ap, len);
+	for(i = 0; i < len; i ++) {
+		mixer_run_midi_send(va_arg(ap, int));
+	}
+	va_end(ap);
+}
+
+// press or release a switch and run for a while
+void test_sw(int sw, int state, int ms) {
+	mixer_io_set_sw(sw, state);
+	test_run_ms(ms + 50);
+}
+
+// get a chord note - each slot has its own range so no two are the same
+int test_note(int slot, int clock) {
+	return 36 + (slot * 16) + (((clock * 5) + slot) % 12);
+}
+
+// write the dense pattern over the selected pattern - chord slots go to
+// the tracks in turn - the last chord is let go on the last clock
+void test_make(int tracks) {
+	struct test_pattern *pat = &seq_patterns[seq_pattern];
+	struct seq_pack_state s;
+	int clock, slot, time = 0, events = 0, ok = 1;
+
+	seq_pack_init(&s, seq_event_buf + pat->start, TEST_BUF_SIZE - pat->start);
+	for(clock = 0; clock < TEST_LENGTH; clock ++) {
+		for(slot = 0; slot < TEST_CHORD && clock > 0; slot ++) {
+			ok &= seq_pack_write(&s, clock - time, slot % tracks, SEQ_EVENT_NOTE_OFF,
+				test_note(slot, clock - 1));
+			time = clock;
+			events ++;
+		}
+		for(slot = 0; slot < TEST_CHORD && clock < TEST_LENGTH - 1; slot ++) {
+			ok &= seq_pack_write(&s, clock - time, slot % tracks, SEQ_EVENT_NOTE_ON,
+				test_note(slot, clock));
+			time = clock;
+			events ++;
+		}
+	}
+	ok &= seq_pack_write(&s, TEST_LENGTH - time, 0, SEQ_EVENT_END, 0);
+	events ++;
+	HARNESS_CHECK(ok, "%d tracks: the pattern does not fit", tracks);
+	pat->len = s.pos;
+	pat->num_events = events;
+	seq_buf_used = pat->start + pat->len;
+	seq_index_build(seq_pattern);
+	seq_pattern_select(seq_pattern);
+	HARNESS_CHECK(pat->length == TEST_LENGTH, "%d tracks: pattern is %d clocks",
+		tracks, pat->length);
+}
+
+// play the pattern through once and keep the host time of the clock ticks
+void test_play(int tracks, double *ns, int *num) {
+	unsigned int want[2][4];
+	int i, timer, pos, slot, note, voice, errors = 0;
+	double start, tick_ns;
+
+	// hold play - loop it
+	test_sw(1, 1, 550);
+	test_sw(1, 0, 0);
+	HARNESS_CHECK(seq_get_state() == TEST_STATE_PLAY_LOOP, "%d tracks: state %d",
+		tracks, seq_get_state());
+	// let it get to the start of a loop
+	for(i = 0; i < 1000000 && (seq_run_timer - seq_loop_base) != 0; i ++) {
+		mixer_run_tick();
+	}
+
+	timer = seq_run_timer;
+	// to the last clock - the end event is on the one after
+	for(pos = 0; pos < TEST_LENGTH - 1; ) {
+		start = harness_now_ns();
+		mixer_run_tick();
+		tick_ns = harness_now_ns() - start;
+		if(seq_run_timer == timer) {
+			continue;
+		}
+		timer = seq_run_timer;
+		if(*num < TEST_MAX_TICKS) {
+			ns[(*num) ++] = tick_ns;
+		}
+
+		// the notes that should be held - the loop starts on the tick
+		// after the end event so clock 0 of the pattern is 1 from the base
+		pos = seq_run_timer - seq_loop_base - 1;
+		for(i = 0; i < 4; i ++) {
+			want[0][i] = 0;
+			want[1][i] = 0;
+		}
+		for(slot = 0; slot < TEST_CHORD && pos >= 0 && pos < TEST_LENGTH - 1; slot ++) {
+			note = test_note(slot, pos);
+			voice = (slot % tracks) & 0x01;
+			want[voice][note >> 5] |= (1 << (note & 0x1f));
+		}
+		for(voice = 0; voice < 2 && errors < 5; voice ++) {
+			for(i = 0; i < 4 && voice_held[voice][i] == want[voice][i]; i ++);
+			if(i < 4) {
+				HARNESS_CHECK(0, "%d tracks: clock %d: voice %d holds %08x%08x%08x%08x - "
+					"wanted %08x%08x%08x%08x", tracks, pos, voice, voice_held[voice][3],
+					voice_held[voice][2], voice_held[voice][1], voice_held[voice][0],
+					want[voice][3], want[voice][2], want[voice][1], want[voice][0]);
+				errors ++;
+			}
+		}
+	}
+
+	// stop at the end of the loop
+	test_sw(1, 1, 0);
+	test_sw(1, 0, 500);
+}
+
+// sort doubles
+int test_cmp(const void *a, const void *b) {
+	double da = *(const double *)a;
+	double db = *(const double *)b;
+	return (da > db) - (da < db);
+}
+
+// print the clock tick time percentiles and check the budget - returns the median
+// - there are too few ticks for the 99.9th percentile to leave out the host
+double test_report(int tracks, double *ns, int num) {
+	double p99;
+	qsort(ns, num, sizeof(double), test_cmp);
+	p99 = ns[(num * 99) / 100];
+	fprintf(stderr, "seq_track_test: %d tracks - %d bytes - %d events / clock: host clock "
+		"tick time median %.0fns - p99 %.0fns - p99.9 %.0fns - longest %.0fns\n", tracks,
+		seq_play_size, TEST_CHORD * 2, ns[num / 2], p99, ns[(num * 999) / 1000], ns[num - 1]);
+	HARNESS_CHECK(p99 <= TEST_TICK_BUDGET_NS, "%d tracks: p99 tick time %.0fns is over %dns",
+		tracks, p99, TEST_TICK_BUDGET_NS);
+	return ns[num / 2];
+}
@@ -0,0 +1,376 @@
+/*
+ * K65 Phenol - Simulator MIDI File Player
+ *
+ * Copyright 2015: Andrew Kilpatrick
+ * Written by: Andrew Kilpatrick
+ *
+ * Reads a type 0 or 1 standard MIDI file into one list of messages in
+ * time order, with the tracks merged and the tempo map applied. Channel
+ * messages are stored with their status byte even where the file uses
+ * running status. Sysex is stored with its F0 and F7 escapes are stored
+ * as they are. Meta events other than tempo are dropped.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sim_midi.h"
+
+// a tempo change
+struct sim_midi_tempo {
+	int64_t tick;
+	int64_t us_per_beat;
+	int order;  // to keep changes on the same tick in file order
+};
+
+// file
+unsigned char *sim_midi_file;
+long sim_midi_file_len;
+int sim_midi_division;  // ticks per beat
+
+// events - times are in ticks until they are all read
+struct sim_midi_event *sim_midi_events;
+int sim_midi_num_events;
+int sim_midi_max_events;
+int *sim_midi_order;  // order read - for sorting the same tick in file order
+unsigned char *sim_midi_bytes;  // message bytes
+long sim_midi_num_bytes;
+long sim_midi_max_bytes;
+struct sim_midi_tempo *sim_midi_tempos;
+int sim_midi_num_tempos;
+int sim_midi_max_tempos;
+int64_t sim_midi_end_tick;
+int64_t sim_midi_end_time;
+
+// playback
+int sim_midi_pos;
+int sim_midi_loop;
+int64_t sim_midi_loop_base;  // start time of the current pass
+
+// local functions
+int sim_midi_track(long pos, long len);
+int sim_midi_add(int64_t tick, const unsigned char *pre, int pre_len,
+	const unsigned char *data, long len);
+int sim_midi_vlq(long *pos, long end, long *val);
+int sim_midi_cmp(const void *a, const void *b);
+int sim_midi_tempo_cmp(const void *a, const void *b);
+int64_t sim_midi_tick_to_us(int64_t tick, int *tempo, int64_t *base_tick, int64_t *base_us);
+void *sim_midi_grow(void *p, int count, int *max, size_t size);
+
+// load a standard MIDI file - type 0 or 1 - returns the number of events or -1 on error
+int sim_midi_load(const char *path) {
+	FILE *f;
+	long pos, len;
+	int format, tracks, i, tempo;
+	int64_t base_tick, base_us;
+	uint32_t *offsets;
+	struct sim_midi_event *sorted;
+
+	f = fopen(path, "rb");
+	if(f == NULL) {
+		perror(path);
+		return -1;
+	}
+	fseek(f, 0, SEEK_END);
+	sim_midi_file_len = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	sim_midi_file = malloc(sim_midi_file_len + 1);
+	if(sim_midi_file == NULL ||
+			fread(sim_midi_file, 1, sim_midi_file_len, f) != (size_t)sim_midi_file_len) {
+		fprintf(stderr, "%s: can't read the file\n", path);
+		fclose(f);
+		return -1;
+	}
+	fclose(f);
+
+	// header
+	if(sim_midi_file_len < 14 || memcmp(sim_midi_file, "MThd", 4) != 0) {
+		fprintf(stderr, "%s: not a MIDI file\n", path);
+		return -1;
+	}
+	len = (sim_midi_file[4] << 24) | (sim_midi_file[5] << 16) |
+		(sim_midi_file[6] << 8) | sim_midi_file[7];
+	format = (sim_midi_file[8] << 8) | sim_midi_file[9];
+	tracks = (sim_midi_file[10] << 8) | sim_midi_file[11];
+	sim_midi_division = (sim_midi_file[12] << 8) | sim_midi_file[13];
+	if(format > 1) {
+		fprintf(stderr, "%s: type %d files are not supported\n", path, format);
+		return -1;
+	}
+	if(sim_midi_division & 0x8000 || sim_midi_division == 0) {
+		fprintf(stderr, "%s: SMPTE time is not supported\n", path);
+		return -1;
+	}
+
+	// tracks
+	sim_midi_num_events = 0;
+	sim_midi_num_bytes = 0;
+	sim_midi_num_tempos = 0;
+	sim_midi_end_tick = 0;
+	pos = 8 + len;
+	for(i = 0; i < tracks; i ++) {
+		if(pos + 8 > sim_midi_file_len) {
+			fprintf(stderr, "%s: file ends before track %d\n", path, i);
+			return -1;
+		}
+		len = (sim_midi_file[pos + 4] << 24) | (sim_midi_file[pos + 5] << 16) |
+			(sim_midi_file[pos + 6] << 8) | sim_midi_file[pos + 7];
+		if(pos + 8 + len > sim_midi_file_len) {
+			fprintf(stderr, "%s: track %d runs past the end of the file\n", path, i);
+			return -1;
+		}
+		// skip chunks that aren't tracks
+		if(memcmp(&sim_midi_file[pos], "MTrk", 4) == 0 &&
+				sim_midi_track(pos + 8, len) < 0) {
+			fprintf(stderr, "%s: track %d is damaged\n", path, i);
+			return -1;
+		}
+		pos += 8 + len;
+	}
+
+	// put the tracks together in time order and change ticks to us
+	offsets = malloc(sizeof(uint32_t) * (sim_midi_num_events + 1));
+	for(i = 0; i < sim_midi_num_events; i ++) {
+		offsets[i] = (uint32_t)(uintptr_t)sim_midi_events[i].data;  // byte offset while reading
+	}
+	sim_midi_order = malloc(sizeof(int) * (sim_midi_num_events + 1));
+	for(i = 0; i < sim_midi_num_events; i ++) {
+		sim_midi_order[i] = i;
+	}
+	qsort(sim_midi_order, sim_midi_num_events, sizeof(int), sim_midi_cmp);
+	qsort(sim_midi_tempos, sim_midi_num_tempos, sizeof(struct sim_midi_tempo),
+		sim_midi_tempo_cmp);
+	sorted = malloc(sizeof(struct sim_midi_event) * (sim_midi_num_events + 1));
+	tempo = 0;
+	base_tick = 0;
+	base_us = 0;
+	for(i = 0; i < sim_midi_num_events; i ++) {
+		sorted[i] = sim_midi_events[sim_midi_order[i]];
+		sorted[i].data = sim_midi_bytes + offsets[sim_midi_order[i]];
+		sorted[i].time = sim_midi_tick_to_us(sorted[i].time, &tempo, &base_tick, &base_us);
+	}
+	free(sim_midi_events);
+	sim_midi_events = sorted;
+	sim_midi_end_time = sim_midi_tick_to_us(sim_midi_end_tick, &tempo, &base_tick, &base_us);
+	free(offsets);
+	free(sim_midi_order);
+
+	sim_midi_pos = 0;
+	sim_midi_loop = 0;
+	sim_midi_loop_base = 0;
+	return sim_midi_num_events;
+}
+
+// get the length of the loaded file in us - to the last end of track
+int64_t sim_midi_length(void) {
+	return sim_midi_end_time;
+}
+
+// play the file again from the start after its length - 0 = off, 1 = on
+void sim_midi_set_loop(int loop) {
+	sim_midi_loop = loop;
+}
+
+// get the next event due at or before a time in us - returns NULL if none
+struct sim_midi_event *sim_midi_next(int64_t time) {
+	struct sim_midi_event *ev;
+	if(sim_midi_pos == sim_midi_num_events) {
+		if(!sim_midi_loop || sim_midi_end_time <= 0 ||
+				time < sim_midi_loop_base + sim_midi_end_time) {
+			return NULL;
+		}
+		sim_midi_loop_base += sim_midi_end_time;
+		sim_midi_pos = 0;
+		if(sim_midi_num_events == 0) {
+			return NULL;
+		}
+	}
+	ev = &sim_midi_events[sim_midi_pos];
+	if(sim_midi_loop_base + ev->time > time) {
+		return NULL;
+	}
+	sim_midi_pos ++;
+	return ev;
+}
+
+//
+// local functions
+//
+// read the events from a track
+int sim_midi_track(long pos, long len) {
+	static const unsigned char sysex = 0xf0;
+	long end = pos + len, data_len, delta;
+	int64_t tick = 0;
+	unsigned char status = 0, type;
+	int num;
+
+	while(pos < end) {
+		if(sim_midi_vlq(&pos, end, &delta) < 0 || pos >= end) {
+			return -1;
+		}
+		tick += delta;
+		// status - or running status
+		if(sim_midi_file[pos] & 0x80) {
+			status = sim_midi_file[pos ++];
+		}
+		else if(status == 0) {
+			return -1;
+		}
+		switch(status) {
+			// meta event
+			case 0xff:
+				status = 0;
+				if(pos >= end) {
+					return -1;
+				}
+				type = sim_midi_file[pos ++];
+				if(sim_midi_vlq(&pos, end, &data_len) < 0 || pos + data_len > end) {
+					return -1;
+				}
+				// tempo
+				if(type == 0x51 && data_len == 3) {
+					sim_midi_tempos = sim_midi_grow(sim_midi_tempos,
+						sim_midi_num_tempos, &sim_midi_max_tempos, sizeof(struct sim_midi_tempo));
+					sim_midi_tempos[sim_midi_num_tempos].tick = tick;
+					sim_midi_tempos[sim_midi_num_tempos].us_per_beat =
+						(sim_midi_file[pos] << 16) | (sim_midi_file[pos + 1] << 8) |
+						sim_midi_file[pos + 2];
+					sim_midi_tempos[sim_midi_num_tempos].order = sim_midi_num_tempos;
+					sim_midi_num_tempos ++;
+				}
+				// end of track
+				else if(type == 0x2f) {
+					if(tick > sim_midi_end_tick) {
+						sim_midi_end_tick = tick;
+					}
+					return 0;
+				}
+				pos += data_len;
+				break;
+			// sysex - with F0 put back in front
+			case 0xf0:
+			// sysex escape - sent as it is
+			case 0xf7:
+				if(sim_midi_vlq(&pos, end, &data_len) < 0 || pos + data_len > end) {
+					return -1;
+				}
+				if(status == 0xf0) {
+					sim_midi_add(tick, &sysex, 1, &sim_midi_file[pos], data_len);
+				}
+				else if(data_len) {
+					sim_midi_add(tick, NULL, 0, &sim_midi_file[pos], data_len);
+				}
+				pos += data_len;
+				status = 0;
+				break;
+			// channel messages
+			default:
+				num = ((status & 0xf0) == 0xc0 || (status & 0xf0) == 0xd0) ? 1 : 2;
+				if(pos + num > end) {
+					return -1;
+				}
+				sim_midi_add(tick, &status, 1, &sim_midi_file[pos], num);
+				pos += num;
+				break;
+		}
+	}
+	// no end of track
+	if(tick > sim_midi_end_tick) {
+		sim_midi_end_tick = tick;
+	}
+	return 0;
+}
+
+// add a message - pre is put in front of the data
+int sim_midi_add(int64_t tick, const unsigned char *pre, int pre_len,
+		const unsigned char *data, long len) {
+	struct sim_midi_event *ev;
+	while(sim_midi_num_bytes + pre_len + len > sim_midi_max_bytes) {
+		sim_midi_max_bytes = (sim_midi_max_bytes * 2) + 4096;
+		sim_midi_bytes = realloc(sim_midi_bytes, sim_midi_max_bytes);
+		if(sim_midi_bytes == NULL) {
+			fprintf(stderr, "sim_midi: out of memory\n");
+			exit(1);
+		}
+	}
+	sim_midi_events = sim_midi_grow(sim_midi_events, sim_midi_num_events, &sim_midi_max_events,
+		sizeof(struct sim_midi_event));
+	ev = &sim_midi_events[sim_midi_num_events];
+	ev->time = tick;
+	ev->len = pre_len + len;
+	ev->data = (unsigned char *)(uintptr_t)sim_midi_num_bytes;  // byte offset until sorted
+	memcpy(sim_midi_bytes + sim_midi_num_bytes, pre, pre_len);
+	memcpy(sim_midi_bytes + sim_midi_num_bytes + pre_len, data, len);
+	sim_midi_num_bytes += pre_len + len;
+	sim_midi_num_events ++;
+	return 0;
+}
+
+// read a variable length number
+int sim_midi_vlq(long *pos, long end, long *val) {
+	int i;
+	*val = 0;
+	for(i = 0; i < 4; i ++) {
+		if(*pos >= end) {
+			return -1;
+		}
+		*val = (*val << 7) | (sim_midi_file[*pos] & 0x7f);
+		if(!(sim_midi_file[(*pos) ++] & 0x80)) {
+			return 0;
+		}
+	}
+	return -1;
+}
+
+// sort events by tick - then in the order they were read
+int sim_midi_cmp(const void *a, const void *b) {
+	const struct sim_midi_event *ea = &sim_midi_events[*(const int *)a];
+	const struct sim_midi_event *eb = &sim_midi_events[*(const int *)b];
+	if(ea->time != eb->time) {
+		return (ea->time > eb->time) - (ea->time < eb->time);
+	}
+	return *(const int *)a - *(const int *)b;
+}
+
+// sort tempo changes by tick - then in the order they were read
+int sim_midi_tempo_cmp(const void *a, const void *b) {
+	const struct sim_midi_tempo *ta = a;
+	const struct sim_midi_tempo *tb = b;
+	if(ta->tick != tb->tick) {
+		return (ta->tick > tb->tick) - (ta->tick < tb->tick);
+	}
+	return ta->order - tb->order;
+}
+
+// change a tick to us - ticks must be asked for in order
+// - tempo is the next tempo change and base is the time it was last used
+int64_t sim_midi_tick_to_us(int64_t tick, int *tempo, int64_t *base_tick, int64_t *base_us) {
+	int64_t us_per_beat = 500000;  // 120 BPM until the first tempo change
+	while(*tempo < sim_midi_num_tempos && sim_midi_tempos[*tempo].tick <= tick) {
+		if(*tempo) {
+			us_per_beat = sim_midi_tempos[*tempo - 1].us_per_beat;
+		}
+		*base_us += ((sim_midi_tempos[*tempo].tick - *base_tick) * us_per_beat) /
+			sim_midi_division;
+		*base_tick = sim_midi_tempos[*tempo].tick;
+		(*tempo) ++;
+	}
+	if(*tempo) {
+		us_per_beat = sim_midi_tempos[*tempo - 1].us_per_beat;
+	}
+	return *base_us + (((tick - *base_tick) * us_per_beat) / sim_midi_division);
+}
+
+// make room for one more entry in a list
+void *sim_midi_grow(void *p, int count, int *max, size_t size) {
+	if(count < *max) {
+		return p;
+	}
+	*max = (*max * 2) + 256;
+	p = realloc(p, *max * size);
+	if(p == NULL) {
+		fprintf(stderr, "sim_midi: out of memory\n");
+		exit(1);
+	}
+	return p;
+}
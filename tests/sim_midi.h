@@ -0,0 +1,32 @@
+/*
+ * K65 Phenol - Simulator MIDI File Player
+ *
+ * Copyright 2015: Andrew Kilpatrick
+ * Written by: Andrew Kilpatrick
+ *
+ */
+#ifndef SIM_MIDI_H
+#define SIM_MIDI_H
+
+#include <inttypes.h>
+
+// a MIDI message from the file
+struct sim_midi_event {
+	int64_t time;  // time from the start of the file in us
+	int len;  // bytes in the message
+	unsigned char *data;  // the message - status byte first
+};
+
+// load a standard MIDI file - type 0 or 1 - returns the number of events or -1 on error
+int sim_midi_load(const char *path);
+
+// get the length of the loaded file in us - to the last end of track
+int64_t sim_midi_length(void);
+
+// play the file again from the start after its length - 0 = off, 1 = on
+void sim_midi_set_loop(int loop);
+
+// get the next event due at or before a time in us - returns NULL if none
+struct sim_midi_event *sim_midi_next(int64_t time);
+
+#endif
@@ -0,0 +1,170 @@
+/*
+ * K65 Phenol - Simulator WAV Files
+ *
+ * Copyright 2015: Andrew Kilpatrick
+ * Written by: Andrew Kilpatrick
+ *
+ * Reads and writes 16 bit PCM WAV files. The header is written with
+ * zero sizes when the file is opened and filled in when it is closed.
+ * Samples are stored little endian whatever the host is.
+ *
+ */
+#include <string.h>
+#include "sim_wav.h"
+
+#define SIM_WAV_HEADER 44
+
+// local functions
+uint32_t sim_wav_get32(const unsigned char *buf);
+void sim_wav_put16(unsigned char *buf, int val);
+void sim_wav_put32(unsigned char *buf, uint32_t val);
+void sim_wav_header(struct sim_wav *wav);
+
+// open a file to read - returns 0 on success or -1 on error
+int sim_wav_open_read(struct sim_wav *wav, const char *path) {
+	unsigned char buf[16];
+	uint32_t len;
+	int format = 0, bits = 0;
+
+	memset(wav, 0, sizeof(struct sim_wav));
+	wav->f = fopen(path, "rb");
+	if(wav->f == NULL) {
+		perror(path);
+		return -1;
+	}
+	if(fread(buf, 1, 12, wav->f) != 12 || memcmp(buf, "RIFF", 4) != 0 ||
+			memcmp(&buf[8], "WAVE", 4) != 0) {
+		fprintf(stderr, "%s: not a WAV file\n", path);
+		goto fail;
+	}
+	// find the format and data chunks
+	while(fread(buf, 1, 8, wav->f) == 8) {
+		len = sim_wav_get32(&buf[4]);
+		if(memcmp(buf, "fmt ", 4) == 0) {
+			if(len < 16 || fread(buf, 1, 16, wav->f) != 16) {
+				break;
+			}
+			format = buf[0] | (buf[1] << 8);
+			wav->chans = buf[2] | (buf[3] << 8);
+			wav->rate = sim_wav_get32(&buf[4]);
+			bits = buf[14] | (buf[15] << 8);
+			len -= 16;
+		}
+		else if(memcmp(buf, "data", 4) == 0) {
+			// PCM or extensible
+			if((format != 1 && format != 0xfffe) || bits != 16 ||
+					wav->chans < 1 || wav->chans > SIM_WAV_MAXCHANS) {
+				fprintf(stderr, "%s: only 16 bit PCM with 1 to %d channels is supported\n",
+					path, SIM_WAV_MAXCHANS);
+				goto fail;
+			}
+			wav->length = len / (wav->chans * 2);
+			return 0;
+		}
+		// skip the rest of the chunk - chunks are padded to an even length
+		if(fseek(wav->f, len + (len & 1), SEEK_CUR) != 0) {
+			break;
+		}
+	}
+	fprintf(stderr, "%s: no audio data found\n", path);
+fail:
+	fclose(wav->f);
+	wav->f = NULL;
+	return -1;
+}
+
+// read a frame - returns 0 at the end of the file
+int sim_wav_read(struct sim_wav *wav, int16_t *frame) {
+	unsigned char buf[SIM_WAV_MAXCHANS * 2];
+	int i;
+	if(wav->f == NULL || wav->frames >= wav->length ||
+			fread(buf, 2, wav->chans, wav->f) != (size_t)wav->chans) {
+		return 0;
+	}
+	for(i = 0; i < wav->chans; i ++) {
+		frame[i] = (int16_t)(buf[i * 2] | (buf[(i * 2) + 1] << 8));
+	}
+	wav->frames ++;
+	return 1;
+}
+
+// open a file to write - returns 0 on success or -1 on error
+int sim_wav_open_write(struct sim_wav *wav, const char *path, int chans, int rate) {
+	memset(wav, 0, sizeof(struct sim_wav));
+	wav->f = fopen(path, "wb");
+	if(wav->f == NULL) {
+		perror(path);
+		return -1;
+	}
+	wav->chans = chans;
+	wav->rate = rate;
+	wav->writing = 1;
+	sim_wav_header(wav);
+	return 0;
+}
+
+// write a frame
+void sim_wav_write(struct sim_wav *wav, const int16_t *frame) {
+	unsigned char buf[SIM_WAV_MAXCHANS * 2];
+	int i;
+	if(wav->f == NULL) {
+		return;
+	}
+	for(i = 0; i < wav->chans; i ++) {
+		sim_wav_put16(&buf[i * 2], frame[i]);
+	}
+	fwrite(buf, 2, wav->chans, wav->f);
+	wav->frames ++;
+}
+
+// close a file - the sizes are filled in if it was written
+void sim_wav_close(struct sim_wav *wav) {
+	if(wav->f == NULL) {
+		return;
+	}
+	if(wav->writing) {
+		fseek(wav->f, 0, SEEK_SET);
+		sim_wav_header(wav);
+	}
+	fclose(wav->f);
+	wav->f = NULL;
+}
+
+//
+// local functions
+//
+// get a little endian 32 bit number
+uint32_t sim_wav_get32(const unsigned char *buf) {
+	return buf[0] | (buf[1] << 8) | (buf[2] << 16) | ((uint32_t)buf[3] << 24);
+}
+
+// put a little endian 16 bit number
+void sim_wav_put16(unsigned char *buf, int val) {
+	buf[0] = val & 0xff;
+	buf[1] = (val >> 8) & 0xff;
+}
+
+// put a little endian 32 bit number
+void sim_wav_put32(unsigned char *buf, uint32_t val) {
+	sim_wav_put16(buf, val & 0xffff);
+	sim_wav_put16(&buf[2], val >> 16);
+}
+
+// write the header for the frames written so far
+void sim_wav_header(struct sim_wav *wav) {
+	unsigned char buf[SIM_WAV_HEADER];
+	uint32_t data_len = wav->frames * wav->chans * 2;
+	memcpy(buf, "RIFF", 4);
+	sim_wav_put32(&buf[4], data_len + SIM_WAV_HEADER - 8);
+	memcpy(&buf[8], "WAVEfmt ", 8);
+	sim_wav_put32(&buf[16], 16);
+	sim_wav_put16(&buf[20], 1);  // PCM
+	sim_wav_put16(&buf[22], wav->chans);
+	sim_wav_put32(&buf[24], wav->rate);
+	sim_wav_put32(&buf[28], wav->rate * wav->chans * 2);
+	sim_wav_put16(&buf[32], wav->chans * 2);
+	sim_wav_put16(&buf[34], 16);
+	memcpy(&buf[36], "data", 4);
+	sim_wav_put32(&buf[40], data_len);
+	fwrite(buf, 1, SIM_WAV_HEADER, wav->f);
+}
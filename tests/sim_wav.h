@@ -0,0 +1,41 @@
+/*
+ * K65 Phenol - Simulator WAV Files
+ *
+ * Copyright 2015: Andrew Kilpatrick
+ * Written by: Andrew Kilpatrick
+ *
+ */
+#ifndef SIM_WAV_H
+#define SIM_WAV_H
+
+#include <stdio.h>
+#include <inttypes.h>
+
+#define SIM_WAV_MAXCHANS 8
+
+// a 16 bit PCM WAV file being read or written
+struct sim_wav {
+	FILE *f;
+	int chans;
+	int rate;
+	long frames;  // frames read or written so far
+	long length;  // frames in the file - reading only
+	int writing;
+};
+
+// open a file to read - returns 0 on success or -1 on error
+int sim_wav_open_read(struct sim_wav *wav, const char *path);
+
+// read a frame - returns 0 at the end of the file
+int sim_wav_read(struct sim_wav *wav, int16_t *frame);
+
+// open a file to write - returns 0 on success or -1 on error
+int sim_wav_open_write(struct sim_wav *wav, const char *path, int chans, int rate);
+
+// write a frame
+void sim_wav_write(struct sim_wav *wav, const int16_t *frame);
+
+// close a file - the sizes are filled in if it was written
+void sim_wav_close(struct sim_wav *wav);
+
+#endif
@@ -0,0 +1,24 @@
+/*
+ * K65 Phenol - Host Stand-In for GenericTypedefs.h
+ *
+ * Copyright 2015: Andrew Kilpatrick
+ * Written by: Andrew Kilpatrick
+ *
+ * Only the types used by the firmware headers that are built on the host.
+ *
+ */
+#ifndef GENERIC_TYPEDEFS_H
+#define GENERIC_TYPEDEFS_H
+
+typedef unsigned char BYTE;
+typedef unsigned short WORD;
+typedef unsigned int DWORD;
+typedef unsigned char UINT8;
+typedef unsigned short UINT16;
+typedef unsigned int UINT32;
+typedef signed char INT8;
+typedef short INT16;
+typedef int INT32;
+typedef enum { FALSE = 0, TRUE } BOOL;
+
+#endif
@@ -0,0 +1,27 @@
+/*
+ * K65 Phenol - Host Stand-In for dsplib_def.h
+ *
+ * Copyright 2015: Andrew Kilpatrick
+ * Written by: Andrew Kilpatrick
+ *
+ * The PIC32 DSP library helpers used by audio_proc.c, written in C with
+ * the same results.
+ *
+ */
+#ifndef DSPLIB_DEF_H
+#define DSPLIB_DEF_H
+
+#include <inttypes.h>
+
+typedef short int16;
+
+// saturate a 32 bit value to 16 bits
+#define SAT16(x) ((x) > 32767 ? 32767 : ((x) < -32768 ? -32768 : (x)))
+
+// multiply two Q15 values - -1 * -1 saturates to just under 1
+static inline int16 mul16(int16 a, int16 b) {
+	int32_t temp = ((int32_t)a * b) >> 15;
+	return SAT16(temp);
+}
+
+#endif
@@ -0,0 +1,192 @@
+/*
+ * K65 Phenol - Host Stand-In for the Mixer I/O
+ *
+ * Copyright 2015: Andrew Kilpatrick
+ * Written by: Andrew Kilpatrick
+ *
+ * Outputs that hold a state are traced when they change. Outputs that
+ * take a blink timeout are traced when a pulse starts. The mixer output
+ * LEDs and the MIDI in LED are not traced - they follow the audio and
+ * MIDI inputs, which are traced already.
+ *
+ */
+#include "GenericTypedefs.h"
+#include "harness.h"
+#include "mixer_io.h"
+#include "ioctl.h"
+#include "switch_filter.h"
+
+#define MIXER_IO_NUM_POTS 7
+#define MIXER_IO_SW_QUEUE 16
+#define MIXER_IO_DC_IN_OK 3000  // DC in sense with a good supply
+
+// audio streaming buffers - from audio_sys.c
+int16_t audio_rec_buf[AUDIO_BUF_SIZE];
+int16_t audio_play_buf[AUDIO_BUF_SIZE];
+int audio_stream_p;
+
+// inputs
+int mixer_io_pots[MIXER_IO_NUM_POTS];
+int mixer_io_divider_in;
+int mixer_io_sw_queue[MIXER_IO_SW_QUEUE];
+int mixer_io_sw_in_pos;
+int mixer_io_sw_out_pos;
+int mixer_io_power_sw;
+int mixer_io_dc_in;
+
+// outputs
+int mixer_io_power_ctrl;
+
+// init the fake I/O - pots are all set to 0
+void mixer_io_init(void) {
+	int i;
+	for(i = 0; i < MIXER_IO_NUM_POTS; i ++) {
+		mixer_io_pots[i] = 0;
+	}
+	for(i = 0; i < AUDIO_BUF_SIZE; i ++) {
+		audio_rec_buf[i] = 0;
+		audio_play_buf[i] = 0;
+	}
+	audio_stream_p = 0;
+	mixer_io_divider_in = 0;
+	mixer_io_sw_in_pos = 0;
+	mixer_io_sw_out_pos = 0;
+	mixer_io_power_sw = 0;
+	mixer_io_dc_in = MIXER_IO_DC_IN_OK;
+	mixer_io_power_ctrl = 0;
+}
+
+// set a pot value - 0-255
+void mixer_io_set_pot(int pot, int val) {
+	if(pot < 0 || pot >= MIXER_IO_NUM_POTS) {
+		return;
+	}
+	mixer_io_pots[pot] = val & 0xff;
+}
+
+// set the divider input - 0 = low, 1 = high
+void mixer_io_set_divider_in(int state) {
+	mixer_io_divider_in = state & 0x01;
+}
+
+// press or release a switch - queues a switch filter event
+void mixer_io_set_sw(int sw, int state) {
+	int next = (mixer_io_sw_in_pos + 1) & (MIXER_IO_SW_QUEUE - 1);
+	if(next == mixer_io_sw_out_pos) {
+		return;
+	}
+	if(state) {
+		mixer_io_sw_queue[mixer_io_sw_in_pos] = SW_CHANGE_PRESSED | sw;
+	}
+	else {
+		mixer_io_sw_queue[mixer_io_sw_in_pos] = SW_CHANGE_UNPRESSED | sw;
+	}
+	mixer_io_sw_in_pos = next;
+}
+
+// press or release the power switch - 0 = released, 1 = pressed
+void mixer_io_set_power_sw(int state) {
+	mixer_io_power_sw = state & 0x01;
+}
+
+// set the DC in sense value - 0-4095 - starts over the low voltage cutoff
+void mixer_io_set_dc_in(int val) {
+	mixer_io_dc_in = val & 0xfff;
+}
+
+// get the analog power control output - 0 = off, 1 = on
+int mixer_io_get_power_ctrl(void) {
+	return mixer_io_power_ctrl;
+}
+
+//
+// switch_filter.c
+//
+int switch_filter_get_event(void) {
+	int ev;
+	if(mixer_io_sw_in_pos == mixer_io_sw_out_pos) {
+		return 0;
+	}
+	ev = mixer_io_sw_queue[mixer_io_sw_out_pos];
+	mixer_io_sw_out_pos = (mixer_io_sw_out_pos + 1) & (MIXER_IO_SW_QUEUE - 1);
+	return ev;
+}
+
+//
+// TimeDelay.c
+//
+void DelayMs(UINT16 ms) {
+}
+
+//
+// ioctl.c
+//
+int ioctl_get_pot(unsigned char pot) {
+	if(pot >= MIXER_IO_NUM_POTS) {
+		return 0;
+	}
+	return mixer_io_pots[pot];
+}
+
+int ioctl_get_divider_in(void) {
+	return mixer_io_divider_in;
+}
+
+int ioctl_get_dc_vsense(void) {
+	return mixer_io_dc_in;
+}
+
+int ioctl_get_power_sw(void) {
+	return mixer_io_power_sw;
+}
+
+// not traced - the power control only runs in the simulator
+void ioctl_set_analog_power_ctrl(int state) {
+	mixer_io_power_ctrl = state & 0x01;
+}
+
+// traced when a blink starts with the LED off - timeout is in 250us units
+void ioctl_set_mixer_delay_led(int timeout) {
+	static int off_time = 0;
+	if(timeout == 0) {
+		return;
+	}
+	if(harness_get_time() >= off_time) {
+		harness_trace("delay_led %d", timeout);
+	}
+	off_time = harness_get_time() + (timeout >> 2);
+}
+
+void ioctl_set_mixer_output_leds(int left, int right) {
+}
+
+void ioctl_set_midi_in_led(int state) {
+}
+
+void ioctl_set_midi_rec_led(int state) {
+	harness_out("rec_led", 0, state);
+}
+
+void ioctl_set_midi_play_led(int state) {
+	harness_out("play_led", 0, state);
+}
+
+void ioctl_set_divider_outputs(int a, int b, int c, int d) {
+	harness_out("div_out", 0, (a << 3) | (b << 2) | (c << 1) | d);
+}
+
+void ioctl_set_midi_cv_out(int chan, int val) {
+	harness_out("cv_out", chan, val);
+}
+
+void ioctl_set_midi_gate_out(int state) {
+	harness_out("gate_out", 0, state);
+}
+
+void ioctl_set_midi_clock_out(int timeout) {
+	static int last = 0;
+	if(timeout || last) {
+		harness_trace("clock_out %d", timeout);
+	}
+	last = timeout;
+}
@@ -0,0 +1,43 @@
+/*
+ * K65 Phenol - Host Stand-In for the Mixer I/O
+ *
+ * Copyright 2015: Andrew Kilpatrick
+ * Written by: Andrew Kilpatrick
+ *
+ * Takes the place of ioctl.c, switch_filter.c, audio_sys.c and
+ * TimeDelay.c on the mixer. Inputs are set by the trace program and
+ * outputs are written to the trace.
+ *
+ */
+#ifndef MIXER_IO_H
+#define MIXER_IO_H
+
+#include <inttypes.h>
+#include "audio_sys.h"
+
+extern int16_t audio_rec_buf[AUDIO_BUF_SIZE];
+extern int16_t audio_play_buf[AUDIO_BUF_SIZE];
+extern int audio_stream_p;
+
+// init the fake I/O - pots are all set to 0
+void mixer_io_init(void);
+
+// set a pot value - 0-255
+void mixer_io_set_pot(int pot, int val);
+
+// set the divider input - 0 = low, 1 = high
+void mixer_io_set_divider_in(int state);
+
+// press or release a switch - queues a switch filter event
+void mixer_io_set_sw(int sw, int state);
+
+// press or release the power switch - 0 = released, 1 = pressed
+void mixer_io_set_power_sw(int state);
+
+// set the DC in sense value - 0-4095 - starts over the low voltage cutoff
+void mixer_io_set_dc_in(int val);
+
+// get the analog power control output - 0 = off, 1 = on
+int mixer_io_get_power_ctrl(void);
+
+#endif
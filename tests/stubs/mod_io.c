@@ -0,0 +1,185 @@
+/*
+ * K65 Phenol - Host Stand-In for the Mod I/O
+ *
+ * Copyright 2015: Andrew Kilpatrick
+ * Written by: Andrew Kilpatrick
+ *
+ * The DACs are written at the 10kHz sample rate, which is too much to
+ * trace line by line. Every write goes into a CRC instead and the trace
+ * program flushes it every few ms - so any change to any sample shows up
+ * as a different trace line.
+ *
+ */
+#include "harness.h"
+#include "mod_io.h"
+#include "ioctl.h"
+#include "dac.h"
+#include "switch_filter.h"
+
+#define MOD_IO_NUM_POTS 7
+#define MOD_IO_NUM_CVS 2
+#define MOD_IO_SW_QUEUE 16
+
+// inputs
+int mod_io_pots[MOD_IO_NUM_POTS];
+int mod_io_cvs[MOD_IO_NUM_CVS];
+int mod_io_gate_in[2];
+int mod_io_gate_sw[2];
+int mod_io_sw_queue[MOD_IO_SW_QUEUE];
+int mod_io_sw_in_pos;
+int mod_io_sw_out_pos;
+int mod_io_power_ctrl;
+
+// DAC outputs
+int mod_io_dacs[MOD_IO_NUM_DACS];
+uint32_t mod_io_dac_crc;
+int mod_io_dac_changed;
+
+// init the fake I/O - pots are all set to 0 and the power is on
+void mod_io_init(void) {
+	int i;
+	for(i = 0; i < MOD_IO_NUM_POTS; i ++) {
+		mod_io_pots[i] = 0;
+	}
+	for(i = 0; i < MOD_IO_NUM_CVS; i ++) {
+		mod_io_cvs[i] = 0;
+	}
+	for(i = 0; i < MOD_IO_NUM_DACS; i ++) {
+		mod_io_dacs[i] = 0;
+	}
+	mod_io_gate_in[0] = 0;
+	mod_io_gate_in[1] = 0;
+	mod_io_gate_sw[0] = 0;
+	mod_io_gate_sw[1] = 0;
+	mod_io_sw_in_pos = 0;
+	mod_io_sw_out_pos = 0;
+	mod_io_power_ctrl = 1;
+	mod_io_dac_crc = 0;
+	mod_io_dac_changed = 0;
+}
+
+// set a pot value - 0-255
+void mod_io_set_pot(int pot, int val) {
+	if(pot < 0 || pot >= MOD_IO_NUM_POTS) {
+		return;
+	}
+	mod_io_pots[pot] = val & 0xff;
+}
+
+// set a CV input value - 0-4095
+void mod_io_set_cv(int cv, int val) {
+	if(cv < 0 || cv >= MOD_IO_NUM_CVS) {
+		return;
+	}
+	mod_io_cvs[cv] = val & 0xfff;
+}
+
+// set a gate input - 0 = low, 1 = high
+void mod_io_set_gate_in(int chan, int state) {
+	mod_io_gate_in[chan & 0x01] = state & 0x01;
+}
+
+// set a gate switch - 0 = released, 1 = pressed
+void mod_io_set_gate_sw(int chan, int state) {
+	mod_io_gate_sw[chan & 0x01] = state & 0x01;
+}
+
+// press or release a mode switch - queues a switch filter event
+void mod_io_set_sw(int sw, int state) {
+	int next = (mod_io_sw_in_pos + 1) & (MOD_IO_SW_QUEUE - 1);
+	if(next == mod_io_sw_out_pos) {
+		return;
+	}
+	if(state) {
+		mod_io_sw_queue[mod_io_sw_in_pos] = SW_CHANGE_PRESSED | sw;
+	}
+	else {
+		mod_io_sw_queue[mod_io_sw_in_pos] = SW_CHANGE_UNPRESSED | sw;
+	}
+	mod_io_sw_in_pos = next;
+}
+
+// set the analog power control input from the mixer - 0 = off, 1 = on
+void mod_io_set_power_ctrl(int state) {
+	mod_io_power_ctrl = state & 0x01;
+}
+
+// trace the DAC outputs written since the last call - one line if any
+// DAC value changed - the line has a CRC of every write and the last values
+void mod_io_dac_flush(void) {
+	if(!mod_io_dac_changed) {
+		return;
+	}
+	harness_trace("dac %08x %d %d %d %d", mod_io_dac_crc, mod_io_dacs[0],
+		mod_io_dacs[1], mod_io_dacs[2], mod_io_dacs[3]);
+	mod_io_dac_crc = 0;
+	mod_io_dac_changed = 0;
+}
+
+//
+// switch_filter.c
+//
+int switch_filter_get_event(void) {
+	int ev;
+	if(mod_io_sw_in_pos == mod_io_sw_out_pos) {
+		return 0;
+	}
+	ev = mod_io_sw_queue[mod_io_sw_out_pos];
+	mod_io_sw_out_pos = (mod_io_sw_out_pos + 1) & (MOD_IO_SW_QUEUE - 1);
+	return ev;
+}
+
+//
+// dac.c
+//
+void dac_write_dac(unsigned char chan, unsigned int val) {
+	if(chan >= MOD_IO_NUM_DACS) {
+		return;
+	}
+	mod_io_dac_crc = harness_crc(mod_io_dac_crc, (chan << 16) | val);
+	if(mod_io_dacs[chan] != (int)val) {
+		mod_io_dacs[chan] = val;
+		mod_io_dac_changed = 1;
+	}
+}
+
+//
+// ioctl.c
+//
+int ioctl_get_pot(unsigned char pot) {
+	if(pot >= MOD_IO_NUM_POTS) {
+		return 0;
+	}
+	return mod_io_pots[pot];
+}
+
+int ioctl_get_cv(unsigned char cv) {
+	if(cv >= MOD_IO_NUM_CVS) {
+		return 0;
+	}
+	return mod_io_cvs[cv];
+}
+
+int ioctl_get_cv_fast(unsigned char cv) {
+	return ioctl_get_cv(cv);
+}
+
+int ioctl_get_gate_sw(int chan) {
+	return mod_io_gate_sw[chan & 0x01];
+}
+
+int ioctl_get_gate_in(int chan) {
+	return mod_io_gate_in[chan & 0x01];
+}
+
+int ioctl_get_analog_power_ctrl(void) {
+	return mod_io_power_ctrl;
+}
+
+void ioctl_set_gate_led(int chan, int state) {
+	harness_out("gate_led", chan, state);
+}
+
+void ioctl_set_mode_led(int chan, int led, int val) {
+	harness_out("mode_led", (chan * 3) + led, val);
+}
@@ -0,0 +1,44 @@
+/*
+ * K65 Phenol - Host Stand-In for the Mod I/O
+ *
+ * Copyright 2015: Andrew Kilpatrick
+ * Written by: Andrew Kilpatrick
+ *
+ * Takes the place of ioctl.c, switch_filter.c and dac.c on the mod
+ * processor. Inputs are set by the trace program and outputs are written
+ * to the trace.
+ *
+ */
+#ifndef MOD_IO_H
+#define MOD_IO_H
+
+#include <inttypes.h>
+
+#define MOD_IO_NUM_DACS 4
+
+// init the fake I/O - pots are all set to 0 and the power is on
+void mod_io_init(void);
+
+// set a pot value - 0-255
+void mod_io_set_pot(int pot, int val);
+
+// set a CV input value - 0-4095
+void mod_io_set_cv(int cv, int val);
+
+// set a gate input - 0 = low, 1 = high
+void mod_io_set_gate_in(int chan, int state);
+
+// set a gate switch - 0 = released, 1 = pressed
+void mod_io_set_gate_sw(int chan, int state);
+
+// press or release a mode switch - queues a switch filter event
+void mod_io_set_sw(int sw, int state);
+
+// set the analog power control input from the mixer - 0 = off, 1 = on
+void mod_io_set_power_ctrl(int state);
+
+// trace the DAC outputs written since the last call - one line if any
+// DAC value changed - the line has a CRC of every write and the last values
+void mod_io_dac_flush(void);
+
+#endif
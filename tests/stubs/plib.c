@@ -0,0 +1,230 @@
+/*
+ * K65 Phenol - Host Stand-In for plib.h
+ *
+ * Copyright 2015: Andrew Kilpatrick
+ * Written by: Andrew Kilpatrick
+ *
+ * Program flash is one host memory block mapped twice, at the kseg0 and
+ * kseg1 addresses, so code that reads flash through either view works
+ * unchanged. Writes can only clear bits and erases set a whole page back
+ * to 0xff, like the real flash. A power cut can be set up to happen at
+ * any write or erase for testing what is left behind.
+ *
+ * The core timer is set by the program running the firmware. It stands
+ * still between sets unless a scale is given - then the host time since
+ * the last set, times the scale, is added on.
+ *
+ * The ADC only converts when the program running the firmware asks it
+ * to, so it can read the result buffer at any point in the scan.
+ *
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "plib.h"
+#include "harness.h"
+
+#define PLIB_KSEG0 0x80000000
+#define PLIB_KSEG1 0xa0000000
+#define PLIB_CORE_NS 50.0  // core timer period - half the 40MHz system clock
+
+uint32_t *plib_flash;  // kseg1 view
+unsigned long plib_flash_writes;
+unsigned long plib_flash_erases;
+unsigned int plib_core_count;
+double plib_core_scale;
+double plib_core_ns;  // host time of the last set
+long plib_cut_ops = -1;
+int plib_cut_mode;
+void (*plib_cut_hook)(void);
+unsigned int CNPUA, CNPUB, ANSELB;
+struct plib_porta PORTAbits;
+struct plib_portb PORTBbits;
+struct plib_lata LATAbits;
+struct plib_latb LATBbits;
+struct plib_latc LATCbits;
+int plib_adc_pin[PLIB_ADC_INPUTS];
+unsigned int plib_adc_analog;
+int plib_adc_scan[PLIB_ADC_INPUTS];
+int plib_adc_num_scan;
+int plib_adc_samples;
+int plib_adc_buf[16];  // result buffer - ADC1BUF0-F
+int plib_adc_scan_pos;  // next input in the scan
+int plib_adc_buf_pos;  // next result slot
+
+// local functions
+void *plib_map(int fd, unsigned long addr);
+uint32_t *plib_flash_word(void *address);
+int plib_cut_now(void);
+
+// map the flash views before main runs
+__attribute__((constructor)) void plib_init(void) {
+	int fd = memfd_create("plib_flash", 0);
+	if(fd < 0 || ftruncate(fd, PLIB_FLASH_SIZE) != 0) {
+		perror("plib: flash");
+		exit(1);
+	}
+	plib_map(fd, PLIB_KSEG0 | PLIB_FLASH_BASE);
+	plib_flash = plib_map(fd, PLIB_KSEG1 | PLIB_FLASH_BASE);
+	close(fd);
+	plib_flash_reset();
+}
+
+void INTEnable(int source, int enable) {
+}
+
+unsigned int INTDisableInterrupts(void) {
+	return 0;
+}
+
+void INTRestoreInterrupts(unsigned int status) {
+}
+
+unsigned int _CP0_GET_COUNT(void) {
+	if(plib_core_scale > 0.0) {
+		return plib_core_count + (unsigned int)(((harness_now_ns() - plib_core_ns) *
+			plib_core_scale) / PLIB_CORE_NS);
+	}
+	return plib_core_count;
+}
+
+// write a word - can only clear bits
+unsigned int NVMWriteWord(void *address, unsigned int data) {
+	uint32_t *word = plib_flash_word(address);
+	plib_flash_writes ++;
+	if(plib_cut_now()) {
+		if(plib_cut_mode == PLIB_CUT_PART) {
+			*word &= data | 0xffff0000;
+		}
+		else if(plib_cut_mode == PLIB_CUT_DONE) {
+			*word &= data;
+		}
+		plib_cut_hook();
+	}
+	*word &= data;
+	return 0;
+}
+
+// erase the page holding an address
+unsigned int NVMErasePage(void *address) {
+	uint32_t *word = plib_flash_word(address);
+	uint32_t *page = plib_flash + ((word - plib_flash) & ~((PLIB_FLASH_PAGE_SIZE >> 2) - 1));
+	plib_flash_erases ++;
+	if(plib_cut_now()) {
+		if(plib_cut_mode == PLIB_CUT_PART) {
+			memset(page, 0xff, PLIB_FLASH_PAGE_SIZE >> 1);
+		}
+		else if(plib_cut_mode == PLIB_CUT_DONE) {
+			memset(page, 0xff, PLIB_FLASH_PAGE_SIZE);
+		}
+		plib_cut_hook();
+	}
+	memset(page, 0xff, PLIB_FLASH_PAGE_SIZE);
+	return 0;
+}
+
+// set the core timer - with a scale the host time taken since then is
+// added on, so the ISR load meters see the time the code takes
+void plib_core_set(unsigned int count) {
+	plib_core_count = count;
+	if(plib_core_scale > 0.0) {
+		plib_core_ns = harness_now_ns();
+	}
+}
+
+// erase all of flash
+void plib_flash_reset(void) {
+	memset(plib_flash, 0xff, PLIB_FLASH_SIZE);
+}
+
+// cut the power after a number of flash writes / erases
+void plib_flash_cut(long ops, int mode, void (*hook)(void)) {
+	plib_cut_ops = ops;
+	plib_cut_mode = mode;
+	plib_cut_hook = hook;
+}
+
+void PORTSetPinsDigitalOut(int port, unsigned int bits) {
+}
+
+void PORTSetPinsDigitalIn(int port, unsigned int bits) {
+}
+
+// set up the scan - the inputs that are not skipped are scanned
+void OpenADC10(unsigned int config1, unsigned int config2, unsigned int config3,
+		unsigned int configport, unsigned int configscan) {
+	int i;
+	plib_adc_analog = configport;
+	plib_adc_num_scan = 0;
+	for(i = 0; i < PLIB_ADC_INPUTS; i ++) {
+		if(!(configscan & (1 << i))) {
+			plib_adc_scan[plib_adc_num_scan ++] = i;
+		}
+	}
+	plib_adc_samples = ((config2 >> 2) & 0x0f) + 1;
+	plib_adc_scan_pos = 0;
+	plib_adc_buf_pos = 0;
+	for(i = 0; i < 16; i ++) {
+		plib_adc_buf[i] = 0;
+	}
+}
+
+// read a result slot
+unsigned int ReadADC10(unsigned int buf) {
+	return plib_adc_buf[buf & 0x0f];
+}
+
+// run a number of conversions - an input that is not set to analog
+// reads as 0
+void plib_adc_convert(int num) {
+	int an;
+	while(num -- > 0 && plib_adc_num_scan > 0) {
+		an = plib_adc_scan[plib_adc_scan_pos];
+		plib_adc_buf[plib_adc_buf_pos] = 0;
+		if(plib_adc_analog & (1 << an)) {
+			plib_adc_buf[plib_adc_buf_pos] = plib_adc_pin[an] & 0x3ff;
+		}
+		plib_adc_scan_pos = (plib_adc_scan_pos + 1) % plib_adc_num_scan;
+		plib_adc_buf_pos = (plib_adc_buf_pos + 1) % plib_adc_samples;
+	}
+}
+
+//
+// local functions
+//
+// map the flash memory at a fixed address
+void *plib_map(int fd, unsigned long addr) {
+	void *p = mmap((void *)addr, PLIB_FLASH_SIZE, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_FIXED_NOREPLACE, fd, 0);
+	if(p != (void *)addr) {
+		fprintf(stderr, "plib: can't map flash at 0x%08lx\n", addr);
+		exit(1);
+	}
+	return p;
+}
+
+// get the flash word for an address in kseg0 or kseg1
+uint32_t *plib_flash_word(void *address) {
+	unsigned int pa = KVA_TO_PA(address);
+	if(pa < PLIB_FLASH_BASE || pa >= (PLIB_FLASH_BASE + PLIB_FLASH_SIZE) || (pa & 3)) {
+		fprintf(stderr, "plib: bad flash address 0x%08x\n", pa);
+		exit(1);
+	}
+	return plib_flash + ((pa - PLIB_FLASH_BASE) >> 2);
+}
+
+// count down to a power cut - returns 1 if it happens now
+int plib_cut_now(void) {
+	if(plib_cut_ops < 0) {
+		return 0;
+	}
+	if(plib_cut_ops == 0) {
+		plib_cut_ops = -1;
+		return 1;
+	}
+	plib_cut_ops --;
+	return 0;
+}
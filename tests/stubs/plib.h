@@ -0,0 +1,138 @@
+/*
+ * K65 Phenol - Host Stand-In for plib.h
+ *
+ * Copyright 2015: Andrew Kilpatrick
+ * Written by: Andrew Kilpatrick
+ *
+ * Only the peripheral library calls used by the modules that are built
+ * on the host. Program flash is a host memory block mapped at the same
+ * kseg0 and kseg1 addresses as on the PIC32 so the flash store runs
+ * unchanged, and the ADC scans the pin levels set by the test into its
+ * result buffer like the real one - see plib.c.
+ *
+ */
+#ifndef PLIB_H
+#define PLIB_H
+
+#include <inttypes.h>
+
+// interrupts
+#define __ISR(vector, ipl)
+#define INT_DISABLED 0
+#define INT_ENABLED 1
+#define TMR1 1
+#define TMR2 2
+#define INT_SOURCE_TIMER(timer) (timer)
+void INTEnable(int source, int enable);
+unsigned int INTDisableInterrupts(void);
+void INTRestoreInterrupts(unsigned int status);
+#define ClearWDT()
+
+// core timer - counts at half the system clock
+unsigned int _CP0_GET_COUNT(void);
+
+// flash programming
+#define KVA_TO_PA(v) ((unsigned int)(uintptr_t)(v) & 0x1fffffff)
+#define PA_TO_KVA0(pa) ((pa) | 0x80000000)
+#define PA_TO_KVA1(pa) ((pa) | 0xa0000000)
+unsigned int NVMWriteWord(void *address, unsigned int data);
+unsigned int NVMErasePage(void *address);
+
+// ports - only the pins used by the mixer ioctl.c
+#define IOPORT_A 0
+#define IOPORT_B 1
+#define IOPORT_C 2
+#define BIT_0 (1 << 0)
+#define BIT_1 (1 << 1)
+#define BIT_5 (1 << 5)
+#define BIT_7 (1 << 7)
+#define BIT_8 (1 << 8)
+#define BIT_10 (1 << 10)
+void PORTSetPinsDigitalOut(int port, unsigned int bits);
+void PORTSetPinsDigitalIn(int port, unsigned int bits);
+extern unsigned int CNPUA, CNPUB, ANSELB;
+extern struct plib_porta { unsigned RA8:1, RA10:1; } PORTAbits;
+extern struct plib_portb { unsigned RB0:1, RB1:1; } PORTBbits;
+extern struct plib_lata { unsigned LATA7:1; } LATAbits;
+extern struct plib_latb { unsigned LATB5:1, LATB7:1; } LATBbits;
+extern struct plib_latc { unsigned LATC5:1, LATC7:1; } LATCbits;
+
+// ADC - the settings that matter to the model have their AD1CON bits
+#define ADC_MODULE_ON (1 << 15)
+#define ADC_IDLE_STOP (1 << 13)
+#define ADC_FORMAT_INTG 0
+#define ADC_CLK_AUTO (7 << 5)
+#define ADC_AUTO_SAMPLING_ON (1 << 2)
+#define ADC_SAMP_ON (1 << 1)
+#define ADC_VREF_AVDD_AVSS 0
+#define ADC_OFFSET_CAL_DISABLE 0
+#define ADC_SCAN_ON (1 << 10)
+#define ADC_SAMPLES_PER_INT_8 (7 << 2)
+#define ADC_SAMPLES_PER_INT_9 (8 << 2)
+#define ADC_BUF_16 0
+#define ADC_ALT_INPUT_OFF 0
+#define ADC_SAMPLE_TIME_16 (16 << 8)
+#define ADC_CONV_CLK_INTERNAL_RC (1 << 15)
+#define ADC_CONV_CLK_32Tcy 31
+#define ENABLE_AN0_ANA (1 << 0)
+#define ENABLE_AN4_ANA (1 << 4)
+#define ENABLE_AN5_ANA (1 << 5)
+#define ENABLE_AN6_ANA (1 << 6)
+#define ENABLE_AN7_ANA (1 << 7)
+#define ENABLE_AN8_ANA (1 << 8)
+#define ENABLE_AN11_ANA (1 << 11)
+#define ENABLE_AN12_ANA (1 << 12)
+#define SKIP_SCAN_AN1 (1 << 1)
+#define SKIP_SCAN_AN2 (1 << 2)
+#define SKIP_SCAN_AN3 (1 << 3)
+#define SKIP_SCAN_AN9 (1 << 9)
+#define SKIP_SCAN_AN10 (1 << 10)
+void OpenADC10(unsigned int config1, unsigned int config2, unsigned int config3,
+	unsigned int configport, unsigned int configscan);
+unsigned int ReadADC10(unsigned int buf);
+
+//
+// host only
+//
+// program flash model
+#define PLIB_FLASH_BASE 0x1d000000  // physical address of program flash
+#define PLIB_FLASH_SIZE 0x20000  // 128KB
+#define PLIB_FLASH_PAGE_SIZE 1024  // erase page size
+#define PLIB_CUT_NONE 0  // the cut off write / erase didn't happen
+#define PLIB_CUT_PART 1  // the cut off write / erase was half done
+#define PLIB_CUT_DONE 2  // the cut off write / erase finished
+extern uint32_t *plib_flash;  // program flash contents - kseg1 view
+extern unsigned long plib_flash_writes;  // words written since start
+extern unsigned long plib_flash_erases;  // pages erased since start
+extern unsigned int plib_core_count;  // core timer value
+extern double plib_core_scale;  // PIC32 time per host time - 0 = the core timer only moves when set
+
+// set the core timer - with a scale the host time taken since then is
+// added on, so the ISR load meters see the time the code takes
+void plib_core_set(unsigned int count);
+
+// erase all of flash
+void plib_flash_reset(void);
+
+// cut the power after a number of flash writes / erases
+// - ops = 0 cuts on the next one - -1 turns it off
+// - mode is one of PLIB_CUT_ - the hook is called in place of returning
+//   from the cut off write and must not return (eg. longjmp out)
+void plib_flash_cut(long ops, int mode, void (*hook)(void));
+
+// ADC model - the scan goes through the inputs that are not skipped,
+// lowest first, and fills the result buffer from slot 0, going back to
+// slot 0 after the number of samples per interrupt - the scan and the
+// buffer go around on their own, so each slot only holds one input if
+// the scan is as long as the samples per interrupt
+#define PLIB_ADC_INPUTS 13  // AN0-AN12 on the 44 pin parts
+extern int plib_adc_pin[PLIB_ADC_INPUTS];  // pin levels - 10 bit
+extern unsigned int plib_adc_analog;  // inputs set to analog by OpenADC10
+extern int plib_adc_scan[PLIB_ADC_INPUTS];  // inputs in scan order
+extern int plib_adc_num_scan;  // inputs in the scan
+extern int plib_adc_samples;  // samples per interrupt - result slots used
+
+// run a number of conversions
+void plib_adc_convert(int num);
+
+#endif
@@ -0,0 +1,371 @@
+/*
+ * K65 Phenol - Telemetry Test
+ *
+ * Copyright 2015: Andrew Kilpatrick
+ * Written by: Andrew Kilpatrick
+ *
+ * Runs the whole mixer firmware with the analog inputs moving, notes coming
+ * in and an external MIDI clock. Telemetry is turned on with the same set rate
+ * message that tools/telem_dump.c sends, and the USB MIDI out is taken
+ * byte by byte into the decoder from tools/telem_dump.c itself:
+ *	- after every frame the decoder must hold the values that the
+ *	  firmware sent in it, with a key frame every 16 frames
+ *	- with the USB MIDI out not taken, frames are dropped once the TX
+ *	  buffer can't hold the largest frame - the seq doesn't move for a
+ *	  dropped frame, so the decoder must stay in sync without losing a
+ *	  frame and the drops field must count them
+ *	- a frame lost on the way to the host must be counted as lost, and
+ *	  the decoder has no values until the next key frame, where they must
+ *	  be right again
+ *
+ * The host time of telem_timer_task is printed for ticks with no frame,
+ * with a delta frame and with a key frame. The firmware's own calls are
+ * held off while it is timed, so only the timed calls make frames. The
+ * 99th percentile of the key frames - the biggest ones - must stay inside
+ * a fixed budget.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include "harness.h"
+#include "mixer_run.h"
+#include "midi.h"
+#include "phenol_midi.h"
+#include "analog_filter.h"
+#include "telem.h"
+
+// the decoder from tools/telem_dump.c - with its main renamed
+#define main telem_dump_main
+#include "tools/telem_dump.c"
+#undef main
+
+#define TEST_CLOCK_US 20000  // 125 BPM
+#define TEST_PERIOD 10  // ms between frames
+#define TEST_KEY_INTERVAL 16  // TELEM_KEY_INTERVAL in telem.c
+#define TEST_NUM_SEQ 128  // frame seq numbers
+#define TEST_FRAMES 200  // frames checked in each part
+#define TEST_BENCH_FRAMES 2000  // frames timed
+#define TEST_FRAME_BUDGET_NS 20000  // for the 99th percentile of key frames
+
+// telemetry state in telem.c
+extern int telem_period;
+extern int telem_count;
+extern int telem_seq;
+extern int telem_key_count;
+extern int telem_drops;
+extern int telem_last[];
+
+int test_sent[TEST_NUM_SEQ][TELEM_NUM_FIELDS];  // values in each frame sent - by seq
+int test_key[TEST_NUM_SEQ];  // 1 = the frame was a key frame
+int test_seq;  // seq of the next frame sent
+int test_num_sent;  // frames sent
+int test_last_key;  // frame number of the last key frame - -1 = none yet
+int test_moved;  // fields that changed between frames - 1 bit each
+int test_level[ANALOG_CHANS];  // analog input levels - 12 bit
+int test_drain = 1;  // 1 = take the USB MIDI out into the decoder
+int test_lose;  // frames to lose on the way to the decoder
+int test_losing;  // 1 = in a frame that is being lost
+int test_frame_len;  // bytes in the frame being received
+long test_bytes[2];  // bytes in delta and key frames received
+long test_frames[2];  // delta and key frames received
+int test_bad;  // value errors printed
+uint32_t test_rand_state = 1;
+double test_ns[3][TEST_BENCH_FRAMES];  // no frame, delta frames, key frames
+int test_num_ns[3];
+
+// local functions
+void test_hook(const char *line);
+uint32_t test_rand(void);
+void test_midi(int len, ...);
+void test_run_ms(int ms);
+void test_sent_frame(void);
+void test_receive(void);
+void test_check_frame(void);
+void test_set_rate(int period);
+void test_run(void);
+void test_drop(void);
+void test_resync(void);
+void test_bench(void);
+int test_cmp(const void *a, const void *b);
+void test_report(const char *what, double *ns, int num);
+
+int main(int argc, char *argv[]) {
+	harness_set_trace_hook(test_hook);
+	// telem_dump prints every frame it decodes
+	if(freopen("/dev/null", "w", stdout) == NULL) {
+		HARNESS_CHECK(0, "can't send stdout to /dev/null");
+	}
+	telem_dump_len = -1;
+	test_last_key = -1;
+	mixer_run_init();
+	test_run_ms(5000);  // startup settings time
+	mixer_run_clock(TEST_CLOCK_US);
+	test_midi(1, 0xfa);
+	test_set_rate(TEST_PERIOD);
+
+	test_run();
+	test_drop();
+	test_resync();
+	test_bench();
+	return harness_done("telem_test");
+}
+
+//
+// local functions
+//
+// the outputs are not looked at - keep the trace off stdout
+void test_hook(const char *line) {
+}
+
+// repeatable random numbers
+uint32_t test_rand(void) {
+	test_rand_state ^= test_rand_state << 13;
+	test_rand_state ^= test_rand_state >> 17;
+	test_rand_state ^= test_rand_state << 5;
+	return test_rand_state;
+}
+
+// send MIDI bytes
+void test_midi(int len, ...) {
+	va_list ap;
+	int i;
+	va_start(ap, len);
+	for(i = 0; i < len; i ++) {
+		mixer_run_midi_send(va_arg(ap, int));
+	}
+	va_end(ap);
+}
+
+// run the firmware for a while - an analog input moves every 20ms and a
+// note is played or let go every 50ms
+// - stubs/mixer_io.c doesn't run the analog filter, so it is fed every 1ms
+//   like ioctl.c does
+void test_run_ms(int ms) {
+	int i, chan;
+	for(i = 0; i < ms; i ++) {
+		if((mixer_run_get_tick() % 80) == 0) {
+			test_level[test_rand() % ANALOG_CHANS] = test_rand() & 0xfff;
+		}
+		for(chan = 0; chan < ANALOG_CHANS; chan ++) {
+			analog_filter_set_val(chan, test_level[chan]);
+		}
+		if((mixer_run_get_tick() % 200) == 0) {
+			test_midi(3, 0x90, 48 + (test_rand() % 24), (test_rand() & 0x01) ? 0x64 : 0x00);
+		}
+		mixer_run_tick();
+		mixer_run_tick();
+		mixer_run_tick();
+		mixer_run_tick();
+		test_sent_frame();
+		if(test_drain) {
+			test_receive();
+		}
+	}
+}
+
+// keep the values of a frame that was just made
+void test_sent_frame(void) {
+	int i, seq;
+	if(telem_seq == test_seq) {
+		return;
+	}
+	seq = test_seq;
+	for(i = 0; i < TELEM_NUM_FIELDS; i ++) {
+		if(telem_last[i] != test_sent[(seq - 1) & 0x7f][i]) {
+			test_moved |= (1 << i);
+		}
+		test_sent[seq][i] = telem_last[i];
+	}
+	// the key count has moved on from 0
+	test_key[seq] = (telem_key_count == 1);
+	if(test_key[seq]) {
+		if(test_last_key >= 0) {
+			HARNESS_CHECK(test_num_sent - test_last_key == TEST_KEY_INTERVAL, "key frame %d "
+				"came %d frames after the last one", seq, test_num_sent - test_last_key);
+		}
+		test_last_key = test_num_sent;
+	}
+	test_seq = telem_seq;
+	test_num_sent ++;
+}
+
+// take the USB MIDI out into the decoder - frames can be lost on the way
+void test_receive(void) {
+	unsigned char b;
+	long frames;
+	while(midi_tx_avail(MIDI_PORT_USB)) {
+		b = midi_tx_get_byte(MIDI_PORT_USB);
+		if(b == 0xf0 && test_lose) {
+			test_lose --;
+			test_losing = 1;
+		}
+		if(test_losing) {
+			if(b == 0xf7) {
+				test_losing = 0;
+			}
+			continue;
+		}
+		if(b == 0xf0) {
+			test_frame_len = 0;
+		}
+		test_frame_len ++;
+		frames = telem_dump_frames;
+		telem_dump_byte(b);
+		if(telem_dump_frames != frames) {
+			test_check_frame();
+		}
+	}
+}
+
+// check the values the decoder has after a frame
+void test_check_frame(void) {
+	int i, seq = (telem_dump_next_seq - 1) & 0x7f;
+	test_bytes[test_key[seq]] += test_frame_len;
+	test_frames[test_key[seq]] ++;
+	if(!telem_dump_synced) {
+		return;
+	}
+	for(i = 0; i < TELEM_NUM_FIELDS && test_bad < 5; i ++) {
+		if(telem_dump_vals[i] != test_sent[seq][i]) {
+			HARNESS_CHECK(0, "frame %d: %s is %d - %d was sent", seq, telem_dump_names[i],
+				telem_dump_vals[i], test_sent[seq][i]);
+			test_bad ++;
+		}
+	}
+}
+
+// send the set rate message on the DIN MIDI in - like telem_dump -rate
+void test_set_rate(int period) {
+	test_midi(9, 0xf0, 0x00, 0x01, 0x72, TELEM_DUMP_DEV_ID, TELEM_CMD_SET_RATE,
+		period & 0x7f, (period >> 7) & 0x7f, 0xf7);
+}
+
+// every frame sent is decoded with the values in it
+void test_run(void) {
+	long frames = telem_dump_frames;
+	int sent = test_num_sent;
+	test_run_ms(TEST_FRAMES * TEST_PERIOD);
+	fprintf(stderr, "telem_test: %ld frames - delta frames %.1f bytes - key frames "
+		"%.1f bytes - largest can be %d\n", telem_dump_frames - frames,
+		(double)test_bytes[0] / test_frames[0], (double)test_bytes[1] / test_frames[1],
+		TELEM_MAX_FRAME + 2);
+	HARNESS_CHECK(test_num_sent - sent >= TEST_FRAMES - 1 &&
+		telem_dump_frames - frames == test_num_sent - sent,
+		"%d frames sent - %ld decoded", test_num_sent - sent, telem_dump_frames - frames);
+	HARNESS_CHECK(telem_dump_synced && telem_dump_lost == 0, "decoder synced %d - %ld lost",
+		telem_dump_synced, telem_dump_lost);
+	HARNESS_CHECK((test_moved & ((1 << ANALOG_CHANS) - 1)) == ((1 << ANALOG_CHANS) - 1) &&
+		(test_moved & (1 << TELEM_FIELD_TEMPO)), "fields that moved: %07x", test_moved);
+}
+
+// let the TX buffer fill so frames are dropped
+void test_drop(void) {
+	long frames = telem_dump_frames;
+	int i, drops = telem_drops, sent = test_num_sent;
+
+	test_drain = 0;
+	for(i = 0; i < 100 * TEST_PERIOD && telem_drops < drops + 3; i ++) {
+		test_run_ms(1);
+	}
+	HARNESS_CHECK(telem_drops >= drops + 3, "%d frames dropped with the TX buffer not taken",
+		telem_drops - drops);
+	HARNESS_CHECK(midi_tx_room(MIDI_PORT_USB) < TELEM_MAX_FRAME + 2, "dropped with %d bytes "
+		"of room", midi_tx_room(MIDI_PORT_USB));
+	test_drain = 1;
+	test_run_ms(TEST_FRAMES * TEST_PERIOD);
+	fprintf(stderr, "telem_test: %d frames dropped - %ld frames decoded - %ld lost\n",
+		telem_drops - drops, telem_dump_frames - frames, telem_dump_lost);
+	HARNESS_CHECK(telem_dump_frames - frames == test_num_sent - sent, "%d frames sent - "
+		"%ld decoded", test_num_sent - sent, telem_dump_frames - frames);
+	HARNESS_CHECK(telem_dump_synced && telem_dump_lost == 0, "decoder synced %d - %ld lost",
+		telem_dump_synced, telem_dump_lost);
+	HARNESS_CHECK(telem_dump_vals[TELEM_FIELD_DROPS] == telem_drops, "drops field is %d - "
+		"%d were dropped", telem_dump_vals[TELEM_FIELD_DROPS], telem_drops);
+}
+
+// lose the frame after a key frame and sync again on the next one
+void test_resync(void) {
+	long lost = telem_dump_lost;
+	int i, sent, frames;
+
+	// wait for a key frame
+	for(i = 0; i < TEST_KEY_INTERVAL * TEST_PERIOD * 2; i ++) {
+		sent = test_num_sent;
+		test_run_ms(1);
+		if(test_num_sent != sent && test_key[(test_seq - 1) & 0x7f]) {
+			break;
+		}
+	}
+	test_lose = 1;
+	sent = test_num_sent;
+	for(i = 0; i < TEST_KEY_INTERVAL * TEST_PERIOD * 2 && telem_dump_synced; i ++) {
+		test_run_ms(1);
+	}
+	HARNESS_CHECK(!telem_dump_synced && telem_dump_lost == lost + 1, "decoder synced %d - "
+		"%ld lost after losing a frame", telem_dump_synced, telem_dump_lost - lost);
+	for(i = 0; i < TEST_KEY_INTERVAL * TEST_PERIOD * 2 && !telem_dump_synced; i ++) {
+		test_run_ms(1);
+	}
+	frames = test_num_sent - sent;
+	fprintf(stderr, "telem_test: lost the frame after a key frame - synced again "
+		"%d frames later\n", frames);
+	HARNESS_CHECK(telem_dump_synced && frames == TEST_KEY_INTERVAL && test_key[(test_seq - 1) & 0x7f],
+		"synced %d after %d frames", telem_dump_synced, frames);
+
+	// and stays right
+	sent = test_num_sent;
+	test_run_ms(TEST_FRAMES * TEST_PERIOD);
+	HARNESS_CHECK(telem_dump_synced && telem_dump_lost == lost + 1, "decoder synced %d - "
+		"%ld lost", telem_dump_synced, telem_dump_lost - lost);
+}
+
+// time telem_timer_task with no frame, a delta frame and a key frame
+void test_bench(void) {
+	double start, ns;
+	int f, key;
+
+	for(f = 0; f < TEST_BENCH_FRAMES; f ++) {
+		// the firmware runs with no frames in between
+		telem_period = 0;
+		test_run_ms(TEST_PERIOD);
+		telem_period = TEST_PERIOD;
+
+		telem_count = 0;
+		start = harness_now_ns();
+		telem_timer_task();
+		test_ns[0][test_num_ns[0] ++] = harness_now_ns() - start;
+
+		key = (telem_key_count == 0);
+		telem_count = TEST_PERIOD - 1;
+		start = harness_now_ns();
+		telem_timer_task();
+		ns = harness_now_ns() - start;
+		test_ns[1 + key][test_num_ns[1 + key] ++] = ns;
+		test_sent_frame();
+		test_receive();
+	}
+	HARNESS_CHECK(telem_dump_synced && telem_dump_frames + telem_dump_lost == test_num_sent,
+		"decoder synced %d - %ld of %d frames decoded - %ld lost", telem_dump_synced,
+		telem_dump_frames, test_num_sent, telem_dump_lost);
+	test_report("no frame", test_ns[0], test_num_ns[0]);
+	test_report("delta frame", test_ns[1], test_num_ns[1]);
+	test_report("key frame", test_ns[2], test_num_ns[2]);
+	HARNESS_CHECK(test_ns[2][(test_num_ns[2] * 99) / 100] <= TEST_FRAME_BUDGET_NS,
+		"p99 key frame time %.0fns is over %dns", test_ns[2][(test_num_ns[2] * 99) / 100],
+		TEST_FRAME_BUDGET_NS);
+}
+
+// sort doubles
+int test_cmp(const void *a, const void *b) {
+	double da = *(const double *)a;
+	double db = *(const double *)b;
+	return (da > db) - (da < db);
+}
+
+// sort and print the times
+void test_report(const char *what, double *ns, int num) {
+	qsort(ns, num, sizeof(double), test_cmp);
+	fprintf(stderr, "telem_test: %-11s %4d calls - host time median %.0fns - p99 %.0fns - "
+		"longest %.0fns\n", what, num, ns[num / 2], ns[(num * 99) / 100], ns[num - 1]);
+}
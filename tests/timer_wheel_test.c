@@ -0,0 +1,239 @@
+/*
+ * K65 Phenol - Timer Wheel Test
+ *
+ * Copyright 2015: Andrew Kilpatrick
+ * Written by: Andrew Kilpatrick
+ *
+ * Runs the timer wheel against a plain countdown per timer for a long
+ * run of random starts, restarts and stops, with delays and periods over
+ * the whole range so both wheel levels and the cascade are used. Every
+ * tick the wheel must call exactly the timers the countdowns say are due.
+ * Timers due on the same tick within level 0 must be called in the order
+ * they were started, and two runs of the same inputs must give the same
+ * calls.
+ *
+ * The cost per tick is printed against the number of running timers,
+ * next to the cost of decrementing the same number of countdowns.
+ *
+ */
+#include <stdio.h>
+#include <string.h>
+#include "harness.h"
+#include "timer_wheel.h"
+
+#define TEST_TICKS 1000000
+
+// the countdown model of a timer
+struct test_timer {
+	int count;  // ticks until due - 0 = stopped
+	int period;
+};
+
+struct test_timer test_model[TIMER_WHEEL_MAX_TIMERS];
+int test_handles[TIMER_WHEEL_MAX_TIMERS];
+uint32_t test_called;  // timers called this tick - one bit each
+uint32_t test_log_crc;  // CRC of every call
+int test_order[TIMER_WHEEL_MAX_TIMERS];
+int test_order_count;
+volatile int test_sink;
+uint32_t test_rand_state = 1;
+
+// local functions
+uint32_t test_rand(void);
+void test_expire(int arg);
+void test_order_expire(int arg);
+void test_bench_expire(int arg);
+uint32_t test_random_run(uint32_t seed);
+void test_same_tick_order(void);
+void test_bench(void);
+
+int main(int argc, char *argv[]) {
+	uint32_t crc1, crc2;
+
+	crc1 = test_random_run(1);
+	crc2 = test_random_run(1);
+	HARNESS_CHECK(crc1 == crc2, "two runs of the same inputs gave different calls");
+	test_random_run(12345);
+	test_same_tick_order();
+	test_bench();
+	return harness_done("timer_wheel_test");
+}
+
+//
+// local functions
+//
+// repeatable random numbers
+uint32_t test_rand(void) {
+	test_rand_state ^= test_rand_state << 13;
+	test_rand_state ^= test_rand_state >> 17;
+	test_rand_state ^= test_rand_state << 5;
+	return test_rand_state;
+}
+
+// timer callback - logs the call
+void test_expire(int arg) {
+	test_called |= (1 << arg);
+	test_log_crc = harness_crc(test_log_crc, arg);
+}
+
+// timer callback - logs the order of the calls
+void test_order_expire(int arg) {
+	if(test_order_count < TIMER_WHEEL_MAX_TIMERS) {
+		test_order[test_order_count] = arg;
+	}
+	test_order_count ++;
+}
+
+// timer callback - for the benchmark
+void test_bench_expire(int arg) {
+	test_sink += arg;
+}
+
+// run random timer changes against the countdown model - returns the log CRC
+uint32_t test_random_run(uint32_t seed) {
+	int i, tick, delay, period, errors;
+	uint32_t due;
+
+	test_rand_state = seed;
+	test_log_crc = 0;
+	timer_wheel_init();
+	for(i = 0; i < TIMER_WHEEL_MAX_TIMERS; i ++) {
+		test_handles[i] = timer_wheel_alloc(test_expire, i);
+		test_model[i].count = 0;
+		test_model[i].period = 0;
+	}
+	HARNESS_CHECK(timer_wheel_alloc(test_expire, 0) == TIMER_WHEEL_NONE,
+		"alloc past the end did not fail");
+
+	errors = 0;
+	for(tick = 0; tick < TEST_TICKS; tick ++) {
+		// change a timer now and then - short and long delays
+		if((test_rand() & 0x0f) == 0) {
+			i = test_rand() % TIMER_WHEEL_MAX_TIMERS;
+			switch(test_rand() & 0x03) {
+				case 0:
+					timer_wheel_stop(test_handles[i]);
+					test_model[i].count = 0;
+					break;
+				default:
+					if(test_rand() & 0x01) {
+						delay = 1 + (test_rand() % 70);
+					}
+					else {
+						delay = 1 + (test_rand() % TIMER_WHEEL_MAX_DELAY);
+					}
+					period = 0;
+					if(test_rand() & 0x01) {
+						period = 1 + (test_rand() % ((test_rand() & 0x01) ? 10 : TIMER_WHEEL_MAX_DELAY));
+					}
+					timer_wheel_start(test_handles[i], delay, period);
+					test_model[i].count = delay;
+					test_model[i].period = period;
+					break;
+			}
+		}
+		if((tick & 0x3ff) == 0) {
+			for(i = 0; i < TIMER_WHEEL_MAX_TIMERS; i ++) {
+				HARNESS_CHECK(timer_wheel_is_running(test_handles[i]) == (test_model[i].count != 0),
+					"tick %d: timer %d running state is wrong", tick, i);
+			}
+		}
+
+		// the model
+		due = 0;
+		for(i = 0; i < TIMER_WHEEL_MAX_TIMERS; i ++) {
+			if(test_model[i].count) {
+				test_model[i].count --;
+				if(test_model[i].count == 0) {
+					due |= (1 << i);
+					test_model[i].count = test_model[i].period;
+				}
+			}
+		}
+
+		// the wheel
+		test_called = 0;
+		timer_wheel_task();
+		if(test_called != due && errors < 10) {
+			HARNESS_CHECK(0, "tick %d: timers called: %04x - due: %04x",
+				tick, test_called, due);
+			errors ++;
+		}
+	}
+	return test_log_crc;
+}
+
+// timers due on the same tick are called in the order they were started
+// - delays are short enough to stay in level 0
+void test_same_tick_order(void) {
+	int handles[TIMER_WHEEL_MAX_TIMERS];
+	int i, delay;
+	static int delays[] = {1, 20, 47};
+
+	for(delay = 0; delay < (int)(sizeof(delays) / sizeof(int)); delay ++) {
+		timer_wheel_init();
+		for(i = 0; i < TIMER_WHEEL_MAX_TIMERS; i ++) {
+			handles[i] = timer_wheel_alloc(test_order_expire, i);
+		}
+		// start the timers in a scrambled order over a few ticks
+		for(i = 0; i < TIMER_WHEEL_MAX_TIMERS; i ++) {
+			timer_wheel_start(handles[(i * 7) & (TIMER_WHEEL_MAX_TIMERS - 1)],
+				delays[delay] + TIMER_WHEEL_MAX_TIMERS - i, 0);
+			timer_wheel_task();
+		}
+		test_order_count = 0;
+		for(i = 0; i < delays[delay]; i ++) {
+			timer_wheel_task();
+		}
+		HARNESS_CHECK(test_order_count == TIMER_WHEEL_MAX_TIMERS,
+			"delay %d: %d of %d timers called", delays[delay], test_order_count,
+			TIMER_WHEEL_MAX_TIMERS);
+		for(i = 0; i < TIMER_WHEEL_MAX_TIMERS && i < test_order_count; i ++) {
+			HARNESS_CHECK(test_order[i] == ((i * 7) & (TIMER_WHEEL_MAX_TIMERS - 1)),
+				"delay %d: call %d was timer %d", delays[delay], i, test_order[i]);
+		}
+	}
+}
+
+// print the cost per tick against the number of running timers
+void test_bench(void) {
+	int handles[TIMER_WHEEL_MAX_TIMERS];
+	int counts[TIMER_WHEEL_MAX_TIMERS];
+	int num, i, tick;
+	double start, wheel, countdown;
+
+	for(num = 0; num <= TIMER_WHEEL_MAX_TIMERS; num += 4) {
+		// LED blinks and such - 10 to 200ms
+		timer_wheel_init();
+		test_rand_state = 1;
+		for(i = 0; i < num; i ++) {
+			handles[i] = timer_wheel_alloc(test_bench_expire, i);
+			timer_wheel_start(handles[i], 1 + (test_rand() % 800),
+				40 + (test_rand() % 760));
+		}
+		start = harness_now_ns();
+		for(tick = 0; tick < TEST_TICKS; tick ++) {
+			timer_wheel_task();
+		}
+		wheel = (harness_now_ns() - start) / TEST_TICKS;
+
+		// the same timers as countdowns
+		test_rand_state = 1;
+		for(i = 0; i < num; i ++) {
+			counts[i] = 1 + (test_rand() % 800);
+		}
+		start = harness_now_ns();
+		for(tick = 0; tick < TEST_TICKS; tick ++) {
+			for(i = 0; i < num; i ++) {
+				if(counts[i] && -- counts[i] == 0) {
+					test_bench_expire(i);
+					counts[i] = 100;
+				}
+			}
+			__asm__ volatile("" : : "r"(counts) : "memory");
+		}
+		countdown = (harness_now_ns() - start) / TEST_TICKS;
+		fprintf(stderr, "timer_wheel_test: %2d timers running: %.1fns per tick "
+			"(countdowns: %.1fns)\n", num, wheel, countdown);
+	}
+}
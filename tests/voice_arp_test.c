@@ -0,0 +1,231 @@
+/*
+ * K65 Phenol - Arpeggiator Test
+ *
+ * Copyright 2015: Andrew Kilpatrick
+ * Written by: Andrew Kilpatrick
+ *
+ * Runs the whole mixer firmware in arp mode on an external MIDI clock
+ * from 30 to 1000 BPM, with the fastest and slowest arp rates and short,
+ * half and full gate lengths. A chord is held and every gate edge on the
+ * CV / gate output must land on the 250us tick where the clock byte it
+ * belongs to arrives:
+ *	- the gate goes on at every step - every rate clocks
+ *	- the gate goes off the gate length after each step - or stays on
+ *	  for a full length gate
+ *	- there are no other gate edges
+ * The notes of each step must go up or down through the chord.
+ *
+ * The cost of an arp clock tick is printed against the number of notes
+ * held.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "harness.h"
+#include "mixer_run.h"
+#include "voice.h"
+
+#define TEST_CLOCKS 200  // clocks for each setup
+#define TEST_MAX_EDGES 1024
+#define TEST_CHORD 3
+
+// a gate output edge
+struct test_edge {
+	int tick;
+	int state;
+};
+
+struct test_edge test_edges[TEST_MAX_EDGES];
+int test_num_edges;
+int test_cv;
+int test_clock_tick[TEST_CLOCKS];  // tick each clock arrived on
+int test_step_cv[TEST_CLOCKS];  // CV after each clock
+
+// local functions
+void test_hook(const char *line);
+void test_quiet(const char *line);
+void test_run_ms(int ms);
+void test_arp(int bpm, int order, int rate, int gate);
+void test_bench(void);
+
+int main(int argc, char *argv[]) {
+	static int tempos[] = {30, 120, 300, 1000};
+	static int rates[] = {1, 2, 6, 24, 96};
+	static int gates[] = {0, 64, 126, 127};
+	int t, r, g;
+
+	harness_set_trace_hook(test_hook);
+	mixer_run_init();
+	test_run_ms(5000);  // startup settings time
+
+	// start the external clock
+	mixer_run_midi_send(0xfa);
+	for(t = 0; t < 10; t ++) {
+		mixer_run_midi_send(0xf8);
+		test_run_ms(20);
+	}
+
+	for(t = 0; t < (int)(sizeof(tempos) / sizeof(int)); t ++) {
+		for(r = 0; r < (int)(sizeof(rates) / sizeof(int)); r ++) {
+			for(g = 0; g < (int)(sizeof(gates) / sizeof(int)); g ++) {
+				test_arp(tempos[t], (g & 1) ? VOICE_ARP_DOWN : VOICE_ARP_UP,
+					rates[r], gates[g]);
+			}
+		}
+	}
+	test_bench();
+	return harness_done("voice_arp_test");
+}
+
+//
+// local functions
+//
+// take the gate and CV outputs from the trace
+void test_hook(const char *line) {
+	int chan, val;
+	if(sscanf(line, "cv_out %d %d", &chan, &val) == 2 && chan == 0) {
+		test_cv = val;
+	}
+	else if(sscanf(line, "gate_out %d %d", &chan, &val) == 2) {
+		if(test_num_edges < TEST_MAX_EDGES) {
+			test_edges[test_num_edges].tick = mixer_run_get_tick();
+			test_edges[test_num_edges].state = val;
+			test_num_edges ++;
+		}
+	}
+}
+
+// ignore the trace
+void test_quiet(const char *line) {
+}
+
+// run the firmware for a while
+void test_run_ms(int ms) {
+	int i;
+	for(i = 0; i < ms * 4; i ++) {
+		mixer_run_tick();
+	}
+}
+
+// hold a chord and check the gates for one arp setup
+void test_arp(int bpm, int order, int rate, int gate) {
+	int clock_us = 2500000 / bpm;  // 24 PPQ
+	int gate_ticks, start, clock, tick, i, e, step, steps, dir;
+	int expect[TEST_MAX_EDGES][2];
+	int num_expect;
+
+	voice_set_mode(VOICE_MODE_ARP, 60);
+	voice_set_arp_order(order);
+	voice_set_arp_octaves(1);
+	voice_set_arp_rate(rate);
+	voice_set_arp_gate(gate);
+	gate_ticks = (rate * (gate + 1)) >> 7;
+	if(gate_ticks < 1) gate_ticks = 1;
+	if(gate_ticks >= rate) gate_ticks = 0;
+
+	// hold a chord between clocks so the note bytes don't hold up a clock
+	mixer_run_midi_send(0x90);
+	mixer_run_midi_send(0x3c);
+	mixer_run_midi_send(0x64);
+	mixer_run_midi_send(0x40);
+	mixer_run_midi_send(0x64);
+	mixer_run_midi_send(0x43);
+	mixer_run_midi_send(0x64);
+	test_run_ms(5);
+
+	// send the clocks
+	test_num_edges = 0;
+	start = mixer_run_get_tick();
+	for(clock = 0; clock < TEST_CLOCKS; clock ++) {
+		tick = start + (int)(((long long)clock * clock_us) / MIXER_RUN_TICK_US);
+		while(mixer_run_get_tick() < tick) {
+			mixer_run_tick();
+		}
+		mixer_run_midi_send(0xf8);
+		test_clock_tick[clock] = mixer_run_get_tick();
+		mixer_run_tick();
+		test_step_cv[clock] = test_cv;
+	}
+	tick = mixer_run_get_tick();
+
+	// the gate edges there should be - the first step is on the first clock
+	num_expect = 0;
+	steps = 0;
+	for(clock = 0; clock < TEST_CLOCKS; clock += rate) {
+		if(clock == 0 || gate_ticks) {
+			expect[num_expect][0] = test_clock_tick[clock];
+			expect[num_expect][1] = 1;
+			num_expect ++;
+		}
+		if(gate_ticks && clock + gate_ticks < TEST_CLOCKS) {
+			expect[num_expect][0] = test_clock_tick[clock + gate_ticks];
+			expect[num_expect][1] = 0;
+			num_expect ++;
+		}
+		steps ++;
+	}
+	for(e = 0; e < test_num_edges && e < num_expect; e ++) {
+		if(test_edges[e].tick != expect[e][0] || test_edges[e].state != expect[e][1]) {
+			break;
+		}
+	}
+	HARNESS_CHECK(e == num_expect && e == test_num_edges,
+		"%d BPM rate %d gate %d: edge %d is gate %d on tick %d - wanted gate %d on tick %d",
+		bpm, rate, gate, e, e < test_num_edges ? test_edges[e].state : -1,
+		e < test_num_edges ? test_edges[e].tick - start : -1,
+		e < num_expect ? expect[e][1] : -1, e < num_expect ? expect[e][0] - start : -1);
+
+	// notes go up or down through the chord
+	dir = (order == VOICE_ARP_DOWN) ? -1 : 1;
+	for(step = 0; step + 1 < steps; step ++) {
+		i = test_step_cv[(step + 1) * rate] - test_step_cv[step * rate];
+		if(((step + 1) % TEST_CHORD) == 0) {
+			i = -i;  // back to the start of the chord
+		}
+		if(i * dir <= 0) {
+			HARNESS_CHECK(0, "%d BPM rate %d gate %d: step %d goes the wrong way",
+				bpm, rate, gate, step);
+			break;
+		}
+	}
+
+	// let go
+	mixer_run_midi_send(0x80);
+	mixer_run_midi_send(0x3c);
+	mixer_run_midi_send(0x00);
+	mixer_run_midi_send(0x40);
+	mixer_run_midi_send(0x00);
+	mixer_run_midi_send(0x43);
+	mixer_run_midi_send(0x00);
+	mixer_run_midi_send(0xf8);  // the arp stops on the next step
+	test_run_ms(5);
+}
+
+// print the cost of a clock tick against the number of notes held
+void test_bench(void) {
+	int held, i, note;
+	double start;
+
+	harness_set_trace_hook(test_quiet);
+	voice_set_mode(VOICE_MODE_ARP, 60);
+	voice_set_arp_rate(1);
+	voice_set_arp_octaves(4);
+	note = 24;
+	for(held = 1; held <= 64; held <<= 1) {
+		while(note < 24 + held) {
+			voice_note_on(0, note, 100);
+			note ++;
+		}
+		for(i = VOICE_ARP_UP; i <= VOICE_ARP_PLAYED; i ++) {
+			voice_set_arp_order(i);
+		}
+		start = harness_now_ns();
+		for(i = 0; i < 1000000; i ++) {
+			voice_set_arp_order(i & 0x03);
+			voice_clock_tick();
+		}
+		fprintf(stderr, "voice_arp_test: %2d notes held: %.1fns per clock tick\n",
+			held, (harness_now_ns() - start) / 1000000);
+	}
+	harness_set_trace_hook(test_hook);
+}
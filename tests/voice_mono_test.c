@@ -0,0 +1,399 @@
+/*
+ * K65 Phenol - Mono Note Priority Test
+ *
+ * Copyright 2015: Andrew Kilpatrick
+ * Written by: Andrew Kilpatrick
+ *
+ * Plays random MIDI streams - chords, held notes, repeated notes and the
+ * damper pedal - into voice 0 in single mode and looks at the CV / gate
+ * output after every event:
+ *	- with last note priority and up to 4 keys held it must do the same
+ *	  as the old 8 slot ring, which is copied in here - except from where
+ *	  the ring lost a key that was still held until every key is let go,
+ *	  which is counted
+ *	- with last, highest and lowest note priority and up to 40 keys held
+ *	  the output must be the held key with the highest priority, or the
+ *	  last note held by the damper once every key is let go
+ *
+ * The cost per event of a glissando up and down the keyboard and of 48
+ * note chords is printed for each priority. The chords must cost about
+ * the same per event as the glissando - the held keys don't add work.
+ *
+ */
+#include <stdio.h>
+#include <string.h>
+#include "plib.h"
+#include "harness.h"
+#include "voice.h"
+#include "cv_gate_ctrl.h"
+#include "seq_store.h"
+
+#define TEST_EVENTS 20000
+#define TEST_OLD_MAX 8  // slots in the old ring
+#define TEST_OLD_HELD 4  // held keys - the ring doesn't get back in step with more
+#define TEST_MAX_HELD 40
+#define TEST_CHORD 48  // notes in a bench chord
+#define TEST_BENCH_EVENTS 200000
+#define TEST_GROWTH_MAX 2.0  // most a chord event can cost over a glissando event
+
+// events
+#define TEST_NOTE_ON 0
+#define TEST_NOTE_OFF 1
+#define TEST_DAMPER 2
+
+struct test_event {
+	int type;
+	int value;
+};
+
+// the old note ring from voice.c
+struct test_old {
+	uint8_t prio[TEST_OLD_MAX];
+	int pos;
+	int cur;
+	int playing;
+	int keypressed;
+	int damper;
+};
+
+struct test_event test_events[TEST_EVENTS];
+struct test_event test_bench[TEST_BENCH_EVENTS];
+uint8_t test_gate[2];  // gate and note on this unit
+uint8_t test_note[2];
+uint32_t test_rand_state = 1;
+
+// local functions
+uint32_t test_rand(void);
+void test_make(int max_held);
+void test_play(struct test_event *ev);
+void test_check_old(void);
+void test_check_prio(int prio);
+int test_old_event(struct test_old *old, struct test_event *ev);
+void test_old_out(struct test_old *old, int note, int on);
+void test_make_glide(void);
+void test_make_chords(void);
+double test_bench_run(int prio);
+
+int main(int argc, char *argv[]) {
+	static const char *names[] = {"last", "high", "low"};
+	double glide_ns, chord_ns;
+	int prio;
+
+	plib_flash_reset();
+	seq_store_init();
+	voice_init();
+	voice_set_mode(VOICE_MODE_SINGLE, 0);
+
+	test_make(TEST_OLD_HELD);
+	test_check_old();
+	test_make(TEST_MAX_HELD);
+	for(prio = VOICE_PRIO_LAST; prio <= VOICE_PRIO_LOW; prio ++) {
+		test_check_prio(prio);
+	}
+
+	for(prio = VOICE_PRIO_LAST; prio <= VOICE_PRIO_LOW; prio ++) {
+		test_make_glide();
+		glide_ns = test_bench_run(prio);
+		test_make_chords();
+		chord_ns = test_bench_run(prio);
+		fprintf(stderr, "voice_mono_test: %s note priority: glissando %.1fns / event - "
+			"%d note chords %.1fns / event\n", names[prio], glide_ns, TEST_CHORD, chord_ns);
+		HARNESS_CHECK(chord_ns < glide_ns * TEST_GROWTH_MAX,
+			"%s note priority: chords took %.1fns / event - glissando %.1fns",
+			names[prio], chord_ns, glide_ns);
+	}
+	return harness_done("voice_mono_test");
+}
+
+//
+// local functions
+//
+// repeatable random numbers
+uint32_t test_rand(void) {
+	test_rand_state ^= test_rand_state << 13;
+	test_rand_state ^= test_rand_state >> 17;
+	test_rand_state ^= test_rand_state << 5;
+	return test_rand_state;
+}
+
+// make up a stream - the more held the more likely to let go
+void test_make(int max_held) {
+	uint8_t held[128];
+	int i, note, num_held = 0, damper = 0;
+
+	memset(held, 0, sizeof(held));
+	for(i = 0; i < TEST_EVENTS; i ++) {
+		note = 36 + (test_rand() % 48);
+		if(num_held == max_held || (int)(test_rand() % (max_held * 2)) < num_held) {
+			// let go of a held note
+			while(!held[note]) {
+				note = 36 + (test_rand() % 48);
+			}
+			test_events[i].type = TEST_NOTE_OFF;
+			test_events[i].value = note;
+			held[note] = 0;
+			num_held --;
+		}
+		else if((test_rand() % 40) == 0) {
+			damper ^= 1;
+			test_events[i].type = TEST_DAMPER;
+			test_events[i].value = damper;
+		}
+		else {
+			// a note that is held already is played again
+			test_events[i].type = TEST_NOTE_ON;
+			test_events[i].value = note;
+			if(!held[note]) {
+				held[note] = 1;
+				num_held ++;
+			}
+		}
+	}
+}
+
+// play an event and let retriggers finish
+void test_play(struct test_event *ev) {
+	int i;
+	switch(ev->type) {
+		case TEST_NOTE_ON:
+			voice_note_on(0, ev->value, 100);
+			break;
+		case TEST_NOTE_OFF:
+			voice_note_off(0, ev->value);
+			break;
+		case TEST_DAMPER:
+			voice_damper(0, ev->value);
+			break;
+	}
+	for(i = 0; i < 4; i ++) {
+		voice_timer_task();
+	}
+}
+
+// check last note priority against the old ring
+void test_check_old(void) {
+	struct test_old old;
+	uint8_t held[128];
+	int i, num_held = 0, lost = 0, losses = 0, compared = 0, errors = 0;
+	struct test_event *ev;
+
+	voice_set_priority(VOICE_PRIO_LAST);
+	voice_all_notes_off(0);
+	memset(&old, 0, sizeof(old));
+	memset(held, 0, sizeof(held));
+	old.cur = test_note[0];
+	for(i = 0; i < TEST_EVENTS && errors < 10; i ++) {
+		ev = &test_events[i];
+		test_play(ev);
+		if(test_old_event(&old, ev)) {
+			lost = 1;
+			losses ++;
+		}
+		if(ev->type == TEST_NOTE_ON && !held[ev->value]) {
+			held[ev->value] = 1;
+			num_held ++;
+		}
+		else if(ev->type == TEST_NOTE_OFF) {
+			held[ev->value] = 0;
+			num_held --;
+		}
+		// the ring is in step again once every key is let go
+		if(lost) {
+			if(num_held == 0) {
+				memset(old.prio, 0, sizeof(old.prio));
+				old.cur = test_note[0];
+				old.playing = test_gate[0];
+				lost = 0;
+			}
+			continue;
+		}
+		compared ++;
+		if(test_gate[0] != old.playing || (old.playing && test_note[0] != old.cur)) {
+			HARNESS_CHECK(0, "event %d: %s %d: gate %d note %d - old ring gate %d note %d",
+				i, ev->type == TEST_NOTE_OFF ? "note off" : ev->type == TEST_NOTE_ON ?
+				"note on" : "damper", ev->value, test_gate[0], test_note[0],
+				old.playing, old.cur);
+			errors ++;
+		}
+	}
+	fprintf(stderr, "voice_mono_test: %d of %d events the same as the old ring - "
+		"it lost a held key %d times\n", compared, TEST_EVENTS, losses);
+	HARNESS_CHECK(compared > TEST_EVENTS / 2, "only %d events were compared", compared);
+}
+
+// play an event on the old ring - returns 1 if the ring lost a held key
+int test_old_event(struct test_old *old, struct test_event *ev) {
+	int i, rev, lost = 0;
+	switch(ev->type) {
+		case TEST_NOTE_ON:
+			for(i = 0; i < TEST_OLD_MAX; i ++) {
+				if(old->prio[i] == ev->value) {
+					old->prio[i] = 0;
+				}
+			}
+			old->pos = (old->pos + 1) & 0x07;
+			if(old->prio[old->pos]) {
+				lost = 1;
+			}
+			old->prio[old->pos] = ev->value;
+			test_old_out(old, ev->value, 1);
+			old->keypressed = 1;
+			break;
+		case TEST_NOTE_OFF:
+			for(i = 0; i < TEST_OLD_MAX; i ++) {
+				if(old->prio[i] == ev->value) {
+					old->prio[i] = 0;
+				}
+			}
+			if(old->prio[old->pos]) {
+				break;
+			}
+			for(rev = (old->pos - 1) & 0x07; rev != old->pos; rev = (rev - 1) & 0x07) {
+				if(old->prio[rev]) {
+					test_old_out(old, old->prio[rev], 1);
+					old->pos = rev;
+					return 0;
+				}
+			}
+			old->keypressed = 0;
+			if(!old->damper) {
+				test_old_out(old, old->cur, 0);
+			}
+			break;
+		case TEST_DAMPER:
+			old->damper = ev->value;
+			if(!old->damper && old->cur && !old->keypressed) {
+				test_old_out(old, old->cur, 0);
+			}
+			break;
+	}
+	return lost;
+}
+
+// old ring output
+void test_old_out(struct test_old *old, int note, int on) {
+	old->cur = note;
+	old->playing = on;
+}
+
+// check a note priority against the held keys
+void test_check_prio(int prio) {
+	uint8_t order[128];  // held keys - oldest first
+	int i, j, num_held = 0, want, gate, note, errors = 0, damper = 0;
+	struct test_event *ev;
+
+	voice_set_priority(prio);
+	voice_all_notes_off(0);
+	gate = 0;
+	note = 0;
+	for(i = 0; i < TEST_EVENTS && errors < 10; i ++) {
+		ev = &test_events[i];
+		test_play(ev);
+		// take the key out of the order - a note on puts it back at the end
+		if(ev->type == TEST_NOTE_ON || ev->type == TEST_NOTE_OFF) {
+			for(j = 0; j < num_held && order[j] != ev->value; j ++);
+			if(j < num_held) {
+				memmove(&order[j], &order[j + 1], num_held - j - 1);
+				num_held --;
+			}
+			if(ev->type == TEST_NOTE_ON) {
+				order[num_held ++] = ev->value;
+			}
+		}
+		else {
+			damper = ev->value;
+		}
+		if(num_held) {
+			want = order[num_held - 1];
+			for(j = 0; j < num_held; j ++) {
+				if((prio == VOICE_PRIO_HIGH && order[j] > want) ||
+						(prio == VOICE_PRIO_LOW && order[j] < want)) {
+					want = order[j];
+				}
+			}
+			gate = 1;
+			note = want;
+		}
+		// no keys - the damper holds the last note
+		else if(!damper) {
+			gate = 0;
+		}
+		if(test_gate[0] != gate || (gate && test_note[0] != note)) {
+			HARNESS_CHECK(0, "prio %d: event %d: %d keys held: gate %d note %d - wanted "
+				"gate %d note %d", prio, i, num_held, test_gate[0], test_note[0], gate, note);
+			errors ++;
+		}
+	}
+}
+
+// make a legato glissando up and down the keyboard
+void test_make_glide(void) {
+	int i, note = NOTE_LOW, dir = 1;
+	for(i = 0; i < TEST_BENCH_EVENTS; i += 2) {
+		test_bench[i].type = TEST_NOTE_ON;
+		test_bench[i].value = note + dir;
+		test_bench[i + 1].type = TEST_NOTE_OFF;
+		test_bench[i + 1].value = note;
+		note += dir;
+		if(note + dir > NOTE_HIGH || note + dir < NOTE_LOW) {
+			dir = -dir;
+		}
+	}
+}
+
+// make chords - all the notes go down and then come up in a random order
+void test_make_chords(void) {
+	uint8_t notes[TEST_CHORD];
+	int i, j, k, tmp;
+	for(i = 0; i < TEST_BENCH_EVENTS; i += TEST_CHORD * 2) {
+		for(j = 0; j < TEST_CHORD; j ++) {
+			notes[j] = NOTE_LOW + 24 + j;
+		}
+		for(j = TEST_CHORD - 1; j > 0; j --) {
+			k = test_rand() % (j + 1);
+			tmp = notes[j];
+			notes[j] = notes[k];
+			notes[k] = tmp;
+		}
+		for(j = 0; j < TEST_CHORD * 2 && (i + j) < TEST_BENCH_EVENTS; j ++) {
+			test_bench[i + j].type = j < TEST_CHORD ? TEST_NOTE_ON : TEST_NOTE_OFF;
+			test_bench[i + j].value = notes[j < TEST_CHORD ? j : (TEST_CHORD * 2) - 1 - j];
+		}
+	}
+}
+
+// time the bench events through voice_note_on / off
+double test_bench_run(int prio) {
+	double start;
+	int i;
+	voice_set_priority(prio);
+	voice_all_notes_off(0);
+	start = harness_now_ns();
+	for(i = 0; i < TEST_BENCH_EVENTS; i ++) {
+		if(test_bench[i].type == TEST_NOTE_ON) {
+			voice_note_on(0, test_bench[i].value, 100);
+		}
+		else {
+			voice_note_off(0, test_bench[i].value);
+		}
+	}
+	return (harness_now_ns() - start) / TEST_BENCH_EVENTS;
+}
+
+//
+// cv_gate_ctrl.c - only what the voice manager uses
+//
+void cv_gate_ctrl_note(unsigned char chan, unsigned char note, unsigned char on) {
+	test_note[chan & 0x01] = note;
+	test_gate[chan & 0x01] = on;
+}
+
+void cv_gate_ctrl_bend(unsigned char chan, int bend) {
+}
+
+void cv_gate_ctrl_cv(unsigned char chan, unsigned int val) {
+}
+
+void cv_gate_ctrl_gate(unsigned char chan, unsigned char on) {
+	test_gate[chan & 0x01] = on;
+}
@@ -0,0 +1,280 @@
+/*
+ * K65 Phenol - Chained Poly Unit Test
+ *
+ * Copyright 2015: Andrew Kilpatrick
+ * Written by: Andrew Kilpatrick
+ *
+ * Plays one random MIDI stream - chords bigger than all the voices, held
+ * notes, repeated notes and the damper pedal - into 1 to 8 chained units
+ * in poly mode. Each unit is run over the whole stream in turn with its
+ * own unit number, and the outputs of all the units are put side by side
+ * after every event:
+ *	- every unit must have the same slot table
+ *	- a note never sounds on two voices at once
+ *	- a note that is sounding is held by a key or the damper
+ *	- a note on always gets a voice
+ *	- a voice only stops or changes for a note off, the damper going up,
+ *	  or a note on that steals it while every voice is busy
+ *
+ */
+#include <stdio.h>
+#include <string.h>
+#include "plib.h"
+#include "harness.h"
+#include "voice.h"
+#include "cv_gate_ctrl.h"
+#include "seq_store.h"
+
+#define TEST_EVENTS 20000
+#define TEST_MAX_UNITS 8
+#define TEST_VOICES (TEST_MAX_UNITS * 2)
+
+// events
+#define TEST_NOTE_ON 0
+#define TEST_NOTE_OFF 1
+#define TEST_DAMPER 2
+
+struct test_event {
+	int type;
+	int value;
+};
+
+// slot table in voice.c
+extern unsigned char note_poly_slots[];
+extern unsigned char note_poly_hold[];
+extern unsigned int note_poly_time[];
+
+struct test_event test_events[TEST_EVENTS];
+uint8_t test_out[TEST_EVENTS][TEST_VOICES];  // note on each voice after each event - 0 = off
+uint32_t test_slot_crc[TEST_EVENTS][TEST_MAX_UNITS];
+uint8_t test_gate[2];  // gate and note on this unit
+uint8_t test_note[2];
+uint32_t test_rand_state = 1;
+
+// local functions
+uint32_t test_rand(void);
+void test_make(void);
+void test_run_unit(int units, int unit);
+void test_check(int units);
+
+int main(int argc, char *argv[]) {
+	int units, unit;
+
+	plib_flash_reset();
+	seq_store_init();
+	test_make();
+	for(units = 1; units <= TEST_MAX_UNITS; units ++) {
+		for(unit = 0; unit < units; unit ++) {
+			test_run_unit(units, unit);
+		}
+		test_check(units);
+	}
+	return harness_done("voice_poly_test");
+}
+
+//
+// local functions
+//
+// repeatable random numbers
+uint32_t test_rand(void) {
+	test_rand_state ^= test_rand_state << 13;
+	test_rand_state ^= test_rand_state >> 17;
+	test_rand_state ^= test_rand_state << 5;
+	return test_rand_state;
+}
+
+// make up a stream - a small range of notes so notes repeat a lot
+void test_make(void) {
+	uint8_t held[128];
+	int i, note, num_held = 0, damper = 0;
+
+	memset(held, 0, sizeof(held));
+	for(i = 0; i < TEST_EVENTS; i ++) {
+		note = 48 + (test_rand() % 24);
+		// sometimes play big chords - the more held the more likely to let go
+		if((int)(test_rand() % 24) < num_held) {
+			// let go of a held note
+			while(!held[note]) {
+				note = 48 + (test_rand() % 24);
+			}
+			test_events[i].type = TEST_NOTE_OFF;
+			test_events[i].value = note;
+			held[note] = 0;
+			num_held --;
+		}
+		else if((test_rand() % 40) == 0) {
+			damper ^= 1;
+			test_events[i].type = TEST_DAMPER;
+			test_events[i].value = damper;
+		}
+		else {
+			// a note that is held already is played again
+			test_events[i].type = TEST_NOTE_ON;
+			test_events[i].value = note;
+			if(!held[note]) {
+				held[note] = 1;
+				num_held ++;
+			}
+		}
+	}
+}
+
+// run the stream on one unit and keep its outputs
+void test_run_unit(int units, int unit) {
+	int i, j;
+	uint32_t crc;
+	struct test_event *ev;
+
+	voice_init();
+	voice_set_units(units);
+	voice_set_unit(unit);
+	voice_set_mode(VOICE_MODE_POLY, 0);
+	HARNESS_CHECK(voice_get_units() == units && voice_get_unit() == unit,
+		"%d units: could not set unit %d", units, unit);
+	test_gate[0] = 0;
+	test_gate[1] = 0;
+	for(i = 0; i < TEST_EVENTS; i ++) {
+		ev = &test_events[i];
+		switch(ev->type) {
+			case TEST_NOTE_ON:
+				voice_note_on(0, ev->value, 100);
+				break;
+			case TEST_NOTE_OFF:
+				voice_note_off(0, ev->value);
+				break;
+			case TEST_DAMPER:
+				voice_damper(0, ev->value);
+				break;
+		}
+		// let retriggers finish
+		for(j = 0; j < 4; j ++) {
+			voice_timer_task();
+		}
+		test_out[i][unit * 2] = test_gate[0] ? test_note[0] : 0;
+		test_out[i][(unit * 2) + 1] = test_gate[1] ? test_note[1] : 0;
+		crc = 0;
+		for(j = 0; j < units * 2; j ++) {
+			crc = harness_crc(crc, (note_poly_slots[j] << 16) |
+				(note_poly_hold[j] << 8));
+			crc = harness_crc(crc, note_poly_time[j]);
+		}
+		test_slot_crc[i][unit] = crc;
+	}
+}
+
+// check the outputs of all the units
+void test_check(int units) {
+	uint8_t active[128], key[128];
+	int i, v, w, busy, changed, damper = 0, errors = 0;
+	struct test_event *ev;
+	uint8_t *before, *after;
+	static uint8_t none[TEST_VOICES];
+
+	memset(active, 0, sizeof(active));
+	memset(key, 0, sizeof(key));
+	for(i = 0; i < TEST_EVENTS && errors < 10; i ++) {
+		ev = &test_events[i];
+		before = i ? test_out[i - 1] : none;
+		after = test_out[i];
+
+		// the notes that should be able to sound
+		switch(ev->type) {
+			case TEST_NOTE_ON:
+				key[ev->value] = 1;
+				active[ev->value] = 1;
+				break;
+			case TEST_NOTE_OFF:
+				key[ev->value] = 0;
+				if(!damper) {
+					active[ev->value] = 0;
+				}
+				break;
+			case TEST_DAMPER:
+				damper = ev->value;
+				if(!damper) {
+					memcpy(active, key, sizeof(active));
+				}
+				break;
+		}
+
+		for(v = 1; v < units; v ++) {
+			if(test_slot_crc[i][v] != test_slot_crc[i][0]) {
+				HARNESS_CHECK(0, "%d units: event %d: unit %d has a different slot table",
+					units, i, v);
+				errors ++;
+				break;
+			}
+		}
+
+		busy = 0;
+		changed = 0;
+		for(v = 0; v < units * 2; v ++) {
+			if(before[v]) {
+				busy ++;
+			}
+			if(after[v] == 0) {
+				continue;
+			}
+			for(w = v + 1; w < units * 2; w ++) {
+				if(after[w] == after[v]) {
+					HARNESS_CHECK(0, "%d units: event %d: note %d on voices %d and %d",
+						units, i, after[v], v, w);
+					errors ++;
+				}
+			}
+			if(!active[after[v]]) {
+				HARNESS_CHECK(0, "%d units: event %d: note %d sounds but is not held",
+					units, i, after[v]);
+				errors ++;
+			}
+		}
+		for(v = 0; v < units * 2; v ++) {
+			if(!before[v] || before[v] == after[v]) {
+				continue;
+			}
+			// let go - fine
+			if(!active[before[v]]) {
+				continue;
+			}
+			// stolen for the new note while every voice was busy
+			if(ev->type == TEST_NOTE_ON && after[v] == ev->value &&
+					busy == units * 2 && changed == 0) {
+				changed = 1;
+				continue;
+			}
+			HARNESS_CHECK(0, "%d units: event %d: note %d on voice %d was dropped",
+				units, i, before[v], v);
+			errors ++;
+		}
+		if(ev->type == TEST_NOTE_ON) {
+			for(v = 0; v < units * 2; v ++) {
+				if(after[v] == ev->value) {
+					break;
+				}
+			}
+			if(v == units * 2) {
+				HARNESS_CHECK(0, "%d units: event %d: note on %d did not get a voice",
+					units, i, ev->value);
+				errors ++;
+			}
+		}
+	}
+}
+
+//
+// cv_gate_ctrl.c - only what the voice manager uses
+//
+void cv_gate_ctrl_note(unsigned char chan, unsigned char note, unsigned char on) {
+	test_note[chan & 0x01] = note;
+	test_gate[chan & 0x01] = on;
+}
+
+void cv_gate_ctrl_bend(unsigned char chan, int bend) {
+}
+
+void cv_gate_ctrl_cv(unsigned char chan, unsigned int val) {
+}
+
+void cv_gate_ctrl_gate(unsigned char chan, unsigned char on) {
+	test_gate[chan & 0x01] = on;
+}